@@ -1,7 +1,19 @@
-#define _POSIX_C_SOURCE 199309L
+#define _POSIX_C_SOURCE 200809L
 #include "backup_manager.h"
 #include "deduplication.h"
 #include "file_handler.h"
+#include "metadata.h"
+#include "filter.h"
+#include "change_journal.h"
+#include "dir_walk.h"
+#include "read_scheduler.h"
+#include "cache_io.h"
+#include "throttle.h"
+#include "durable.h"
+#include "pack.h"
+#include "seal.h"
+#include "catalog.h"
+#include "network.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -10,6 +22,11 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <errno.h>
+#include <libgen.h>
+#include <pthread.h>
 
 // Fonction utilitaire pour générer un nom de répertoire avec le format "YYYY-MM-DD-hh:mm:ss.sss"
 void generate_backup_name(char *buffer, size_t size) {
@@ -132,62 +149,117 @@ const char *find_most_recent_folder(log_t *logs) {
     return folder_name; // Retourner le nom du dossier (ex: "2024-12-15-16:37:24.967")
 }
 
-void process_directory(const char *directory_path, FILE *logs, const char *backup_dir) {
-    DIR *dir;
-    struct dirent *entry;
+// Fonction pour écrire dans logfile la ligne d'un fichier ou d'un lien symbolique de la sauvegarde
+static void write_entry_line(const char *file_to_process, const struct stat *statbuf, FILE *logfile,
+                             const char *backup_dir, size_t root_len, InodeMap *inodes) {
+    log_element test_element;
+    if (create_log_element_from_file(file_to_process, &test_element) != 0) {
+        return;
+    }
+
+    // Les chemins suivants d'un même inode sont enregistrés comme liens durs vers le premier
+    if (S_ISREG(statbuf->st_mode) && statbuf->st_nlink > 1) {
+        const char *first = inode_map_find_or_add(inodes, statbuf, file_to_process + root_len + 1);
+        if (first) {
+            test_element.hardlink = strdup(first);
+        }
+    }
+
+    write_log_element(&test_element, logfile, backup_dir);
+
+    // Libère la mémoire allouée pour les éléments de log
+    free((char *)test_element.path);
+    free(test_element.date);
+    free_file_metadata(&test_element);
+}
+
+// Fonction pour écrire dans log_path la ligne d'un fichier ou d'un lien symbolique de la sauvegarde
+static void log_entry(const char *file_to_process, const struct stat *statbuf, const char *log_path,
+                      const char *backup_dir, size_t root_len, InodeMap *inodes) {
+    FILE *logfile = fopen(log_path, "a");
+    if (!logfile) {
+        perror("Erreur lors de l'ouverture du fichier de log");
+        return;
+    }
+    write_entry_line(file_to_process, statbuf, logfile, backup_dir, root_len, inodes);
+    fclose(logfile);
+}
+
+// Paramètres de l'écriture du log d'une sauvegarde
+// root_len est la longueur du chemin de la sauvegarde ; inodes associe chaque inode déjà
+// rencontré à son chemin relatif, pour enregistrer les liens durs internes à la sauvegarde
+typedef struct {
+    const char *log_path;
+    const char *backup_dir;
+    size_t root_len;
+    InodeMap *inodes;
+} LogWalk;
+
+// Fonction pour écrire la ligne d'un fichier lu par la file de lectures
+static void log_scheduled_entry(const ReadJob *job, void *arg) {
+    const LogWalk *walk = arg;
+    log_entry(job->path, &job->st, walk->log_path, walk->backup_dir, walk->root_len, walk->inodes);
+}
+
+// Fonction récursive d'écriture du log d'une sauvegarde
+// Le dossier est lu par son descripteur (parent_fd, name) ; path est son chemin complet
+// Les fichiers sont hachés par reads, dans l'ordre choisi par --read-order
+static void process_directory_links(int parent_fd, const char *name, PathBuffer *path, ReadScheduler *reads) {
+    DirListing listing;
 
     // Ouvre le dossier
-    dir = opendir(directory_path);
-    if (dir == NULL) {
+    if (dir_listing_open(parent_fd, name, &listing) != 0) {
         perror("Erreur lors de l'ouverture du dossier");
         return;
     }
 
     // Parcours les fichiers du dossier
-    while ((entry = readdir(dir)) != NULL) {
-        // Ignore les fichiers "." et ".."
-        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
-            continue;
-        }
-
-        // Construit le chemin complet du fichier/dossier
-        char file_to_process[1024];
-        snprintf(file_to_process, sizeof(file_to_process), "%s/%s", directory_path, entry->d_name);
+    for (int i = 0; i < listing.count; i++) {
+        DirEntry *entry = &listing.entries[i];
 
-        // Vérifie si l'entrée est un répertoire
+        // Vérifie si l'entrée est un répertoire (sans suivre les liens symboliques)
         struct stat statbuf;
-        if (stat(file_to_process, &statbuf) == -1) {
+        if (dir_entry_stat(&listing, entry, &statbuf) == -1) {
             perror("Erreur lors de la récupération des informations du fichier");
             continue;
         }
 
+        // Construit le chemin complet du fichier/dossier
+        size_t len = path_buffer_push(path, entry->name);
         if (S_ISDIR(statbuf.st_mode)) {
             // Si c'est un répertoire, appel récursif sur le sous-dossier
-            process_directory(file_to_process, logs, backup_dir);
-        } else if (S_ISREG(statbuf.st_mode)) {
-            // Si c'est un fichier, traitement du fichier
-            log_element test_element;
-            create_log_element_from_file(file_to_process, &test_element);
-
-            // Écriture dans le fichier de log
-            FILE *logfile = fopen(logs, "a");
-            if (!logfile) {
-                perror("Erreur lors de l'ouverture du fichier de log");
-                free(test_element.path);
-                free(test_element.date);
-                continue;
-            }
-            write_log_element(&test_element, logfile, backup_dir);
-            fclose(logfile);
-
-            // Libère la mémoire allouée pour les éléments de log
-            free(test_element.path);
-            free(test_element.date);
+            process_directory_links(listing.fd, entry->name, path, reads);
+        } else if (S_ISREG(statbuf.st_mode) || S_ISLNK(statbuf.st_mode)) {
+            // Si c'est un fichier ou un lien symbolique, traitement de l'entrée
+            read_scheduler_add(reads, path->buf, &statbuf, NULL);
         }
+        // Les fichiers spéciaux (périphériques, tubes, sockets) ne sont pas sauvegardés
+        path_buffer_pop(path, len);
     }
 
     // Ferme le dossier
-    closedir(dir);
+    dir_listing_close(&listing);
+}
+
+// Fonction pour écrire dans log_path les lignes du sous-arbre directory_path d'une sauvegarde
+static void process_subtree(const char *directory_path, const char *log_path, const char *backup_dir,
+                            size_t root_len, InodeMap *inodes) {
+    LogWalk walk = { log_path, backup_dir, root_len, inodes };
+    ReadScheduler reads;
+    PathBuffer path;
+    read_scheduler_init(&reads, log_scheduled_entry, &walk);
+    path_buffer_init(&path, directory_path);
+    process_directory_links(AT_FDCWD, directory_path, &path, &reads);
+    path_buffer_free(&path);
+    read_scheduler_finish(&reads);
+}
+
+// Fonction pour écrire dans log_path une ligne par fichier de la sauvegarde directory_path
+void process_directory(const char *directory_path, const char *log_path, const char *backup_dir) {
+    InodeMap inodes;
+    inode_map_init(&inodes);
+    process_subtree(directory_path, log_path, backup_dir, strlen(directory_path), &inodes);
+    inode_map_free(&inodes);
 }
 
 
@@ -217,386 +289,1685 @@ int file_exists_in_dir(const char *directory, const char *filename) {
 
 
 
+// Les copies stockées chiffrées sont comparées en clair : seules les tailles des données en clair comptent
 int files_are_different(const char *file1, const char *file2) {
-    struct stat stat1, stat2;
-
-    // Obtenir les informations des fichiers
-    if (stat(file1, &stat1) == -1 || stat(file2, &stat2) == -1) {
+    // Ouvrir les fichiers (lectures selon --cache-mode)
+    SealReader reader1, reader2;
+    if (seal_reader_open(&reader1, file1, 0, -1) != 0) {
+        perror("Erreur lors de l'accès aux fichiers pour comparaison");
+        return 1; // Considérer les fichiers comme différents si l'un des deux ne peut être ouvert
+    }
+    if (seal_reader_open(&reader2, file2, 0, -1) != 0) {
         perror("Erreur lors de l'accès aux fichiers pour comparaison");
-        return 1; // Considérer les fichiers comme différents si les stat échouent
+        seal_reader_close(&reader1);
+        return 1;
     }
 
     // Comparer les tailles des fichiers
-    if (stat1.st_size != stat2.st_size) {
+    if (reader1.size != reader2.size) {
+        seal_reader_close(&reader1);
+        seal_reader_close(&reader2);
         return 1; // Les fichiers ont des tailles différentes
     }
 
-    // Ouvrir les fichiers
-    FILE *f1 = fopen(file1, "rb");
-    FILE *f2 = fopen(file2, "rb");
+    // Lire et comparer le contenu des fichiers par blocs (un bloc déchiffré s'arrête à la fin de son segment)
+    const unsigned char *data1, *data2;
+    ssize_t size1, size2;
+    off_t offset = 0;
+    int different = 0;
 
-    if (!f1 || !f2) {
-        if (f1) fclose(f1);
-        if (f2) fclose(f2);
-        return 1; // Considérer les fichiers comme différents si l'un des deux ne peut être ouvert
-    }
-
-    // Lire et comparer le contenu des fichiers par blocs
-    char buffer1[4096], buffer2[4096];
-    size_t size1, size2;
-
-    do {
-        size1 = fread(buffer1, 1, sizeof(buffer1), f1);
-        size2 = fread(buffer2, 1, sizeof(buffer2), f2);
+    while (offset < reader1.size) {
+        size1 = seal_reader_pread(&reader1, offset, CACHE_IO_BUFFER_SIZE / 2, &data1);
+        size2 = size1 > 0 ? seal_reader_pread(&reader2, offset, size1, &data2) : -1;
 
-        if (size1 != size2 || memcmp(buffer1, buffer2, size1) != 0) {
-            fclose(f1);
-            fclose(f2);
-            return 1; // Les fichiers sont différents
+        if (size1 <= 0 || size2 <= 0 || memcmp(data1, data2, size2) != 0) {
+            different = 1; // Les fichiers sont différents (ou ont changé pendant la lecture)
+            break;
         }
-    } while (size1 > 0 && size2 > 0);
+        offset += size2;
+    }
 
-    fclose(f1);
-    fclose(f2);
+    seal_reader_close(&reader1);
+    seal_reader_close(&reader2);
+    if (different) {
+        return 1;
+    }
     return 0; // Les fichiers sont identiques
 }
 
 #include <unistd.h>
 
-void sync_directories(const char *dir1, const char *dir2) {
-    DIR *dir;
-    struct dirent *entry;
+// Fonction pour savoir si les métadonnées conservées d'un fichier ont changé
+static int metadata_differs(const struct stat *st1, const struct stat *st2) {
+    return st1->st_mode != st2->st_mode || st1->st_uid != st2->st_uid || st1->st_gid != st2->st_gid ||
+           st1->st_mtim.tv_sec != st2->st_mtim.tv_sec || st1->st_mtim.tv_nsec != st2->st_mtim.tv_nsec;
+}
 
-    // Vérifier les fichiers et sous-dossiers du premier répertoire (dir1)
-    dir = opendir(dir1);
-    if (dir == NULL) {
-        perror("Erreur lors de l'ouverture du premier répertoire");
+// Fonction pour savoir si deux liens symboliques pointent vers la même cible
+static int links_are_different(const char *link1, const char *link2) {
+    char target1[PATH_MAX], target2[PATH_MAX];
+    ssize_t len1 = readlink(link1, target1, sizeof(target1));
+    ssize_t len2 = readlink(link2, target2, sizeof(target2));
+    return len1 < 0 || len1 != len2 || memcmp(target1, target2, len1) != 0;
+}
+
+// Copie des seuls ajouts en fin de fichier (--append-tails)
+static int append_tails = 0;
+
+// Fonction pour ne copier que la fin ajoutée des fichiers qui n'ont fait que grandir
+void set_append_tails(int enabled) {
+    append_tails = enabled;
+}
+
+// Fonction pour copier dans la sauvegarde un fichier modifié de la source
+// Un fichier source déjà copié sous un autre nom (lien dur) est relié à cette copie
+// previous est la copie précédente du fichier (NULL si aucune) : avec --append-tails, si le
+// fichier n'a fait que grandir, seule la fin ajoutée est copiée depuis la source
+static void sync_copy_file(const char *source, const struct stat *st, const char *dest, const char *previous,
+                           InodeMap *inodes) {
+    const char *first = st->st_nlink > 1 ? inode_map_find_or_add(inodes, st, dest) : NULL;
+    if (first) {
+        unlink(dest);
+        if (link(first, dest) == 0) return;
+    }
+    if (append_tails && previous && copy_appended_file(source, previous, dest) == 0) {
         return;
     }
+    // copy_file supprime la destination avant de l'écrire : l'inode partagé avec
+    // la sauvegarde précédente n'est jamais modifié
+    copy_file(source, dest);
+}
 
-    while ((entry = readdir(dir)) != NULL) {
-        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
-            continue;
+// Fonction pour supprimer l'entrée name du répertoire parent_fd et tout son contenu
+static void remove_tree_at(int parent_fd, const char *name) {
+    struct stat st;
+    if (fstatat(parent_fd, name, &st, AT_SYMLINK_NOFOLLOW) == -1) {
+        return;
+    }
+    if (S_ISDIR(st.st_mode)) {
+        DirListing listing;
+        if (dir_listing_open(parent_fd, name, &listing) == 0) {
+            for (int i = 0; i < listing.count; i++) {
+                DirEntry *entry = &listing.entries[i];
+                // d_type évite un fstatat par fichier ; seuls les répertoires sont parcourus
+                if (entry->type == DT_DIR || entry->type == DT_UNKNOWN) {
+                    remove_tree_at(listing.fd, entry->name);
+                } else {
+                    unlinkat(listing.fd, entry->name, 0);
+                }
+            }
+            dir_listing_close(&listing);
         }
+        unlinkat(parent_fd, name, AT_REMOVEDIR);
+    } else {
+        unlinkat(parent_fd, name, 0);
+    }
+}
 
-        char filepath1[1024];
-        snprintf(filepath1, sizeof(filepath1), "%s/%s", dir1, entry->d_name);
+// Fonction pour supprimer une arborescence de la sauvegarde (entrée désormais exclue)
+static void remove_tree(const char *path) {
+    remove_tree_at(AT_FDCWD, path);
+}
 
-        char filepath2[1024];
-        snprintf(filepath2, sizeof(filepath2), "%s/%s", dir2, entry->d_name);
+// Nombre de threads copiant les fichiers modifiés lors d'une synchronisation (0 = nombre de cœurs)
+static int sync_threads = 0;
 
-        struct stat statbuf1, statbuf2;
+// Fonction pour choisir le nombre de threads de copie des synchronisations
+void set_sync_threads(int threads) {
+    sync_threads = threads;
+}
 
-        if (stat(filepath1, &statbuf1) == -1) {
-            perror("Erreur lors de l'obtention des informations du fichier source");
-            continue;
-        }
+// État partagé par les threads de copie d'une synchronisation
+typedef struct {
+    InodeMap *inodes;
+    pthread_mutex_t lock;     // Protège inodes : un groupe de liens durs est copié une seule fois
+} SyncCopy;
+
+// Fonction pour copier dans la sauvegarde (job->dest) un fichier ajouté ou modifié de la source (job->path)
+// La décision a été prise par la comparaison des répertoires ; cette fonction est appelée en parallèle
+static void sync_scheduled_file(const ReadJob *job, void *arg) {
+    SyncCopy *copy = arg;
+    // Le premier chemin d'un groupe de liens durs doit être entièrement copié avant que les suivants y soient liés
+    int grouped = job->st.st_nlink > 1;
+    if (grouped) pthread_mutex_lock(&copy->lock);
+    // La destination est encore la copie de la sauvegarde précédente (lien dur) si le fichier existait
+    sync_copy_file(job->path, &job->st, job->dest, job->dest, copy->inodes);
+    if (grouped) pthread_mutex_unlock(&copy->lock);
+}
 
-        if (S_ISDIR(statbuf1.st_mode)) {
-            // Si c'est un répertoire
-            if (stat(filepath2, &statbuf2) == -1) {
-                // Répertoire inexistant dans dir2 -> le supprimer
-                printf("Suppression du répertoire : %s\n", filepath1);
-                sync_directories(filepath1, filepath2);
-                rmdir(filepath1); // Supprime le répertoire une fois vide
-            } else {
-                sync_directories(filepath1, filepath2);
-            }
-        } else if (S_ISREG(statbuf1.st_mode)) {
-            // Si c'est un fichier
-            if (stat(filepath2, &statbuf2) == -1) {
-                // Fichier inexistant dans dir2 -> le supprimer
-                printf("Suppression du fichier : %s\n", filepath1);
-                unlink(filepath1); // Supprime le fichier
-            } else if (files_are_different(filepath1, filepath2)) {
-                // Vérifier si le fichier est un lien dur
-                if (statbuf1.st_nlink > 1) {
-                    // Le fichier a des liens durs, créer une copie unique
-                    printf("Le fichier %s a des liens durs, création d'une copie unique\n", filepath1);
-
-                    char temp_filepath[1024];
-                    snprintf(temp_filepath, sizeof(temp_filepath), "%s.tmp", filepath1);
-
-                    copy_file(filepath1, temp_filepath);  // Copie temporaire
-                    rename(temp_filepath, filepath1);     // Remplacement du fichier original
-                }
+// Fonction pour savoir si une entrée de la sauvegarde (st1) est à jour par rapport à la source (st2)
+// Comme pour --journal et --manifest-only, un fichier de même taille, date et propriétaire n'est pas relu
+static int sync_entry_unchanged(const struct stat *st1, const struct stat *st2) {
+    return !metadata_differs(st1, st2) && (!S_ISREG(st2->st_mode) || seal_size_matches(st1->st_size, st2->st_size));
+}
 
-                // Si le fichier est différent, le mettre à jour
-                printf("Mise à jour du fichier : %s -> %s\n", filepath2, filepath1);
-                copy_file(filepath2, filepath1);
-            }
-        }
+// Fonction pour ajouter à la sauvegarde (dir1) l'entrée name du répertoire source (dir2)
+static void sync_add_entry(DirListing *listing1, DirListing *listing2, const char *name, const struct stat *statbuf2,
+                           PathBuffer *dir1, PathBuffer *dir2, ReadScheduler *reads, const FilterScope *scope);
+
+// Fonction récursive de synchronisation de la sauvegarde dir1 avec le répertoire source dir2
+// Les deux répertoires sont lus une fois par leur descripteur (parent1_fd, name1) et (parent2_fd, name2),
+// triés par nom puis parcourus ensemble : chaque nom est soit absent de la source (suppression),
+// soit absent de la sauvegarde (ajout), soit présent des deux côtés (mise à jour éventuelle),
+// avec un seul fstatat de chaque côté. dir1 et dir2 sont leurs chemins complets ; les fichiers à
+// copier passent par reads. scope est la position dans le répertoire source dir2, pour les filtres
+static void sync_directories_links(int parent1_fd, const char *name1, int parent2_fd, const char *name2,
+                                   PathBuffer *dir1, PathBuffer *dir2, ReadScheduler *reads,
+                                   const FilterScope *scope) {
+    DirListing listing1, listing2;
+
+    if (dir_listing_open(parent1_fd, name1, &listing1) != 0) {
+        perror("Erreur lors de l'ouverture du premier répertoire");
+        return;
     }
-    closedir(dir);
-
-    // Vérifier les fichiers et sous-dossiers du deuxième répertoire (dir2)
-    dir = opendir(dir2);
-    if (dir == NULL) {
+    // Un répertoire source illisible n'a plus d'entrées : elles sont retirées de la sauvegarde
+    if (dir_listing_open(parent2_fd, name2, &listing2) != 0) {
         perror("Erreur lors de l'ouverture du deuxième répertoire");
-        return;
+        listing2.fd = -1;
     }
+    dir_listing_sort(&listing1);
+    dir_listing_sort(&listing2);
+
+    int i = 0, j = 0;
+    while (i < listing1.count || j < listing2.count) {
+        int order = i == listing1.count ? 1 : j == listing2.count ? -1
+                  : strcmp(listing1.entries[i].name, listing2.entries[j].name);
+        const char *name = order <= 0 ? listing1.entries[i].name : listing2.entries[j].name;
+        struct stat statbuf1, statbuf2;
 
-    while ((entry = readdir(dir)) != NULL) {
-        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+        if (order > 0) {
+            // Absent de la sauvegarde -> l'ajouter
+            if (dir_entry_stat(&listing2, &listing2.entries[j], &statbuf2) == -1) {
+                perror("Erreur lors de l'obtention des informations du fichier");
+            } else if (!filter_scope_excludes(scope, name, S_ISDIR(statbuf2.st_mode))) {
+                sync_add_entry(&listing1, &listing2, name, &statbuf2, dir1, dir2, reads, scope);
+            }
+            j++;
             continue;
         }
 
-        char filepath1[1024];
-        snprintf(filepath1, sizeof(filepath1), "%s/%s", dir1, entry->d_name);
-
-        char filepath2[1024];
-        snprintf(filepath2, sizeof(filepath2), "%s/%s", dir2, entry->d_name);
-
-        struct stat statbuf1;
-
-        if (stat(filepath2, &statbuf1) == -1) {
-            perror("Erreur lors de l'obtention des informations du fichier");
+        size_t len1 = path_buffer_push(dir1, name);
+        if (order < 0) {
+            // Absent de la source -> le supprimer (d_type évite un fstatat pour le message)
+            int is_dir = dir_entry_is_dir(&listing1, &listing1.entries[i]);
+            printf("Suppression du %s : %s\n", is_dir ? "répertoire" : "fichier", dir1->buf);
+            remove_tree_at(listing1.fd, name);
+            path_buffer_pop(dir1, len1);
+            i++;
             continue;
         }
 
-        if (S_ISDIR(statbuf1.st_mode)) {
-            // Si c'est un répertoire
-            if (stat(filepath1, &statbuf1) == -1) {
-                // Le répertoire n'existe pas dans dir1, le copier
-                printf("Ajout du répertoire : %s -> %s\n", filepath2, filepath1);
-                mkdir(filepath1, 0755);
-                sync_directories(filepath1, filepath2);
+        // Présent des deux côtés
+        size_t len2 = path_buffer_push(dir2, name);
+        if (dir_entry_stat(&listing1, &listing1.entries[i], &statbuf1) == -1 ||
+            dir_entry_stat(&listing2, &listing2.entries[j], &statbuf2) == -1) {
+            perror("Erreur lors de l'obtention des informations du fichier");
+        } else if (filter_scope_excludes(scope, name, S_ISDIR(statbuf2.st_mode))) {
+            // Entrée exclue depuis la sauvegarde précédente -> la retirer
+            printf("Exclusion : %s\n", dir1->buf);
+            remove_tree_at(listing1.fd, name);
+        } else if ((statbuf1.st_mode & S_IFMT) != (statbuf2.st_mode & S_IFMT)) {
+            // Type différent : l'entrée de la sauvegarde est remplacée
+            printf("Suppression du %s : %s\n", S_ISDIR(statbuf1.st_mode) ? "répertoire" : "fichier", dir1->buf);
+            remove_tree_at(listing1.fd, name);
+            path_buffer_pop(dir2, len2);
+            path_buffer_pop(dir1, len1);
+            sync_add_entry(&listing1, &listing2, name, &statbuf2, dir1, dir2, reads, scope);
+            i++;
+            j++;
+            continue;
+        } else if (S_ISDIR(statbuf2.st_mode)) {
+            FilterScope child;
+            filter_scope_enter(&child, scope, dir2->buf, name);
+            sync_directories_links(listing1.fd, name, listing2.fd, name, dir1, dir2, reads, &child);
+            filter_scope_leave(&child);
+        } else if (S_ISLNK(statbuf2.st_mode)) {
+            // Lien symbolique : le recréer si sa cible ou ses métadonnées ont changé
+            if (!sync_entry_unchanged(&statbuf1, &statbuf2) || links_are_different(dir1->buf, dir2->buf)) {
+                printf("Mise à jour du lien : %s -> %s\n", dir2->buf, dir1->buf);
+                copy_symlink(dir2->buf, dir1->buf);
             }
-        } else if (S_ISREG(statbuf1.st_mode)) {
-            // Si c'est un fichier
-            if (stat(filepath1, &statbuf1) == -1) {
-                // Le fichier n'existe pas dans dir1, le copier
-                printf("Ajout du fichier : %s -> %s\n", filepath2, filepath1);
-                copy_file(filepath2, filepath1);
-            } else if (files_are_different(filepath1, filepath2)) {
-                // Vérifier si le fichier est un lien dur
-                if (statbuf1.st_nlink > 1) {
-
-                    char temp_filepath[1024];
-                    snprintf(temp_filepath, sizeof(temp_filepath), "%s.tmp", filepath1);
-
-                    copy_file(filepath1, temp_filepath);  // Copie temporaire
-                    rename(temp_filepath, filepath1);     // Remplacement du fichier original
-                }
-
-                // Si le fichier est différent, le mettre à jour
-                printf("Mise à jour du fichier : %s -> %s\n", filepath2, filepath1);
-                copy_file(filepath2, filepath1);
+        } else if (S_ISREG(statbuf2.st_mode)) {
+            if (!sync_entry_unchanged(&statbuf1, &statbuf2)) {
+                printf("Mise à jour du fichier : %s -> %s\n", dir2->buf, dir1->buf);
+                read_scheduler_add(reads, dir2->buf, &statbuf2, dir1->buf);
             }
         }
+        path_buffer_pop(dir2, len2);
+        path_buffer_pop(dir1, len1);
+        i++;
+        j++;
     }
-    closedir(dir);
-}
-
-
 
+    // Les permissions et dates du répertoire sont fixées une fois son contenu à jour
+    struct stat dir_stat;
+    if (listing2.fd >= 0 && fstat(listing2.fd, &dir_stat) == 0) {
+        read_scheduler_defer_dir(reads, dir2->buf, dir1->buf, &dir_stat);
+    }
+    dir_listing_close(&listing1);
+    dir_listing_close(&listing2);
+}
 
+// Fonction pour ajouter à la sauvegarde (dir1) l'entrée name du répertoire source (dir2)
+static void sync_add_entry(DirListing *listing1, DirListing *listing2, const char *name, const struct stat *statbuf2,
+                           PathBuffer *dir1, PathBuffer *dir2, ReadScheduler *reads, const FilterScope *scope) {
+    size_t len1 = path_buffer_push(dir1, name);
+    size_t len2 = path_buffer_push(dir2, name);
+
+    if (S_ISDIR(statbuf2->st_mode)) {
+        // Le répertoire n'existe pas dans dir1, le copier
+        printf("Ajout du répertoire : %s -> %s\n", dir2->buf, dir1->buf);
+        mkdirat(listing1->fd, name, 0755);
+        FilterScope child;
+        filter_scope_enter(&child, scope, dir2->buf, name);
+        sync_directories_links(listing1->fd, name, listing2->fd, name, dir1, dir2, reads, &child);
+        filter_scope_leave(&child);
+    } else if (S_ISLNK(statbuf2->st_mode)) {
+        // Le lien n'existe pas dans dir1, le recréer
+        printf("Ajout du lien : %s -> %s\n", dir2->buf, dir1->buf);
+        copy_symlink(dir2->buf, dir1->buf);
+    } else if (S_ISREG(statbuf2->st_mode)) {
+        // Le fichier n'existe pas dans dir1, le copier
+        printf("Ajout du fichier : %s -> %s\n", dir2->buf, dir1->buf);
+        read_scheduler_add(reads, dir2->buf, statbuf2, dir1->buf);
+    }
 
+    path_buffer_pop(dir1, len1);
+    path_buffer_pop(dir2, len2);
+}
 
+// Fonction pour synchroniser la sauvegarde dir1 avec le répertoire source dir2 à partir de scope
+static void sync_subtree(const char *dir1, const char *dir2, InodeMap *inodes, const FilterScope *scope) {
+    PathBuffer path1, path2;
+    ReadScheduler reads;
+    SyncCopy copy = { inodes, PTHREAD_MUTEX_INITIALIZER };
+    read_scheduler_init(&reads, sync_scheduled_file, &copy);
+
+    // Les copies sont réparties entre plusieurs threads, sauf en ordre physique (disque rotatif)
+    int threads = sync_threads;
+    if (threads <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (int)cpus : 1;
+    }
+    if (reads.order != READ_ORDER_EXTENT) {
+        read_scheduler_set_workers(&reads, threads);
+    }
 
+    path_buffer_init(&path1, dir1);
+    path_buffer_init(&path2, dir2);
+    sync_directories_links(AT_FDCWD, dir1, AT_FDCWD, dir2, &path1, &path2, &reads, scope);
+    path_buffer_free(&path1);
+    path_buffer_free(&path2);
+    read_scheduler_finish(&reads);
+    pthread_mutex_destroy(&copy.lock);
+}
 
+// Fonction pour mettre la sauvegarde dir1 à l'image du répertoire source dir2
+void sync_directories(const char *dir1, const char *dir2) {
+    InodeMap inodes;
+    FilterScope scope;
+    inode_map_init(&inodes);
+    filter_scope_enter(&scope, NULL, dir2, NULL);
+    sync_subtree(dir1, dir2, &inodes, &scope);
+    filter_scope_leave(&scope);
+    inode_map_free(&inodes);
+}
 
-// Fonction principale pour créer une sauvegarde
-void create_backup(const char *source_dir, const char *backup_dir) {
-    // Vérifier si le répertoire de sauvegarde existe
-    struct stat backup_stat;
-    if (stat(backup_dir, &backup_stat) == -1) {
-        perror("Le répertoire de sauvegarde spécifié est inaccessible");
-        return;
+// Fonction pour reporter dans la sauvegarde snapshot l'état d'un chemin modifié de la source
+// Retourne -1 sans rien modifier si le chemin dépasse PATH_MAX (le journal ne suffit plus)
+static int apply_change(const char *snapshot, const char *source, const char *path, InodeMap *inodes) {
+    char source_path[PATH_MAX], dest_path[PATH_MAX];
+    if (snprintf(source_path, sizeof(source_path), "%s/%s", source, path) >= (int)sizeof(source_path) ||
+        snprintf(dest_path, sizeof(dest_path), "%s/%s", snapshot, path) >= (int)sizeof(dest_path)) {
+        fprintf(stderr, "Chemin trop long, modification ignorée : %s\n", path);
+        return -1;
     }
 
-    if (!S_ISDIR(backup_stat.st_mode)) {
-        fprintf(stderr, "Le chemin de destination n'est pas un répertoire.\n");
-        return;
+    struct stat source_stat, dest_stat;
+    if (lstat(source_path, &source_stat) == -1) {
+        // Supprimé ou déplacé depuis la sauvegarde précédente
+        if (lstat(dest_path, &dest_stat) == 0) {
+            printf("Suppression : %s\n", dest_path);
+            remove_tree(dest_path);
+        }
+        return 0;
     }
 
-    // Créer un nouveau répertoire pour la sauvegarde
-    char backup_name[64];
-    generate_backup_name(backup_name, sizeof(backup_name));
+    int depth;
+    FilterScope *chain = filter_scope_open_path(source, path, S_ISDIR(source_stat.st_mode), &depth);
+    if (!chain) {
+        remove_tree(dest_path);
+        return 0;
+    }
 
-    char full_backup_path[512];
-    snprintf(full_backup_path, sizeof(full_backup_path), "%s/%s", backup_dir, backup_name);
+    // Les répertoires parents d'un chemin modifié existent dans la sauvegarde, sauf si
+    // leur création n'est pas encore journalisée : les créer avec leurs métadonnées plus tard
+    char parent[PATH_MAX];
+    memcpy(parent, dest_path, strlen(dest_path) + 1);
+    *strrchr(parent, '/') = '\0';
+    make_parent_dirs(parent);
+
+    int exists = lstat(dest_path, &dest_stat) == 0;
+    if (exists && (S_ISDIR(dest_stat.st_mode) != S_ISDIR(source_stat.st_mode) ||
+                   S_ISLNK(dest_stat.st_mode) != S_ISLNK(source_stat.st_mode))) {
+        remove_tree(dest_path);
+        exists = 0;
+    }
 
-    if (mkdir(full_backup_path, 0755) == -1) {
-        perror("Erreur lors de la création du répertoire de sauvegarde");
-        return;
+    if (S_ISDIR(source_stat.st_mode)) {
+        // Répertoire créé, déplacé ou dont un .backupignore a changé : le synchroniser entièrement
+        if (!exists) {
+            printf("Ajout du répertoire : %s -> %s\n", source_path, dest_path);
+            mkdir(dest_path, 0755);
+        }
+        const char *name = strrchr(path, '/');
+        FilterScope child;
+        filter_scope_enter(&child, &chain[depth - 1], source_path, name ? name + 1 : path);
+        sync_subtree(dest_path, source_path, inodes, &child);
+        filter_scope_leave(&child);
+    } else if (S_ISLNK(source_stat.st_mode)) {
+        if (!exists || links_are_different(dest_path, source_path) || metadata_differs(&dest_stat, &source_stat)) {
+            printf("Mise à jour du lien : %s -> %s\n", source_path, dest_path);
+            copy_symlink(source_path, dest_path);
+        }
+    } else if (S_ISREG(source_stat.st_mode)) {
+        if (!exists || metadata_differs(&dest_stat, &source_stat) || files_are_different(dest_path, source_path)) {
+            printf("Mise à jour du fichier : %s -> %s\n", source_path, dest_path);
+            sync_copy_file(source_path, &source_stat, dest_path, exists ? dest_path : NULL, inodes);
+        }
+    } else if (exists) {
+        // Devenu un fichier spécial : il n'est plus sauvegardé
+        remove_tree(dest_path);
     }
 
-    // Vérifier s'il existe une sauvegarde précédente
-    char previous_backup_path[512];
-    snprintf(previous_backup_path, sizeof(previous_backup_path), "%s/.backup_log", backup_dir);
+    filter_scope_close_path(chain, depth);
+    return 0;
+}
 
-    if (access(previous_backup_path, F_OK) == -1) {
-        // Première sauvegarde : copier tout simplement le répertoire source
-        // Ouvrir le fichier de log
-        char log_path[512];
-        snprintf(log_path, sizeof(log_path), "%s/.backup_log", backup_dir);
-        FILE *logfile = fopen(log_path, "a");
-        if (!logfile) {
-            perror("Erreur lors de la création du fichier .backup_log");
-            return;
+// Fonction pour mettre la sauvegarde snapshot à jour à partir des seuls chemins modifiés de la source
+// Retourne -1 si un chemin n'a pas pu être reporté : la sauvegarde doit alors parcourir toute la source
+static int apply_changes(const char *snapshot, const char *source, const ChangeSet *changes, InodeMap *inodes) {
+    for (int i = 0; i < changes->count; i++) {
+        if (apply_change(snapshot, source, changes->paths[i], inodes) != 0) {
+            return -1;
         }
+    }
 
-        // Copier le répertoire source
-        copy_file(source_dir, full_backup_path);
+    // Les dates des répertoires parents ne sont fixées qu'une fois tous leurs fichiers à jour
+    for (int i = 0; i < changes->count; i++) {
+        char source_parent[PATH_MAX], dest_parent[PATH_MAX];
+        const char *slash = strrchr(changes->paths[i], '/');
+        int len = slash ? (int)(slash - changes->paths[i]) : 0;
+        snprintf(source_parent, sizeof(source_parent), "%s/%.*s", source, len, changes->paths[i]);
+        snprintf(dest_parent, sizeof(dest_parent), "%s/%.*s", snapshot, len, changes->paths[i]);
+
+        struct stat st;
+        if (lstat(source_parent, &st) == 0 && S_ISDIR(st.st_mode)) {
+            copy_path_metadata(source_parent, dest_parent, &st);
+        }
+    }
+    return 0;
+}
 
-        process_directory(full_backup_path, log_path, backup_dir);
-        
+// Fonction pour retourner le champ index (à partir de 0) d'une ligne du .backup_log
+static const char *log_line_field(const char *line, int index, size_t *len) {
+    for (; index > 0 && line; index--) {
+        line = strchr(line, ';');
+        if (line) line++;
+    }
+    if (!line) {
+        *len = 0;
+        return "";
+    }
+    *len = strcspn(line, ";\n");
+    return line;
+}
 
-    } else {
-        // Sauvegarde incrémentale
-        printf("Sauvegarde précédente détectée. Création d'une sauvegarde incrémentale...\n");
-        log_t logs = read_backup_log(previous_backup_path);
-        
-        // Trouver le dossier le plus récent
-        const char *most_recent_folder = find_most_recent_folder(&logs);
-        if (most_recent_folder) {
-            // Créer le chemin complet du dossier le plus récent
-            char most_recent_folder_path[512];
-            snprintf(most_recent_folder_path, sizeof(most_recent_folder_path), "%s/%s", backup_dir, most_recent_folder);
-            
-            printf("Dossier le plus récent : %s\n", most_recent_folder_path);
-
-            // Copier les fichiers avec des liens durs
-            copy_with_hard_links(most_recent_folder_path, full_backup_path);
-
-            char log_path[512];
-            snprintf(log_path, sizeof(log_path), "%s/.backup_log", backup_dir);
+// Fonction pour écrire le log de la sauvegarde journalisée snapshot_name
+// Les lignes des chemins non modifiés sont reprises du log de la sauvegarde précédente,
+// seuls les chemins modifiés sont relus et hachés
+static int write_journaled_log(const char *backup_dir, const char *previous_name, const char *snapshot_name,
+                               const ChangeSet *changes, InodeMap *inodes) {
+    char previous_log[PATH_MAX], log_path[PATH_MAX], snapshot_path[PATH_MAX];
+    snprintf(previous_log, sizeof(previous_log), "%s/%s/.backup_log", backup_dir, previous_name);
+    snprintf(log_path, sizeof(log_path), "%s/%s", backup_dir, BACKUP_LOG_PENDING);
+    snprintf(snapshot_path, sizeof(snapshot_path), "%s/%s", backup_dir, snapshot_name);
+
+    FILE *in = fopen(previous_log, "r");
+    if (!in) {
+        perror("Erreur lors de l'ouverture du log de la sauvegarde précédente");
+        return -1;
+    }
+    FILE *out = fopen(log_path, "w");
+    if (!out) {
+        perror("Erreur lors de l'écriture du fichier .backup_log");
+        fclose(in);
+        return -1;
+    }
 
-            sync_directories(full_backup_path, source_dir);
+    // Fichiers inchangés dont le premier chemin de l'inode a été recopié : lien à réécrire
+    char **relog = NULL;
+    int relog_count = 0, relog_capacity = 0;
 
-            FILE *log1 = fopen(log_path, "w");
-            fclose(log1);
+    size_t prefix_len = strlen(previous_name);
+    char line[BACKUP_LOG_LINE_MAX];
+    while (fgets(line, sizeof(line), in)) {
+        if (strncmp(line, previous_name, prefix_len) != 0 || line[prefix_len] != '/') {
+            continue;
+        }
+        char *relative = line + prefix_len + 1;
+        char *end = strchr(relative, ';');
+        if (!end) {
+            continue;
+        }
+        *end = '\0';
+        if (change_set_contains(changes, relative)) {
+            continue;
+        }
 
-            process_directory(full_backup_path, log_path, backup_dir );
+        // Une entrée retirée par copy_with_hard_links (nouvelle règle d'exclusion) disparaît du log
+        char dest_path[PATH_MAX];
+        struct stat st;
+        if (snprintf(dest_path, sizeof(dest_path), "%s/%s", snapshot_path, relative) >= (int)sizeof(dest_path) ||
+            lstat(dest_path, &st) == -1) {
+            continue;
+        }
 
-            
-        } else {
-            printf("Aucun dossier précédent trouvé.\n");
+        size_t hardlink_len;
+        const char *hardlink = log_line_field(end + 1, 8, &hardlink_len);
+        if (hardlink_len > 0) {
+            char target[PATH_MAX];
+            snprintf(target, sizeof(target), "%.*s", (int)hardlink_len, hardlink);
+            if (change_set_contains(changes, target)) {
+                if (relog_count == relog_capacity) {
+                    relog_capacity = relog_capacity ? relog_capacity * 2 : 64;
+                    char **grown = realloc(relog, relog_capacity * sizeof(char *));
+                    if (!grown) break;
+                    relog = grown;
+                }
+                relog[relog_count++] = strdup(dest_path);
+                continue;
+            }
         }
+        fprintf(out, "%s/%s;%s", snapshot_name, relative, end + 1);
     }
-
-    char log_dest_path[512];
-    snprintf(log_dest_path, sizeof(log_dest_path), "%s/.backup_log", full_backup_path);
-    char back[500]; // Déclare une chaîne suffisamment grande pour contenir le chemin complet.
-    snprintf(back, sizeof(back), "%s/.backup_log", backup_dir); // Formate la chaîne avec le répertoire de sauvegarde.
-    copy_single_file(back, log_dest_path); // Appelle la fonction pour copier le fichier.
-
-
-    printf("Sauvegarde terminée : %s\n", full_backup_path);
+    fclose(in);
+    fclose(out);
+
+    // Lignes des chemins modifiés, lues dans la nouvelle sauvegarde
+    size_t root_len = strlen(snapshot_path);
+    for (int i = 0; i < changes->count; i++) {
+        char dest_path[PATH_MAX];
+        struct stat st;
+        if (snprintf(dest_path, sizeof(dest_path), "%s/%s", snapshot_path, changes->paths[i]) >= (int)sizeof(dest_path) ||
+            lstat(dest_path, &st) == -1) {
+            continue;
+        }
+        if (S_ISDIR(st.st_mode)) {
+            process_subtree(dest_path, log_path, backup_dir, root_len, inodes);
+        } else if (S_ISREG(st.st_mode) || S_ISLNK(st.st_mode)) {
+            log_entry(dest_path, &st, log_path, backup_dir, root_len, inodes);
+        }
+    }
+    for (int i = 0; i < relog_count; i++) {
+        struct stat st;
+        if (lstat(relog[i], &st) == 0) {
+            log_entry(relog[i], &st, log_path, backup_dir, root_len, inodes);
+        }
+        free(relog[i]);
+    }
+    free(relog);
+    return 0;
 }
 
+// Sauvegardes incrémentales par manifeste (--manifest-only)
+static int manifest_snapshots = 0;
 
-
-
-
-
-// Function to join paths safely
-void join_paths(const char *base, const char *name, char *result, size_t size) {
-    snprintf(result, size, "%s/%s", base, name);
+// Fonction pour choisir les sauvegardes incrémentales par manifeste
+void set_manifest_snapshots(int enabled) {
+    manifest_snapshots = enabled;
 }
 
-#include <errno.h>
-#include <limits.h> // Inclure pour PATH_MAX si disponible
-
-#ifndef PATH_MAX
-#define PATH_MAX 4096 // Définit PATH_MAX si non défini par le système
-#endif
+// Regroupement des petits fichiers copiés dans des conteneurs (--pack)
+static int pack_small_files = 0;
 
+// Fonction pour regrouper les petits fichiers des sauvegardes suivantes dans des conteneurs
+void set_pack_small_files(int enabled) {
+    pack_small_files = enabled;
+}
 
-// Recursive function to copy source to destination using hard links
-int copy_with_hard_links(const char *source, const char *destination) {
-    DIR *dir;
-    struct dirent *entry;
-    struct stat entry_stat;
-    char source_path[PATH_MAX];
-    char destination_path[PATH_MAX];
+// Ligne du log de la sauvegarde précédente
+typedef struct {
+    const char *path;         // Chemin relatif
+    const char *fields;       // Champs suivant le chemin (date;md5;taille;...)
+} ManifestLine;
+
+// Fichier de la source à plusieurs liens durs : son groupe est comparé au log précédent en fin de parcours
+typedef struct {
+    char *path;               // Chemin complet dans la source
+    char *dest;               // Chemin dans la nouvelle sauvegarde
+    struct stat st;
+    const ManifestLine *line; // Ligne du log précédent (NULL pour un nouveau chemin)
+} ManifestLink;
+
+// Parcours d'une sauvegarde par manifeste : seuls les fichiers modifiés sont copiés,
+// les autres sont repris du log précédent et désignent la sauvegarde qui les contient
+// Le parcours et sa file de lectures n'utilisent qu'un thread (pas de read_scheduler_set_workers) :
+// le log, les conteneurs, les tables d'inodes et les compteurs ne sont donc pas verrouillés
+typedef struct {
+    char *data;               // Contenu du log précédent (les lignes pointent dedans)
+    ManifestLine *lines;      // Lignes triées par chemin
+    int count;
+    const char *previous_name;
+    const char *snapshot_name;
+    const char *backup_dir;
+    size_t source_len;        // Longueur du chemin de la source
+    size_t root_len;          // Longueur du chemin de la nouvelle sauvegarde
+    PathBuffer dest;          // Chemin dans la nouvelle sauvegarde (suit le parcours de la source)
+    FILE *log;                // Seul flux d'écriture du log (lignes reprises, copiées et regroupées)
+    FILE *dirs;
+    InodeMap source_inodes;   // Liens durs de la source déjà copiés
+    InodeMap snapshot_inodes; // Liens durs de la source déjà enregistrés dans le log
+    PackWriter *pack;         // Conteneurs des petits fichiers (NULL sans --pack)
+    ManifestLink *links;      // Fichiers à liens durs rencontrés pendant le parcours
+    int link_count, link_capacity;
+    int reused, copied, packed;
+} ManifestWalk;
+
+static int compare_manifest_lines(const void *a, const void *b) {
+    return strcmp(((const ManifestLine *)a)->path, ((const ManifestLine *)b)->path);
+}
 
-    // Open the source directory
-    dir = opendir(source);
-    if (dir == NULL) {
-        perror("Failed to open source directory");
+// Fonction pour charger et trier par chemin le log de la sauvegarde previous_name
+// Sans sauvegarde précédente (première sauvegarde regroupée), tous les fichiers sont copiés
+static int load_previous_manifest(ManifestWalk *walk) {
+    if (!walk->previous_name) {
+        return 0;
+    }
+    char log_path[PATH_MAX];
+    snprintf(log_path, sizeof(log_path), "%s/%s/.backup_log", walk->backup_dir, walk->previous_name);
+    FILE *file = fopen(log_path, "r");
+    struct stat st;
+    if (!file || fstat(fileno(file), &st) != 0) {
+        perror("Erreur lors de l'ouverture du log de la sauvegarde précédente");
+        if (file) fclose(file);
         return -1;
     }
 
-    // Ensure the destination directory exists
-    if (mkdir(destination, 0755) == -1 && errno != EEXIST) {
-        perror("Failed to create destination directory");
-        closedir(dir);
+    walk->data = malloc(st.st_size + 1);
+    size_t size = walk->data ? fread(walk->data, 1, st.st_size, file) : 0;
+    fclose(file);
+    if (!walk->data) {
+        perror("Erreur d'allocation mémoire pour le log précédent");
         return -1;
     }
-
-    // Iterate over all entries in the source directory
-    while ((entry = readdir(dir)) != NULL) {
-        // Skip "." and ".." and files that start with a "."
-        if (entry->d_name[0] == '.' || strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+    walk->data[size] = '\0';
+
+    int capacity = 0;
+    size_t prefix_len = strlen(walk->previous_name);
+    for (char *line = walk->data, *next; line && *line; line = next) {
+        next = strchr(line, '\n');
+        if (next) *next++ = '\0';
+        if (strncmp(line, walk->previous_name, prefix_len) != 0 || line[prefix_len] != '/') {
             continue;
         }
-
-        // Construct full paths for source and destination
-        join_paths(source, entry->d_name, source_path, sizeof(source_path));
-        join_paths(destination, entry->d_name, destination_path, sizeof(destination_path));
-
-        // Get the entry's metadata
-        if (lstat(source_path, &entry_stat) == -1) {
-            perror("Failed to stat source entry");
-            closedir(dir);
-            return -1;
+        char *end = strchr(line + prefix_len + 1, ';');
+        if (!end) {
+            continue;
         }
-
-        // Handle directories recursively
-        if (S_ISDIR(entry_stat.st_mode)) {
-            if (copy_with_hard_links(source_path, destination_path) == -1) {
-                closedir(dir);
-                return -1;
-            }
-        } else if (S_ISREG(entry_stat.st_mode)) {
-            // Create a hard link for regular files
-            if (link(source_path, destination_path) == -1) {
-                perror("Failed to create hard link");
-                closedir(dir);
+        *end = '\0';
+        if (walk->count == capacity) {
+            capacity = capacity ? capacity * 2 : 1024;
+            ManifestLine *grown = realloc(walk->lines, capacity * sizeof(ManifestLine));
+            if (!grown) {
+                perror("Erreur d'allocation mémoire pour le log précédent");
                 return -1;
             }
-        } else {
-            fprintf(stderr, "Skipping unsupported file type: %s\n", source_path);
+            walk->lines = grown;
         }
+        walk->lines[walk->count].path = line + prefix_len + 1;
+        walk->lines[walk->count].fields = end + 1;
+        walk->count++;
     }
-
-    closedir(dir);
+    qsort(walk->lines, walk->count, sizeof(ManifestLine), compare_manifest_lines);
     return 0;
 }
 
+// Fonction pour comparer un champ numérique du log à une valeur
+static int field_equals(const char *fields, int index, const char *value) {
+    size_t len;
+    const char *field = log_line_field(fields, index, &len);
+    return len > 0 && strlen(value) == len && strncmp(field, value, len) == 0;
+}
+
+// Fonction pour savoir si une entrée de la source est inchangée depuis sa ligne du log précédent
+// (le groupe de liens durs d'un fichier est vérifié séparément)
+static int manifest_line_matches(const ManifestLine *line, const struct stat *st) {
+    char value[64];
+    size_t len;
+    log_line_field(line->fields, 7, &len);
+    if ((len > 0) != (S_ISLNK(st->st_mode) != 0)) {
+        return 0;
+    }
+    // La cible d'un lien ne change pas sans le recréer, ce qui change sa date
+    snprintf(value, sizeof(value), "%lld", (long long)st->st_size);
+    if (S_ISREG(st->st_mode) && !field_equals(line->fields, 2, value)) return 0;
+    snprintf(value, sizeof(value), "%o", (unsigned int)st->st_mode);
+    if (!field_equals(line->fields, 3, value)) return 0;
+    snprintf(value, sizeof(value), "%u", (unsigned int)st->st_uid);
+    if (!field_equals(line->fields, 4, value)) return 0;
+    snprintf(value, sizeof(value), "%u", (unsigned int)st->st_gid);
+    if (!field_equals(line->fields, 5, value)) return 0;
+    snprintf(value, sizeof(value), "%lld.%09ld", (long long)st->st_mtim.tv_sec, st->st_mtim.tv_nsec);
+    return field_equals(line->fields, 6, value);
+}
 
+// Fonction pour regrouper un petit fichier modifié de la source dans un conteneur et l'enregistrer
+// Sa ligne du log désigne sa plage dans le conteneur ; retourne 0 en cas de succès
+static int manifest_pack_file(ManifestWalk *walk, const ReadJob *job) {
+    const char *relative = job->path + walk->source_len + 1;
+    int fd = open(job->path, O_RDONLY | O_NOFOLLOW);
+    if (fd < 0) {
+        perror("Erreur lors de l'ouverture du fichier à regrouper");
+        return -1;
+    }
+    log_element elt;
+    if (read_file_metadata(job->path, &job->st, &elt) != 0) {
+        close(fd);
+        return -1;
+    }
+    char ref[PATH_MAX];
+    off_t size = pack_writer_add(walk->pack, fd, job->st.st_size, relative, elt.md5, ref, sizeof(ref));
+    close(fd);
+    if (size < 0) {
+        free_file_metadata(&elt);
+        return -1;
+    }
 
+    char date[64];
+    struct tm *mod_time = localtime(&job->st.st_mtime);
+    if (!mod_time || strftime(date, sizeof(date), "%Y-%m-%d-%H:%M:%S", mod_time) == 0) {
+        snprintf(date, sizeof(date), "%lld", (long long)job->st.st_mtime);
+    }
+    elt.path = job->dest;
+    elt.date = date;
+    elt.size = size;
+    elt.stored = strdup(ref);
+    write_log_element(&elt, walk->log, walk->backup_dir);
+    free_file_metadata(&elt);
+
+    printf("Regroupement : %s\n", relative);
+    walk->packed++;
+    return 0;
+}
 
+// Fonction pour copier dans la nouvelle sauvegarde un fichier modifié de la source et l'enregistrer
+static void manifest_scheduled_file(const ReadJob *job, void *arg) {
+    ManifestWalk *walk = arg;
 
+    // Un petit fichier sans autre lien dur rejoint le conteneur en cours plutôt qu'un fichier à lui
+    if (walk->pack && S_ISREG(job->st.st_mode) && job->st.st_nlink == 1 && job->st.st_size <= PACK_FILE_MAX &&
+        manifest_pack_file(walk, job) == 0) {
+        return;
+    }
 
-// Fonction permettant d'enregistrer dans fichier le tableau de chunk dédupliqué
-void write_backup_file(const char *output_filename, Chunk *chunks, int chunk_count) {
-    /*
-    */
-}
+    char parent[PATH_MAX];
+    snprintf(parent, sizeof(parent), "%s", job->dest);
+    make_parent_dirs(dirname(parent));
 
+    if (S_ISLNK(job->st.st_mode)) {
+        copy_symlink(job->path, job->dest);
+    } else {
+        // La copie précédente est dans la sauvegarde qui stocke la ligne du log précédent
+        char previous[PATH_MAX];
+        const char *relative = job->path + walk->source_len + 1;
+        ManifestLine key = { relative, NULL };
+        const ManifestLine *line = bsearch(&key, walk->lines, walk->count, sizeof(ManifestLine), compare_manifest_lines);
+        size_t stored_len = 0, link_len = 0;
+        const char *stored = line ? log_line_field(line->fields, 10, &stored_len) : NULL;
+        if (line) {
+            log_line_field(line->fields, 7, &link_len);
+            snprintf(previous, sizeof(previous), "%s/%.*s/%s", walk->backup_dir,
+                     stored_len ? (int)stored_len : (int)strlen(walk->previous_name),
+                     stored_len ? stored : walk->previous_name, relative);
+        }
+        sync_copy_file(job->path, &job->st, job->dest, line && link_len == 0 ? previous : NULL, &walk->source_inodes);
+    }
 
-// Fonction implémentant la logique pour la sauvegarde d'un fichier
-void backup_file(const char *filename) {
-    /*
-    */
+    // Les liens durs sont regroupés d'après la source : la copie du premier chemin
+    // n'a encore qu'un lien quand elle est enregistrée
+    // (lstat : la cible d'un lien symbolique n'est pas forcément stockée dans cette sauvegarde)
+    struct stat copied;
+    if (lstat(job->dest, &copied) == 0) {
+        printf("Copie : %s\n", job->path + walk->source_len + 1);
+        write_entry_line(job->dest, &job->st, walk->log, walk->backup_dir, walk->root_len, &walk->snapshot_inodes);
+        walk->copied++;
+    }
 }
 
+// Fonction pour reprendre dans le log la ligne précédente d'un fichier inchangé
+// Elle désigne la sauvegarde qui stocke les données
+static void manifest_reuse_line(ManifestWalk *walk, const char *relative, const ManifestLine *line) {
+    size_t stored_len;
+    log_line_field(line->fields, 10, &stored_len);
+    fprintf(walk->log, "%s/%s;%s", walk->snapshot_name, relative, line->fields);
+    if (stored_len == 0) {
+        fprintf(walk->log, ";%s", walk->previous_name);
+    }
+    fputc('\n', walk->log);
+    walk->reused++;
+}
 
-// Fonction permettant la restauration du fichier backup via le tableau de chunk
-void write_restored_file(const char *output_filename, Chunk *chunks, int chunk_count) {
-    /*
-    */
+// Fonction pour mettre de côté un fichier à liens durs jusqu'à la fin du parcours de la source
+// Retourne -1 si la mémoire manque (le fichier est alors copié tout de suite)
+static int manifest_defer_link(ManifestWalk *walk, const char *path, const char *dest, const struct stat *st,
+                               const ManifestLine *line) {
+    if (walk->link_count == walk->link_capacity) {
+        int capacity = walk->link_capacity ? walk->link_capacity * 2 : 64;
+        ManifestLink *grown = realloc(walk->links, capacity * sizeof(ManifestLink));
+        if (!grown) return -1;
+        walk->links = grown;
+        walk->link_capacity = capacity;
+    }
+    ManifestLink *link = &walk->links[walk->link_count];
+    link->path = strdup(path);
+    link->dest = strdup(dest);
+    if (!link->path || !link->dest) {
+        free(link->path);
+        free(link->dest);
+        return -1;
+    }
+    link->st = *st;
+    link->line = line;
+    walk->link_count++;
+    return 0;
 }
 
-// Fonction pour restaurer une sauvegarde
+static int compare_manifest_links(const void *a, const void *b) {
+    const ManifestLink *link1 = a, *link2 = b;
+    if (link1->st.st_dev != link2->st.st_dev) return link1->st.st_dev < link2->st.st_dev ? -1 : 1;
+    if (link1->st.st_ino != link2->st.st_ino) return link1->st.st_ino < link2->st.st_ino ? -1 : 1;
+    return strcmp(link1->path, link2->path);
+}
+
+// Fonction pour savoir si un groupe de liens durs de la source est inchangé depuis le log précédent :
+// chaque chemin y figure avec les mêmes métadonnées, un seul est le premier du groupe et les autres
+// sont des liens vers lui (un chemin supprimé depuis ne change rien aux autres)
+static int manifest_group_matches(const ManifestLink *group, int count) {
+    const ManifestLine *first = NULL;
+    for (int i = 0; i < count; i++) {
+        size_t len;
+        if (!group[i].line || !manifest_line_matches(group[i].line, &group[i].st)) return 0;
+        log_line_field(group[i].line->fields, 8, &len);
+        if (len == 0) {
+            if (first) return 0;
+            first = group[i].line;
+        }
+    }
+    if (!first) return 0;
+
+    for (int i = 0; i < count; i++) {
+        if (group[i].line == first) continue;
+        size_t len;
+        const char *target = log_line_field(group[i].line->fields, 8, &len);
+        if (strlen(first->path) != len || strncmp(target, first->path, len) != 0) return 0;
+    }
+    return 1;
+}
+
+// Fonction pour traiter les fichiers à liens durs en fin de parcours : un groupe inchangé reprend
+// ses lignes du log précédent, un groupe modifié est entièrement recopié
+static void manifest_finish_links(ManifestWalk *walk, ReadScheduler *reads) {
+    qsort(walk->links, walk->link_count, sizeof(ManifestLink), compare_manifest_links);
+
+    for (int i = 0, end; i < walk->link_count; i = end) {
+        for (end = i + 1; end < walk->link_count; end++) {
+            if (walk->links[end].st.st_dev != walk->links[i].st.st_dev ||
+                walk->links[end].st.st_ino != walk->links[i].st.st_ino) {
+                break;
+            }
+        }
+
+        int unchanged = manifest_group_matches(&walk->links[i], end - i);
+        for (int j = i; j < end; j++) {
+            ManifestLink *link = &walk->links[j];
+            if (unchanged) {
+                manifest_reuse_line(walk, link->line->path, link->line);
+            } else {
+                read_scheduler_add(reads, link->path, &link->st, link->dest);
+            }
+        }
+    }
+
+    for (int i = 0; i < walk->link_count; i++) {
+        free(walk->links[i].path);
+        free(walk->links[i].dest);
+    }
+    free(walk->links);
+    walk->links = NULL;
+    walk->link_count = walk->link_capacity = 0;
+}
+
+// Fonction récursive de parcours de la source pour une sauvegarde par manifeste
+// Le dossier est lu par son descripteur (parent_fd, name) ; path est son chemin complet
+static void manifest_directory_links(ManifestWalk *walk, int parent_fd, const char *name, PathBuffer *path,
+                                     ReadScheduler *reads, const FilterScope *scope) {
+    DirListing listing;
+    if (dir_listing_open(parent_fd, name, &listing) != 0) {
+        perror("Erreur lors de l'ouverture du dossier");
+        return;
+    }
+
+    for (int i = 0; i < listing.count; i++) {
+        DirEntry *entry = &listing.entries[i];
+        struct stat statbuf;
+        if (dir_entry_stat(&listing, entry, &statbuf) == -1) {
+            perror("Erreur lors de la récupération des informations du fichier");
+            continue;
+        }
+        if (filter_scope_excludes(scope, entry->name, S_ISDIR(statbuf.st_mode))) {
+            continue;
+        }
+
+        size_t len = path_buffer_push(path, entry->name);
+        size_t dest_len = path_buffer_push(&walk->dest, entry->name);
+        const char *relative = path->buf + walk->source_len + 1;
+
+        if (S_ISDIR(statbuf.st_mode)) {
+            // Les métadonnées de chaque répertoire vont dans .backup_dirs, sans créer le répertoire
+            log_element dir;
+            if (read_file_metadata(path->buf, &statbuf, &dir) == 0) {
+                fputs(relative, walk->dirs);
+                write_metadata_fields(walk->dirs, &dir);
+                fputc('\n', walk->dirs);
+                free_file_metadata(&dir);
+            }
+            FilterScope child;
+            filter_scope_enter(&child, scope, path->buf, entry->name);
+            manifest_directory_links(walk, listing.fd, entry->name, path, reads, &child);
+            filter_scope_leave(&child);
+        } else if (S_ISREG(statbuf.st_mode) || S_ISLNK(statbuf.st_mode)) {
+            ManifestLine key = { relative, NULL };
+            const ManifestLine *line = bsearch(&key, walk->lines, walk->count, sizeof(ManifestLine), compare_manifest_lines);
+            size_t hardlink_len = 0;
+            if (line) {
+                log_line_field(line->fields, 8, &hardlink_len);
+            }
+            if (S_ISREG(statbuf.st_mode) && statbuf.st_nlink > 1 &&
+                manifest_defer_link(walk, path->buf, walk->dest.buf, &statbuf, line) == 0) {
+                // Un groupe de liens durs n'est comparé au log précédent qu'une fois tous ses chemins connus
+            } else if (line && hardlink_len == 0 && statbuf.st_nlink == 1 && manifest_line_matches(line, &statbuf)) {
+                // Inchangé : la ligne précédente est reprise
+                manifest_reuse_line(walk, relative, line);
+            } else {
+                read_scheduler_add(reads, path->buf, &statbuf, walk->dest.buf);
+            }
+        }
+
+        path_buffer_pop(path, len);
+        path_buffer_pop(&walk->dest, dest_len);
+    }
+    dir_listing_close(&listing);
+}
+
+// Fonction pour créer la sauvegarde par manifeste snapshot_name à partir de la sauvegarde previous_name
+// Seuls les fichiers modifiés sont copiés dans la sauvegarde ; son log est écrit dans log_path
+static int write_manifest_snapshot(const char *source_dir, const char *backup_dir, const char *previous_name,
+                                   const char *snapshot_name, const char *log_path) {
+    ManifestWalk walk;
+    memset(&walk, 0, sizeof(walk));
+    walk.previous_name = previous_name;
+    walk.snapshot_name = snapshot_name;
+    walk.backup_dir = backup_dir;
+    walk.source_len = strlen(source_dir);
+    if (load_previous_manifest(&walk) != 0) {
+        free(walk.data);
+        free(walk.lines);
+        return -1;
+    }
+
+    char snapshot_path[PATH_MAX], dirs_path[PATH_MAX];
+    snprintf(snapshot_path, sizeof(snapshot_path), "%s/%s", backup_dir, snapshot_name);
+    walk.root_len = strlen(snapshot_path);
+    if (snprintf(dirs_path, sizeof(dirs_path), "%s/%s", snapshot_path, BACKUP_DIRS) < (int)sizeof(dirs_path)) {
+        walk.log = fopen(log_path, "a");
+        walk.dirs = fopen(dirs_path, "w");
+    } else {
+        errno = ENAMETOOLONG;
+    }
+    if (!walk.log || !walk.dirs) {
+        perror("Erreur lors de l'écriture du manifeste");
+        if (walk.log) fclose(walk.log);
+        if (walk.dirs) fclose(walk.dirs);
+        free(walk.data);
+        free(walk.lines);
+        return -1;
+    }
+
+    // Les conteneurs sont écrits dans la sauvegarde et validés avec elle par le même syncfs
+    PackWriter pack;
+    if (pack_small_files && pack_writer_init(&pack, snapshot_path, snapshot_name) == 0) {
+        walk.pack = &pack;
+    }
+
+    inode_map_init(&walk.source_inodes);
+    inode_map_init(&walk.snapshot_inodes);
+    path_buffer_init(&walk.dest, snapshot_path);
+    PathBuffer path;
+    path_buffer_init(&path, source_dir);
+    FilterScope scope;
+    filter_scope_enter(&scope, NULL, source_dir, NULL);
+    ReadScheduler reads;
+    read_scheduler_init(&reads, manifest_scheduled_file, &walk);
+
+    manifest_directory_links(&walk, AT_FDCWD, source_dir, &path, &reads, &scope);
+    manifest_finish_links(&walk, &reads);
+    read_scheduler_finish(&reads);
+    int result = 0;
+    if (walk.pack && pack_writer_finish(walk.pack) != 0) {
+        result = -1;
+    }
+
+    filter_scope_leave(&scope);
+    path_buffer_free(&path);
+    path_buffer_free(&walk.dest);
+    inode_map_free(&walk.source_inodes);
+    inode_map_free(&walk.snapshot_inodes);
+    fclose(walk.log);
+    fclose(walk.dirs);
+    free(walk.data);
+    free(walk.lines);
+
+    printf("Sauvegarde par manifeste : %d fichier(s) repris de la sauvegarde précédente, %d copié(s), %d regroupé(s)\n",
+           walk.reused, walk.copied, walk.packed);
+    if (walk.pack) {
+        printf("Conteneurs : %d\n", pack.number);
+    }
+    return result;
+}
+
+// Fonction pour retrouver la date de création d'une sauvegarde à partir de son nom
+static time_t backup_name_time(const char *name) {
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    if (sscanf(name, "%d-%d-%d-%d:%d:%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+               &tm.tm_hour, &tm.tm_min, &tm.tm_sec) != 6) {
+        return 0;
+    }
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+    tm.tm_isdst = -1; // Les noms sont générés en heure locale
+    return mktime(&tm);
+}
+
+// Fonction pour supprimer une sauvegarde qui n'a pas pu être validée : sans .backup_log elle
+// serait ignorée, mais son répertoire resterait dans le répertoire de sauvegarde
+void abandon_snapshot(const char *snapshot_path) {
+    fprintf(stderr, "Sauvegarde non validée : %s\n", snapshot_path);
+    remove_tree(snapshot_path);
+}
+
+// Fonction principale pour créer une sauvegarde
+void create_backup(const char *source_dir, const char *backup_dir) {
+    create_backup_journaled(source_dir, backup_dir, 0);
+}
+
+// Fonction pour créer une sauvegarde, en s'appuyant sur le journal des modifications si use_journal vaut 1
+void create_backup_journaled(const char *source_dir, const char *backup_dir, int use_journal) {
+    // Vérifier si le répertoire de sauvegarde existe
+    struct stat backup_stat;
+    if (stat(backup_dir, &backup_stat) == -1) {
+        perror("Le répertoire de sauvegarde spécifié est inaccessible");
+        return;
+    }
+
+    if (!S_ISDIR(backup_stat.st_mode)) {
+        fprintf(stderr, "Le chemin de destination n'est pas un répertoire.\n");
+        return;
+    }
+
+    // Un répertoire chiffré n'accepte que des sauvegardes chiffrées avec la même clé
+    if (seal_check_repository(backup_dir, 1) != 0) {
+        return;
+    }
+
+    // Les recettes des fichiers stockés sont enregistrées dans le répertoire de sauvegarde
+    set_recipe_dir(backup_dir);
+
+    // Créer un nouveau répertoire pour la sauvegarde
+    char backup_name[64];
+    generate_backup_name(backup_name, sizeof(backup_name));
+
+    char full_backup_path[512];
+    snprintf(full_backup_path, sizeof(full_backup_path), "%s/%s", backup_dir, backup_name);
+    int journaled = 0;
+    int manifest = 0;
+
+    if (mkdir(full_backup_path, 0755) == -1) {
+        perror("Erreur lors de la création du répertoire de sauvegarde");
+        return;
+    }
+
+    // Vérifier s'il existe une sauvegarde précédente
+    char previous_backup_path[512];
+    snprintf(previous_backup_path, sizeof(previous_backup_path), "%s/.backup_log", backup_dir);
+
+    // Le log de travail n'est remplacé qu'à la publication de la sauvegarde
+    char log_path[PATH_MAX];
+    snprintf(log_path, sizeof(log_path), "%s/%s", backup_dir, BACKUP_LOG_PENDING);
+
+    const char *most_recent_folder = NULL;
+    if (access(previous_backup_path, F_OK) == 0) {
+        printf("Sauvegarde précédente détectée. Création d'une sauvegarde incrémentale...\n");
+        log_t logs = read_backup_log(previous_backup_path);
+        most_recent_folder = find_most_recent_folder(&logs);
+        free_backup_log(&logs);
+        if (!most_recent_folder) {
+            // Log vide ou illisible : aucune sauvegarde sur laquelle s'appuyer
+            printf("Aucun dossier précédent trouvé : sauvegarde complète.\n");
+        }
+    }
+
+    if (!most_recent_folder) {
+        // Première sauvegarde : copier tout simplement le répertoire source
+        // Ouvrir le fichier de log (vidé : il peut rester d'une sauvegarde interrompue)
+        FILE *logfile = fopen(log_path, "w");
+        if (!logfile) {
+            perror("Erreur lors de la création du fichier .backup_log");
+            abandon_snapshot(full_backup_path);
+            return;
+        }
+        fclose(logfile);
+
+        if (pack_small_files) {
+            // Les petits fichiers sont regroupés dans des conteneurs dès la première sauvegarde
+            if (write_manifest_snapshot(source_dir, backup_dir, NULL, backup_name, log_path) != 0) {
+                abandon_snapshot(full_backup_path);
+                return;
+            }
+        } else {
+            // Copier le répertoire source
+            copy_file(source_dir, full_backup_path);
+
+            process_directory(full_backup_path, log_path, backup_dir);
+        }
+    } else {
+        // Sauvegarde incrémentale : créer le chemin complet du dossier le plus récent
+        char most_recent_folder_path[512];
+        snprintf(most_recent_folder_path, sizeof(most_recent_folder_path), "%s/%s", backup_dir, most_recent_folder);
+
+        printf("Dossier le plus récent : %s\n", most_recent_folder_path);
+
+        // Une sauvegarde par manifeste n'a pas d'arborescence complète : les suivantes le sont aussi
+        char previous_dirs[PATH_MAX];
+        snprintf(previous_dirs, sizeof(previous_dirs), "%s/%s", most_recent_folder_path, BACKUP_DIRS);
+        if (manifest_snapshots || pack_small_files || access(previous_dirs, F_OK) == 0) {
+            // Parcours complet de la source, sans recréer l'arborescence de la sauvegarde précédente
+            FILE *log1 = fopen(log_path, "w");
+            if (log1) fclose(log1);
+            if (!log1 || write_manifest_snapshot(source_dir, backup_dir, most_recent_folder, backup_name, log_path) != 0) {
+                free((char *)most_recent_folder);
+                abandon_snapshot(full_backup_path);
+                return;
+            }
+            manifest = 1;
+        } else {
+            // Copier les fichiers avec des liens durs (une copie incomplète n'est pas publiée)
+            if (copy_with_hard_links(most_recent_folder_path, full_backup_path) != 0) {
+                fprintf(stderr, "Erreur lors de la copie par liens durs de %s\n", most_recent_folder_path);
+                free((char *)most_recent_folder);
+                abandon_snapshot(full_backup_path);
+                return;
+            }
+        }
+
+        // Avec un journal complet, seuls les chemins modifiés sont relus dans la source
+        ChangeSet changes;
+        time_t previous_time = backup_name_time(most_recent_folder);
+        if (!manifest && use_journal && previous_time > 0 && change_journal_take(backup_dir, previous_time, &changes) == 0) {
+            printf("Journal des modifications : %d chemin(s) modifié(s)\n", changes.count);
+            InodeMap inodes;
+            inode_map_init(&inodes);
+            if (apply_changes(full_backup_path, source_dir, &changes, &inodes) == 0) {
+                inode_map_free(&inodes);
+                inode_map_init(&inodes);
+                journaled = write_journaled_log(backup_dir, most_recent_folder, backup_name, &changes, &inodes) == 0;
+            } else {
+                // Journal inutilisable : la source est parcourue entièrement, comme avec un journal incomplet
+                printf("Journal des modifications incomplet : parcours complet de la source\n");
+            }
+            inode_map_free(&inodes);
+            change_set_free(&changes);
+        }
+
+        if (!journaled && !manifest) {
+            sync_directories(full_backup_path, source_dir);
+
+            FILE *log1 = fopen(log_path, "w");
+            if (!log1) {
+                perror("Erreur lors de la création du fichier .backup_log");
+                free((char *)most_recent_folder);
+                abandon_snapshot(full_backup_path);
+                return;
+            }
+            fclose(log1);
+
+            process_directory(full_backup_path, log_path, backup_dir);
+        }
+        free((char *)most_recent_folder);
+    }
+
+    char work_log[PATH_MAX], log_dest_path[PATH_MAX], log_pending[PATH_MAX];
+    snprintf(work_log, sizeof(work_log), "%s/.backup_log", backup_dir);
+    snprintf(log_dest_path, sizeof(log_dest_path), "%s/.backup_log", full_backup_path);
+    snprintf(log_pending, sizeof(log_pending), "%s/%s", full_backup_path, BACKUP_LOG_PENDING);
+
+    // Trier le log de la sauvegarde et écrire son index pour les restaurations partielles
+    if (index_backup_log(full_backup_path, log_path) != 0) {
+        abandon_snapshot(full_backup_path);
+        return;
+    }
+
+    // Validation : tant que son .backup_log n'existe pas, la sauvegarde est ignorée (liste,
+    // vérification, base de la sauvegarde suivante). Un seul syncfs écrit d'abord toutes
+    // ses données, liens et répertoires ; les deux logs sont ensuite publiés par renommage,
+    // celui de la sauvegarde puis le log de travail qui désigne la sauvegarde la plus récente
+    if (durable_sync_filesystem(full_backup_path) != 0 ||
+        durable_publish(log_pending, log_dest_path) != 0 ||
+        durable_publish(log_path, work_log) != 0) {
+        abandon_snapshot(full_backup_path);
+        return;
+    }
+
+    // Le journal consommé est validé ; un parcours complet sert de nouvelle référence
+    if (use_journal) {
+        change_journal_commit(backup_dir, !journaled);
+    }
+
+    // Le catalogue des chemins reçoit la nouvelle sauvegarde (il peut être reconstruit à partir des logs)
+    if (catalog_update(backup_dir) != 0) {
+        fprintf(stderr, "Catalogue non mis à jour : il sera complété à la prochaine recherche\n");
+    }
+
+    print_dedup_stats(stdout);
+    printf("Sauvegarde terminée : %s\n", full_backup_path);
+}
+
+
+
+
+
+
+// Function to join paths safely
+void join_paths(const char *base, const char *name, char *result, size_t size) {
+    snprintf(result, size, "%s/%s", base, name);
+}
+
+#include <errno.h>
+#include <limits.h> // Inclure pour PATH_MAX si disponible
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096 // Définit PATH_MAX si non défini par le système
+#endif
+
+
+// Check whether a name at the root of a snapshot is one of its own metadata files
+static int is_snapshot_metadata(const char *name) {
+    return strcmp(name, ".backup_log") == 0 || strcmp(name, ".backup_index") == 0 ||
+           strcmp(name, BACKUP_LOG_PENDING) == 0 || strcmp(name, BACKUP_DIRS) == 0;
+}
+
+// Recursive function to copy source to destination using hard links
+// Both directories are accessed through descriptors (links are made with linkat);
+// source and destination hold the full paths, used for filters and symbolic links
+// Entries excluded by the filters of scope are skipped, excluded directories are not descended into
+static int copy_with_hard_links_scope(int source_parent, const char *source_name, int dest_parent,
+                                      const char *dest_name, PathBuffer *source, PathBuffer *destination,
+                                      const FilterScope *scope) {
+    DirListing listing;
+    struct stat entry_stat;
+
+    // Open the source directory
+    if (dir_listing_open(source_parent, source_name, &listing) != 0) {
+        perror("Failed to open source directory");
+        return -1;
+    }
+
+    // Ensure the destination directory exists
+    if (mkdirat(dest_parent, dest_name, 0755) == -1 && errno != EEXIST) {
+        perror("Failed to create destination directory");
+        dir_listing_close(&listing);
+        return -1;
+    }
+    int dest_fd = openat(dest_parent, dest_name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dest_fd < 0) {
+        perror("Failed to open destination directory");
+        dir_listing_close(&listing);
+        return -1;
+    }
+
+    int result = 0;
+    // Iterate over all entries in the source directory
+    for (int i = 0; i < listing.count && result == 0; i++) {
+        const char *name = listing.entries[i].name;
+
+        // Skip the snapshot's own log and index (hidden user files are kept)
+        if (!scope->parent && is_snapshot_metadata(name)) {
+            continue;
+        }
+
+        // Get the entry's metadata
+        if (dir_entry_stat(&listing, &listing.entries[i], &entry_stat) == -1) {
+            perror("Failed to stat source entry");
+            result = -1;
+            break;
+        }
+
+        if (filter_scope_excludes(scope, name, S_ISDIR(entry_stat.st_mode))) {
+            continue;
+        }
+
+        // Handle directories recursively
+        if (S_ISDIR(entry_stat.st_mode)) {
+            size_t source_len = path_buffer_push(source, name);
+            size_t dest_len = path_buffer_push(destination, name);
+            FilterScope child;
+            filter_scope_enter(&child, scope, source->buf, name);
+            result = copy_with_hard_links_scope(listing.fd, name, dest_fd, name, source, destination, &child);
+            filter_scope_leave(&child);
+            path_buffer_pop(source, source_len);
+            path_buffer_pop(destination, dest_len);
+        } else if (S_ISLNK(entry_stat.st_mode)) {
+            // Recreate symbolic links instead of following them
+            size_t source_len = path_buffer_push(source, name);
+            size_t dest_len = path_buffer_push(destination, name);
+            copy_symlink(source->buf, destination->buf);
+            path_buffer_pop(source, source_len);
+            path_buffer_pop(destination, dest_len);
+        } else if (S_ISREG(entry_stat.st_mode)) {
+            // Create a hard link for regular files
+            if (linkat(listing.fd, name, dest_fd, name, 0) == -1) {
+                perror("Failed to create hard link");
+                result = -1;
+            }
+        } else {
+            fprintf(stderr, "Skipping unsupported file type: %s/%s\n", source->buf, name);
+        }
+    }
+
+    close(dest_fd);
+    dir_listing_close(&listing);
+    return result;
+}
+
+// Copy a snapshot into a new one using hard links, applying the exclusion filters
+int copy_with_hard_links(const char *source, const char *destination) {
+    FilterScope scope;
+    filter_scope_enter(&scope, NULL, source, NULL);
+    PathBuffer source_path, dest_path;
+    path_buffer_init(&source_path, source);
+    path_buffer_init(&dest_path, destination);
+    int result = copy_with_hard_links_scope(AT_FDCWD, source, AT_FDCWD, destination,
+                                            &source_path, &dest_path, &scope);
+    path_buffer_free(&source_path);
+    path_buffer_free(&dest_path);
+    filter_scope_leave(&scope);
+    return result;
+}
+
+
+
+
+
+
+// Fonction permettant d'enregistrer dans fichier le tableau de chunk dédupliqué
+void write_backup_file(const char *output_filename, Chunk *chunks, int chunk_count) {
+    /*
+    */
+}
+
+
+// Fonction implémentant la logique pour la sauvegarde d'un fichier
+void backup_file(const char *filename) {
+    /*
+    */
+}
+
+
+// Fonction permettant la restauration du fichier backup via le tableau de chunk
+void write_restored_file(const char *output_filename, Chunk *chunks, int chunk_count) {
+    /*
+    */
+}
+
+// Fonction pour restaurer une sauvegarde
 #include <sys/stat.h>
 #include <unistd.h>
 #include <libgen.h> // Pour dirname
 
-void restore_backup(const char *backup_id, const char *restore_dir) {
+#include <fnmatch.h>
+#include "chunk_cache.h"
+
+// Fonction pour copier un fichier sauvegardé par grandes plages, sans passer par le cache de chunks :
+// une restauration ne lit chaque fichier qu'une fois, le cache n'y trouverait jamais un bloc déjà lu
+// Les trous et les blocs nuls ne sont pas écrits : le fichier restauré est creux comme l'original
+static void copy_stored_file(const char *source_path, const char *dest_path) {
+    int fd = open(source_path, O_RDONLY | O_NOFOLLOW);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        perror("Error opening source file");
+        if (fd >= 0) close(fd);
+        return;
+    }
+
+    // Ne jamais écrire à travers un lien symbolique laissé dans le répertoire de restauration
+    unlink(dest_path);
+    int dest_fd = open(dest_path, O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW, 0600);
+    if (dest_fd < 0) {
+        perror("Error opening destination file");
+        close(fd);
+        return;
+    }
+
+    // Une copie chiffrée est déchiffrée segment par segment, sans passer par le cache de chunks
+    if (seal_is_sealed(fd, 0, -1)) {
+        SealReader reader;
+        if (seal_reader_attach(&reader, fd, 0, -1) != 0) {
+            perror("Error reading source file");
+        } else {
+            if (seal_reader_copy(&reader, dest_fd) != 0) {
+                perror("Error writing destination file");
+            }
+            seal_reader_close(&reader);
+        }
+        close(fd);
+        close(dest_fd);
+        return;
+    }
+
+    if (copy_sparse(fd, dest_fd, st.st_size) != 0) {
+        perror("Error writing destination file");
+    }
+
+    close(fd);
+    close(dest_fd);
+}
+
+// Fonction pour extraire d'un conteneur un fichier regroupé
+static void copy_packed_file(const StoredData *data, const char *dest_path) {
+    unsigned char *buffer = malloc(PACK_FILE_MAX);
+    ssize_t size = buffer ? pack_read_entry(data, buffer, PACK_FILE_MAX) : -1;
+    if (size < 0) {
+        perror("Error reading packed file");
+        free(buffer);
+        return;
+    }
+
+    // Ne jamais écrire à travers un lien symbolique laissé dans le répertoire de restauration
+    unlink(dest_path);
+    int dest_fd = open(dest_path, O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW, 0600);
+    if (dest_fd < 0) {
+        perror("Error opening destination file");
+    } else {
+        if (write(dest_fd, buffer, size) != size) {
+            perror("Error writing destination file");
+        } else {
+            throttle_consume(THROTTLE_WRITE, size);
+        }
+        close(dest_fd);
+    }
+    free(buffer);
+}
+
+// Fonction pour retrouver les données d'un élément du log de la sauvegarde backup_id
+static void stored_entry_data(const char *backup_id, const log_element *elt, StoredData *data) {
+    char parent[PATH_MAX], name[PATH_MAX];
+    snprintf(parent, sizeof(parent), "%s", backup_id);
+    snprintf(name, sizeof(name), "%s", backup_id);
+    stored_data_locate(dirname(parent), basename(name), elt, data);
+}
+
+// Fonction pour copier les données d'un élément du log (fichier stocké ou plage d'un conteneur)
+static void copy_stored_data(const StoredData *data, const char *dest_path) {
+    if (data->length >= 0) {
+        copy_packed_file(data, dest_path);
+    } else {
+        copy_stored_file(data->path, dest_path);
+    }
+}
+
+static int path_matches(const char *pattern, const char *path);
+
+// Fonction pour restaurer un élément du journal dans le répertoire de restauration
+// pattern est le motif de la restauration partielle (NULL = tout) : un lien dur dont le premier
+// chemin n'est pas restauré devient une copie
+static void restore_entry(const char *backup_id, const char *restore_dir, log_element *current, const char *pattern) {
+    // Construire le chemin source (dans le répertoire de sauvegarde)
+    StoredData data;
+    stored_entry_data(backup_id, current, &data);
+    const char *source_path = data.path;
+
+    // Construire le chemin de destination (dans le répertoire de restauration)
+    char dest_path[PATH_MAX];
+    snprintf(dest_path, sizeof(dest_path), "%s/%s", restore_dir, current->path);
+
+    // Extraire le répertoire parent du fichier destination
+    char dest_dir[PATH_MAX];
+    snprintf(dest_dir, sizeof(dest_dir), "%s", dest_path);
+    dirname(dest_dir);
+
+    // Vérifier si le répertoire parent existe, sinon le créer
+    struct stat dir_stat;
+    if (stat(dest_dir, &dir_stat) == -1) {
+        printf("Création du répertoire : %s\n", dest_dir);
+        if (make_parent_dirs(dest_dir) == -1) {
+            perror("Erreur lors de la création du répertoire");
+            return; // Passer au fichier suivant en cas d'erreur
+        }
+    }
+
+    struct stat dest_stat;
+    int dest_exists = lstat(dest_path, &dest_stat) == 0;
+
+    if (current->link_target) {
+        // Lien symbolique : recréé tel qu'enregistré dans le journal
+        printf("Création du lien %s -> %s\n", dest_path, current->link_target);
+        if (dest_exists) unlink(dest_path);
+        if (symlink(current->link_target, dest_path) == -1) {
+            perror("Erreur lors de la création du lien symbolique");
+            return;
+        }
+    } else if (current->hardlink && (!pattern || path_matches(pattern, current->hardlink))) {
+        // Lien dur vers un fichier de la sauvegarde déjà restauré
+        char first_path[PATH_MAX];
+        snprintf(first_path, sizeof(first_path), "%s/%s", restore_dir, current->hardlink);
+        if (dest_exists) unlink(dest_path);
+        if (link(first_path, dest_path) == 0) {
+            printf("Création du lien dur %s -> %s\n", dest_path, first_path);
+            return; // Les métadonnées sont partagées avec le premier chemin
+        }
+        perror("Erreur lors de la création du lien dur");
+        printf("Copie initiale de %s -> %s\n", source_path, dest_path);
+        copy_stored_data(&data, dest_path);
+    } else if (dest_exists && S_ISREG(dest_stat.st_mode)) {
+        // Comparer les fichiers uniquement si le fichier destination existe (un fichier regroupé est réécrit)
+        if (data.length >= 0 || files_are_different(source_path, dest_path)) {
+            printf("Mise à jour de %s -> %s\n", source_path, dest_path);
+            copy_stored_data(&data, dest_path);
+        } else {
+            printf("Le fichier %s est déjà à jour.\n", dest_path);
+        }
+    } else {
+        // Le fichier destination n'existe pas, copier directement
+        printf("Copie initiale de %s -> %s\n", source_path, dest_path);
+        copy_stored_data(&data, dest_path);
+    }
+
+    apply_file_metadata(dest_path, current);
+}
+
+// Métadonnées des répertoires d'une sauvegarde par manifeste (lignes de .backup_dirs triées par chemin)
+typedef struct {
+    char **lines;
+    int count;
+} DirManifest;
+
+// Fonction pour comparer deux lignes de .backup_dirs (ou un chemin et une ligne) par leur chemin
+static int compare_dir_lines(const void *a, const void *b) {
+    const char *line1 = *(const char **)a, *line2 = *(const char **)b;
+    size_t len1 = strcspn(line1, ";"), len2 = strcspn(line2, ";");
+    int cmp = strncmp(line1, line2, len1 < len2 ? len1 : len2);
+    return cmp ? cmp : (len1 > len2) - (len1 < len2);
+}
+
+// Fonction pour charger le .backup_dirs de la sauvegarde backup_id (vide pour une sauvegarde complète)
+static void load_dir_manifest(const char *backup_id, DirManifest *dirs) {
+    dirs->lines = NULL;
+    dirs->count = 0;
+    char dirs_path[PATH_MAX];
+    snprintf(dirs_path, sizeof(dirs_path), "%s/%s", backup_id, BACKUP_DIRS);
+    FILE *file = fopen(dirs_path, "r");
+    if (!file) {
+        return;
+    }
+
+    int capacity = 0;
+    char line[BACKUP_LOG_LINE_MAX];
+    while (fgets(line, sizeof(line), file)) {
+        line[strcspn(line, "\n")] = '\0';
+        if (dirs->count == capacity) {
+            capacity = capacity ? capacity * 2 : 256;
+            char **grown = realloc(dirs->lines, capacity * sizeof(char *));
+            if (!grown) break;
+            dirs->lines = grown;
+        }
+        dirs->lines[dirs->count++] = strdup(line);
+    }
+    fclose(file);
+    qsort(dirs->lines, dirs->count, sizeof(char *), compare_dir_lines);
+}
+
+static void free_dir_manifest(DirManifest *dirs) {
+    for (int i = 0; i < dirs->count; i++) {
+        free(dirs->lines[i]);
+    }
+    free(dirs->lines);
+}
+
+// Fonction pour rendre aux répertoires restaurés les permissions et dates de la sauvegarde
+// (après la restauration de leur contenu, qui modifie leur date)
+// Elles sont lues dans .backup_dirs pour une sauvegarde par manifeste, sur les répertoires stockés sinon
+static void restore_directory_metadata(const char *backup_id, const char *restore_dir, const char *path,
+                                       const DirManifest *dirs) {
+    char dir[PATH_MAX];
+    snprintf(dir, sizeof(dir), "%s", path);
+
+    for (char *slash = strrchr(dir, '/'); slash; slash = strrchr(dir, '/')) {
+        *slash = '\0';
+
+        char source_dir[PATH_MAX], dest_dir[PATH_MAX];
+        struct stat st;
+        if (snprintf(source_dir, sizeof(source_dir), "%s/%s", backup_id, dir) >= (int)sizeof(source_dir) ||
+            snprintf(dest_dir, sizeof(dest_dir), "%s/%s", restore_dir, dir) >= (int)sizeof(dest_dir)) {
+            continue;
+        }
+        if (dirs->lines) {
+            const char *key = dir;
+            char **found = bsearch(&key, dirs->lines, dirs->count, sizeof(char *), compare_dir_lines);
+            if (found) {
+                char *copy = strdup(*found);
+                char *cursor = copy + strcspn(copy, ";") + 1;
+                log_element elt;
+                parse_metadata_fields(&cursor, &elt);
+                apply_file_metadata(dest_dir, &elt);
+                free_file_metadata(&elt);
+                free(copy);
+            }
+        } else if (lstat(source_dir, &st) == 0 && S_ISDIR(st.st_mode)) {
+            copy_path_metadata(source_dir, dest_dir, &st);
+        }
+    }
+}
+
+// Fonction pour vérifier si un chemin correspond au motif ou appartient
+// à un répertoire qui y correspond (restauration d'un sous-arbre)
+static int path_matches(const char *pattern, const char *path) {
+    if (fnmatch(pattern, path, 0) == 0) {
+        return 1;
+    }
+
+    char parent[PATH_MAX];
+    for (const char *slash = strchr(path, '/'); slash; slash = strchr(slash + 1, '/')) {
+        size_t len = slash - path;
+        if (len >= sizeof(parent)) break;
+        memcpy(parent, path, len);
+        parent[len] = '\0';
+        if (fnmatch(pattern, parent, 0) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Fonction pour recréer les répertoires stockés sous path dans une sauvegarde complète (vides compris)
+// et leur rendre leurs métadonnées une fois leur contenu restauré ; root_len est la longueur du chemin
+// de la sauvegarde. Retourne le nombre de répertoires recréés
+static int restore_stored_dirs(const char *restore_dir, PathBuffer *path, size_t root_len, const char *pattern) {
+    DirListing listing;
+    if (dir_listing_open(AT_FDCWD, path->buf, &listing) != 0) {
+        return 0;
+    }
+    int created = 0;
+    for (int i = 0; i < listing.count; i++) {
+        DirEntry *entry = &listing.entries[i];
+        if (!dir_entry_is_dir(&listing, entry)) {
+            continue;
+        }
+        size_t len = path_buffer_push(path, entry->name);
+        const char *relative = path->buf + root_len + 1;
+        char dest_dir[PATH_MAX];
+        int dest_len = snprintf(dest_dir, sizeof(dest_dir), "%s/%s", restore_dir, relative);
+        int selected = !pattern || path_matches(pattern, relative);
+        if (selected && (dest_len < 0 || (size_t)dest_len >= sizeof(dest_dir) || make_parent_dirs(dest_dir) == -1)) {
+            perror("Erreur lors de la création du répertoire restauré");
+            selected = 0;
+        }
+        created += restore_stored_dirs(restore_dir, path, root_len, pattern);
+        struct stat st;
+        if (selected && lstat(path->buf, &st) == 0) {
+            copy_path_metadata(path->buf, dest_dir, &st);
+            created++;
+        }
+        path_buffer_pop(path, len);
+    }
+    dir_listing_close(&listing);
+    return created;
+}
+
+// Fonction pour lire les éléments du journal pouvant correspondre au motif (tous si pattern est NULL)
+static log_t read_selected_entries(const char *backup_id, const char *pattern) {
+    if (pattern) {
+        // Seule la partie littérale du motif (avant le premier joker) sert à la recherche dans l'index
+        char prefix[PATH_MAX];
+        size_t prefix_len = strcspn(pattern, "*?[\\");
+        if (prefix_len >= sizeof(prefix)) prefix_len = sizeof(prefix) - 1;
+        memcpy(prefix, pattern, prefix_len);
+        prefix[prefix_len] = '\0';
+        return read_backup_log_prefix(backup_id, prefix);
+    }
+
+    // Construire le chemin du fichier `.backup_log` pour la sauvegarde spécifiée
+    char backup_log_path[PATH_MAX];
+    snprintf(backup_log_path, sizeof(backup_log_path), "%s/.backup_log", backup_id);
+
+    // Lire le fichier .backup_log
+    return read_backup_log(backup_log_path);
+}
+
+// Fonction pour restaurer une sauvegarde
+// Si pattern n'est pas NULL, seuls les fichiers (ou sous-arbres) correspondant
+// au motif glob sont restaurés ; ils sont localisés grâce à l'index de la sauvegarde
+void restore_backup_paths(const char *backup_id, const char *restore_dir, const char *pattern) {
     // Vérifier si le répertoire de destination est valide
     struct stat restore_stat;
 
@@ -610,80 +1981,617 @@ void restore_backup(const char *backup_id, const char *restore_dir) {
         return;
     }
 
-    // Construire le chemin du fichier `.backup_log` pour la sauvegarde spécifiée
-    char backup_log_path[512];
-    snprintf(backup_log_path, sizeof(backup_log_path), "%s/.backup_log", backup_id);
-
-    // Lire le fichier .backup_log
-    log_t logs = read_backup_log(backup_log_path);
-    if (!logs.head) {
-        fprintf(stderr, "Aucun fichier à restaurer trouvé dans .backup_log\n");
+    // Les fichiers d'un répertoire chiffré ne peuvent être restaurés qu'avec sa clé
+    char repository[PATH_MAX];
+    snprintf(repository, sizeof(repository), "%s", backup_id);
+    if (seal_check_repository(dirname(repository), 0) != 0) {
         return;
     }
 
-    // Parcourir les éléments du journal pour restaurer les fichiers
-    log_element *current = logs.head;
-    while (current) {
-        // Construire le chemin source (dans le répertoire de sauvegarde)
-        char source_path[512];
-        snprintf(source_path, sizeof(source_path), "%s/%s", backup_id, current->path);
-
-        // Construire le chemin de destination (dans le répertoire de restauration)
-        char dest_path[512];
-        snprintf(dest_path, sizeof(dest_path), "%s/%s", restore_dir, current->path);
-
-        // Extraire le répertoire parent du fichier destination
-        char dest_dir[512];
-        snprintf(dest_dir, sizeof(dest_dir), "%s", dest_path);
-        dirname(dest_dir);
-
-        // Vérifier si le répertoire parent existe, sinon le créer
-        struct stat dir_stat;
-        if (stat(dest_dir, &dir_stat) == -1) {
-            printf("Création du répertoire : %s\n", dest_dir);
-            if (mkdir(dest_dir, 0755) == -1) {
-                perror("Erreur lors de la création du répertoire");
-                continue; // Passer au fichier suivant en cas d'erreur
+    // Une sauvegarde peut ne contenir que des répertoires (vides)
+    log_t logs = read_selected_entries(backup_id, pattern);
+    DirManifest dirs;
+    load_dir_manifest(backup_id, &dirs);
+
+    // Parcourir les éléments du journal pour restaurer les fichiers, puis (second passage)
+    // les liens durs, dont le premier chemin doit déjà exister
+    int restored = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        for (log_element *current = logs.head; current; current = current->next) {
+            if ((current->hardlink != NULL) != pass) {
+                continue;
+            }
+            if (pattern && !path_matches(pattern, current->path)) {
+                continue;
             }
+            restore_entry(backup_id, restore_dir, current, pattern);
+            restored++;
+        }
+    }
+
+    // Les répertoires d'une sauvegarde complète sont ceux qui sont stockés, vides compris
+    int dirs_created = 0;
+    if (!dirs.lines) {
+        PathBuffer path;
+        path_buffer_init(&path, backup_id);
+        dirs_created = restore_stored_dirs(restore_dir, &path, strlen(backup_id), pattern);
+        path_buffer_free(&path);
+    }
+
+    // Les répertoires d'une sauvegarde par manifeste sont tous recréés, y compris ceux qui
+    // ne contiennent aucun fichier, avant de recevoir leurs métadonnées
+    for (int i = 0; i < dirs.count; i++) {
+        char dir[PATH_MAX], dest_dir[PATH_MAX];
+        snprintf(dir, sizeof(dir), "%.*s", (int)strcspn(dirs.lines[i], ";"), dirs.lines[i]);
+        if (pattern && !path_matches(pattern, dir)) {
+            continue;
+        }
+        int len = snprintf(dest_dir, sizeof(dest_dir), "%s/%s", restore_dir, dir);
+        if (len < 0 || (size_t)len >= sizeof(dest_dir) || make_parent_dirs(dest_dir) == -1) {
+            perror("Erreur lors de la création du répertoire restauré");
+            continue;
+        }
+        dirs_created++;
+    }
+
+    // Le journal est trié par chemin : chaque répertoire n'est traité qu'à son premier fichier
+    char previous_dir[PATH_MAX] = "";
+    for (log_element *current = logs.head; current; current = current->next) {
+        const char *slash = strrchr(current->path, '/');
+        int dir_len = slash ? (int)(slash - current->path) : 0;
+        if (dir_len == 0 || (pattern && !path_matches(pattern, current->path))) {
+            continue;
+        }
+        if ((int)strlen(previous_dir) != dir_len || strncmp(previous_dir, current->path, dir_len) != 0) {
+            snprintf(previous_dir, sizeof(previous_dir), "%.*s", dir_len, current->path);
+            restore_directory_metadata(backup_id, restore_dir, current->path, &dirs);
+        }
+    }
+    for (int i = 0; i < dirs.count; i++) {
+        char *copy = strdup(dirs.lines[i]);
+        if (!copy) break;
+        char *cursor = strchr(copy, ';');
+        if (cursor) *cursor++ = '\0';
+        char dest_dir[PATH_MAX];
+        int len = snprintf(dest_dir, sizeof(dest_dir), "%s/%s", restore_dir, copy);
+        if (cursor && (!pattern || path_matches(pattern, copy)) && len > 0 && (size_t)len < sizeof(dest_dir)) {
+            log_element elt;
+            parse_metadata_fields(&cursor, &elt);
+            apply_file_metadata(dest_dir, &elt);
+            free_file_metadata(&elt);
+        }
+        free(copy);
+    }
+
+    if (pattern && restored == 0 && dirs_created == 0) {
+        fprintf(stderr, "Aucun fichier ne correspond au motif %s\n", pattern);
+    } else if (restored == 0 && dirs_created == 0) {
+        fprintf(stderr, "Aucun fichier à restaurer trouvé dans .backup_log\n");
+    }
+
+    free_dir_manifest(&dirs);
+    chunk_cache_print_stats(stdout);
+    print_dedup_stats(stdout);
+
+    // Libérer la mémoire allouée pour le journal
+    free_backup_log(&logs);
+}
+
+void restore_backup(const char *backup_id, const char *restore_dir) {
+    restore_backup_paths(backup_id, restore_dir, NULL);
+}
+
+// Fonction pour envoyer les fichiers d'une sauvegarde correspondant au motif dans un flux
+// Chaque fichier est précédé d'une ligne "FILE <taille> <chemin>" ; les blocs sont lus via le cache de chunks
+void send_backup_files(const char *backup_id, const char *pattern, FILE *out) {
+    log_t logs = read_selected_entries(backup_id, pattern);
+    unsigned char block[CHUNK_SIZE];
+
+    for (log_element *current = logs.head; current; current = current->next) {
+        if (pattern && !path_matches(pattern, current->path)) {
+            continue;
+        }
+
+        // Seuls les fichiers réguliers sont transmis (les liens symboliques ne le sont pas)
+        if (current->link_target) {
+            continue;
         }
 
-        // Vérifier si le fichier destination existe déjà
-        if (access(dest_path, F_OK) == 0) {  // Le fichier existe
-            // Comparer les fichiers uniquement si le fichier destination existe
-            if (files_are_different(source_path, dest_path)) {
-                printf("Mise à jour de %s -> %s\n", source_path, dest_path);
-                copy_single_file(source_path, dest_path);
+        StoredData data;
+        stored_entry_data(backup_id, current, &data);
+        if (data.length >= 0) {
+            // Fichier regroupé : sa plage du conteneur est envoyée d'un bloc, telle qu'elle est stockée
+            // (chiffrée avec --encrypt-key : le serveur n'a pas besoin de la clé, le client déchiffre)
+            unsigned char *packed = malloc(PACK_STORED_MAX);
+            ssize_t size = packed ? pack_read_stored(&data, packed, PACK_STORED_MAX) : -1;
+            if (size < 0) {
+                perror("Erreur lors de la lecture du fichier regroupé");
             } else {
-                printf("Le fichier %s est déjà à jour.\n", dest_path);
+                fprintf(out, "FILE %lld %s\n", (long long)size, current->path);
+                fwrite(packed, 1, size, out);
             }
-        } else {
-            // Le fichier destination n'existe pas, copier directement
-            printf("Copie initiale de %s -> %s\n", source_path, dest_path);
-            copy_single_file(source_path, dest_path);
+            free(packed);
+            continue;
         }
 
-        current = current->next;
+        int fd = open(data.path, O_RDONLY | O_NOFOLLOW);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0) {
+            perror("Erreur lors de l'ouverture du fichier sauvegardé");
+            if (fd >= 0) close(fd);
+            continue;
+        }
+        if (!S_ISREG(st.st_mode)) {
+            close(fd);
+            continue;
+        }
+
+        // La taille annoncée est celle du fichier stocké : le client lit exactement ces octets
+        // Chaque fichier n'est envoyé qu'une fois : il est lu par grandes plages, sans le cache de chunks
+        fprintf(out, "FILE %lld %s\n", (long long)st.st_size, current->path);
+        off_t sent = 0;
+        CacheReader reader;
+        if (cache_reader_attach(&reader, fd) == 0) {
+            while (sent < st.st_size) {
+                const unsigned char *chunk;
+                size_t len = st.st_size - sent < CACHE_IO_BUFFER_SIZE / 2 ? (size_t)(st.st_size - sent)
+                                                                          : CACHE_IO_BUFFER_SIZE / 2;
+                ssize_t bytes = cache_reader_pread(&reader, sent, len, &chunk);
+                if (bytes <= 0) break;
+                fwrite(chunk, 1, bytes, out);
+                sent += bytes;
+            }
+            cache_reader_close(&reader);
+        }
+        // Compléter si le fichier a été tronqué pendant l'envoi, pour garder le flux cohérent
+        memset(block, 0, sizeof(block));
+        while (sent < st.st_size) {
+            size_t pad = (st.st_size - sent < CHUNK_SIZE) ? (size_t)(st.st_size - sent) : CHUNK_SIZE;
+            fwrite(block, 1, pad, out);
+            sent += pad;
+        }
+        close(fd);
     }
 
-    // Libérer la mémoire allouée pour le journal
     free_backup_log(&logs);
 }
 
+// Fichier d'une sauvegarde transmis morceau par morceau (données telles qu'elles sont stockées)
+typedef struct {
+    const log_element *elt;
+    StoredData data;
+    off_t size;               // Taille stockée
+} SentFile;
+
+// Fonction pour choisir les fichiers réguliers d'une sauvegarde correspondant au motif
+// Le manifeste et chaque flux d'une restauration parallèle obtiennent la même liste, dans le même ordre
+static SentFile *select_sent_files(const char *backup_id, const char *pattern, log_t *logs, int *count) {
+    *logs = read_selected_entries(backup_id, pattern);
+    *count = 0;
+
+    int capacity = 0;
+    SentFile *files = NULL;
+    for (log_element *current = logs->head; current; current = current->next) {
+        if ((pattern && !path_matches(pattern, current->path)) || current->link_target) {
+            continue;
+        }
+        // Un lien dur dont le premier chemin est restauré est recréé par le client, sans données
+        if (current->hardlink && (!pattern || path_matches(pattern, current->hardlink))) {
+            continue;
+        }
 
+        StoredData data;
+        struct stat st;
+        off_t size;
+        stored_entry_data(backup_id, current, &data);
+        if (data.length >= 0) {
+            // Plage d'un conteneur : sa taille stockée dépend de son chiffrement
+            int fd = open(data.path, O_RDONLY | O_NOFOLLOW);
+            if (fd < 0) continue;
+            size = seal_is_sealed(fd, data.offset, data.length) ? seal_stored_size(data.length) : data.length;
+            close(fd);
+        } else if (lstat(data.path, &st) == 0 && S_ISREG(st.st_mode)) {
+            size = st.st_size;
+        } else {
+            continue;
+        }
 
+        if (*count == capacity) {
+            capacity = capacity ? capacity * 2 : 256;
+            SentFile *grown = realloc(files, capacity * sizeof(SentFile));
+            if (!grown) {
+                perror("Erreur d'allocation mémoire pour l'envoi des fichiers");
+                break;
+            }
+            files = grown;
+        }
+        SentFile *file = &files[(*count)++];
+        file->elt = current;
+        file->data = data;
+        file->size = size;
+    }
+    return files;
+}
 
-void free_backup_log(log_t *logs) {
-    log_element *current = logs->head;
-    while (current) {
-        log_element *next = current->next;
-        free(current->path);
-        free(current->date);
-        free(current);
-        current = next;
+// Durée (en secondes) pendant laquelle une liste de fichiers inutilisée reste en mémoire
+#define SENT_LIST_IDLE_SECONDS 60
+
+// Liste des fichiers d'une restauration parallèle, calculée une seule fois pour le manifeste et
+// tous les flux de la restauration (ils arrivent sur des connexions différentes)
+typedef struct SentList {
+    char *backup_id;
+    char *pattern;            // NULL = tous les fichiers
+    struct stat log_stat;     // .backup_log au moment du calcul
+    log_t logs;
+    SentFile *files;
+    int count;
+    int ready;                // 0 tant que la liste est en cours de calcul
+    int users;
+    time_t released;          // Dernière libération (users à 0)
+    struct SentList *next;
+} SentList;
+
+static SentList *sent_lists = NULL;
+static pthread_mutex_t sent_lists_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sent_lists_ready = PTHREAD_COND_INITIALIZER;
+
+// Fonction pour libérer les listes inutilisées depuis plus de SENT_LIST_IDLE_SECONDS (verrou tenu)
+static void expire_sent_lists(time_t now) {
+    for (SentList **link = &sent_lists; *link; ) {
+        SentList *list = *link;
+        if (list->ready && list->users == 0 && now - list->released >= SENT_LIST_IDLE_SECONDS) {
+            *link = list->next;
+            free(list->files);
+            free_backup_log(&list->logs);
+            free(list->backup_id);
+            free(list->pattern);
+            free(list);
+        } else {
+            link = &list->next;
+        }
+    }
+}
+
+// Fonction pour obtenir la liste des fichiers de backup_id correspondant au motif
+// La liste d'une restauration en cours est reprise tant que le .backup_log n'a pas changé ; un
+// flux qui arrive pendant son calcul attend le résultat au lieu de relire le log
+static SentList *acquire_sent_list(const char *backup_id, const char *pattern) {
+    char log_path[PATH_MAX];
+    struct stat log_stat;
+    int len = snprintf(log_path, sizeof(log_path), "%s/.backup_log", backup_id);
+    if (len < 0 || (size_t)len >= sizeof(log_path) || stat(log_path, &log_stat) != 0) {
+        memset(&log_stat, 0, sizeof(log_stat));
+    }
+
+    pthread_mutex_lock(&sent_lists_lock);
+    expire_sent_lists(time(NULL));
+    for (SentList *list = sent_lists; list; list = list->next) {
+        if (strcmp(list->backup_id, backup_id) == 0 &&
+            (list->pattern ? pattern && strcmp(list->pattern, pattern) == 0 : !pattern) &&
+            list->log_stat.st_ino == log_stat.st_ino && list->log_stat.st_size == log_stat.st_size &&
+            list->log_stat.st_mtim.tv_sec == log_stat.st_mtim.tv_sec &&
+            list->log_stat.st_mtim.tv_nsec == log_stat.st_mtim.tv_nsec) {
+            list->users++;
+            while (!list->ready) {
+                pthread_cond_wait(&sent_lists_ready, &sent_lists_lock);
+            }
+            pthread_mutex_unlock(&sent_lists_lock);
+            return list;
+        }
     }
-    logs->head = logs->tail = NULL;
+
+    SentList *list = calloc(1, sizeof(SentList));
+    if (!list || !(list->backup_id = strdup(backup_id)) || (pattern && !(list->pattern = strdup(pattern)))) {
+        perror("Erreur d'allocation mémoire pour l'envoi des fichiers");
+        if (list) free(list->backup_id);
+        free(list);
+        pthread_mutex_unlock(&sent_lists_lock);
+        return NULL;
+    }
+    list->log_stat = log_stat;
+    list->users = 1;
+    list->next = sent_lists;
+    sent_lists = list;
+    pthread_mutex_unlock(&sent_lists_lock);
+
+    // Le calcul se fait hors du verrou : les requêtes sur d'autres sauvegardes ne l'attendent pas
+    list->files = select_sent_files(backup_id, pattern, &list->logs, &list->count);
+
+    pthread_mutex_lock(&sent_lists_lock);
+    list->ready = 1;
+    pthread_cond_broadcast(&sent_lists_ready);
+    pthread_mutex_unlock(&sent_lists_lock);
+    return list;
 }
 
+// Fonction pour rendre une liste obtenue par acquire_sent_list
+static void release_sent_list(SentList *list) {
+    pthread_mutex_lock(&sent_lists_lock);
+    list->released = time(NULL);
+    list->users--;
+    expire_sent_lists(list->released);
+    pthread_mutex_unlock(&sent_lists_lock);
+}
 
+// Fonction pour envoyer les métadonnées d'un répertoire de la sauvegarde ("DIR <chemin>" puis ses champs)
+// Dans une sauvegarde complète, elles sont lues sur le répertoire stocké
+static void send_stored_dir_metadata(const char *backup_id, const char *dir, InodeMap *seen, FILE *out) {
+    char source_dir[PATH_MAX];
+    struct stat st;
+    log_element elt;
+    int len = snprintf(source_dir, sizeof(source_dir), "%s/%s", backup_id, dir);
+    if (len < 0 || (size_t)len >= sizeof(source_dir) || lstat(source_dir, &st) != 0 || !S_ISDIR(st.st_mode) ||
+        inode_map_find_or_add(seen, &st, dir) || read_file_metadata(source_dir, &st, &elt) != 0) {
+        return;
+    }
+    fprintf(out, "DIR %s\n", dir);
+    write_metadata_fields(out, &elt);
+    fputc('\n', out);
+    free_file_metadata(&elt);
+}
 
+// Fonction pour envoyer les répertoires stockés sous path dans une sauvegarde complète (vides compris)
+// root_len est la longueur du chemin de la sauvegarde
+static void send_stored_dirs(const char *backup_id, PathBuffer *path, size_t root_len, const char *pattern,
+                             InodeMap *seen, FILE *out) {
+    DirListing listing;
+    if (dir_listing_open(AT_FDCWD, path->buf, &listing) != 0) {
+        return;
+    }
+    for (int i = 0; i < listing.count; i++) {
+        DirEntry *entry = &listing.entries[i];
+        if (!dir_entry_is_dir(&listing, entry)) {
+            continue;
+        }
+        size_t len = path_buffer_push(path, entry->name);
+        const char *relative = path->buf + root_len + 1;
+        if (!pattern || path_matches(pattern, relative)) {
+            send_stored_dir_metadata(backup_id, relative, seen, out);
+        }
+        send_stored_dirs(backup_id, path, root_len, pattern, seen, out);
+        path_buffer_pop(path, len);
+    }
+    dir_listing_close(&listing);
+}
 
+// Fonction pour envoyer la liste des fichiers d'une sauvegarde correspondant au motif
+// Une ligne "FILE <taille stockée> <chemin>" par fichier, dans l'ordre de leurs numéros, puis les
+// métadonnées de restauration : "ENTRY <chemin>" par élément (fichier, lien symbolique ou lien dur) et
+// "DIR <chemin>" par répertoire, chacun suivi d'une ligne de champs de métadonnées au format du log
+void send_backup_manifest(const char *backup_id, const char *pattern, FILE *out) {
+    SentList *list = acquire_sent_list(backup_id, pattern);
+    if (!list) {
+        return;
+    }
+    for (int i = 0; i < list->count; i++) {
+        fprintf(out, "FILE %lld %s\n", (long long)list->files[i].size, list->files[i].elt->path);
+    }
+
+    // Les liens durs gardent leur premier chemin s'il est restauré (le client les recrée), deviennent
+    // des fichiers sinon ; la sauvegarde qui stocke les données ne concerne que le serveur
+    for (const log_element *current = list->logs.head; current; current = current->next) {
+        if (pattern && !path_matches(pattern, current->path)) {
+            continue;
+        }
+        log_element meta = *current;
+        meta.stored = NULL;
+        if (meta.hardlink && pattern && !path_matches(pattern, meta.hardlink)) {
+            meta.hardlink = NULL;
+        }
+        fprintf(out, "ENTRY %s\n", current->path);
+        write_metadata_fields(out, &meta);
+        fputc('\n', out);
+    }
+
+    // Répertoires : ceux de .backup_dirs pour une sauvegarde par manifeste, les répertoires stockés
+    // pour une sauvegarde complète (vides compris dans les deux cas), ainsi que les parents des
+    // éléments envoyés
+    DirManifest dirs;
+    load_dir_manifest(backup_id, &dirs);
+    for (int i = 0; i < dirs.count; i++) {
+        int dir_len = (int)strcspn(dirs.lines[i], ";");
+        char dir[PATH_MAX];
+        snprintf(dir, sizeof(dir), "%.*s", dir_len, dirs.lines[i]);
+        if (!pattern || path_matches(pattern, dir)) {
+            fprintf(out, "DIR %s\n%s\n", dir, dirs.lines[i] + dir_len);
+        }
+    }
+    if (dirs.count == 0) {
+        InodeMap seen;
+        PathBuffer path;
+        inode_map_init(&seen);
+        path_buffer_init(&path, backup_id);
+        send_stored_dirs(backup_id, &path, strlen(backup_id), pattern, &seen, out);
+        path_buffer_free(&path);
+        for (const log_element *current = list->logs.head; current; current = current->next) {
+            if (pattern && !path_matches(pattern, current->path)) {
+                continue;
+            }
+            char dir[PATH_MAX];
+            snprintf(dir, sizeof(dir), "%s", current->path);
+            for (char *slash = strrchr(dir, '/'); slash; slash = strrchr(dir, '/')) {
+                *slash = '\0';
+                send_stored_dir_metadata(backup_id, dir, &seen, out);
+            }
+        }
+        inode_map_free(&seen);
+    }
+    free_dir_manifest(&dirs);
+    release_sent_list(list);
+}
+
+// Fonction pour lire dans buffer la plage [offset, offset + length) des données stockées d'un fichier
+// fd et st désignent le fichier stocké ou le conteneur ; les fichiers entiers sont lus via le cache de chunks
+// Retourne -1 si la plage ne peut pas être lue entièrement (fichier illisible ou tronqué)
+static int read_stored_range(int fd, const struct stat *st, const SentFile *file, off_t offset, off_t length,
+                             unsigned char *buffer) {
+    unsigned char block[CHUNK_SIZE];
+    while (fd >= 0 && length > 0) {
+        ssize_t bytes;
+        size_t skip = 0;
+        if (file->data.length >= 0) {
+            bytes = pread(fd, buffer, length, file->data.offset + offset);
+            if (bytes > 0) {
+                buffer += bytes;
+                offset += bytes;
+                length -= bytes;
+                continue;
+            }
+        } else {
+            skip = offset % CHUNK_SIZE;
+            bytes = chunk_cache_read_block(fd, st, offset / CHUNK_SIZE, block);
+            bytes = bytes > (ssize_t)skip ? bytes - (ssize_t)skip : 0;
+        }
+        if (bytes <= 0) break;
+        if (bytes > length) bytes = length;
+        memcpy(buffer, block + skip, bytes);
+        buffer += bytes;
+        offset += bytes;
+        length -= bytes;
+    }
+    return length == 0 ? 0 : -1;
+}
+
+// Fonction pour servir un flux de restauration parallèle : répond dans l'ordre aux requêtes
+// "GET <numéro> <offset> <taille>" lues dans in, vide le tampon de sortie à chaque "FLUSH"
+// (fin d'un lot du client) et s'arrête à "END"
+// Une plage illisible (fichier stocké absent, tronqué) est signalée par "ILLISIBLE <numéro> <offset>
+// <taille>" sans données : le client écarte ce fichier au lieu de le restaurer rempli de zéros
+void serve_backup_ranges(const char *backup_id, const char *pattern, FILE *in, FILE *out) {
+    SentList *list = acquire_sent_list(backup_id, pattern);
+    if (!list) {
+        fprintf(out, "ERREUR\n");
+        return;
+    }
+    const SentFile *files = list->files;
+    int count = list->count;
+    unsigned char *buffer = malloc(NET_PIECE_SIZE);
+    if (!buffer) {
+        perror("Erreur d'allocation mémoire pour l'envoi des fichiers");
+        fprintf(out, "ERREUR\n");
+        release_sent_list(list);
+        return;
+    }
+    fprintf(out, "OK %d\n", count);
+    fflush(out);
+
+    // Les morceaux d'un même fichier se suivent : son descripteur reste ouvert entre deux requêtes
+    int current = -1, fd = -1;
+    struct stat st = {0};
+    char line[256];
+    while (fgets(line, sizeof(line), in)) {
+        int index;
+        long long offset, length;
+        if (strcmp(line, "FLUSH\n") == 0) {
+            fflush(out);
+            continue;
+        }
+        if (strcmp(line, "END\n") == 0) {
+            fprintf(out, "FIN\n");
+            break;
+        }
+        if (sscanf(line, "GET %d %lld %lld", &index, &offset, &length) != 3 || index < 0 || index >= count ||
+            offset < 0 || length < 0 || length > NET_PIECE_SIZE || offset + length > files[index].size) {
+            fprintf(out, "ERREUR\n");
+            break;
+        }
+
+        if (index != current) {
+            if (fd >= 0) close(fd);
+            current = index;
+            fd = open(files[index].data.path, O_RDONLY | O_NOFOLLOW);
+            if (fd >= 0 && fstat(fd, &st) != 0) {
+                close(fd);
+                fd = -1;
+            }
+            if (fd < 0) {
+                perror("Erreur lors de l'ouverture du fichier sauvegardé");
+            }
+        }
+        if (read_stored_range(fd, &st, &files[index], offset, length, buffer) != 0) {
+            fprintf(stderr, "Plage illisible : %s (%lld octets à %lld)\n", files[index].elt->path, length, offset);
+            fprintf(out, "ILLISIBLE %d %lld %lld\n", index, offset, length);
+            continue;
+        }
+        fprintf(out, "DATA %d %lld %lld\n", index, offset, length);
+        fwrite(buffer, 1, length, out);
+    }
+    fflush(out);
+
+    if (fd >= 0) close(fd);
+    free(buffer);
+    release_sent_list(list);
+}
+
+
+
+// Fonction pour comparer deux sauvegardes à partir de leurs fichiers .backup_log
+// Les deux logs sont triés par chemin puis parcourus en une seule passe (jointure par fusion) :
+// aucun fichier de sauvegarde n'est ouvert, seuls les tailles et MD5 du log sont comparés
+void diff_backups(const char *snapshot_a, const char *snapshot_b, FILE *out) {
+    char log_path_a[512], log_path_b[512];
+    snprintf(log_path_a, sizeof(log_path_a), "%s/.backup_log", snapshot_a);
+    snprintf(log_path_b, sizeof(log_path_b), "%s/.backup_log", snapshot_b);
+
+    log_t logs_a = read_backup_log(log_path_a);
+    log_t logs_b = read_backup_log(log_path_b);
+
+    int count_a = 0, count_b = 0;
+    log_element **entries_a = sort_backup_log(&logs_a, &count_a);
+    log_element **entries_b = sort_backup_log(&logs_b, &count_b);
+    if (!entries_a || !entries_b) {
+        fprintf(out, "Erreur lors de la lecture des logs de sauvegarde\n");
+        free(entries_a);
+        free(entries_b);
+        free_backup_log(&logs_a);
+        free_backup_log(&logs_b);
+        return;
+    }
+
+    int added = 0, removed = 0, modified = 0;
+    long long added_bytes = 0, removed_bytes = 0, modified_bytes = 0;
+    int i = 0, j = 0;
+
+    while (i < count_a || j < count_b) {
+        int cmp;
+        if (i >= count_a) {
+            cmp = 1;
+        } else if (j >= count_b) {
+            cmp = -1;
+        } else {
+            cmp = strcmp(entries_a[i]->path, entries_b[j]->path);
+        }
+
+        if (cmp < 0) {
+            // Présent uniquement dans la première sauvegarde
+            log_element *elt = entries_a[i++];
+            fprintf(out, "- %s (%lld octets)\n", elt->path, (long long)elt->size);
+            removed++;
+            if (elt->size > 0) removed_bytes += elt->size;
+        } else if (cmp > 0) {
+            // Présent uniquement dans la deuxième sauvegarde
+            log_element *elt = entries_b[j++];
+            fprintf(out, "+ %s (%lld octets)\n", elt->path, (long long)elt->size);
+            added++;
+            if (elt->size > 0) added_bytes += elt->size;
+        } else {
+            log_element *elt_a = entries_a[i++];
+            log_element *elt_b = entries_b[j++];
+            if (elt_a->size != elt_b->size || memcmp(elt_a->md5, elt_b->md5, MD5_DIGEST_LENGTH) != 0) {
+                fprintf(out, "M %s (%lld -> %lld octets)\n", elt_b->path,
+                        (long long)elt_a->size, (long long)elt_b->size);
+                modified++;
+                if (elt_b->size > 0) modified_bytes += elt_b->size;
+            }
+        }
+    }
+
+    fprintf(out, "\nFichiers ajoutés : %d (%lld octets)\n", added, added_bytes);
+    fprintf(out, "Fichiers supprimés : %d (%lld octets)\n", removed, removed_bytes);
+    fprintf(out, "Fichiers modifiés : %d (%lld octets)\n", modified, modified_bytes);
+
+    free(entries_a);
+    free(entries_b);
+    free_backup_log(&logs_a);
+    free_backup_log(&logs_b);
+}
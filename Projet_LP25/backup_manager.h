@@ -10,10 +10,40 @@
 #include <time.h>
 #include <sys/stat.h>
 
+// Fonction pour générer le nom d'une nouvelle sauvegarde (date au format "YYYY-MM-DD-hh:mm:ss.sss")
+void generate_backup_name(char *buffer, size_t size);
 // Fonction pour créer un nouveau backup incrémental
 void create_backup(const char *source_dir, const char *backup_dir);
+// Fonction pour créer une sauvegarde en ne relisant que les chemins du journal des modifications
+// (si use_journal vaut 1 et que le journal est complet ; sinon la source est parcourue entièrement)
+void create_backup_journaled(const char *source_dir, const char *backup_dir, int use_journal);
+// Fonction pour choisir les sauvegardes incrémentales par manifeste : les fichiers inchangés ne sont
+// que des lignes du log désignant la sauvegarde qui les stocke, sans arborescence de liens durs
+void set_manifest_snapshots(int enabled);
+// Fonction pour choisir le nombre de threads copiant les fichiers modifiés d'une sauvegarde incrémentale
+// (0 = nombre de cœurs ; les copies restent séquentielles avec --read-order extent)
+void set_sync_threads(int threads);
+// Fonction pour ne copier que la fin ajoutée des fichiers qui n'ont fait que grandir (journaux, logs)
+// Le reste est repris de la copie précédente après comparaison de quelques blocs seulement
+void set_append_tails(int enabled);
+// Fonction pour regrouper les petits fichiers copiés dans de gros conteneurs indexés (implique --manifest-only)
+// La destination ne reçoit que quelques fichiers par sauvegarde, écrits séquentiellement
+void set_pack_small_files(int enabled);
+// Fonction pour supprimer une sauvegarde qui n'a pas pu être validée (répertoire et contenu)
+void abandon_snapshot(const char *snapshot_path);
+// Fonction pour copier une sauvegarde dans une nouvelle par liens durs, en appliquant les filtres d'exclusion
+// Retourne 0 en cas de succès, -1 si une entrée n'a pas pu être copiée
+int copy_with_hard_links(const char *source, const char *destination);
 // Fonction pour restaurer une sauvegarde
 void restore_backup(const char *backup_id, const char *restore_dir);
+// Fonction pour restaurer uniquement les fichiers d'une sauvegarde correspondant à un motif glob
+void restore_backup_paths(const char *backup_id, const char *restore_dir, const char *pattern);
+// Fonction pour envoyer dans un flux les fichiers d'une sauvegarde correspondant à un motif (NULL = tous)
+void send_backup_files(const char *backup_id, const char *pattern, FILE *out);
+// Fonction pour envoyer la liste numérotée des fichiers d'une sauvegarde correspondant au motif (NULL = tous)
+void send_backup_manifest(const char *backup_id, const char *pattern, FILE *out);
+// Fonction pour servir les requêtes de morceaux de fichiers d'un flux de restauration parallèle
+void serve_backup_ranges(const char *backup_id, const char *pattern, FILE *in, FILE *out);
 // Fonction permettant la restauration du fichier backup via le tableau de chunk
 void write_backup_file(const char *output_filename, Chunk *chunks, int chunk_count);
 // Fonction pour la sauvegarde de fichier dédupliqué
@@ -22,5 +52,7 @@ void backup_file(const char *filename);
 void write_restored_file(const char *output_filename, Chunk *chunks, int chunk_count);
 // Fonction permettant de lister les différentes sauvegardes présentes dans la destination
 void list_backups(const char *backup_dir);
+// Fonction pour afficher les différences entre deux sauvegardes à partir de leurs logs
+void diff_backups(const char *snapshot_a, const char *snapshot_b, FILE *out);
 
 #endif // BACKUP_MANAGER_H
\ No newline at end of file
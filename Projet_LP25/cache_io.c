@@ -0,0 +1,225 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "cache_io.h"
+#include "throttle.h"
+
+static CacheMode cache_mode = CACHE_MODE_NORMAL;
+
+// Fonction pour choisir le mode de cache des lectures suivantes
+void cache_io_set_mode(CacheMode mode) {
+    cache_mode = mode;
+}
+
+// Fonction pour connaître le mode de cache courant
+CacheMode cache_io_get_mode(void) {
+    return cache_mode;
+}
+
+// Fonction pour lire un mode de cache ("normal", "dontneed" ou "direct")
+int parse_cache_mode(const char *text, CacheMode *mode) {
+    if (strcmp(text, "normal") == 0) {
+        *mode = CACHE_MODE_NORMAL;
+    } else if (strcmp(text, "dontneed") == 0) {
+        *mode = CACHE_MODE_DONTNEED;
+    } else if (strcmp(text, "direct") == 0) {
+        *mode = CACHE_MODE_DIRECT;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+// Fonction pour repasser un lecteur O_DIRECT en lectures ordinaires libérées du cache
+static void disable_direct(CacheReader *reader) {
+    int flags = fcntl(reader->fd, F_GETFL);
+    if (flags >= 0) {
+        fcntl(reader->fd, F_SETFL, flags & ~O_DIRECT);
+    }
+    reader->mode = CACHE_MODE_DONTNEED;
+}
+
+// Fonction pour libérer du cache la zone [start, end) sauf les pages déjà présentes à l'ouverture
+static void release_range(CacheReader *reader, off_t start, off_t end) {
+    long page_size = sysconf(_SC_PAGESIZE);
+    off_t run = start;
+    for (off_t page = start; page < end; page += page_size) {
+        size_t index = (size_t)(page / page_size);
+        if (index < reader->pages && (reader->resident[index] & 1)) {
+            // Page d'un autre processus : libérer ce qui précède et la laisser en cache
+            if (page > run) {
+                posix_fadvise(reader->fd, run, page - run, POSIX_FADV_DONTNEED);
+            }
+            run = page + page_size;
+        }
+    }
+    if (end > run) {
+        posix_fadvise(reader->fd, run, end - run, POSIX_FADV_DONTNEED);
+    }
+}
+
+// Fonction pour libérer du cache les pages lues en attente (celles que la sauvegarde a chargées)
+static void release_pending(CacheReader *reader) {
+    if (reader->read_end > reader->released) {
+        release_range(reader, reader->released, reader->read_end);
+    }
+    reader->released = reader->read_end;
+}
+
+// Fonction pour relever les pages du fichier présentes en cache avant toute lecture
+// La lecture anticipée du noyau charge ensuite des pages au-delà de chaque lecture :
+// un relevé fait au fil des lectures les prendrait pour des pages d'un autre processus.
+static void snapshot_residency(CacheReader *reader) {
+    struct stat st;
+    long page_size = sysconf(_SC_PAGESIZE);
+    if (fstat(reader->fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        return;
+    }
+    size_t pages = (size_t)((st.st_size + page_size - 1) / page_size);
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, reader->fd, 0);
+    if (map == MAP_FAILED) {
+        return;
+    }
+    reader->resident = malloc(pages);
+    if (reader->resident && mincore(map, (size_t)st.st_size, reader->resident) == 0) {
+        reader->pages = pages;
+    } else {
+        free(reader->resident);
+        reader->resident = NULL;
+    }
+    munmap(map, (size_t)st.st_size);
+}
+
+// Fonction pour lire un descripteur déjà ouvert
+int cache_reader_attach(CacheReader *reader, int fd) {
+    reader->fd = fd;
+    reader->owns_fd = 0;
+    reader->mode = cache_mode;
+    reader->resident = NULL;
+    reader->pages = 0;
+    reader->released = 0;
+    reader->read_end = 0;
+    if (posix_memalign((void **)&reader->buffer, CACHE_IO_ALIGN, CACHE_IO_BUFFER_SIZE) != 0) {
+        reader->buffer = NULL;
+        return -1;
+    }
+
+    if (reader->mode == CACHE_MODE_DIRECT) {
+        // O_DIRECT peut être activé sur un descripteur ouvert ; tmpfs et certains FUSE le refusent
+        int flags = fcntl(fd, F_GETFL);
+        if (flags < 0 || fcntl(fd, F_SETFL, flags | O_DIRECT) != 0) {
+            reader->mode = CACHE_MODE_DONTNEED;
+        }
+    }
+    if (reader->mode == CACHE_MODE_DONTNEED) {
+        snapshot_residency(reader);
+    }
+    if (reader->mode != CACHE_MODE_DIRECT) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+    return 0;
+}
+
+// Fonction pour ouvrir path en lecture
+int cache_reader_open(CacheReader *reader, const char *path) {
+    int fd = open(path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    if (cache_reader_attach(reader, fd) != 0) {
+        close(fd);
+        return -1;
+    }
+    reader->owns_fd = 1;
+    return 0;
+}
+
+// Fonction pour lire au plus len octets à offset
+ssize_t cache_reader_pread(CacheReader *reader, off_t offset, size_t len, const unsigned char **data) {
+    if (len > CACHE_IO_BUFFER_SIZE - CACHE_IO_ALIGN) {
+        len = CACHE_IO_BUFFER_SIZE - CACHE_IO_ALIGN;
+    }
+
+    if (reader->mode == CACHE_MODE_DIRECT) {
+        // Position et taille alignées ; la partie demandée est au milieu du tampon
+        off_t aligned = offset & ~((off_t)CACHE_IO_ALIGN - 1);
+        size_t skip = (size_t)(offset - aligned);
+        size_t to_read = (skip + len + CACHE_IO_ALIGN - 1) & ~((size_t)CACHE_IO_ALIGN - 1);
+        ssize_t bytes = pread(reader->fd, reader->buffer, to_read, aligned);
+        if (bytes >= 0) {
+            *data = reader->buffer + skip;
+            throttle_consume(THROTTLE_READ, bytes);
+            if ((size_t)bytes <= skip) return 0;
+            return (size_t)bytes - skip < len ? (ssize_t)((size_t)bytes - skip) : (ssize_t)len;
+        }
+        if (errno != EINVAL) {
+            return -1;
+        }
+        // Alignement refusé par le système de fichiers : lectures ordinaires
+        disable_direct(reader);
+    }
+
+    ssize_t bytes = pread(reader->fd, reader->buffer, len, offset);
+    if (bytes <= 0) {
+        return bytes;
+    }
+    *data = reader->buffer;
+    throttle_consume(THROTTLE_READ, bytes);
+
+    if (reader->mode == CACHE_MODE_DONTNEED) {
+        long page_size = sysconf(_SC_PAGESIZE);
+        off_t start = offset & ~((off_t)page_size - 1);
+        off_t end = (offset + bytes + page_size - 1) & ~((off_t)page_size - 1);
+        if (start > reader->read_end || end < reader->released) {
+            // Lecture hors de la zone en attente : la libérer avant d'en commencer une autre
+            release_pending(reader);
+            reader->released = start;
+        }
+        if (start < reader->released) reader->released = start;
+        if (end > reader->read_end) reader->read_end = end;
+        // Libérer par grandes zones : un appel par lecture coûterait plus qu'il ne rapporte
+        if (reader->read_end - reader->released >= CACHE_IO_RELEASE_BYTES) {
+            release_pending(reader);
+        }
+    }
+    return bytes;
+}
+
+// Fonction pour terminer la lecture
+void cache_reader_close(CacheReader *reader) {
+    if (reader->mode == CACHE_MODE_DONTNEED) {
+        // La lecture anticipée a pu charger des pages au-delà de la dernière lecture
+        struct stat st;
+        if (fstat(reader->fd, &st) == 0 && st.st_size > reader->read_end) {
+            reader->read_end = st.st_size;
+        }
+        release_pending(reader);
+    }
+    if (reader->owns_fd) {
+        close(reader->fd);
+    } else if (reader->mode == CACHE_MODE_DIRECT) {
+        // Rendre le descripteur à l'appelant dans son état d'origine
+        disable_direct(reader);
+    }
+    free(reader->buffer);
+    free(reader->resident);
+    reader->buffer = NULL;
+    reader->resident = NULL;
+    reader->fd = -1;
+}
+
+// Fonction pour libérer du cache la zone [start, end) d'un fichier écrit
+void cache_io_release_written(int fd, off_t start, off_t end) {
+    if (cache_mode == CACHE_MODE_NORMAL || end <= start) {
+        return;
+    }
+    sync_file_range(fd, start, end - start,
+                    SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+    posix_fadvise(fd, start, end - start, POSIX_FADV_DONTNEED);
+}
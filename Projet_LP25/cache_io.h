@@ -0,0 +1,56 @@
+#ifndef CACHE_IO_H
+#define CACHE_IO_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+// Taille du tampon de lecture (multiple de l'alignement exigé par O_DIRECT)
+#define CACHE_IO_BUFFER_SIZE (1024 * 1024)
+
+// Alignement des lectures O_DIRECT (taille de bloc logique la plus courante)
+#define CACHE_IO_ALIGN 4096
+
+// Quantité lue ou écrite entre deux libérations du cache (POSIX_FADV_DONTNEED)
+#define CACHE_IO_RELEASE_BYTES (8 * 1024 * 1024)
+
+// Gestion du cache de pages pendant les lectures de sauvegarde
+typedef enum {
+    CACHE_MODE_NORMAL,        // Lectures ordinaires par le cache de pages
+    CACHE_MODE_DONTNEED,      // Pages chargées par la lecture puis libérées (POSIX_FADV_DONTNEED)
+    CACHE_MODE_DIRECT         // Lectures O_DIRECT alignées, sans passer par le cache
+} CacheMode;
+
+// Lecteur d'un fichier respectant le mode de cache choisi
+typedef struct {
+    int fd;
+    int owns_fd;              // Le descripteur a été ouvert par cache_reader_open
+    CacheMode mode;           // Mode effectif (O_DIRECT peut être refusé par le système de fichiers)
+    unsigned char *buffer;    // Tampon aligné
+    unsigned char *resident;  // Pages déjà en cache à l'ouverture (mincore), à ne jamais libérer
+    size_t pages;             // Nombre de pages décrites par resident
+    off_t released;           // Début de la zone lue pas encore libérée du cache
+    off_t read_end;           // Fin de cette zone
+} CacheReader;
+
+// Fonction pour choisir le mode de cache des lectures suivantes
+void cache_io_set_mode(CacheMode mode);
+// Fonction pour connaître le mode de cache courant
+CacheMode cache_io_get_mode(void);
+// Fonction pour lire un mode de cache ("normal", "dontneed" ou "direct") ; retourne 0 si valide
+int parse_cache_mode(const char *text, CacheMode *mode);
+
+// Fonction pour ouvrir path en lecture (sans suivre les liens symboliques) ; retourne 0 en cas de succès
+int cache_reader_open(CacheReader *reader, const char *path);
+// Fonction pour lire un descripteur déjà ouvert (qui reste à fermer par l'appelant)
+int cache_reader_attach(CacheReader *reader, int fd);
+// Fonction pour lire au plus len octets à offset ; *data pointe dans le tampon du lecteur
+// Retourne le nombre d'octets lus, 0 à la fin du fichier, -1 en cas d'erreur
+ssize_t cache_reader_pread(CacheReader *reader, off_t offset, size_t len, const unsigned char **data);
+// Fonction pour terminer la lecture : libère les pages restantes et le tampon
+void cache_reader_close(CacheReader *reader);
+
+// Fonction pour libérer du cache la zone [start, end) d'un fichier écrit (hors mode normal)
+// L'écriture de la zone est lancée puis attendue : seules des pages propres peuvent être libérées
+void cache_io_release_written(int fd, off_t start, off_t end);
+
+#endif // CACHE_IO_H
@@ -0,0 +1,644 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <fnmatch.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "catalog.h"
+#include "file_handler.h"
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+// Version d'un chemin et plages [début, fin] des numéros des sauvegardes qui la contiennent
+typedef struct {
+    char md5[MD5_DIGEST_LENGTH * 2 + 1];
+    long long size;
+    long long mtime;
+    long mtime_nsec;
+    int *runs;
+    int run_count, run_capacity;
+} CatalogVersion;
+
+// Versions d'une ligne du catalogue (les tableaux sont réutilisés d'une ligne à l'autre)
+typedef struct {
+    CatalogVersion *versions;
+    int count, capacity;
+} CatalogEntry;
+
+// Noms des sauvegardes du catalogue, par numéro
+typedef struct {
+    char (*names)[256];
+    int count;
+} SnapshotTable;
+
+static int compare_names(const void *a, const void *b) {
+    return strcmp((const char *)a, (const char *)b);
+}
+
+// Compare un chemin de longueur len à une chaîne terminée par '\0'
+static int compare_path_span(const char *path, size_t len, const char *other) {
+    size_t other_len = strlen(other);
+    int cmp = strncmp(path, other, len < other_len ? len : other_len);
+    if (cmp != 0) return cmp;
+    return (len > other_len) - (len < other_len);
+}
+
+// Fonction pour lister les sauvegardes (dossiers contenant un .backup_log), triées par nom
+static int list_snapshots(const char *backup_dir, char (**names)[256]) {
+    DIR *dp = opendir(backup_dir);
+    if (!dp) {
+        perror("Erreur lors de l'ouverture du répertoire de sauvegarde");
+        return -1;
+    }
+
+    int count = 0;
+    struct dirent *entry;
+    *names = NULL;
+    while ((entry = readdir(dp)) != NULL) {
+        if (entry->d_name[0] == '.') continue;
+
+        char log_path[PATH_MAX];
+        struct stat log_stat;
+        snprintf(log_path, sizeof(log_path), "%s/%s/.backup_log", backup_dir, entry->d_name);
+        if (stat(log_path, &log_stat) != 0 || !S_ISREG(log_stat.st_mode)) continue;
+
+        char (*grown)[256] = realloc(*names, (count + 1) * sizeof(**names));
+        if (!grown) break;
+        *names = grown;
+        snprintf((*names)[count++], 256, "%s", entry->d_name);
+    }
+    closedir(dp);
+
+    if (count > 0) {
+        qsort(*names, count, sizeof(**names), compare_names);
+    }
+    return count;
+}
+
+// Fonction pour lire l'en-tête du catalogue (noms des sauvegardes) ; retourne -1 s'il est invalide
+static int read_catalog_header(FILE *file, SnapshotTable *table) {
+    char line[300];
+    int count;
+    table->names = NULL;
+    table->count = 0;
+    if (!fgets(line, sizeof(line), file) || sscanf(line, CATALOG_MAGIC " %d", &count) != 1 || count < 0) {
+        return -1;
+    }
+
+    table->names = malloc((count ? count : 1) * sizeof(*table->names));
+    if (!table->names) {
+        return -1;
+    }
+    for (; table->count < count; table->count++) {
+        if (!fgets(line, sizeof(line), file)) {
+            return -1;
+        }
+        // Un nom de sauvegarde tient dans 255 caractères : un nom plus long rend le catalogue invalide
+        line[strcspn(line, "\n")] = 0;
+        if (snprintf(table->names[table->count], 256, "%s", line) >= 256) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Fonction pour ajouter la plage de sauvegardes [start, end] à une version (à la suite des précédentes)
+static int version_add_run(CatalogVersion *version, int start, int end) {
+    if (version->run_count > 0) {
+        int *last = &version->runs[2 * (version->run_count - 1)];
+        if (start <= last[1]) {
+            return 0; // Déjà présente (chemin répété dans un log)
+        }
+        if (start == last[1] + 1) {
+            last[1] = end;
+            return 0;
+        }
+    }
+    if (version->run_count == version->run_capacity) {
+        int capacity = version->run_capacity ? version->run_capacity * 2 : 4;
+        int *grown = realloc(version->runs, 2 * capacity * sizeof(int));
+        if (!grown) {
+            perror("Erreur d'allocation mémoire pour le catalogue");
+            return -1;
+        }
+        version->runs = grown;
+        version->run_capacity = capacity;
+    }
+    version->runs[2 * version->run_count] = start;
+    version->runs[2 * version->run_count + 1] = end;
+    version->run_count++;
+    return 0;
+}
+
+// Fonction pour obtenir une version vide à la suite de celles de la ligne
+static CatalogVersion *entry_new_version(CatalogEntry *entry) {
+    if (entry->count == entry->capacity) {
+        int capacity = entry->capacity ? entry->capacity * 2 : 8;
+        CatalogVersion *grown = realloc(entry->versions, capacity * sizeof(CatalogVersion));
+        if (!grown) {
+            perror("Erreur d'allocation mémoire pour le catalogue");
+            return NULL;
+        }
+        memset(grown + entry->capacity, 0, (capacity - entry->capacity) * sizeof(CatalogVersion));
+        entry->versions = grown;
+        entry->capacity = capacity;
+    }
+    CatalogVersion *version = &entry->versions[entry->count++];
+    version->run_count = 0;
+    return version;
+}
+
+static void free_entry(CatalogEntry *entry) {
+    for (int i = 0; i < entry->capacity; i++) {
+        free(entry->versions[i].runs);
+    }
+    free(entry->versions);
+}
+
+// Fonction pour décoder les numéros de sauvegardes d'une version ("écart[+suivants]:...")
+static int parse_runs(const char *text, CatalogVersion *version) {
+    int end = -1;
+    while (*text) {
+        char *next;
+        long gap = strtol(text, &next, 10);
+        long extra = 0;
+        if (next == text || gap < 0) return -1;
+        if (*next == '+') {
+            text = next + 1;
+            extra = strtol(text, &next, 10);
+            if (next == text || extra < 0) return -1;
+        }
+        int start = end + 1 + (int)gap;
+        end = start + (int)extra;
+        if (version_add_run(version, start, end) != 0) return -1;
+        if (*next == ':') {
+            next++;
+        } else if (*next) {
+            return -1;
+        }
+        text = next;
+    }
+    return 0;
+}
+
+// Fonction pour lire les versions d'une ligne du catalogue (la ligne est modifiée)
+static int parse_catalog_line(char *line, CatalogEntry *entry) {
+    entry->count = 0;
+    line[strcspn(line, "\n")] = 0;
+
+    char *cursor = strchr(line, ';');
+    if (cursor) cursor++;
+    char *field;
+    while (cursor && (field = strsep(&cursor, ";")) != NULL) {
+        CatalogVersion *version = entry_new_version(entry);
+        int consumed = 0;
+        if (!version ||
+            sscanf(field, "%32[0-9a-f],%lld,%lld.%ld,%n", version->md5, &version->size, &version->mtime,
+                   &version->mtime_nsec, &consumed) != 4 || consumed == 0 ||
+            parse_runs(field + consumed, version) != 0) {
+            fprintf(stderr, "Ligne invalide dans le catalogue\n");
+            entry->count = 0;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Fonction pour ajouter la sauvegarde id à la version de elt (créée si le chemin n'avait pas ce contenu)
+static int entry_add_element(CatalogEntry *entry, const log_element *elt, int id) {
+    static const char hex[] = "0123456789abcdef";
+    char md5[MD5_DIGEST_LENGTH * 2 + 1];
+    for (int i = 0; i < MD5_DIGEST_LENGTH; i++) {
+        md5[i * 2] = hex[elt->md5[i] >> 4];
+        md5[i * 2 + 1] = hex[elt->md5[i] & 0xf];
+    }
+    md5[MD5_DIGEST_LENGTH * 2] = '\0';
+
+    CatalogVersion *version = NULL;
+    for (int i = 0; i < entry->count && !version; i++) {
+        CatalogVersion *v = &entry->versions[i];
+        if (v->size == (long long)elt->size && v->mtime == (long long)elt->mtime &&
+            v->mtime_nsec == elt->mtime_nsec && strcmp(v->md5, md5) == 0) {
+            version = v;
+        }
+    }
+    if (!version) {
+        version = entry_new_version(entry);
+        if (!version) return -1;
+        memcpy(version->md5, md5, sizeof(md5));
+        version->size = elt->size;
+        version->mtime = elt->mtime;
+        version->mtime_nsec = elt->mtime_nsec;
+    }
+    return version_add_run(version, id, id);
+}
+
+// Fonction pour écrire une ligne du catalogue
+static void write_catalog_line(FILE *out, const char *path, const CatalogEntry *entry) {
+    fputs(path, out);
+    for (int i = 0; i < entry->count; i++) {
+        const CatalogVersion *version = &entry->versions[i];
+        fprintf(out, ";%s,%lld,%lld.%09ld,", version->md5, version->size, version->mtime, version->mtime_nsec);
+        int previous_end = -1;
+        for (int r = 0; r < version->run_count; r++) {
+            int start = version->runs[2 * r], end = version->runs[2 * r + 1];
+            fprintf(out, r ? ":%d" : "%d", start - previous_end - 1);
+            if (end > start) {
+                fprintf(out, "+%d", end - start);
+            }
+            previous_end = end;
+        }
+    }
+    fputc('\n', out);
+}
+
+// Fonction pour écrire le catalogue augmenté des sauvegardes batch, numérotées à la suite de celles de table
+// Le catalogue actuel et les logs (triés par chemin) sont fusionnés en un seul passage
+static int merge_snapshots(const char *backup_dir, SnapshotTable *table, char (*batch)[256], int batch_count) {
+    char catalog_path[PATH_MAX], index_path[PATH_MAX], catalog_tmp[PATH_MAX], index_tmp[PATH_MAX];
+    snprintf(catalog_path, sizeof(catalog_path), "%s/%s", backup_dir, CATALOG_FILE);
+    snprintf(index_path, sizeof(index_path), "%s/%s", backup_dir, CATALOG_INDEX);
+    snprintf(catalog_tmp, sizeof(catalog_tmp), "%s/%s.tmp", backup_dir, CATALOG_FILE);
+    snprintf(index_tmp, sizeof(index_tmp), "%s/%s.tmp", backup_dir, CATALOG_INDEX);
+
+    // Catalogue actuel, lu à partir de sa première ligne de chemin
+    FILE *old = NULL;
+    if (table->count > 0) {
+        SnapshotTable skipped = {NULL, 0};
+        old = fopen(catalog_path, "r");
+        if (!old || read_catalog_header(old, &skipped) != 0 || skipped.count != table->count) {
+            fprintf(stderr, "Catalogue illisible : %s\n", catalog_path);
+            if (old) fclose(old);
+            free(skipped.names);
+            return -1;
+        }
+        free(skipped.names);
+    }
+
+    FILE *out = fopen(catalog_tmp, "w");
+    FILE *index = fopen(index_tmp, "w");
+    if (!out || !index) {
+        perror("Erreur lors de l'écriture du catalogue");
+        if (out) fclose(out);
+        if (index) fclose(index);
+        if (old) fclose(old);
+        return -1;
+    }
+
+    // Logs des sauvegardes ajoutées, triés par chemin comme le catalogue
+    log_t logs[CATALOG_MERGE_BATCH];
+    log_element **sorted[CATALOG_MERGE_BATCH];
+    int counts[CATALOG_MERGE_BATCH], positions[CATALOG_MERGE_BATCH];
+    for (int b = 0; b < batch_count; b++) {
+        char log_path[PATH_MAX];
+        snprintf(log_path, sizeof(log_path), "%s/%s/.backup_log", backup_dir, batch[b]);
+        logs[b] = read_backup_log(log_path);
+        sorted[b] = sort_backup_log(&logs[b], &counts[b]);
+        positions[b] = 0;
+    }
+
+    fprintf(out, "%s %d\n", CATALOG_MAGIC, table->count + batch_count);
+    for (int i = 0; i < table->count; i++) {
+        fprintf(out, "%s\n", table->names[i]);
+    }
+    for (int b = 0; b < batch_count; b++) {
+        fprintf(out, "%s\n", batch[b]);
+    }
+    // En-tête de l'index à largeur fixe, réécrit une fois la taille du catalogue connue
+    fprintf(index, "%s %010d %020lld\n", CATALOG_MAGIC, 0, 0LL);
+
+    CatalogEntry entry = {NULL, 0, 0};
+    char *line = NULL;
+    size_t line_capacity = 0;
+    ssize_t line_len = old ? getline(&line, &line_capacity, old) : -1;
+    long long entries = 0;
+    int result = 0;
+    while (result == 0) {
+        // Plus petit chemin parmi les logs des sauvegardes ajoutées
+        const char *next = NULL;
+        for (int b = 0; b < batch_count; b++) {
+            if (positions[b] < counts[b]) {
+                const char *path = sorted[b][positions[b]]->path;
+                if (!next || strcmp(path, next) < 0) next = path;
+            }
+        }
+        if (line_len <= 0 && !next) break;
+
+        size_t path_len = line_len > 0 ? strcspn(line, ";\n") : 0;
+        int cmp = line_len <= 0 ? 1 : !next ? -1 : compare_path_span(line, path_len, next);
+
+        if (entries % CATALOG_INDEX_STRIDE == 0) {
+            fprintf(index, "%lld %.*s\n", (long long)ftello(out),
+                    cmp < 0 ? (int)path_len : (int)strlen(next), cmp < 0 ? line : next);
+        }
+        entries++;
+
+        if (cmp < 0) {
+            // Chemin absent des sauvegardes ajoutées : ligne recopiée sans être décodée
+            fputs(line, out);
+            if (line[line_len - 1] != '\n') fputc('\n', out);
+            line_len = getline(&line, &line_capacity, old);
+            continue;
+        }
+
+        entry.count = 0;
+        if (cmp == 0 && parse_catalog_line(line, &entry) != 0) {
+            result = -1;
+            break;
+        }
+        for (int b = 0; b < batch_count; b++) {
+            while (positions[b] < counts[b] && strcmp(sorted[b][positions[b]]->path, next) == 0) {
+                if (entry_add_element(&entry, sorted[b][positions[b]], table->count + b) != 0) {
+                    result = -1;
+                }
+                positions[b]++;
+            }
+        }
+        write_catalog_line(out, next, &entry);
+        if (cmp == 0) {
+            line_len = getline(&line, &line_capacity, old);
+        }
+    }
+
+    free(line);
+    free_entry(&entry);
+    for (int b = 0; b < batch_count; b++) {
+        free(sorted[b]);
+        free_backup_log(&logs[b]);
+    }
+    if (old) fclose(old);
+
+    long long catalog_size = ftello(out);
+    if (ferror(out) || ferror(index)) {
+        perror("Erreur lors de l'écriture du catalogue");
+        result = -1;
+    }
+    if (fclose(out) != 0) result = -1;
+    rewind(index);
+    fprintf(index, "%s %010d %020lld\n", CATALOG_MAGIC, table->count + batch_count, catalog_size);
+    if (fclose(index) != 0) result = -1;
+
+    // Le catalogue est publié avant son index : entre les deux renommages, l'ancien index ne
+    // correspond plus à la taille du catalogue et est ignoré. Le catalogue pouvant être
+    // reconstruit à partir des logs, un simple renommage suffit (sans écriture sur disque forcée)
+    if (result != 0 || rename(catalog_tmp, catalog_path) != 0 || rename(index_tmp, index_path) != 0) {
+        if (result == 0) perror("Erreur lors de la publication du catalogue");
+        unlink(catalog_tmp);
+        unlink(index_tmp);
+        return -1;
+    }
+
+    char (*grown)[256] = realloc(table->names, (table->count + batch_count) * sizeof(*table->names));
+    if (!grown) {
+        return -1;
+    }
+    table->names = grown;
+    for (int b = 0; b < batch_count; b++) {
+        snprintf(table->names[table->count++], 256, "%s", batch[b]);
+    }
+    return 0;
+}
+
+// Fonction pour ajouter au catalogue les sauvegardes manquantes ; present reçoit la liste
+// des sauvegardes du répertoire (triée par nom, à libérer par l'appelant)
+static int update_catalog(const char *backup_dir, char (**present)[256], int *present_count) {
+    *present_count = list_snapshots(backup_dir, present);
+    if (*present_count < 0) {
+        return -1;
+    }
+
+    char catalog_path[PATH_MAX];
+    snprintf(catalog_path, sizeof(catalog_path), "%s/%s", backup_dir, CATALOG_FILE);
+    SnapshotTable table = {NULL, 0};
+    FILE *file = fopen(catalog_path, "r");
+    int valid = file && read_catalog_header(file, &table) == 0;
+    if (file) fclose(file);
+    if (!valid) {
+        table.count = 0;
+    }
+
+    // Sauvegardes absentes du catalogue (les numéros suivent l'ordre des noms)
+    char (*missing)[256] = malloc((*present_count ? *present_count : 1) * sizeof(*missing));
+    int missing_count = 0;
+    if (!missing) {
+        free(table.names);
+        return -1;
+    }
+    for (int i = 0; i < *present_count; i++) {
+        if (!bsearch((*present)[i], table.names, table.count, sizeof(*table.names), compare_names)) {
+            memcpy(missing[missing_count++], (*present)[i], sizeof(*missing));
+        }
+    }
+
+    // Une sauvegarde plus ancienne que la dernière du catalogue (ou un catalogue illisible) impose
+    // de tout renuméroter : le catalogue est reconstruit, sans les sauvegardes supprimées depuis
+    if (missing_count > 0 && table.count > 0 && strcmp(missing[0], table.names[table.count - 1]) < 0) {
+        table.count = 0;
+        missing_count = *present_count;
+        memcpy(missing, *present, missing_count * sizeof(*missing));
+    }
+
+    int result = 0;
+    for (int i = 0; i < missing_count && result == 0; i += CATALOG_MERGE_BATCH) {
+        int batch_count = missing_count - i < CATALOG_MERGE_BATCH ? missing_count - i : CATALOG_MERGE_BATCH;
+        result = merge_snapshots(backup_dir, &table, missing + i, batch_count);
+    }
+    if (result == 0 && missing_count > 1) {
+        printf("Catalogue : %d sauvegarde(s) ajoutée(s)\n", missing_count);
+    }
+
+    free(missing);
+    free(table.names);
+    return result;
+}
+
+// Fonction pour ajouter au catalogue les sauvegardes de backup_dir qu'il ne contient pas encore
+int catalog_update(const char *backup_dir) {
+    char (*present)[256] = NULL;
+    int present_count;
+    int result = update_catalog(backup_dir, &present, &present_count);
+    free(present);
+    return result;
+}
+
+// Fonction pour trouver, grâce à l'index du catalogue, l'offset à partir duquel lire les chemins >= prefix
+// Retourne -1 si l'index manque ou ne correspond pas au catalogue
+static long long find_catalog_offset(const char *backup_dir, const char *prefix, int snapshot_count,
+                                     long long catalog_size) {
+    char index_path[PATH_MAX];
+    snprintf(index_path, sizeof(index_path), "%s/%s", backup_dir, CATALOG_INDEX);
+
+    FILE *index = fopen(index_path, "r");
+    if (!index) {
+        return -1;
+    }
+
+    int indexed_count;
+    long long indexed_size;
+    char line[PATH_MAX + 32];
+    if (!fgets(line, sizeof(line), index) ||
+        sscanf(line, CATALOG_MAGIC " %d %lld", &indexed_count, &indexed_size) != 2 ||
+        indexed_count != snapshot_count || indexed_size != catalog_size) {
+        fclose(index);
+        return -1;
+    }
+
+    // Les entrées de l'index sont triées : on garde la dernière dont le chemin est < prefix
+    long long offset = -1;
+    while (fgets(line, sizeof(line), index)) {
+        char *path = strchr(line, ' ');
+        if (!path) continue;
+        path++;
+        path[strcspn(path, "\n")] = 0;
+        if (offset >= 0 && strcmp(path, prefix) >= 0) break;
+        offset = strtoll(line, NULL, 10);
+    }
+
+    fclose(index);
+    return offset;
+}
+
+// Fonction pour écrire le nom de la sauvegarde id, ou la plage de sauvegardes first → last
+static void print_snapshot_span(FILE *out, const SnapshotTable *table, int first, int last, int separator) {
+    if (separator) fputs(", ", out);
+    fputs(table->names[first], out);
+    if (last != first) {
+        fprintf(out, " → %s", table->names[last]);
+    }
+}
+
+// Fonction pour afficher les versions d'un chemin présentes dans des sauvegardes qui existent encore
+// rank donne le rang de chaque sauvegarde parmi celles-ci (-1 si elle a été supprimée)
+// Retourne 1 si le chemin a été affiché
+static int print_catalog_entry(FILE *out, const char *path, const CatalogEntry *entry,
+                               const SnapshotTable *table, const int *rank) {
+    int printed = 0;
+    for (int i = 0; i < entry->count; i++) {
+        const CatalogVersion *version = &entry->versions[i];
+        int snapshots = 0;
+        for (int r = 0; r < version->run_count; r++) {
+            for (int id = version->runs[2 * r]; id <= version->runs[2 * r + 1] && id < table->count; id++) {
+                if (rank[id] >= 0) snapshots++;
+            }
+        }
+        if (snapshots == 0) continue;
+
+        if (!printed) {
+            fprintf(out, "%s\n", path);
+            printed = 1;
+        }
+        char date[32];
+        time_t mtime = (time_t)version->mtime;
+        struct tm tm_info;
+        strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", localtime_r(&mtime, &tm_info));
+        fprintf(out, "  %s %lld octets, modifié le %s : %d sauvegarde(s) : ", version->md5, version->size, date,
+                snapshots);
+
+        // Sauvegardes regroupées en plages : aucune sauvegarde existante entre first et last n'en est exclue
+        int first = -1, last = -1, spans = 0;
+        for (int r = 0; r < version->run_count; r++) {
+            for (int id = version->runs[2 * r]; id <= version->runs[2 * r + 1] && id < table->count; id++) {
+                if (rank[id] < 0) continue;
+                if (first >= 0 && rank[id] == rank[last] + 1) {
+                    last = id;
+                    continue;
+                }
+                if (first >= 0) print_snapshot_span(out, table, first, last, spans++);
+                first = last = id;
+            }
+        }
+        print_snapshot_span(out, table, first, last, spans);
+        fputc('\n', out);
+    }
+    return printed;
+}
+
+// Fonction pour écrire dans out les versions des chemins correspondant au motif
+int catalog_find(const char *backup_dir, const char *pattern, FILE *out) {
+    // Les sauvegardes pas encore cataloguées (créées avant le catalogue) sont ajoutées d'abord
+    char (*present)[256] = NULL;
+    int present_count;
+    if (update_catalog(backup_dir, &present, &present_count) != 0) {
+        if (present_count < 0) {
+            return -1;
+        }
+        fprintf(stderr, "Catalogue non mis à jour : la recherche porte sur les sauvegardes déjà cataloguées\n");
+    }
+
+    char catalog_path[PATH_MAX];
+    snprintf(catalog_path, sizeof(catalog_path), "%s/%s", backup_dir, CATALOG_FILE);
+    FILE *file = fopen(catalog_path, "r");
+    SnapshotTable table = {NULL, 0};
+    if (!file || read_catalog_header(file, &table) != 0) {
+        fprintf(stderr, "Catalogue illisible : %s\n", catalog_path);
+        if (file) fclose(file);
+        free(table.names);
+        free(present);
+        return -1;
+    }
+
+    // Rang de chaque sauvegarde du catalogue parmi celles qui existent encore
+    int *rank = malloc((table.count ? table.count : 1) * sizeof(int));
+    for (int id = 0, next_rank = 0; rank && id < table.count; id++) {
+        rank[id] = bsearch(table.names[id], present, present_count, sizeof(*present), compare_names) ? next_rank++ : -1;
+    }
+
+    // Seule la partie littérale du motif (avant le premier joker) sert à la recherche dans l'index
+    char prefix[PATH_MAX];
+    size_t prefix_len = strcspn(pattern, "*?[\\");
+    if (prefix_len >= sizeof(prefix)) prefix_len = sizeof(prefix) - 1;
+    memcpy(prefix, pattern, prefix_len);
+    prefix[prefix_len] = '\0';
+    int wildcard = pattern[prefix_len] != '\0';
+
+    struct stat catalog_stat;
+    long long offset = fstat(fileno(file), &catalog_stat) == 0
+                           ? find_catalog_offset(backup_dir, prefix, table.count, (long long)catalog_stat.st_size)
+                           : -1;
+    if (offset >= 0) {
+        fseeko(file, offset, SEEK_SET);
+    }
+
+    CatalogEntry entry = {NULL, 0, 0};
+    char *line = NULL;
+    size_t line_capacity = 0;
+    int found = 0;
+    while (rank && getline(&line, &line_capacity, file) > 0) {
+        size_t len = strcspn(line, ";\n");
+        int cmp = strncmp(line, prefix, len < prefix_len ? len : prefix_len);
+        if (cmp > 0) {
+            // Catalogue trié : plus aucun chemin ne peut commencer par prefix
+            break;
+        }
+        if (cmp < 0 || len < prefix_len) {
+            continue;
+        }
+
+        char separator = line[len];
+        line[len] = '\0';
+        int matches = !wildcard || fnmatch(pattern, line, 0) == 0;
+        if (!matches) {
+            continue;
+        }
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s", line);
+        line[len] = separator;
+        if (parse_catalog_line(line, &entry) == 0) {
+            found += print_catalog_entry(out, path, &entry, &table, rank);
+        }
+    }
+    fprintf(out, "%d chemin(s) trouvé(s) parmi %d sauvegarde(s)\n", found, present_count);
+
+    free(line);
+    free_entry(&entry);
+    free(rank);
+    fclose(file);
+    free(table.names);
+    free(present);
+    return found;
+}
@@ -0,0 +1,35 @@
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include <stdio.h>
+
+// Catalogue d'un répertoire de sauvegarde : pour chaque chemin, ses versions (MD5, taille, date de
+// modification) et les sauvegardes qui les contiennent, sans relire les .backup_log de chaque sauvegarde
+//
+// Format texte : une ligne "LP25CATALOG <n>", les noms des n sauvegardes (leur numéro est leur rang,
+// dans l'ordre des noms), puis une ligne par chemin, triées par chemin :
+//   chemin;md5,taille,mtime.nsec,numéros[;md5,taille,mtime.nsec,numéros...]
+// Les numéros de sauvegardes sont codés par écarts : "écart[+suivants]" séparés par ':', l'écart étant
+// compté depuis la fin de la plage précédente. "0+4:2" désigne les sauvegardes 0 à 4 puis 7 :
+// un fichier inchangé pendant des centaines de sauvegardes tient en quelques caractères
+#define CATALOG_FILE ".backup_catalog"
+
+// Index du catalogue : "LP25CATALOG <n> <taille du catalogue>" puis l'offset et le chemin
+// d'une ligne sur CATALOG_INDEX_STRIDE (ignoré s'il ne correspond plus au catalogue)
+#define CATALOG_INDEX ".backup_catalog_index"
+
+#define CATALOG_MAGIC "LP25CATALOG"
+#define CATALOG_INDEX_STRIDE 64
+
+// Nombre maximal de sauvegardes ajoutées au catalogue en un seul passage (logs gardés en mémoire)
+#define CATALOG_MERGE_BATCH 32
+
+// Fonction pour ajouter au catalogue les sauvegardes de backup_dir qu'il ne contient pas encore
+// (la dernière après une sauvegarde, toutes à la première utilisation) ; retourne 0 en cas de succès
+int catalog_update(const char *backup_dir);
+// Fonction pour écrire dans out les versions des chemins correspondant au motif et les sauvegardes
+// qui les contiennent ; un motif sans joker est un préfixe de chemin
+// Retourne le nombre de chemins trouvés ou -1 en cas d'erreur
+int catalog_find(const char *backup_dir, const char *pattern, FILE *out);
+
+#endif // CATALOG_H
@@ -0,0 +1,632 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/fanotify.h>
+#include <sys/inotify.h>
+#include "change_journal.h"
+#include "filter.h"
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+// Taille du tampon de lecture des événements
+#define EVENT_BUFFER_SIZE 65536
+
+// Nombre de chemins en attente au-delà duquel le journal est écrit sans attendre
+#define MAX_PENDING_PATHS 100000
+
+static long full_interval = CHANGE_JOURNAL_FULL_INTERVAL;
+static volatile sig_atomic_t stop_requested = 0;
+
+// État de l'observateur
+typedef struct {
+    char root[PATH_MAX];      // Chemin absolu de la source
+    size_t root_len;
+    char journal_path[PATH_MAX];
+    char **pending;           // Chemins relatifs modifiés depuis la dernière écriture
+    int pending_count;
+    int pending_capacity;
+    int overflow;             // Des événements ont été perdus
+    char **wd_paths;          // inotify : chemin relatif de chaque descripteur de surveillance
+    int wd_capacity;
+    uint32_t move_cookie;     // inotify : déplacement de répertoire en cours
+    char *move_from;
+} Watcher;
+
+static void handle_stop(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+// Fonction pour ajouter une ligne au journal (ouvert à chaque écriture : une sauvegarde peut le renommer)
+static int journal_append(const char *journal_path, const char *text) {
+    int fd = open(journal_path, O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if (fd < 0) {
+        perror("Erreur lors de l'ouverture du journal des modifications");
+        return -1;
+    }
+    size_t len = strlen(text);
+    ssize_t written = write(fd, text, len);
+    close(fd);
+    return written == (ssize_t)len ? 0 : -1;
+}
+
+static void watcher_record(Watcher *w, const char *relative) {
+    if (relative[0] == '\0') {
+        return; // La racine elle-même : ses métadonnées sont reprises à chaque sauvegarde
+    }
+
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s", relative);
+    // Un nom contenant un saut de ligne ne tient pas dans le journal : consigner son répertoire
+    char *newline = strchr(path, '\n');
+    if (newline) {
+        *newline = '\0';
+        char *slash = strrchr(path, '/');
+        if (!slash) return;
+        *slash = '\0';
+    }
+
+    if (w->pending_count == w->pending_capacity) {
+        int capacity = w->pending_capacity ? w->pending_capacity * 2 : 256;
+        char **grown = realloc(w->pending, capacity * sizeof(char *));
+        if (!grown) {
+            w->overflow = 1;
+            return;
+        }
+        w->pending = grown;
+        w->pending_capacity = capacity;
+    }
+    w->pending[w->pending_count++] = strdup(path);
+}
+
+// Fonction pour consigner un chemin absolu s'il appartient à la source
+static void watcher_record_absolute(Watcher *w, const char *dir, const char *name) {
+    if (strncmp(dir, w->root, w->root_len) != 0 || (dir[w->root_len] != '/' && dir[w->root_len] != '\0')) {
+        return;
+    }
+    const char *relative_dir = dir + w->root_len;
+    if (*relative_dir == '/') relative_dir++;
+
+    char relative[PATH_MAX];
+    if (relative_dir[0] && name[0]) {
+        snprintf(relative, sizeof(relative), "%s/%s", relative_dir, name);
+    } else {
+        snprintf(relative, sizeof(relative), "%s", relative_dir[0] ? relative_dir : name);
+    }
+    watcher_record(w, relative);
+}
+
+static int compare_strings(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+// Fonction pour écrire dans le journal les chemins en attente, sans doublons
+static void watcher_flush(Watcher *w) {
+    if (w->pending_count == 0 && !w->overflow) {
+        return;
+    }
+
+    qsort(w->pending, w->pending_count, sizeof(char *), compare_strings);
+
+    char *text = NULL;
+    size_t text_size = 0;
+    FILE *out = open_memstream(&text, &text_size);
+    if (out) {
+        if (w->overflow) {
+            fprintf(out, "OVERFLOW %lld\n", (long long)time(NULL));
+        }
+        for (int i = 0; i < w->pending_count; i++) {
+            if (i == 0 || strcmp(w->pending[i - 1], w->pending[i]) != 0) {
+                fprintf(out, "%s\n", w->pending[i]);
+            }
+        }
+        fclose(out);
+        journal_append(w->journal_path, text);
+        free(text);
+    }
+
+    for (int i = 0; i < w->pending_count; i++) {
+        free(w->pending[i]);
+    }
+    w->pending_count = 0;
+    w->overflow = 0;
+}
+
+static long elapsed_ms(const struct timespec *since) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - since->tv_sec) * 1000 + (now.tv_nsec - since->tv_nsec) / 1000000;
+}
+
+// Boucle commune : lit les événements de fd et écrit le journal toutes les CHANGE_JOURNAL_FLUSH_MS
+static void watcher_loop(Watcher *w, int fd, void (*handle_events)(Watcher *, int, char *, ssize_t)) {
+    static char buffer[EVENT_BUFFER_SIZE] __attribute__((aligned(8)));
+    struct timespec last_flush;
+    clock_gettime(CLOCK_MONOTONIC, &last_flush);
+
+    while (!stop_requested) {
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        int ready = poll(&pfd, 1, CHANGE_JOURNAL_FLUSH_MS);
+        if (ready < 0 && errno != EINTR) {
+            perror("Erreur lors de l'attente des événements");
+            break;
+        }
+        if (ready > 0) {
+            ssize_t len = read(fd, buffer, sizeof(buffer));
+            if (len > 0) {
+                handle_events(w, fd, buffer, len);
+            }
+        }
+        if (elapsed_ms(&last_flush) >= CHANGE_JOURNAL_FLUSH_MS || w->pending_count >= MAX_PENDING_PATHS) {
+            watcher_flush(w);
+            clock_gettime(CLOCK_MONOTONIC, &last_flush);
+        }
+    }
+    watcher_flush(w);
+}
+
+// --- fanotify : une marque sur tout le système de fichiers, événements nommés (répertoire + nom) ---
+
+static int fanotify_mount_fd = -1;
+
+static void handle_fanotify_events(Watcher *w, int fd, char *buffer, ssize_t len) {
+    (void)fd;
+    for (struct fanotify_event_metadata *m = (struct fanotify_event_metadata *)buffer; FAN_EVENT_OK(m, len);
+         m = FAN_EVENT_NEXT(m, len)) {
+        if (m->mask & FAN_Q_OVERFLOW) {
+            w->overflow = 1;
+            continue;
+        }
+
+        struct fanotify_event_info_fid *fid = (struct fanotify_event_info_fid *)(m + 1);
+        if ((char *)fid >= (char *)m + m->event_len ||
+            (fid->hdr.info_type != FAN_EVENT_INFO_TYPE_DFID_NAME && fid->hdr.info_type != FAN_EVENT_INFO_TYPE_DFID)) {
+            continue;
+        }
+        struct file_handle *handle = (struct file_handle *)fid->handle;
+        const char *name = fid->hdr.info_type == FAN_EVENT_INFO_TYPE_DFID_NAME
+            ? (const char *)handle->f_handle + handle->handle_bytes : "";
+        if (strcmp(name, ".") == 0) name = "";
+
+        // Retrouver le chemin du répertoire ; s'il a disparu, son parent a reçu un événement
+        int dir_fd = open_by_handle_at(fanotify_mount_fd, handle, O_RDONLY | O_PATH);
+        if (dir_fd < 0) continue;
+        char link[64], dir[PATH_MAX];
+        snprintf(link, sizeof(link), "/proc/self/fd/%d", dir_fd);
+        ssize_t dir_len = readlink(link, dir, sizeof(dir) - 1);
+        close(dir_fd);
+        if (dir_len < 0) continue;
+        dir[dir_len] = '\0';
+
+        watcher_record_absolute(w, dir, name);
+    }
+}
+
+static int watch_fanotify(Watcher *w) {
+    int fd = fanotify_init(FAN_CLASS_NOTIF | FAN_REPORT_DFID_NAME, O_RDONLY | O_LARGEFILE);
+    if (fd < 0) {
+        return -1;
+    }
+    uint64_t mask = FAN_CREATE | FAN_DELETE | FAN_MOVED_FROM | FAN_MOVED_TO | FAN_MODIFY | FAN_ATTRIB | FAN_ONDIR;
+    if (fanotify_mark(fd, FAN_MARK_ADD | FAN_MARK_FILESYSTEM, mask, AT_FDCWD, w->root) < 0) {
+        close(fd);
+        return -1;
+    }
+    fanotify_mount_fd = open(w->root, O_RDONLY | O_DIRECTORY);
+    if (fanotify_mount_fd < 0) {
+        close(fd);
+        return -1;
+    }
+
+    printf("Observation de %s (fanotify)\n", w->root);
+    fflush(stdout);
+    watcher_loop(w, fd, handle_fanotify_events);
+
+    close(fanotify_mount_fd);
+    close(fd);
+    return 0;
+}
+
+// --- inotify : une surveillance par répertoire, ajoutée à la création des sous-répertoires ---
+
+#define INOTIFY_MASK (IN_MODIFY | IN_ATTRIB | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | \
+                      IN_DONT_FOLLOW | IN_EXCL_UNLINK | IN_ONLYDIR)
+
+static void inotify_add_tree(Watcher *w, int fd, const char *relative) {
+    char path[PATH_MAX];
+    int len = relative[0] ? snprintf(path, sizeof(path), "%s/%s", w->root, relative)
+                          : snprintf(path, sizeof(path), "%s", w->root);
+    if (len < 0 || (size_t)len >= sizeof(path)) {
+        // Répertoire trop profond pour être surveillé : le journal est incomplet
+        fprintf(stderr, "Chemin trop long pour être surveillé : %s\n", relative);
+        w->overflow = 1;
+        return;
+    }
+
+    int wd = inotify_add_watch(fd, path, INOTIFY_MASK);
+    if (wd < 0) {
+        if (errno == ENOSPC) {
+            // Limite fs.inotify.max_user_watches atteinte : le journal est incomplet
+            fprintf(stderr, "Limite de surveillances inotify atteinte pour %s\n", path);
+            w->overflow = 1;
+        }
+        return;
+    }
+    if (wd >= w->wd_capacity) {
+        int capacity = w->wd_capacity ? w->wd_capacity : 1024;
+        while (capacity <= wd) capacity *= 2;
+        char **grown = realloc(w->wd_paths, capacity * sizeof(char *));
+        if (!grown) {
+            w->overflow = 1;
+            return;
+        }
+        memset(grown + w->wd_capacity, 0, (capacity - w->wd_capacity) * sizeof(char *));
+        w->wd_paths = grown;
+        w->wd_capacity = capacity;
+    }
+    free(w->wd_paths[wd]);
+    w->wd_paths[wd] = strdup(relative);
+
+    DIR *dir = opendir(path);
+    struct dirent *entry;
+    while (dir && (entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+
+        char child[PATH_MAX];
+        len = relative[0] ? snprintf(child, sizeof(child), "%s/%s", relative, entry->d_name)
+                          : snprintf(child, sizeof(child), "%s", entry->d_name);
+        if (len < 0 || (size_t)len >= sizeof(child)) {
+            w->overflow = 1;
+            continue;
+        }
+        int is_dir = entry->d_type == DT_DIR;
+        if (entry->d_type == DT_UNKNOWN) {
+            struct stat st;
+            char full[PATH_MAX];
+            is_dir = snprintf(full, sizeof(full), "%s/%s", path, entry->d_name) < (int)sizeof(full) &&
+                     lstat(full, &st) == 0 && S_ISDIR(st.st_mode);
+        }
+        if (is_dir) {
+            inotify_add_tree(w, fd, child);
+        }
+    }
+    if (dir) closedir(dir);
+}
+
+// Fonction pour mettre à jour les chemins des surveillances d'un répertoire déplacé dans la source
+static void inotify_rename_tree(Watcher *w, const char *from, const char *to) {
+    size_t from_len = strlen(from);
+    for (int wd = 0; wd < w->wd_capacity; wd++) {
+        char *path = w->wd_paths[wd];
+        if (!path || strncmp(path, from, from_len) != 0 || (path[from_len] != '/' && path[from_len] != '\0')) {
+            continue;
+        }
+        char renamed[PATH_MAX];
+        snprintf(renamed, sizeof(renamed), "%s%s", to, path + from_len);
+        free(path);
+        w->wd_paths[wd] = strdup(renamed);
+    }
+}
+
+static void handle_inotify_events(Watcher *w, int fd, char *buffer, ssize_t len) {
+    for (char *p = buffer; p < buffer + len; ) {
+        struct inotify_event *ev = (struct inotify_event *)p;
+        p += sizeof(struct inotify_event) + ev->len;
+
+        if (ev->mask & IN_Q_OVERFLOW) {
+            w->overflow = 1;
+            continue;
+        }
+        if (ev->wd < 0 || ev->wd >= w->wd_capacity || !w->wd_paths[ev->wd]) {
+            continue;
+        }
+        if (ev->mask & IN_IGNORED) {
+            free(w->wd_paths[ev->wd]);
+            w->wd_paths[ev->wd] = NULL;
+            continue;
+        }
+        if (ev->len == 0) {
+            continue; // Événement sur le répertoire lui-même : déjà signalé à son parent
+        }
+
+        const char *dir = w->wd_paths[ev->wd];
+        char relative[PATH_MAX];
+        if (dir[0]) {
+            snprintf(relative, sizeof(relative), "%s/%s", dir, ev->name);
+        } else {
+            snprintf(relative, sizeof(relative), "%s", ev->name);
+        }
+        watcher_record(w, relative);
+
+        if (ev->mask & IN_ISDIR) {
+            if ((ev->mask & IN_MOVED_FROM)) {
+                free(w->move_from);
+                w->move_from = strdup(relative);
+                w->move_cookie = ev->cookie;
+            } else if ((ev->mask & IN_MOVED_TO) && w->move_from && ev->cookie == w->move_cookie) {
+                // Déplacement interne : les surveillances existantes suivent le répertoire
+                inotify_rename_tree(w, w->move_from, relative);
+                free(w->move_from);
+                w->move_from = NULL;
+            } else if (ev->mask & (IN_CREATE | IN_MOVED_TO)) {
+                inotify_add_tree(w, fd, relative);
+            }
+        }
+    }
+}
+
+static int watch_inotify(Watcher *w) {
+    int fd = inotify_init1(IN_CLOEXEC);
+    if (fd < 0) {
+        perror("Erreur lors de l'initialisation d'inotify");
+        return -1;
+    }
+
+    inotify_add_tree(w, fd, "");
+    printf("Observation de %s (inotify)\n", w->root);
+    fflush(stdout);
+    watcher_loop(w, fd, handle_inotify_events);
+
+    for (int wd = 0; wd < w->wd_capacity; wd++) {
+        free(w->wd_paths[wd]);
+    }
+    free(w->wd_paths);
+    free(w->move_from);
+    close(fd);
+    return 0;
+}
+
+// Fonction pour observer source_dir et consigner ses modifications dans le journal de backup_dir
+int watch_source(const char *source_dir, const char *backup_dir) {
+    Watcher w;
+    memset(&w, 0, sizeof(w));
+    if (!realpath(source_dir, w.root)) {
+        perror("Le répertoire source est inaccessible");
+        return -1;
+    }
+    w.root_len = strlen(w.root);
+    snprintf(w.journal_path, sizeof(w.journal_path), "%s/%s", backup_dir, CHANGE_JOURNAL_FILE);
+
+    // Un seul observateur par répertoire de sauvegarde ; le verrou indique aux sauvegardes qu'il tourne
+    char lock_path[PATH_MAX];
+    snprintf(lock_path, sizeof(lock_path), "%s/%s", backup_dir, CHANGE_JOURNAL_LOCK);
+    int lock_fd = open(lock_path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (lock_fd < 0 || flock(lock_fd, LOCK_EX | LOCK_NB) != 0) {
+        fprintf(stderr, "Un observateur est déjà actif pour %s\n", backup_dir);
+        if (lock_fd >= 0) close(lock_fd);
+        return -1;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_stop;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    // Les événements antérieurs à cette date ne sont pas couverts par le journal
+    char start_line[64];
+    snprintf(start_line, sizeof(start_line), "START %lld\n", (long long)time(NULL));
+    journal_append(w.journal_path, start_line);
+
+    // fanotify demande CAP_SYS_ADMIN et un noyau récent ; sinon inotify
+    int result = watch_fanotify(&w);
+    if (result != 0) {
+        result = watch_inotify(&w);
+    }
+
+    free(w.pending);
+    close(lock_fd);
+    return result;
+}
+
+// Fonction pour fixer l'intervalle entre deux parcours complets (en secondes)
+void change_journal_set_full_interval(long seconds) {
+    full_interval = seconds;
+}
+
+static void change_set_add(ChangeSet *changes, const char *path, int *capacity) {
+    if (changes->count == *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 256;
+        char **grown = realloc(changes->paths, *capacity * sizeof(char *));
+        if (!grown) return;
+        changes->paths = grown;
+    }
+    changes->paths[changes->count++] = strdup(path);
+}
+
+static int contains_exact(const ChangeSet *changes, const char *path) {
+    return bsearch(&path, changes->paths, changes->count, sizeof(char *), compare_strings) != NULL;
+}
+
+// Fonction pour savoir si un chemin ou l'un de ses répertoires parents a été modifié
+int change_set_contains(const ChangeSet *changes, const char *path) {
+    char prefix[PATH_MAX];
+    snprintf(prefix, sizeof(prefix), "%s", path);
+    if (contains_exact(changes, prefix)) {
+        return 1;
+    }
+    for (char *slash = strrchr(prefix, '/'); slash; slash = strrchr(prefix, '/')) {
+        *slash = '\0';
+        if (contains_exact(changes, prefix)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Fonction pour trier les chemins, retirer les doublons et les descendants d'un chemin présent
+static void change_set_normalize(ChangeSet *changes) {
+    qsort(changes->paths, changes->count, sizeof(char *), compare_strings);
+
+    int kept = 0;
+    for (int i = 0; i < changes->count; i++) {
+        if (kept > 0 && strcmp(changes->paths[kept - 1], changes->paths[i]) == 0) {
+            free(changes->paths[i]);
+            continue;
+        }
+        changes->paths[kept++] = changes->paths[i];
+    }
+    changes->count = kept;
+
+    // Les descendants sont repérés avant de compacter le tableau : la recherche des ancêtres
+    // se fait par dichotomie sur le tableau trié intact
+    char *covered = calloc(kept ? kept : 1, 1);
+    if (!covered) {
+        return;
+    }
+    for (int i = 0; i < changes->count; i++) {
+        char parent[PATH_MAX];
+        snprintf(parent, sizeof(parent), "%s", changes->paths[i]);
+        char *slash = strrchr(parent, '/');
+        if (slash) {
+            *slash = '\0';
+            covered[i] = (char)change_set_contains(changes, parent);
+        }
+    }
+    kept = 0;
+    for (int i = 0; i < changes->count; i++) {
+        if (covered[i]) {
+            free(changes->paths[i]);
+        } else {
+            changes->paths[kept++] = changes->paths[i];
+        }
+    }
+    changes->count = kept;
+    free(covered);
+}
+
+// Fonction pour récupérer les chemins modifiés depuis la sauvegarde de date previous_backup
+int change_journal_take(const char *backup_dir, time_t previous_backup, ChangeSet *changes) {
+    char journal_path[PATH_MAX], work_path[PATH_MAX], lock_path[PATH_MAX], state_path[PATH_MAX];
+    snprintf(journal_path, sizeof(journal_path), "%s/%s", backup_dir, CHANGE_JOURNAL_FILE);
+    snprintf(work_path, sizeof(work_path), "%s/%s", backup_dir, CHANGE_JOURNAL_WORK);
+    snprintf(lock_path, sizeof(lock_path), "%s/%s", backup_dir, CHANGE_JOURNAL_LOCK);
+    snprintf(state_path, sizeof(state_path), "%s/%s", backup_dir, CHANGE_JOURNAL_STATE);
+
+    changes->paths = NULL;
+    changes->count = 0;
+    const char *reason = NULL;
+
+    // L'observateur garde le verrou tant qu'il tourne
+    int lock_fd = open(lock_path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    int watcher_alive = lock_fd >= 0 && flock(lock_fd, LOCK_EX | LOCK_NB) != 0 && errno == EWOULDBLOCK;
+    if (lock_fd >= 0) close(lock_fd);
+
+    // Un journal resté en traitement signale une sauvegarde interrompue
+    if (access(work_path, F_OK) == 0) {
+        reason = "sauvegarde précédente interrompue";
+        unlink(work_path);
+    }
+
+    // Le journal est renommé atomiquement : les événements suivants vont dans un nouveau journal
+    FILE *work = NULL;
+    if (rename(journal_path, work_path) == 0) {
+        work = fopen(work_path, "r");
+    }
+    if (!work && !reason) {
+        reason = "aucun journal des modifications";
+    }
+
+    long long watch_start = 0;
+    int capacity = 0;
+    char line[PATH_MAX + 16];
+    while (work && fgets(line, sizeof(line), work)) {
+        line[strcspn(line, "\n")] = '\0';
+        long long value;
+        if (sscanf(line, "START %lld", &value) == 1 && strncmp(line, "START ", 6) == 0) {
+            // Un redémarrage de l'observateur après la sauvegarde précédente laisse un trou
+            if (value >= (long long)previous_backup && !reason) {
+                reason = "observateur démarré après la sauvegarde précédente";
+            }
+            watch_start = value;
+        } else if (strncmp(line, "OVERFLOW ", 9) == 0) {
+            if (!reason) reason = "événements perdus";
+        } else if (line[0]) {
+            // Un .backupignore modifié change ce qui est sauvegardé dans tout son répertoire
+            char *slash = strrchr(line, '/');
+            if (strcmp(slash ? slash + 1 : line, FILTER_IGNORE_FILE) == 0) {
+                if (!slash) {
+                    if (!reason) reason = "règles d'exclusion de la racine modifiées";
+                    continue;
+                }
+                *slash = '\0';
+            }
+            change_set_add(changes, line, &capacity);
+        }
+    }
+    if (work) fclose(work);
+
+    if (watch_start == 0 && !reason) {
+        reason = "début d'observation inconnu";
+    }
+    if (!watcher_alive) {
+        if (!reason) reason = "aucun observateur actif";
+    } else if (watch_start > 0) {
+        // Reporter la date de démarrage dans le nouveau journal pour la prochaine sauvegarde
+        char start_line[64];
+        snprintf(start_line, sizeof(start_line), "START %lld\n", watch_start);
+        journal_append(journal_path, start_line);
+    }
+
+    // Réconciliation périodique par un parcours complet
+    long long last_full = 0;
+    FILE *state = fopen(state_path, "r");
+    if (state) {
+        if (fscanf(state, "%lld", &last_full) != 1) last_full = 0;
+        fclose(state);
+    }
+    if ((long long)time(NULL) - last_full >= full_interval && !reason) {
+        reason = "réconciliation périodique";
+    }
+
+    if (reason) {
+        printf("Parcours complet de la source (%s)\n", reason);
+        change_set_free(changes);
+        return -1;
+    }
+
+    change_set_normalize(changes);
+    return 0;
+}
+
+// Fonction pour valider la consommation du journal après une sauvegarde réussie
+void change_journal_commit(const char *backup_dir, int full) {
+    char work_path[PATH_MAX];
+    snprintf(work_path, sizeof(work_path), "%s/%s", backup_dir, CHANGE_JOURNAL_WORK);
+    unlink(work_path);
+
+    if (full) {
+        char state_path[PATH_MAX];
+        snprintf(state_path, sizeof(state_path), "%s/%s", backup_dir, CHANGE_JOURNAL_STATE);
+        FILE *state = fopen(state_path, "w");
+        if (!state) {
+            perror("Erreur lors de l'écriture de l'état du journal");
+            return;
+        }
+        fprintf(state, "%lld\n", (long long)time(NULL));
+        fclose(state);
+    }
+}
+
+// Fonction pour libérer un ensemble de chemins modifiés
+void change_set_free(ChangeSet *changes) {
+    for (int i = 0; i < changes->count; i++) {
+        free(changes->paths[i]);
+    }
+    free(changes->paths);
+    changes->paths = NULL;
+    changes->count = 0;
+}
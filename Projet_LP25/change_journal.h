@@ -0,0 +1,46 @@
+#ifndef CHANGE_JOURNAL_H
+#define CHANGE_JOURNAL_H
+
+#include <time.h>
+
+// Fichiers du journal des modifications, dans le répertoire de sauvegarde
+#define CHANGE_JOURNAL_FILE ".change_journal"          // Chemins modifiés, ajoutés par l'observateur
+#define CHANGE_JOURNAL_WORK ".change_journal.work"     // Journal en cours de traitement par une sauvegarde
+#define CHANGE_JOURNAL_LOCK ".change_journal.lock"     // Verrouillé tant que l'observateur tourne
+#define CHANGE_JOURNAL_STATE ".change_journal.state"   // Date du dernier parcours complet
+
+// Intervalle par défaut entre deux parcours complets de réconciliation (24 h)
+#define CHANGE_JOURNAL_FULL_INTERVAL (24 * 3600)
+
+// Délai de regroupement des événements avant écriture dans le journal (ms)
+#define CHANGE_JOURNAL_FLUSH_MS 1000
+
+// Ensemble des chemins modifiés depuis la dernière sauvegarde
+// Triés, sans doublons, et sans descendants d'un répertoire déjà présent
+typedef struct {
+    char **paths;
+    int count;
+} ChangeSet;
+
+// Fonction pour observer source_dir et consigner ses modifications dans le journal de backup_dir
+// (fanotify si disponible, sinon inotify) ; bloque jusqu'à l'arrêt du processus
+int watch_source(const char *source_dir, const char *backup_dir);
+
+// Fonction pour fixer l'intervalle entre deux parcours complets (en secondes)
+void change_journal_set_full_interval(long seconds);
+
+// Fonction pour récupérer les chemins modifiés depuis la sauvegarde de date previous_backup
+// Retourne 0 si le journal est complet, -1 si un parcours complet est nécessaire
+// (observateur arrêté, événements perdus ou réconciliation périodique)
+int change_journal_take(const char *backup_dir, time_t previous_backup, ChangeSet *changes);
+
+// Fonction pour valider la consommation du journal après une sauvegarde réussie
+// full vaut 1 si la sauvegarde a parcouru toute la source
+void change_journal_commit(const char *backup_dir, int full);
+
+// Fonction pour savoir si un chemin ou l'un de ses répertoires parents a été modifié
+int change_set_contains(const ChangeSet *changes, const char *path);
+// Fonction pour libérer un ensemble de chemins modifiés
+void change_set_free(ChangeSet *changes);
+
+#endif // CHANGE_JOURNAL_H
@@ -0,0 +1,330 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "chunk_cache.h"
+#include "deduplication.h"
+#include "throttle.h"
+
+// Listes de l'algorithme ARC : T1/T2 contiennent les chunks en mémoire (vus une fois / plusieurs fois),
+// B1/B2 ne conservent que les clés des chunks récemment évincés de T1/T2 (entrées fantômes)
+enum { ARC_T1, ARC_T2, ARC_B1, ARC_B2 };
+
+typedef struct CacheEntry {
+    unsigned char key[CHUNK_CACHE_KEY_SIZE];
+    int list;                       // Liste ARC contenant l'entrée
+    void *data;                     // NULL pour une entrée fantôme
+    size_t size;
+    struct CacheEntry *prev, *next; // Position dans la liste (tête = plus récent)
+    struct CacheEntry *hash_next;   // Chaînage dans la table de hachage
+} CacheEntry;
+
+typedef struct {
+    CacheEntry *head, *tail;
+    size_t count;
+} ArcList;
+
+// Partition du cache : ARC indépendant avec son propre verrou
+typedef struct {
+    pthread_mutex_t lock;
+    ArcList lists[4];
+    CacheEntry **buckets;
+    size_t bucket_count;
+    size_t capacity;                // c : nombre maximal de chunks en mémoire
+    size_t target_t1;               // p : taille cible de T1, adaptée selon les succès fantômes
+    unsigned long hits;
+    unsigned long misses;
+} CacheShard;
+
+static CacheShard shards[CHUNK_CACHE_SHARDS];
+static int cache_ready = 0;
+static pthread_mutex_t init_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Fonction de hachage FNV-1a d'une clé
+static unsigned long hash_key(const unsigned char *key) {
+    unsigned long hash = 14695981039346656037UL;
+    for (int i = 0; i < CHUNK_CACHE_KEY_SIZE; i++) {
+        hash = (hash ^ key[i]) * 1099511628211UL;
+    }
+    return hash;
+}
+
+static CacheShard *shard_for(const unsigned char *key, size_t *bucket) {
+    unsigned long hash = hash_key(key);
+    CacheShard *shard = &shards[hash % CHUNK_CACHE_SHARDS];
+    *bucket = (hash / CHUNK_CACHE_SHARDS) % shard->bucket_count;
+    return shard;
+}
+
+static void list_remove(CacheShard *shard, CacheEntry *entry) {
+    ArcList *list = &shard->lists[entry->list];
+    if (entry->prev) entry->prev->next = entry->next; else list->head = entry->next;
+    if (entry->next) entry->next->prev = entry->prev; else list->tail = entry->prev;
+    entry->prev = entry->next = NULL;
+    list->count--;
+}
+
+static void list_push_front(CacheShard *shard, CacheEntry *entry, int list_id) {
+    ArcList *list = &shard->lists[list_id];
+    entry->list = list_id;
+    entry->prev = NULL;
+    entry->next = list->head;
+    if (list->head) list->head->prev = entry; else list->tail = entry;
+    list->head = entry;
+    list->count++;
+}
+
+static CacheEntry *find_entry(CacheShard *shard, size_t bucket, const unsigned char *key) {
+    for (CacheEntry *entry = shard->buckets[bucket]; entry; entry = entry->hash_next) {
+        if (memcmp(entry->key, key, CHUNK_CACHE_KEY_SIZE) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+// Fonction pour supprimer complètement une entrée (liste + table de hachage)
+static void delete_entry(CacheShard *shard, CacheEntry *entry) {
+    list_remove(shard, entry);
+
+    size_t bucket = (hash_key(entry->key) / CHUNK_CACHE_SHARDS) % shard->bucket_count;
+    CacheEntry **link = &shard->buckets[bucket];
+    while (*link != entry) link = &(*link)->hash_next;
+    *link = entry->hash_next;
+
+    free(entry->data);
+    free(entry);
+}
+
+// Fonction pour transformer l'entrée la moins récente de T1 ou T2 en entrée fantôme
+static void replace(CacheShard *shard, int hit_in_b2) {
+    size_t t1 = shard->lists[ARC_T1].count;
+    CacheEntry *victim;
+    int ghost_list;
+
+    if (t1 >= 1 && ((hit_in_b2 && t1 == shard->target_t1) || t1 > shard->target_t1)) {
+        victim = shard->lists[ARC_T1].tail;
+        ghost_list = ARC_B1;
+    } else {
+        victim = shard->lists[ARC_T2].tail;
+        ghost_list = ARC_B2;
+    }
+    if (!victim) return;
+
+    list_remove(shard, victim);
+    free(victim->data);
+    victim->data = NULL;
+    victim->size = 0;
+    list_push_front(shard, victim, ghost_list);
+}
+
+static size_t resident_count(CacheShard *shard) {
+    return shard->lists[ARC_T1].count + shard->lists[ARC_T2].count;
+}
+
+// Fonction pour initialiser le cache avec une taille maximale en octets
+int chunk_cache_init(size_t max_bytes) {
+    pthread_mutex_lock(&init_lock);
+    if (cache_ready) {
+        pthread_mutex_unlock(&init_lock);
+        return 0;
+    }
+
+    size_t capacity = max_bytes / CHUNK_SIZE / CHUNK_CACHE_SHARDS;
+    if (capacity < 1) capacity = 1;
+
+    for (int i = 0; i < CHUNK_CACHE_SHARDS; i++) {
+        CacheShard *shard = &shards[i];
+        memset(shard, 0, sizeof(*shard));
+        pthread_mutex_init(&shard->lock, NULL);
+        shard->capacity = capacity;
+        // Les entrées fantômes portent le nombre de clés suivies à 2c
+        shard->bucket_count = 2 * capacity;
+        shard->buckets = calloc(shard->bucket_count, sizeof(CacheEntry *));
+        if (!shard->buckets) {
+            perror("Erreur d'allocation mémoire pour le cache de chunks");
+            pthread_mutex_unlock(&init_lock);
+            return -1;
+        }
+    }
+
+    cache_ready = 1;
+    pthread_mutex_unlock(&init_lock);
+    return 0;
+}
+
+// Fonction pour libérer toutes les données du cache
+void chunk_cache_destroy(void) {
+    pthread_mutex_lock(&init_lock);
+    if (cache_ready) {
+        for (int i = 0; i < CHUNK_CACHE_SHARDS; i++) {
+            CacheShard *shard = &shards[i];
+            for (size_t b = 0; b < shard->bucket_count; b++) {
+                CacheEntry *entry = shard->buckets[b];
+                while (entry) {
+                    CacheEntry *next = entry->hash_next;
+                    free(entry->data);
+                    free(entry);
+                    entry = next;
+                }
+            }
+            free(shard->buckets);
+            pthread_mutex_destroy(&shard->lock);
+        }
+        cache_ready = 0;
+    }
+    pthread_mutex_unlock(&init_lock);
+}
+
+// Fonction pour construire la clé d'un bloc de fichier stocké
+// Les fichiers liés en dur entre sauvegardes partagent l'inode, donc les mêmes clés
+void chunk_cache_file_key(const struct stat *st, off_t block, unsigned char *key) {
+    unsigned long long dev = st->st_dev, ino = st->st_ino, size = st->st_size, blk = block;
+    unsigned long long mtime = (unsigned long long)st->st_mtim.tv_sec * 1000000000ULL + st->st_mtim.tv_nsec;
+    memcpy(key, &dev, 8);
+    memcpy(key + 8, &ino, 8);
+    memcpy(key + 16, &size, 8);
+    memcpy(key + 24, &mtime, 8);
+    memcpy(key + 32, &blk, 8);
+}
+
+// Fonction pour copier un chunk du cache ; retourne sa taille ou -1 s'il est absent
+ssize_t chunk_cache_get(const unsigned char *key, void *out) {
+    if (!cache_ready) chunk_cache_init(CHUNK_CACHE_DEFAULT_SIZE);
+
+    size_t bucket;
+    CacheShard *shard = shard_for(key, &bucket);
+    ssize_t result = -1;
+
+    pthread_mutex_lock(&shard->lock);
+    CacheEntry *entry = find_entry(shard, bucket, key);
+    if (entry && entry->data) {
+        // Succès : le chunk passe en tête de T2 (vu plusieurs fois)
+        list_remove(shard, entry);
+        list_push_front(shard, entry, ARC_T2);
+        memcpy(out, entry->data, entry->size);
+        result = entry->size;
+        shard->hits++;
+    } else {
+        shard->misses++;
+    }
+    pthread_mutex_unlock(&shard->lock);
+    return result;
+}
+
+// Fonction pour ajouter un chunk (au plus CHUNK_SIZE octets) dans le cache
+void chunk_cache_put(const unsigned char *key, const void *data, size_t size) {
+    if (!cache_ready) chunk_cache_init(CHUNK_CACHE_DEFAULT_SIZE);
+
+    void *copy = malloc(size);
+    if (!copy) return;
+    memcpy(copy, data, size);
+
+    size_t bucket;
+    CacheShard *shard = shard_for(key, &bucket);
+
+    pthread_mutex_lock(&shard->lock);
+    CacheEntry *entry = find_entry(shard, bucket, key);
+    size_t c = shard->capacity;
+
+    if (entry && entry->data) {
+        // Déjà présent (ajout concurrent)
+        free(copy);
+        pthread_mutex_unlock(&shard->lock);
+        return;
+    }
+
+    if (entry) {
+        // Succès fantôme : adapter la taille cible de T1 puis ramener le chunk dans T2
+        size_t b1 = shard->lists[ARC_B1].count, b2 = shard->lists[ARC_B2].count;
+        int in_b2 = entry->list == ARC_B2;
+        if (!in_b2) {
+            size_t delta = (b2 > b1) ? b2 / b1 : 1;
+            shard->target_t1 = (shard->target_t1 + delta > c) ? c : shard->target_t1 + delta;
+        } else {
+            size_t delta = (b1 > b2) ? b1 / b2 : 1;
+            shard->target_t1 = (shard->target_t1 > delta) ? shard->target_t1 - delta : 0;
+        }
+        if (resident_count(shard) >= c) replace(shard, in_b2);
+        list_remove(shard, entry);
+        entry->data = copy;
+        entry->size = size;
+        list_push_front(shard, entry, ARC_T2);
+        pthread_mutex_unlock(&shard->lock);
+        return;
+    }
+
+    // Chunk inconnu : libérer de la place puis l'insérer en tête de T1
+    size_t l1 = shard->lists[ARC_T1].count + shard->lists[ARC_B1].count;
+    size_t total = l1 + shard->lists[ARC_T2].count + shard->lists[ARC_B2].count;
+    if (l1 >= c) {
+        if (shard->lists[ARC_T1].count < c) {
+            if (shard->lists[ARC_B1].tail) delete_entry(shard, shard->lists[ARC_B1].tail);
+            if (resident_count(shard) >= c) replace(shard, 0);
+        } else {
+            delete_entry(shard, shard->lists[ARC_T1].tail);
+        }
+    } else if (total >= c) {
+        if (total >= 2 * c && shard->lists[ARC_B2].tail) delete_entry(shard, shard->lists[ARC_B2].tail);
+        if (resident_count(shard) >= c) replace(shard, 0);
+    }
+
+    entry = calloc(1, sizeof(CacheEntry));
+    if (!entry) {
+        free(copy);
+        pthread_mutex_unlock(&shard->lock);
+        return;
+    }
+    memcpy(entry->key, key, CHUNK_CACHE_KEY_SIZE);
+    entry->data = copy;
+    entry->size = size;
+    entry->hash_next = shard->buckets[bucket];
+    shard->buckets[bucket] = entry;
+    list_push_front(shard, entry, ARC_T1);
+    pthread_mutex_unlock(&shard->lock);
+}
+
+// Fonction pour lire le bloc d'un fichier stocké en passant par le cache
+ssize_t chunk_cache_read_block(int fd, const struct stat *st, off_t block, void *out) {
+    unsigned char key[CHUNK_CACHE_KEY_SIZE];
+    chunk_cache_file_key(st, block, key);
+
+    ssize_t bytes = chunk_cache_get(key, out);
+    if (bytes >= 0) {
+        return bytes;
+    }
+
+    bytes = pread(fd, out, CHUNK_SIZE, block * CHUNK_SIZE);
+    if (bytes > 0) {
+        throttle_consume(THROTTLE_READ, bytes);
+        chunk_cache_put(key, out, bytes);
+    }
+    return bytes;
+}
+
+// Fonction pour récupérer les compteurs du cache
+void chunk_cache_get_stats(ChunkCacheStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (!cache_ready) return;
+
+    for (int i = 0; i < CHUNK_CACHE_SHARDS; i++) {
+        pthread_mutex_lock(&shards[i].lock);
+        stats->hits += shards[i].hits;
+        stats->misses += shards[i].misses;
+        stats->entries += resident_count(&shards[i]);
+        stats->capacity += shards[i].capacity;
+        pthread_mutex_unlock(&shards[i].lock);
+    }
+}
+
+// Fonction pour afficher le taux de succès du cache
+void chunk_cache_print_stats(FILE *out) {
+    ChunkCacheStats stats;
+    chunk_cache_get_stats(&stats);
+
+    unsigned long lookups = stats.hits + stats.misses;
+    fprintf(out, "Cache de chunks : %lu succès / %lu accès (%.1f%%), %zu/%zu chunks en mémoire\n",
+            stats.hits, lookups, lookups ? 100.0 * stats.hits / lookups : 0.0,
+            stats.entries, stats.capacity);
+}
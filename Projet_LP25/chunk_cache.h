@@ -0,0 +1,46 @@
+#ifndef CHUNK_CACHE_H
+#define CHUNK_CACHE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+// Taille par défaut du cache de chunks (64 Mo)
+#define CHUNK_CACHE_DEFAULT_SIZE (64L * 1024 * 1024)
+
+// Nombre de partitions du cache, chacune protégée par son propre verrou
+#define CHUNK_CACHE_SHARDS 16
+
+// Taille d'une clé du cache : (périphérique, inode, taille, date de modification en ns, numéro de bloc)
+// d'un fichier stocké ; la taille et la date distinguent un fichier qui a réutilisé un numéro d'inode
+#define CHUNK_CACHE_KEY_SIZE 40
+
+// Statistiques cumulées de toutes les partitions
+typedef struct {
+    unsigned long hits;
+    unsigned long misses;
+    size_t entries;       // Chunks actuellement en mémoire
+    size_t capacity;      // Nombre maximal de chunks en mémoire
+} ChunkCacheStats;
+
+// Fonction pour initialiser le cache avec une taille maximale en octets
+// (appelée implicitement avec CHUNK_CACHE_DEFAULT_SIZE au premier accès)
+int chunk_cache_init(size_t max_bytes);
+// Fonction pour libérer toutes les données du cache
+void chunk_cache_destroy(void);
+// Fonction pour construire la clé d'un bloc de fichier stocké
+void chunk_cache_file_key(const struct stat *st, off_t block, unsigned char *key);
+// Fonction pour copier un chunk du cache ; retourne sa taille ou -1 s'il est absent
+ssize_t chunk_cache_get(const unsigned char *key, void *out);
+// Fonction pour ajouter un chunk (au plus CHUNK_SIZE octets) dans le cache
+void chunk_cache_put(const unsigned char *key, const void *data, size_t size);
+// Fonction pour lire le bloc d'un fichier stocké en passant par le cache
+// out doit pouvoir contenir CHUNK_SIZE octets ; retourne le nombre d'octets lus
+ssize_t chunk_cache_read_block(int fd, const struct stat *st, off_t block, void *out);
+// Fonction pour récupérer les compteurs du cache
+void chunk_cache_get_stats(ChunkCacheStats *stats);
+// Fonction pour afficher le taux de succès du cache
+void chunk_cache_print_stats(FILE *out);
+
+#endif // CHUNK_CACHE_H
@@ -1,61 +1,204 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <openssl/md5.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <openssl/evp.h>
+#include "deduplication.h"
+#include "throttle.h"
+#include "cache_io.h"
 
-#define CHUNK_SIZE 4096
-#define HASH_TABLE_SIZE 1000
-#define MD5_DIGEST_LENGTH 16
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
 
-// Structure pour un chunk
-typedef struct {
-    unsigned char md5[MD5_DIGEST_LENGTH]; // MD5 du chunk
-    void *data; // Données du chunk
-} Chunk;
-
-// Table de hachage pour stocker les MD5 et leurs index
-typedef struct {
-    unsigned char md5[MD5_DIGEST_LENGTH];
-    int index;
-} Md5Entry;
+// Compteurs de la déduplication, mis à jour par tous les threads
+static DedupStats dedup_stats;
 
 // Fonction de hachage MD5 pour l'indexation dans la table de hachage
-unsigned int hash_md5(unsigned char *md5) {
+unsigned int hash_md5(unsigned char *md5, size_t table_size) {
     unsigned int hash = 0;
     for (int i = 0; i < MD5_DIGEST_LENGTH; i++) {
         hash = (hash << 5) + hash + md5[i];
     }
-    return hash % HASH_TABLE_SIZE;
+    return hash % table_size;
 }
 
 // Fonction pour calculer le MD5 d'un chunk
 void compute_md5(void *data, size_t len, unsigned char *md5_out) {
-    MD5_CTX md5_ctx;
-    MD5_Init(&md5_ctx);
-    MD5_Update(&md5_ctx, data, len);
-    MD5_Final(md5_out, &md5_ctx);
+    EVP_Digest(data, len, md5_out, NULL, EVP_md5(), NULL);
+}
+
+// Taille des tranches comparées entre deux tests de sortie anticipée :
+// un bloc non uniforme est en général rejeté dès la première tranche
+#define UNIFORM_STRIDE 256
+
+// Version portable : chaque tranche est comparée à la précédente (décalage d'un octet)
+static int uniform_scalar(const unsigned char *data, size_t size) {
+    return memcmp(data, data + 1, size - 1) == 0;
+}
+
+#ifdef HAVE_X86_SIMD
+// Version SSE2 : 16 octets comparés par instruction
+static int uniform_sse2(const unsigned char *data, size_t size) {
+    __m128i pattern = _mm_set1_epi8((char)data[0]);
+    size_t i = 0;
+    while (i + 16 <= size) {
+        size_t end = (i + UNIFORM_STRIDE <= size) ? i + UNIFORM_STRIDE : size - (size - i) % 16;
+        __m128i diff = _mm_setzero_si128();
+        for (; i < end; i += 16) {
+            diff = _mm_or_si128(diff, _mm_xor_si128(_mm_loadu_si128((const __m128i *)(data + i)), pattern));
+        }
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(diff, _mm_setzero_si128())) != 0xFFFF) {
+            return 0;
+        }
+    }
+    for (; i < size; i++) {
+        if (data[i] != data[0]) return 0;
+    }
+    return 1;
+}
+
+// Version AVX2 : 32 octets comparés par instruction
+__attribute__((target("avx2")))
+static int uniform_avx2(const unsigned char *data, size_t size) {
+    __m256i pattern = _mm256_set1_epi8((char)data[0]);
+    size_t i = 0;
+    while (i + 32 <= size) {
+        size_t end = (i + UNIFORM_STRIDE <= size) ? i + UNIFORM_STRIDE : size - (size - i) % 32;
+        __m256i diff = _mm256_setzero_si256();
+        for (; i < end; i += 32) {
+            diff = _mm256_or_si256(diff, _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(data + i)), pattern));
+        }
+        if (!_mm256_testz_si256(diff, diff)) {
+            return 0;
+        }
+    }
+    for (; i < size; i++) {
+        if (data[i] != data[0]) return 0;
+    }
+    return 1;
+}
+#endif
+
+// Implémentation choisie au premier appel selon les instructions du processeur
+static int (*uniform_impl)(const unsigned char *, size_t);
+static pthread_once_t uniform_once = PTHREAD_ONCE_INIT;
+
+static void select_uniform_impl(void) {
+    uniform_impl = uniform_scalar;
+#ifdef HAVE_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        uniform_impl = uniform_avx2;
+    } else if (__builtin_cpu_supports("sse2")) {
+        uniform_impl = uniform_sse2;
+    }
+#endif
+}
+
+// Fonction pour savoir si un bloc ne contient qu'un seul octet répété
+int chunk_is_uniform(const void *data, size_t size, unsigned char *byte) {
+    const unsigned char *bytes = (const unsigned char *)data;
+    if (size == 0) {
+        return 0;
+    }
+    // Test rapide des extrémités avant le parcours complet
+    if (bytes[0] != bytes[size - 1] || bytes[0] != bytes[size / 2]) {
+        return 0;
+    }
+
+    pthread_once(&uniform_once, select_uniform_impl);
+    if (!uniform_impl(bytes, size)) {
+        return 0;
+    }
+    if (byte) {
+        *byte = bytes[0];
+    }
+    return 1;
+}
+
+// Fonction pour comptabiliser un chunk lu : les chunks uniformes ne sont pas hachés
+// Retourne 1 si le chunk est uniforme
+static int classify_chunk(const void *data, size_t size, unsigned char *byte) {
+    if (chunk_is_uniform(data, size, byte)) {
+        __atomic_fetch_add(&dedup_stats.uniform_chunks, 1, __ATOMIC_RELAXED);
+        if (*byte == 0) {
+            __atomic_fetch_add(&dedup_stats.zero_chunks, 1, __ATOMIC_RELAXED);
+        }
+        return 1;
+    }
+    __atomic_fetch_add(&dedup_stats.hashed_chunks, 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+// Fonction pour savoir si un chunk à écrire est entièrement nul
+int chunk_is_hole(const void *data, size_t size) {
+    unsigned char byte;
+    if (chunk_is_uniform(data, size, &byte) && byte == 0) {
+        __atomic_fetch_add(&dedup_stats.hole_chunks, 1, __ATOMIC_RELAXED);
+        return 1;
+    }
+    __atomic_fetch_add(&dedup_stats.written_chunks, 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+// Fonction pour récupérer les compteurs de la déduplication
+void get_dedup_stats(DedupStats *stats) {
+    stats->hashed_chunks = __atomic_load_n(&dedup_stats.hashed_chunks, __ATOMIC_RELAXED);
+    stats->uniform_chunks = __atomic_load_n(&dedup_stats.uniform_chunks, __ATOMIC_RELAXED);
+    stats->zero_chunks = __atomic_load_n(&dedup_stats.zero_chunks, __ATOMIC_RELAXED);
+    stats->duplicate_chunks = __atomic_load_n(&dedup_stats.duplicate_chunks, __ATOMIC_RELAXED);
+    stats->written_chunks = __atomic_load_n(&dedup_stats.written_chunks, __ATOMIC_RELAXED);
+    stats->hole_chunks = __atomic_load_n(&dedup_stats.hole_chunks, __ATOMIC_RELAXED);
+}
+
+// Fonction pour afficher les compteurs de la déduplication
+void print_dedup_stats(FILE *out) {
+    DedupStats stats;
+    get_dedup_stats(&stats);
+    unsigned long total = stats.hashed_chunks + stats.uniform_chunks;
+    if (total > 0) {
+        fprintf(out, "Chunks uniformes : %lu (dont %lu nuls) sur %lu, MD5 évité pour %.1f %% des chunks\n",
+                stats.uniform_chunks, stats.zero_chunks, total, 100.0 * stats.uniform_chunks / total);
+    }
+    if (stats.duplicate_chunks > 0) {
+        fprintf(out, "Chunks identiques à un chunk précédent du même fichier : %lu\n", stats.duplicate_chunks);
+    }
+    total = stats.written_chunks + stats.hole_chunks;
+    if (total > 0) {
+        fprintf(out, "Chunks nuls laissés en trous : %lu sur %lu (%.1f %%)\n",
+                stats.hole_chunks, total, 100.0 * stats.hole_chunks / total);
+    }
 }
 
 // Fonction pour ajouter un MD5 dans la table de hachage
-void add_md5(Md5Entry *hash_table, unsigned char *md5, int index) {
-    unsigned int hash = hash_md5(md5);
-    for (int i = 0; i < HASH_TABLE_SIZE; i++) {
-        unsigned int probe = (hash + i) % HASH_TABLE_SIZE;
+int add_md5(Md5Entry *hash_table, size_t table_size, unsigned char *md5, int index) {
+    unsigned int hash = hash_md5(md5, table_size);
+    for (size_t i = 0; i < table_size; i++) {
+        size_t probe = (hash + i) % table_size;
         if (hash_table[probe].index == -1) {
             memcpy(hash_table[probe].md5, md5, MD5_DIGEST_LENGTH);
             hash_table[probe].index = index;
-            return;
+            return 0;
         }
     }
+    return -1;
 }
 
 // Fonction pour chercher un MD5 dans la table de hachage
-int find_md5(Md5Entry *hash_table, unsigned char *md5) {
-    unsigned int index = hash_md5(md5);
-    for (int i = 0; i < HASH_TABLE_SIZE; i++) {
-        unsigned int probe = (index + i) % HASH_TABLE_SIZE;
+int find_md5(Md5Entry *hash_table, size_t table_size, unsigned char *md5) {
+    unsigned int index = hash_md5(md5, table_size);
+    for (size_t i = 0; i < table_size; i++) {
+        size_t probe = (index + i) % table_size;
         if (hash_table[probe].index == -1) {
-            continue;
+            // Les entrées ne sont jamais supprimées : une case vide termine la séquence de sondage
+            return -1;
         }
         if (memcmp(hash_table[probe].md5, md5, MD5_DIGEST_LENGTH) == 0) {
             return hash_table[probe].index;
@@ -64,46 +207,438 @@ int find_md5(Md5Entry *hash_table, unsigned char *md5) {
     return -1;
 }
 
-// Fonction pour dédupliquer un fichier et l'ajouter en chunks
-void deduplicate_file(FILE *file, Chunk *chunks, Md5Entry *hash_table) {
-    size_t bytes_read;
-    unsigned char buffer[CHUNK_SIZE];
-    unsigned char md5[MD5_DIGEST_LENGTH];
-    int chunk_index = 0;
-    
-    // Lecture du fichier en chunks
-    while ((bytes_read = fread(buffer, 1, CHUNK_SIZE, file)) > 0) {
-        // Calculer le MD5 du chunk
-        compute_md5(buffer, bytes_read, md5);
-        
-        // Chercher si ce MD5 est déjà dans la table de hachage
-        int index_in_hash = find_md5(hash_table, md5);
-        
-        if (index_in_hash == -1) {
-            // Si le MD5 n'existe pas encore, l'ajouter à la table de hachage et au tableau de chunks
-            add_md5(hash_table, md5, chunk_index);
-            
-            // Allouer et stocker les données du chunk
-            chunks[chunk_index].data = malloc(bytes_read);
-            memcpy(chunks[chunk_index].data, buffer, bytes_read);
-            memcpy(chunks[chunk_index].md5, md5, MD5_DIGEST_LENGTH);
-            
-            // Incrémenter l'index du chunk
-            chunk_index++;
+// Taille d'un lot de chunks lu par un thread
+#define BATCH_BYTES ((off_t)FINGERPRINT_BATCH_CHUNKS * CHUNK_SIZE)
+
+// États d'une case de lot
+enum { BATCH_FREE, BATCH_READY, BATCH_FAILED };
+
+// Lot de chunks consécutifs d'un fichier, lu et haché par un thread
+typedef struct {
+    int state;                    // BATCH_FREE tant que le lot n'est pas haché
+    unsigned char *data;          // Données lues (BATCH_BYTES octets au plus)
+    size_t bytes;
+    Chunk chunks[FINGERPRINT_BATCH_CHUNKS];
+    int count;
+} FingerprintBatch;
+
+// Calcul des empreintes d'un fichier, partagé entre les threads
+// Le lot number occupe la case number % slots, libérée quand il a été fusionné : au plus
+// slots lots sont en mémoire, quelle que soit la taille du fichier
+typedef struct {
+    int fd;
+    off_t size;
+    long batch_count;
+    long next_batch;              // Prochain lot à lire
+    long merged;                  // Nombre de lots déjà fusionnés
+    int slots;
+    int stop;                     // Erreur ou fin : les threads s'arrêtent
+    FingerprintBatch *batches;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+} FingerprintJob;
+
+// Fonction pour lire et hacher le lot number ; les chunks uniformes ne sont pas hachés
+// Retourne -1 en cas d'erreur de lecture ou si le fichier a raccourci
+static int fingerprint_batch(int fd, off_t size, long number, FingerprintBatch *batch) {
+    off_t start = number * BATCH_BYTES;
+    size_t len = (size - start < BATCH_BYTES) ? (size_t)(size - start) : (size_t)BATCH_BYTES;
+
+    batch->bytes = 0;
+    while (batch->bytes < len) {
+        ssize_t bytes_read = pread(fd, batch->data + batch->bytes, len - batch->bytes, start + batch->bytes);
+        if (bytes_read < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytes_read <= 0) {
+            return -1;
+        }
+        batch->bytes += bytes_read;
+    }
+    throttle_consume(THROTTLE_READ, len);
+
+    batch->count = 0;
+    for (size_t offset = 0; offset < len; offset += CHUNK_SIZE) {
+        Chunk *chunk = &batch->chunks[batch->count++];
+        chunk->data = NULL;
+        chunk->size = (len - offset < CHUNK_SIZE) ? len - offset : CHUNK_SIZE;
+        chunk->fill = -1;
+        unsigned char byte;
+        if (classify_chunk(batch->data + offset, chunk->size, &byte)) {
+            chunk->fill = byte;
         } else {
-            // Si le MD5 existe déjà, ignorer le chunk et ne pas ajouter de doublons
-            printf("Chunk duplicata trouvé : index %d, MD5 déjà présent.\n", index_in_hash);
+            compute_md5(batch->data + offset, chunk->size, chunk->md5);
         }
     }
-    
-    // Terminer la lecture du fichier
-    printf("Déduplication terminée, %d chunks traités.\n", chunk_index);
+    return 0;
+}
+
+// Fonction exécutée par chaque thread : lit et hache les lots suivants tant qu'une case est libre
+static void *fingerprint_worker(void *arg) {
+    FingerprintJob *job = (FingerprintJob *)arg;
+    pthread_mutex_lock(&job->lock);
+    while (!job->stop && job->next_batch < job->batch_count) {
+        long number = job->next_batch;
+        if (number - job->merged >= job->slots) {
+            pthread_cond_wait(&job->changed, &job->lock);
+            continue;
+        }
+        job->next_batch++;
+        FingerprintBatch *batch = &job->batches[number % job->slots];
+        pthread_mutex_unlock(&job->lock);
+
+        int result = fingerprint_batch(job->fd, job->size, number, batch);
+
+        pthread_mutex_lock(&job->lock);
+        batch->state = result == 0 ? BATCH_READY : BATCH_FAILED;
+        pthread_cond_broadcast(&job->changed);
+    }
+    pthread_mutex_unlock(&job->lock);
+    return NULL;
+}
+
+// Fonction pour écrire la référence d'un bloc dans la recette, suivie du MD5 d'un nouveau chunk
+// (md5 non NULL), ou pour la comparer à celle de la recette relue ; retourne -1 en cas d'erreur
+// d'écriture ou de différence
+static int record_block(FileRecipe *recipe, int ref, const unsigned char *md5) {
+    if (!recipe->file) {
+        return 0;
+    }
+    if (!recipe->compare) {
+        return fwrite(&ref, sizeof(int), 1, recipe->file) == 1 &&
+               (!md5 || fwrite(md5, 1, MD5_DIGEST_LENGTH, recipe->file) == MD5_DIGEST_LENGTH) ? 0 : -1;
+    }
+
+    int stored_ref;
+    unsigned char stored_md5[MD5_DIGEST_LENGTH];
+    if (fread(&stored_ref, sizeof(int), 1, recipe->file) != 1 || stored_ref != ref) {
+        return -1;
+    }
+    return !md5 || (fread(stored_md5, 1, MD5_DIGEST_LENGTH, recipe->file) == MD5_DIGEST_LENGTH &&
+                    memcmp(stored_md5, md5, MD5_DIGEST_LENGTH) == 0) ? 0 : -1;
+}
+
+// Fonction pour ajouter les chunks d'un lot à l'index et à la recette, dans l'ordre du fichier
+// Retourne -1 en cas d'erreur d'écriture de la recette ou de différence avec la recette relue
+static int merge_batch(FileRecipe *recipe, const FingerprintBatch *batch) {
+    for (int i = 0; i < batch->count; i++) {
+        const Chunk *chunk = &batch->chunks[i];
+        const unsigned char *new_md5 = NULL;
+        int index;
+        if (chunk->fill >= 0) {
+            index = UNIFORM_CHUNK_REF(chunk->fill);
+        } else {
+            index = find_md5(recipe->hash_table, recipe->table_size, (unsigned char *)chunk->md5);
+            if (index == -1) {
+                // Nouveau chunk : son MD5 suit sa référence dans la recette et il rejoint l'index
+                // tant que celui-ci est à moitié vide
+                index = recipe->chunk_count++;
+                new_md5 = chunk->md5;
+                if (recipe->indexed < recipe->table_size / 2 &&
+                    add_md5(recipe->hash_table, recipe->table_size, (unsigned char *)chunk->md5, index) == 0) {
+                    recipe->indexed++;
+                }
+            } else {
+                __atomic_fetch_add(&dedup_stats.duplicate_chunks, 1, __ATOMIC_RELAXED);
+            }
+        }
+        if (record_block(recipe, index, new_md5) != 0) {
+            return -1;
+        }
+        recipe->block_count++;
+    }
+    return 0;
+}
+
+// Nombre de threads à utiliser pour un fichier de taille donnée (1 = séquentiel)
+static int fingerprint_thread_count(off_t size) {
+    if (size < PARALLEL_MIN_FILE_SIZE) {
+        return 1;
+    }
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1) cpus = 1;
+    if (cpus > MAX_FINGERPRINT_THREADS) cpus = MAX_FINGERPRINT_THREADS;
+
+    // Chaque thread doit traiter au moins PARALLEL_MIN_SEGMENT_SIZE octets
+    off_t max_threads = size / PARALLEL_MIN_SEGMENT_SIZE;
+    if (max_threads < cpus) cpus = max_threads;
+    return cpus < 1 ? 1 : (int)cpus;
+}
+
+// Fonction pour fermer une recette
+void free_file_recipe(FileRecipe *recipe) {
+    if (recipe->file) {
+        fclose(recipe->file);
+        recipe->file = NULL;
+    }
+    if (recipe->temp_path) {
+        unlink(recipe->temp_path);
+        free(recipe->temp_path);
+        recipe->temp_path = NULL;
+    }
+    free(recipe->hash_table);
+    recipe->hash_table = NULL;
+}
+
+// Fonction pour calculer la recette des size premiers octets du fichier fd
+int deduplicate_file(int fd, off_t size, FileRecipe *recipe) {
+    off_t blocks = (size + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    if (size < 0 || blocks > INT_MAX / 2) {
+        return -1;
+    }
+    // Une recette relue doit aussi avoir le même MD5 et le même nombre de chunks distincts
+    unsigned char expected_md5[MD5_DIGEST_LENGTH];
+    int expected_chunks = recipe->chunk_count;
+    memcpy(expected_md5, recipe->md5, MD5_DIGEST_LENGTH);
+    recipe->chunk_count = 0;
+    recipe->block_count = 0;
+    recipe->indexed = 0;
+
+    // La table est dimensionnée pour tous les chunks d'un petit fichier (au plus à moitié pleine)
+    // et bornée pour un gros fichier
+    recipe->table_size = blocks * 2 > HASH_TABLE_SIZE ? (size_t)blocks * 2 : HASH_TABLE_SIZE;
+    if (recipe->table_size > RECIPE_INDEX_MAX_SIZE) {
+        recipe->table_size = RECIPE_INDEX_MAX_SIZE;
+    }
+    recipe->hash_table = malloc(recipe->table_size * sizeof(Md5Entry));
+
+    int thread_count = fingerprint_thread_count(size);
+    FingerprintJob job;
+    memset(&job, 0, sizeof(job));
+    job.fd = fd;
+    job.size = size;
+    job.batch_count = (size + BATCH_BYTES - 1) / BATCH_BYTES;
+    job.slots = thread_count > 1 ? 2 * thread_count : 1;
+    job.batches = calloc(job.slots, sizeof(FingerprintBatch));
+    EVP_MD_CTX *file_md5 = EVP_MD_CTX_new();
+
+    int error = !recipe->hash_table || !job.batches || !file_md5 ||
+                EVP_DigestInit_ex(file_md5, EVP_md5(), NULL) != 1;
+    for (int i = 0; !error && i < job.slots; i++) {
+        job.batches[i].data = malloc(BATCH_BYTES);
+        error = !job.batches[i].data;
+    }
+    if (error) {
+        perror("Erreur d'allocation mémoire pour les empreintes");
+    } else {
+        for (size_t i = 0; i < recipe->table_size; i++) {
+            recipe->hash_table[i].index = -1;
+        }
+    }
+
+    // Les lots sont lus et hachés par les threads, puis fusionnés ici dans l'ordre du fichier
+    pthread_t threads[MAX_FINGERPRINT_THREADS];
+    int launched = 0;
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_cond_init(&job.changed, NULL);
+    while (!error && thread_count > 1 && launched < thread_count &&
+           pthread_create(&threads[launched], NULL, fingerprint_worker, &job) == 0) {
+        launched++;
+    }
+
+    for (long number = 0; !error && number < job.batch_count; number++) {
+        FingerprintBatch *batch = &job.batches[number % job.slots];
+        if (launched == 0) {
+            // Petit fichier (ou threads indisponibles) : lecture par le thread appelant
+            batch->state = fingerprint_batch(fd, size, number, batch) == 0 ? BATCH_READY : BATCH_FAILED;
+        } else {
+            pthread_mutex_lock(&job.lock);
+            while (batch->state == BATCH_FREE) {
+                pthread_cond_wait(&job.changed, &job.lock);
+            }
+            pthread_mutex_unlock(&job.lock);
+        }
+
+        if (batch->state == BATCH_FAILED) {
+            fprintf(stderr, "Erreur de lecture pendant le calcul des empreintes\n");
+            error = 1;
+        } else if (merge_batch(recipe, batch) != 0 || EVP_DigestUpdate(file_md5, batch->data, batch->bytes) != 1) {
+            error = 1;
+        }
+        if (cache_io_get_mode() != CACHE_MODE_NORMAL) {
+            posix_fadvise(fd, number * BATCH_BYTES, batch->bytes, POSIX_FADV_DONTNEED);
+        }
+
+        pthread_mutex_lock(&job.lock);
+        batch->state = BATCH_FREE;
+        job.merged++;
+        pthread_cond_broadcast(&job.changed);
+        pthread_mutex_unlock(&job.lock);
+    }
+
+    pthread_mutex_lock(&job.lock);
+    job.stop = 1;
+    pthread_cond_broadcast(&job.changed);
+    pthread_mutex_unlock(&job.lock);
+    for (int i = 0; i < launched; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    pthread_mutex_destroy(&job.lock);
+    pthread_cond_destroy(&job.changed);
+
+    if (!error && EVP_DigestFinal_ex(file_md5, recipe->md5, NULL) != 1) {
+        error = 1;
+    }
+    EVP_MD_CTX_free(file_md5);
+    for (int i = 0; job.batches && i < job.slots; i++) {
+        free(job.batches[i].data);
+    }
+    free(job.batches);
+    free(recipe->hash_table);
+    recipe->hash_table = NULL;
+
+    if (!error && recipe->compare &&
+        (recipe->chunk_count != expected_chunks || memcmp(recipe->md5, expected_md5, MD5_DIGEST_LENGTH) != 0 ||
+         fgetc(recipe->file) != EOF)) {
+        error = 1;
+    }
+    if (error) {
+        return -1;
+    }
+    recipe->size = size;
+    return recipe->chunk_count;
+}
+
+// Répertoire des recettes du répertoire de sauvegarde en cours (vide = recettes désactivées)
+static char recipe_dir[PATH_MAX];
+
+// Fonction pour choisir le répertoire de sauvegarde où sont enregistrées les recettes
+void set_recipe_dir(const char *backup_dir) {
+    int len = backup_dir ? snprintf(recipe_dir, sizeof(recipe_dir), "%s/%s", backup_dir, RECIPE_DIR) : -1;
+    if (len < 0 || (size_t)len >= sizeof(recipe_dir)) {
+        recipe_dir[0] = '\0';
+    }
+}
+
+// Fonction pour construire le chemin de la recette d'un fichier stocké ; retourne -1 sans répertoire de recettes
+static int recipe_path(const struct stat *st, char *path, size_t size) {
+    if (recipe_dir[0] == '\0') {
+        return -1;
+    }
+    int len = snprintf(path, size, "%s/%llu", recipe_dir, (unsigned long long)st->st_ino);
+    return (len < 0 || (size_t)len >= size) ? -1 : 0;
+}
+
+// Fonction pour écrire l'en-tête d'une recette : ses champs ont une largeur fixe pour qu'il soit
+// réécrit en place une fois le fichier haché
+static int write_recipe_header(FILE *file, const struct stat *st, const FileRecipe *recipe) {
+    char md5_hex[MD5_DIGEST_LENGTH * 2 + 1];
+    for (int i = 0; i < MD5_DIGEST_LENGTH; i++) {
+        snprintf(md5_hex + i * 2, 3, "%02x", recipe->md5[i]);
+    }
+    return fprintf(file, "%s %020lld %020lld.%09ld %020ld %010d %s\n", RECIPE_MAGIC, (long long)st->st_size,
+                   (long long)st->st_mtim.tv_sec, st->st_mtim.tv_nsec, (long)((st->st_size + CHUNK_SIZE - 1) / CHUNK_SIZE),
+                   recipe->chunk_count, md5_hex) < 0 ? -1 : 0;
+}
+
+// Fonction pour créer la recette du fichier stocké décrit par st
+// Elle est écrite à côté puis renommée par write_file_recipe : une recette interrompue n'est jamais relue
+int create_file_recipe(const struct stat *st, FileRecipe *recipe) {
+    char path[PATH_MAX];
+    memset(recipe, 0, sizeof(*recipe));
+    if (recipe_path(st, path, sizeof(path)) != 0) {
+        return -1;
+    }
+    if (mkdir(recipe_dir, 0755) == -1 && errno != EEXIST) {
+        perror("Erreur lors de la création du répertoire des recettes");
+        return -1;
+    }
+    recipe->temp_path = malloc(strlen(path) + 5);
+    if (!recipe->temp_path) {
+        perror("Erreur d'allocation mémoire pour une recette");
+        return -1;
+    }
+    sprintf(recipe->temp_path, "%s.tmp", path);
+
+    recipe->file = fopen(recipe->temp_path, "w");
+    if (!recipe->file || write_recipe_header(recipe->file, st, recipe) != 0) {
+        perror("Erreur lors de l'écriture d'une recette");
+        free_file_recipe(recipe);
+        return -1;
+    }
+    return 0;
+}
+
+// Fonction pour enregistrer une recette créée puis remplie par deduplicate_file
+int write_file_recipe(const struct stat *st, FileRecipe *recipe) {
+    char path[PATH_MAX];
+    if (!recipe->file || recipe->compare || recipe_path(st, path, sizeof(path)) != 0) {
+        return -1;
+    }
+
+    // L'en-tête reçoit le nombre de chunks distincts et le MD5 du fichier
+    int failed = fseeko(recipe->file, 0, SEEK_SET) != 0 || write_recipe_header(recipe->file, st, recipe) != 0 ||
+                 ferror(recipe->file);
+    failed = fclose(recipe->file) != 0 || failed;
+    recipe->file = NULL;
+    if (failed || rename(recipe->temp_path, path) != 0) {
+        perror("Erreur lors de l'écriture d'une recette");
+        free_file_recipe(recipe);
+        return -1;
+    }
+    free(recipe->temp_path);
+    recipe->temp_path = NULL;
+    return 0;
+}
+
+// Fonction pour ouvrir la recette du fichier stocké décrit par st
+int read_file_recipe(const struct stat *st, FileRecipe *recipe) {
+    char path[PATH_MAX];
+    if (recipe_path(st, path, sizeof(path)) != 0) {
+        return -1;
+    }
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        return -1;
+    }
+
+    // L'inode d'un fichier supprimé peut être réutilisé : la taille et la date doivent correspondre
+    long long size, mtime;
+    long mtime_nsec, block_count;
+    int chunk_count;
+    char md5_hex[MD5_DIGEST_LENGTH * 2 + 1];
+    struct stat file_stat;
+    int valid = fscanf(file, RECIPE_MAGIC " %lld %lld.%ld %ld %d %32s", &size, &mtime, &mtime_nsec,
+                       &block_count, &chunk_count, md5_hex) == 6 && fgetc(file) == '\n' &&
+                size == (long long)st->st_size && mtime == (long long)st->st_mtim.tv_sec &&
+                mtime_nsec == st->st_mtim.tv_nsec && block_count == (size + CHUNK_SIZE - 1) / CHUNK_SIZE &&
+                chunk_count >= 0 && chunk_count <= block_count && strlen(md5_hex) == MD5_DIGEST_LENGTH * 2 &&
+                fstat(fileno(file), &file_stat) == 0 &&
+                file_stat.st_size == ftello(file) + (off_t)block_count * (off_t)sizeof(int) +
+                                     (off_t)chunk_count * MD5_DIGEST_LENGTH;
+    if (!valid || !recipe) {
+        fclose(file);
+        return valid ? 0 : -1;
+    }
+
+    // Les références des blocs sont lues au fil de la comparaison
+    memset(recipe, 0, sizeof(*recipe));
+    recipe->size = size;
+    recipe->block_count = block_count;
+    recipe->chunk_count = chunk_count;
+    for (int i = 0; i < MD5_DIGEST_LENGTH; i++) {
+        unsigned int byte;
+        sscanf(md5_hex + i * 2, "%2x", &byte);
+        recipe->md5[i] = (unsigned char)byte;
+    }
+    recipe->file = file;
+    recipe->compare = 1;
+    return 0;
+}
+
+// Fonction pour supprimer la recette du fichier stocké décrit par st
+void remove_file_recipe(const struct stat *st) {
+    char path[PATH_MAX];
+    if (recipe_path(st, path, sizeof(path)) == 0) {
+        unlink(path);
+    }
 }
 
 // Fonction pour afficher la table de hachage
-void print_hash_table(Md5Entry *hash_table) {
+void print_hash_table(Md5Entry *hash_table, size_t table_size) {
     printf("\nTable de hachage des MD5 et leurs indices:\n");
-    for (int i = 0; i < HASH_TABLE_SIZE; i++) {
+    for (size_t i = 0; i < table_size; i++) {
         if (hash_table[i].index != -1) {
             printf("Index: %d, MD5: ", hash_table[i].index);
             for (int j = 0; j < MD5_DIGEST_LENGTH; j++) {
@@ -113,4 +648,3 @@ void print_hash_table(Md5Entry *hash_table) {
         }
     }
 }
-
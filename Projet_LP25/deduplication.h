@@ -6,37 +6,135 @@
 #include <string.h>
 #include <openssl/md5.h>
 #include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 
 // Taille d'un chunk (4096 octets)
 #define CHUNK_SIZE 4096
 
-// Taille de la table de hachage qui contiendra les chunks
+// Taille minimale de la table de hachage qui contiendra les chunks
 // dont on a déjà calculé le MD5 pour effectuer les comparaisons
+// (elle est agrandie au double du nombre de chunks du fichier, jusqu'à RECIPE_INDEX_MAX_SIZE)
 #define HASH_TABLE_SIZE 1000
 
+// Taille maximale de l'index des chunks distincts d'un fichier (1 Mi cases, 20 Mo) : une fois à
+// moitié plein, les nouveaux chunks sont enregistrés dans la recette sans y être ajoutés. La mémoire
+// utilisée ne dépend donc pas de la taille du fichier ; changer cette limite change les recettes
+#define RECIPE_INDEX_MAX_SIZE (1L << 20)
+
+// Taille à partir de laquelle les empreintes d'un fichier sont calculées en parallèle (64 Mo)
+#define PARALLEL_MIN_FILE_SIZE (64L * 1024 * 1024)
+
+// Quantité minimale de données par thread de calcul d'empreintes (16 Mo)
+#define PARALLEL_MIN_SEGMENT_SIZE (16L * 1024 * 1024)
+
+// Nombre de chunks consécutifs lus et hachés ensemble par un thread (256 Ko) ; au plus
+// deux lots par thread sont en mémoire en attendant d'être fusionnés dans l'ordre du fichier
+#define FINGERPRINT_BATCH_CHUNKS 64
+
+// Nombre maximal de threads de calcul d'empreintes pour un fichier
+#define MAX_FINGERPRINT_THREADS 16
+
+// Référence de recette d'un chunk uniforme (un seul octet répété) : aucune donnée n'est stockée
+// et son MD5 n'est pas calculé. Les index des chunks stockés sont positifs.
+#define UNIFORM_CHUNK_REF(byte) (-2 - (int)(byte))
+#define IS_UNIFORM_CHUNK_REF(ref) ((ref) <= -2)
+#define UNIFORM_CHUNK_BYTE(ref) ((unsigned char)(-2 - (ref)))
+
 // Structure pour un chunk
 typedef struct {
     unsigned char md5[MD5_DIGEST_LENGTH]; // MD5 du chunk
-    void *data; // Données du chunk
+    void *data; // Données du chunk (NULL pour un chunk uniforme)
+    size_t size; // Taille des données (inférieure à CHUNK_SIZE pour le dernier chunk)
+    int fill; // Octet répété si le chunk est uniforme, -1 sinon
 } Chunk;
 
+// Taille minimale d'un fichier stocké pour que la recette de ses chunks soit enregistrée (1 Mo)
+#define RECIPE_MIN_SIZE (1024L * 1024)
+
+// Recettes des fichiers stockés, dans le répertoire de sauvegarde : un fichier par inode stocké,
+// partagé par toutes les sauvegardes qui y font un lien dur
+// Format : une ligne "LP25RECIPE2 <taille> <mtime.nsec> <blocs> <chunks> <md5 du fichier>" (champs de
+// largeur fixe) puis, pour chaque bloc, un entier 32 bits (index du chunk distinct ou UNIFORM_CHUNK_REF)
+// suivi du MD5 du chunk quand il apparaît pour la première fois : la recette s'écrit et se relit au fil
+// du fichier, sans être chargée en mémoire
+#define RECIPE_DIR ".backup_recipes"
+#define RECIPE_MAGIC "LP25RECIPE2"
+
+// Compteurs cumulés de la déduplication
+typedef struct {
+    unsigned long hashed_chunks;   // Chunks dont le MD5 a été calculé
+    unsigned long uniform_chunks;  // Chunks uniformes détectés sans calcul de MD5
+    unsigned long zero_chunks;     // Dont chunks entièrement nuls
+    unsigned long duplicate_chunks; // Chunks identiques à un chunk précédent du même fichier
+    unsigned long written_chunks;  // Chunks écrits (restauration, déchiffrement, flux)
+    unsigned long hole_chunks;     // Chunks nuls laissés en trous au lieu d'être écrits
+} DedupStats;
+
 // Table de hachage pour stocker les MD5 et leurs index
+// La déduplication est exacte : un chunk qui diffère de quelques octets d'un chunk précédent est un
+// nouveau chunk. Aucun encodage delta n'est fait, les sauvegardes stockant des fichiers entiers que
+// la restauration, la vérification, le montage et le serveur lisent directement
 typedef struct {
     unsigned char md5[MD5_DIGEST_LENGTH];
     int index;
 } Md5Entry;
 
+// Recette d'un fichier : les références de ses blocs sont écrites dans file au fil du calcul
+// (recette créée) ou comparées à celles qui y sont relues (recette relue)
+typedef struct {
+    unsigned char md5[MD5_DIGEST_LENGTH]; // MD5 du fichier entier
+    off_t size;                           // Taille des données lues
+    int chunk_count;                      // Nombre de chunks distincts
+    long block_count;
+    Md5Entry *hash_table;                 // Index borné des chunks distincts (pendant le calcul)
+    size_t table_size;
+    size_t indexed;                       // Chunks présents dans l'index
+    FILE *file;                           // Recette écrite ou relue (NULL = aucune)
+    char *temp_path;                      // Recette en cours d'écriture, renommée par write_file_recipe
+    int compare;                          // 1 pour une recette relue
+} FileRecipe;
 
-// Fonction de hachage MD5 pour l'indexation dans la table de hachage
-unsigned int hash_md5(unsigned char *md5);
+// Fonction de hachage MD5 pour l'indexation dans une table de table_size cases
+unsigned int hash_md5(unsigned char *md5, size_t table_size);
 // Fonction pour calculer le MD5 d'un chunk
 void compute_md5(void *data, size_t len, unsigned char *md5_out);
 // Fonction permettant de chercher un MD5 dans la table de hachage
-int find_md5(Md5Entry *hash_table, unsigned char *md5);
-// Fonction pour ajouter un MD5 dans la table de hachage
-void add_md5(Md5Entry *hash_table, unsigned char *md5, int index);
-// Fonction pour convertir un fichier non dédupliqué en tableau de chunks
-void deduplicate_file(FILE *file, Chunk *chunks, Md5Entry *hash_table);
+int find_md5(Md5Entry *hash_table, size_t table_size, unsigned char *md5);
+// Fonction pour ajouter un MD5 dans la table de hachage ; retourne -1 si elle est pleine
+int add_md5(Md5Entry *hash_table, size_t table_size, unsigned char *md5, int index);
+// Fonction pour savoir si un bloc ne contient qu'un seul octet répété (SSE2/AVX2 si disponibles)
+// Retourne 1 et renseigne *byte si c'est le cas
+int chunk_is_uniform(const void *data, size_t size, unsigned char *byte);
+// Fonction pour savoir si un chunk à écrire est entièrement nul : il est alors laissé en trou
+// Chaque appel est comptabilisé (chunk écrit ou trou) dans les compteurs de la déduplication
+int chunk_is_hole(const void *data, size_t size);
+// Fonction pour récupérer les compteurs de la déduplication
+void get_dedup_stats(DedupStats *stats);
+// Fonction pour afficher les compteurs de la déduplication (seulement ceux qui ont servi)
+void print_dedup_stats(FILE *out);
+// Fonction pour calculer la recette des size premiers octets du fichier fd, ainsi que leur MD5
+// Les lots de chunks d'un gros fichier sont lus et hachés sur plusieurs cœurs puis fusionnés
+// dans l'ordre du fichier ; chaque bloc fusionné est écrit dans recipe->file ou, pour une recette
+// relue, comparé à celui qu'elle enregistre (le calcul s'arrête à la première différence).
+// Retourne le nombre de chunks distincts, -1 en cas d'erreur de lecture (ou de fichier raccourci),
+// d'allocation, d'écriture de la recette ou de contenu différent de la recette relue
+int deduplicate_file(int fd, off_t size, FileRecipe *recipe);
+// Fonction pour fermer une recette (une recette créée mais pas enregistrée est supprimée)
+void free_file_recipe(FileRecipe *recipe);
+// Fonction pour choisir le répertoire de sauvegarde où sont enregistrées les recettes (NULL = aucun)
+void set_recipe_dir(const char *backup_dir);
+// Fonction pour créer la recette du fichier stocké décrit par st, remplie ensuite par deduplicate_file
+// Retourne 0 en cas de succès
+int create_file_recipe(const struct stat *st, FileRecipe *recipe);
+// Fonction pour enregistrer une recette créée puis remplie ; retourne 0 en cas de succès
+int write_file_recipe(const struct stat *st, FileRecipe *recipe);
+// Fonction pour ouvrir la recette du fichier stocké décrit par st, à comparer par deduplicate_file
+// (NULL pour seulement vérifier qu'elle existe). Retourne -1 si elle est absente ou ne correspond
+// plus au fichier (taille, date de modification)
+int read_file_recipe(const struct stat *st, FileRecipe *recipe);
+// Fonction pour supprimer la recette du fichier stocké décrit par st
+void remove_file_recipe(const struct stat *st);
 // Fonction permettant de charger un fichier dédupliqué en table de chunks
 // en remplaçant les références par les données correspondantes
 void undeduplicate_file(FILE *file, Chunk **chunks, int *chunk_count);
@@ -0,0 +1,191 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "dir_walk.h"
+
+// Taille du tampon passé à getdents64 : plusieurs centaines d'entrées par appel système
+#define GETDENTS_BUFFER_SIZE 65536
+
+// Format des entrées renvoyées par getdents64
+struct linux_dirent64 {
+    ino_t d_ino;
+    off_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+// Fonction pour lire le répertoire name relatif à parent_fd
+int dir_listing_open(int parent_fd, const char *name, DirListing *listing) {
+    listing->entries = NULL;
+    listing->names = NULL;
+    listing->count = 0;
+
+    int flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+    if (parent_fd != AT_FDCWD) {
+        flags |= O_NOFOLLOW;
+    }
+    listing->fd = openat(parent_fd, name, flags);
+    if (listing->fd < 0) {
+        return -1;
+    }
+
+    // Les noms sont copiés bout à bout ; les entrées gardent leur position jusqu'à la fin de la lecture
+    static __thread char buffer[GETDENTS_BUFFER_SIZE] __attribute__((aligned(8)));
+    size_t names_len = 0, names_capacity = 0;
+    int entries_capacity = 0;
+    size_t *offsets = NULL;
+
+    for (;;) {
+        long nread = syscall(SYS_getdents64, listing->fd, buffer, sizeof(buffer));
+        if (nread < 0) {
+            int saved = errno;
+            free(offsets);
+            free(listing->entries);
+            free(listing->names);
+            close(listing->fd);
+            listing->fd = -1;
+            listing->entries = NULL;
+            listing->names = NULL;
+            listing->count = 0;
+            errno = saved;
+            return -1;
+        }
+        if (nread == 0) {
+            break;
+        }
+
+        for (long pos = 0; pos < nread; ) {
+            struct linux_dirent64 *d = (struct linux_dirent64 *)(buffer + pos);
+            pos += d->d_reclen;
+            if (strcmp(d->d_name, ".") == 0 || strcmp(d->d_name, "..") == 0) {
+                continue;
+            }
+
+            size_t len = strlen(d->d_name) + 1;
+            if (names_len + len > names_capacity) {
+                names_capacity = names_capacity ? names_capacity * 2 : 4096;
+                while (names_len + len > names_capacity) names_capacity *= 2;
+                listing->names = realloc(listing->names, names_capacity);
+            }
+            if (listing->count == entries_capacity) {
+                entries_capacity = entries_capacity ? entries_capacity * 2 : 64;
+                listing->entries = realloc(listing->entries, entries_capacity * sizeof(DirEntry));
+                offsets = realloc(offsets, entries_capacity * sizeof(size_t));
+            }
+            if (!listing->names || !listing->entries || !offsets) {
+                perror("Erreur d'allocation mémoire pour la lecture du répertoire");
+                exit(EXIT_FAILURE);
+            }
+
+            memcpy(listing->names + names_len, d->d_name, len);
+            offsets[listing->count] = names_len;
+            listing->entries[listing->count].ino = d->d_ino;
+            listing->entries[listing->count].type = d->d_type;
+            listing->count++;
+            names_len += len;
+        }
+    }
+
+    for (int i = 0; i < listing->count; i++) {
+        listing->entries[i].name = listing->names + offsets[i];
+    }
+    free(offsets);
+    return 0;
+}
+
+// Fonction pour libérer un répertoire lu et fermer son descripteur
+void dir_listing_close(DirListing *listing) {
+    if (listing->fd >= 0) {
+        close(listing->fd);
+    }
+    free(listing->entries);
+    free(listing->names);
+    listing->fd = -1;
+    listing->entries = NULL;
+    listing->names = NULL;
+    listing->count = 0;
+}
+
+// Fonction pour lire les informations d'une entrée sans suivre les liens symboliques
+int dir_entry_stat(const DirListing *listing, const DirEntry *entry, struct stat *st) {
+    return fstatat(listing->fd, entry->name, st, AT_SYMLINK_NOFOLLOW);
+}
+
+// Fonction pour savoir si une entrée est un répertoire
+int dir_entry_is_dir(const DirListing *listing, DirEntry *entry) {
+    if (entry->type == DT_UNKNOWN) {
+        struct stat st;
+        if (dir_entry_stat(listing, entry, &st) != 0) {
+            return 0;
+        }
+        entry->type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISLNK(st.st_mode) ? DT_LNK
+                    : S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN;
+    }
+    return entry->type == DT_DIR;
+}
+
+static int compare_entries(const void *a, const void *b) {
+    return strcmp(((const DirEntry *)a)->name, ((const DirEntry *)b)->name);
+}
+
+// Fonction pour trier les entrées par nom
+void dir_listing_sort(DirListing *listing) {
+    if (listing->count > 1) {
+        qsort(listing->entries, listing->count, sizeof(DirEntry), compare_entries);
+    }
+}
+
+static void path_buffer_reserve(PathBuffer *path, size_t needed) {
+    if (needed <= path->capacity) {
+        return;
+    }
+    size_t capacity = path->capacity ? path->capacity : 256;
+    while (capacity < needed) capacity *= 2;
+    char *grown = realloc(path->buf, capacity);
+    if (!grown) {
+        perror("Erreur d'allocation mémoire pour un chemin");
+        exit(EXIT_FAILURE);
+    }
+    path->buf = grown;
+    path->capacity = capacity;
+}
+
+// Fonction pour initialiser un chemin de parcours à partir de sa racine
+int path_buffer_init(PathBuffer *path, const char *root) {
+    path->buf = NULL;
+    path->capacity = 0;
+    path->len = strlen(root);
+    path_buffer_reserve(path, path->len + 1);
+    memcpy(path->buf, root, path->len + 1);
+    return 0;
+}
+
+// Fonction pour ajouter un composant au chemin
+size_t path_buffer_push(PathBuffer *path, const char *name) {
+    size_t previous = path->len;
+    size_t name_len = strlen(name);
+    path_buffer_reserve(path, previous + name_len + 2);
+    path->buf[previous] = '/';
+    memcpy(path->buf + previous + 1, name, name_len + 1);
+    path->len = previous + 1 + name_len;
+    return previous;
+}
+
+// Fonction pour revenir à une longueur précédente du chemin
+void path_buffer_pop(PathBuffer *path, size_t len) {
+    path->len = len;
+    path->buf[len] = '\0';
+}
+
+// Fonction pour libérer un chemin de parcours
+void path_buffer_free(PathBuffer *path) {
+    free(path->buf);
+    path->buf = NULL;
+    path->len = path->capacity = 0;
+}
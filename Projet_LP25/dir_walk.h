@@ -0,0 +1,62 @@
+#ifndef DIR_WALK_H
+#define DIR_WALK_H
+
+#include <stddef.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+
+// Types d'entrée de getdents64, absents de <dirent.h> en mode POSIX strict
+#ifndef DT_UNKNOWN
+#define DT_UNKNOWN 0
+#define DT_DIR 4
+#define DT_REG 8
+#define DT_LNK 10
+#endif
+
+// Entrée d'un répertoire, lue par lots avec getdents64
+typedef struct {
+    const char *name;
+    ino_t ino;
+    unsigned char type;       // DT_* ; DT_UNKNOWN si le système de fichiers ne le fournit pas
+} DirEntry;
+
+// Contenu d'un répertoire ; son descripteur reste ouvert pour les appels *at() sur ses entrées,
+// ce qui évite au noyau de résoudre à nouveau tout le chemin à chaque entrée
+typedef struct {
+    int fd;
+    DirEntry *entries;
+    int count;
+    char *names;              // Noms des entrées, bout à bout
+} DirListing;
+
+// Fonction pour lire le répertoire name relatif à parent_fd (AT_FDCWD pour un chemin ordinaire)
+// Sous un parent ouvert, un lien symbolique n'est pas suivi ; retourne 0 en cas de succès
+int dir_listing_open(int parent_fd, const char *name, DirListing *listing);
+// Fonction pour libérer un répertoire lu et fermer son descripteur
+void dir_listing_close(DirListing *listing);
+// Fonction pour lire les informations d'une entrée sans suivre les liens symboliques
+int dir_entry_stat(const DirListing *listing, const DirEntry *entry, struct stat *st);
+// Fonction pour savoir si une entrée est un répertoire (fstatat seulement si d_type est inconnu)
+int dir_entry_is_dir(const DirListing *listing, DirEntry *entry);
+// Fonction pour trier les entrées par nom (strcmp), pour comparer deux répertoires en un seul passage
+void dir_listing_sort(DirListing *listing);
+
+// Chemin complet d'un parcours, agrandi à la demande (pas de limite de profondeur)
+typedef struct {
+    char *buf;
+    size_t len;
+    size_t capacity;
+} PathBuffer;
+
+// Fonction pour initialiser un chemin de parcours à partir de sa racine
+int path_buffer_init(PathBuffer *path, const char *root);
+// Fonction pour ajouter un composant au chemin ; retourne la longueur à restaurer avec path_buffer_pop
+size_t path_buffer_push(PathBuffer *path, const char *name);
+// Fonction pour revenir à une longueur précédente du chemin
+void path_buffer_pop(PathBuffer *path, size_t len);
+// Fonction pour libérer un chemin de parcours
+void path_buffer_free(PathBuffer *path);
+
+#endif // DIR_WALK_H
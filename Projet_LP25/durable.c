@@ -0,0 +1,65 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <libgen.h>
+#include "durable.h"
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+// Fonction pour lancer, sans l'attendre, l'écriture sur disque d'un fichier de size octets
+void durable_start_writeback(int fd, off_t size) {
+    if (size >= DURABLE_WRITEBACK_MIN) {
+        sync_file_range(fd, 0, 0, SYNC_FILE_RANGE_WRITE);
+    }
+}
+
+// Fonction pour écrire sur disque tout le système de fichiers contenant path
+// Un seul syncfs remplace le fsync de chaque fichier, lien et répertoire de la sauvegarde
+int durable_sync_filesystem(const char *path) {
+    int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0 || syncfs(fd) != 0) {
+        perror("Erreur lors de l'écriture sur disque de la sauvegarde");
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    close(fd);
+    return 0;
+}
+
+// Fonction pour rendre durables les entrées (créations, renommages) du répertoire dir_path
+int durable_sync_dir(const char *dir_path) {
+    int fd = open(dir_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0 || fsync(fd) != 0) {
+        perror("Erreur lors de l'écriture sur disque du répertoire");
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    close(fd);
+    return 0;
+}
+
+// Fonction pour publier atomiquement tmp_path sous le nom final_path (même répertoire)
+int durable_publish(const char *tmp_path, const char *final_path) {
+    int fd = open(tmp_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0 || fsync(fd) != 0) {
+        perror("Erreur lors de l'écriture sur disque du fichier");
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    close(fd);
+
+    if (rename(tmp_path, final_path) != 0) {
+        perror("Erreur lors de la publication du fichier");
+        return -1;
+    }
+
+    char dir_path[PATH_MAX];
+    snprintf(dir_path, sizeof(dir_path), "%s", final_path);
+    return durable_sync_dir(dirname(dir_path));
+}
@@ -0,0 +1,21 @@
+#ifndef DURABLE_H
+#define DURABLE_H
+
+#include <sys/types.h>
+
+// Taille à partir de laquelle l'écriture d'un fichier copié est lancée dès la fin de sa copie
+// Les petits fichiers sont écrits ensemble par le syncfs final, en un seul passage
+#define DURABLE_WRITEBACK_MIN (1024 * 1024)
+
+// Fonction pour lancer, sans l'attendre, l'écriture sur disque d'un fichier de size octets
+void durable_start_writeback(int fd, off_t size);
+// Fonction pour écrire sur disque tout le système de fichiers contenant path ; retourne 0 en cas de succès
+int durable_sync_filesystem(const char *path);
+// Fonction pour rendre durables les entrées (créations, renommages) du répertoire dir_path
+int durable_sync_dir(const char *dir_path);
+// Fonction pour publier atomiquement tmp_path sous le nom final_path (même répertoire)
+// Le fichier est écrit sur disque avant le renommage, le répertoire après : après une coupure,
+// final_path contient l'ancienne ou la nouvelle version, jamais une version partielle
+int durable_publish(const char *tmp_path, const char *final_path);
+
+#endif // DURABLE_H
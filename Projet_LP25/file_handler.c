@@ -4,10 +4,101 @@
 #include <fcntl.h>
 #include <dirent.h>
 #include <time.h>
+#include <limits.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#include <openssl/evp.h>
 #include "file_handler.h"
 #include "deduplication.h"
+#include "metadata.h"
+#include "filter.h"
+#include "dir_walk.h"
+#include "read_scheduler.h"
+#include "cache_io.h"
+#include "durable.h"
+#include "throttle.h"
+#include "seal.h"
 
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+
+
+// Fonction permettant d'analyser une ligne du fichier .backup_log
+// Retourne un nouvel élément de log ou NULL si la ligne est invalide
+static log_element *parse_log_line(char *line) {
+    // Supprimer le saut de ligne final si présent
+    line[strcspn(line, "\n")] = 0;
+
+    // Analyse de la ligne au format :
+    // YYYY-MM-DD-hh:mm:ss.sss/path/to/file;mtime;md5[;size[;mode;uid;gid;mtime_ns;cible;lien;xattrs]]
+    // strsep (et non strtok) car les champs de métadonnées peuvent être vides
+    char *cursor = line;
+    char *backup_date = strsep(&cursor, "/");
+    char *path = strsep(&cursor, ";");
+    char *mtime_str = strsep(&cursor, ";");
+    char *md5_str = strsep(&cursor, ";");
+    char *size_str = strsep(&cursor, ";"); // Absent des logs écrits avant l'ajout de la taille
+
+    if (!backup_date || !path) {
+        fprintf(stderr, "Format invalide dans .backup_log\n");
+        return NULL;
+    }
+
+    if (!*path || !mtime_str || !md5_str) {
+        fprintf(stderr, "Données incomplètes dans une ligne du fichier .backup_log\n");
+        return NULL;
+    }
+
+    // Allouer un nouvel élément de log
+    log_element *new_element = (log_element *)malloc(sizeof(log_element));
+    if (!new_element) {
+        perror("Erreur d'allocation mémoire pour un élément de log");
+        return NULL;
+    }
+
+    // Remplir les champs de la structure log_element
+    new_element->path = strdup(path);
+    new_element->date = strdup(backup_date);
+    new_element->size = size_str ? (off_t)strtoll(size_str, NULL, 10) : -1;
+    new_element->mtime = 0;
+    new_element->next = NULL;
+    new_element->prev = NULL;
+
+    // Métadonnées (absentes des logs plus anciens : mode reste à 0)
+    parse_metadata_fields(&cursor, new_element);
+
+    // Convertir la date de modification (YYYY-MM-DD-hh:mm:ss, heure locale)
+    struct tm mod_time = {0};
+    if (new_element->mode == 0 && sscanf(mtime_str, "%d-%d-%d-%d:%d:%d", &mod_time.tm_year, &mod_time.tm_mon, &mod_time.tm_mday,
+               &mod_time.tm_hour, &mod_time.tm_min, &mod_time.tm_sec) == 6) {
+        mod_time.tm_year -= 1900;
+        mod_time.tm_mon -= 1;
+        mod_time.tm_isdst = -1;
+        new_element->mtime = mktime(&mod_time);
+    }
 
+    // Convertir md5_str en tableau de MD5_DIGEST_LENGTH octets
+    for (int i = 0; i < MD5_DIGEST_LENGTH; i++) {
+        sscanf(&md5_str[i * 2], "%2hhx", &new_element->md5[i]);
+    }
+
+    return new_element;
+}
+
+// Fonction pour ajouter un élément à la fin de la liste chaînée
+static void append_log_element(log_t *logs, log_element *new_element) {
+    if (!logs->head) {
+        logs->head = logs->tail = new_element;
+    } else {
+        logs->tail->next = new_element;
+        new_element->prev = logs->tail;
+        logs->tail = new_element;
+    }
+}
 
 // Fonction permettant de lire un élément du fichier .backup_log
 log_t read_backup_log(const char *logfile) {
@@ -19,58 +110,168 @@ log_t read_backup_log(const char *logfile) {
         return logs;
     }
 
-    char line[512]; // Buffer pour lire les lignes du fichier
+    char line[BACKUP_LOG_LINE_MAX]; // Buffer pour lire les lignes du fichier
     while (fgets(line, sizeof(line), file)) {
-        // Supprimer le saut de ligne final si présent
-        line[strcspn(line, "\n")] = 0;
-
-        // Allouer un nouvel élément de log
-        log_element *new_element = (log_element *)malloc(sizeof(log_element));
-        if (!new_element) {
-            perror("Erreur d'allocation mémoire pour un élément de log");
-            fclose(file);
-            return logs;
+        log_element *new_element = parse_log_line(line);
+        if (new_element) {
+            append_log_element(&logs, new_element);
         }
+    }
 
-        // Analyse de la ligne au format : YYYY-MM-DD-hh:mm:ss.sss/path/to/file;mtime;md5
-        char *backup_date = strtok(line, "/");
-        char *path_and_metadata = strtok(NULL, "");
+    fclose(file);
+    return logs;
+}
 
-        if (!backup_date || !path_and_metadata) {
-            fprintf(stderr, "Format invalide dans .backup_log\n");
-            free(new_element);
-            continue;
-        }
+// Fonction pour localiser le chemin d'une ligne du log (entre le premier '/' et le premier ';')
+static const char *log_line_path(const char *line, size_t *len) {
+    const char *path = strchr(line, '/');
+    path = path ? path + 1 : line;
+    *len = strcspn(path, ";\n");
+    return path;
+}
 
-        // Extraire le chemin, mtime et MD5
-        char *path = strtok(path_and_metadata, ";");
-        char *mtime_str = strtok(NULL, ";");
-        char *md5_str = strtok(NULL, ";");
+// Compare un chemin de longueur len à une chaîne terminée par '\0'
+static int compare_path_span(const char *path, size_t len, const char *other) {
+    size_t other_len = strlen(other);
+    int cmp = strncmp(path, other, len < other_len ? len : other_len);
+    if (cmp != 0) return cmp;
+    return (len > other_len) - (len < other_len);
+}
 
-        if (!path || !mtime_str || !md5_str) {
-            fprintf(stderr, "Données incomplètes dans une ligne du fichier .backup_log\n");
-            free(new_element);
-            continue;
+static int compare_log_lines(const void *a, const void *b) {
+    size_t len_a, len_b;
+    const char *path_a = log_line_path(*(char *const *)a, &len_a);
+    const char *path_b = log_line_path(*(char *const *)b, &len_b);
+    int cmp = strncmp(path_a, path_b, len_a < len_b ? len_a : len_b);
+    if (cmp != 0) return cmp;
+    return (len_a > len_b) - (len_a < len_b);
+}
+
+// Fonction pour trier le log unsorted_log d'une sauvegarde par chemin et écrire son index
+// L'index (.backup_index) contient le chemin et l'offset d'une ligne sur BACKUP_INDEX_STRIDE
+// Le log trié est écrit dans BACKUP_LOG_PENDING, publié ensuite par durable_publish
+int index_backup_log(const char *snapshot_dir, const char *unsorted_log) {
+    char log_path[PATH_MAX], index_path[PATH_MAX];
+    snprintf(log_path, sizeof(log_path), "%s/%s", snapshot_dir, BACKUP_LOG_PENDING);
+    snprintf(index_path, sizeof(index_path), "%s/.backup_index", snapshot_dir);
+
+    FILE *file = fopen(unsorted_log, "r");
+    if (!file) {
+        perror("Erreur lors de l'ouverture du fichier .backup_log");
+        return -1;
+    }
+
+    // Charger toutes les lignes en mémoire
+    char **lines = NULL;
+    int count = 0, capacity = 0;
+    char line[BACKUP_LOG_LINE_MAX];
+    while (fgets(line, sizeof(line), file)) {
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 1024;
+            char **grown = realloc(lines, capacity * sizeof(char *));
+            if (!grown) {
+                perror("Erreur d'allocation mémoire pour le tri du log");
+                break;
+            }
+            lines = grown;
         }
+        lines[count++] = strdup(line);
+    }
+    fclose(file);
 
-        // Remplir les champs de la structure log_element
-        new_element->path = strdup(path);
-        new_element->date = strdup(backup_date);
-        new_element->next = NULL;
-        new_element->prev = NULL;
+    qsort(lines, count, sizeof(char *), compare_log_lines);
+
+    FILE *log_out = fopen(log_path, "w");
+    FILE *index_out = fopen(index_path, "w");
+    if (!log_out || !index_out) {
+        perror("Erreur lors de l'écriture du log trié");
+        if (log_out) fclose(log_out);
+        if (index_out) fclose(index_out);
+        for (int i = 0; i < count; i++) free(lines[i]);
+        free(lines);
+        return -1;
+    }
 
-        // Convertir md5_str en tableau de MD5_DIGEST_LENGTH octets
-        for (int i = 0; i < MD5_DIGEST_LENGTH; i++) {
-            sscanf(&md5_str[i * 2], "%2hhx", &new_element->md5[i]);
+    for (int i = 0; i < count; i++) {
+        if (i % BACKUP_INDEX_STRIDE == 0) {
+            size_t len;
+            const char *path = log_line_path(lines[i], &len);
+            fprintf(index_out, "%lld %.*s\n", (long long)ftello(log_out), (int)len, path);
         }
+        fputs(lines[i], log_out);
+        free(lines[i]);
+    }
+    free(lines);
+
+    fclose(log_out);
+    fclose(index_out);
+    return 0;
+}
+
+// Fonction pour trouver, grâce à l'index, l'offset à partir duquel lire les chemins >= prefix
+// Retourne -1 si la sauvegarde n'a pas d'index
+static long long find_index_offset(const char *snapshot_dir, const char *prefix) {
+    char index_path[PATH_MAX];
+    snprintf(index_path, sizeof(index_path), "%s/.backup_index", snapshot_dir);
+
+    FILE *index = fopen(index_path, "r");
+    if (!index) {
+        return -1;
+    }
+
+    // Les entrées de l'index sont triées : on garde la dernière dont le chemin est < prefix
+    // (getline : une ligne n'est jamais coupée, quelle que soit la longueur du chemin)
+    long long offset = 0;
+    char *line = NULL;
+    size_t capacity = 0;
+    while (getline(&line, &capacity, index) != -1) {
+        char *path = strchr(line, ' ');
+        if (!path) continue;
+        path++;
+        path[strcspn(path, "\n")] = 0;
+        if (strcmp(path, prefix) >= 0) break;
+        offset = strtoll(line, NULL, 10);
+    }
+
+    free(line);
+    fclose(index);
+    return offset;
+}
+
+// Fonction permettant de lire uniquement les éléments du log dont le chemin commence par prefix
+// Utilise l'index de la sauvegarde s'il existe, sinon parcourt tout le log
+log_t read_backup_log_prefix(const char *snapshot_dir, const char *prefix) {
+    log_t logs = {NULL, NULL};
+    char log_path[PATH_MAX];
+    snprintf(log_path, sizeof(log_path), "%s/.backup_log", snapshot_dir);
 
-        // Ajouter le nouvel élément à la liste chaînée
-        if (!logs.head) {
-            logs.head = logs.tail = new_element;
-        } else {
-            logs.tail->next = new_element;
-            new_element->prev = logs.tail;
-            logs.tail = new_element;
+    long long offset = find_index_offset(snapshot_dir, prefix);
+    int sorted = offset >= 0;
+    size_t prefix_len = strlen(prefix);
+
+    FILE *file = fopen(log_path, "r");
+    if (!file) {
+        perror("Erreur lors de l'ouverture du fichier .backup_log");
+        return logs;
+    }
+    if (sorted) {
+        fseeko(file, offset, SEEK_SET);
+    }
+
+    char line[BACKUP_LOG_LINE_MAX];
+    while (fgets(line, sizeof(line), file)) {
+        size_t len;
+        const char *path = log_line_path(line, &len);
+        int cmp = strncmp(path, prefix, len < prefix_len ? len : prefix_len);
+
+        if (cmp == 0 && len >= prefix_len) {
+            log_element *new_element = parse_log_line(line);
+            if (new_element) {
+                append_log_element(&logs, new_element);
+            }
+        } else if (sorted && compare_path_span(path, len, prefix) > 0) {
+            // Log trié : plus aucun chemin ne peut commencer par prefix
+            break;
         }
     }
 
@@ -78,41 +279,247 @@ log_t read_backup_log(const char *logfile) {
     return logs;
 }
 
+// Fonction permettant de libérer la liste chaînée lue par read_backup_log
+void free_backup_log(log_t *logs) {
+    log_element *current = logs->head;
+    while (current) {
+        log_element *next = current->next;
+        free((char *)current->path);
+        free(current->date);
+        free_file_metadata(current);
+        free(current);
+        current = next;
+    }
+    logs->head = logs->tail = NULL;
+}
+
+static int compare_log_paths(const void *a, const void *b) {
+    const log_element *ea = *(const log_element **)a;
+    const log_element *eb = *(const log_element **)b;
+    return strcmp(ea->path, eb->path);
+}
+
+// Fonction permettant d'obtenir les éléments du log triés par chemin
+// Retourne un tableau de pointeurs vers les éléments de la liste (à libérer avec free)
+log_element **sort_backup_log(log_t *logs, int *count) {
+    *count = 0;
+    for (log_element *cur = logs->head; cur; cur = cur->next) {
+        (*count)++;
+    }
 
+    log_element **sorted = malloc((*count + 1) * sizeof(log_element *));
+    if (!sorted) {
+        perror("Erreur d'allocation mémoire pour le tri du log");
+        *count = 0;
+        return NULL;
+    }
 
+    int i = 0;
+    int already_sorted = 1;
+    for (log_element *cur = logs->head; cur; cur = cur->next, i++) {
+        sorted[i] = cur;
+        if (i > 0 && strcmp(sorted[i - 1]->path, cur->path) > 0) {
+            already_sorted = 0;
+        }
+    }
 
+    // Un log déjà trié n'a pas besoin d'être retrié
+    if (!already_sorted) {
+        qsort(sorted, *count, sizeof(log_element *), compare_log_paths);
+    }
+    return sorted;
+}
 
-int file_md5(const char *file_path, unsigned char *md5_result) {
-    FILE *file = fopen(file_path, "rb");
-    if (!file) {
+
+
+
+
+// Fonction pour calculer le MD5 des données en clair d'un fichier (déchiffrées s'il est stocké chiffré)
+// size reçoit la taille de ces données si elle n'est pas NULL
+static int plain_file_md5(const char *file_path, unsigned char *md5_result, off_t *size) {
+    SealReader reader;
+    if (seal_reader_open(&reader, file_path, 0, -1) != 0) {
         perror("Erreur lors de l'ouverture du fichier pour MD5");
         return 1;
     }
 
-    MD5_CTX md5_context;
-    MD5_Init(&md5_context);
+    EVP_MD_CTX *md5_context = EVP_MD_CTX_new();
+    if (!md5_context || EVP_DigestInit_ex(md5_context, EVP_md5(), NULL) != 1) {
+        fprintf(stderr, "Erreur lors de l'initialisation du calcul du MD5\n");
+        EVP_MD_CTX_free(md5_context);
+        seal_reader_close(&reader);
+        return 1;
+    }
+
+    // Lecture par le lecteur de cache (--cache-mode) pour ne pas évincer les données des autres processus
+    const unsigned char *data;
+    ssize_t bytes_read;
+    off_t offset = 0;
+    while ((bytes_read = seal_reader_pread(&reader, offset, CACHE_IO_BUFFER_SIZE / 2, &data)) > 0) {
+        EVP_DigestUpdate(md5_context, data, bytes_read);
+        offset += bytes_read;
+    }
 
-    unsigned char buffer[4096];
-    size_t bytes_read;
-    while ((bytes_read = fread(buffer, 1, sizeof(buffer), file)) != 0) {
-        MD5_Update(&md5_context, buffer, bytes_read);
+    EVP_DigestFinal_ex(md5_context, md5_result, NULL);
+    EVP_MD_CTX_free(md5_context);
+    if (size) {
+        *size = reader.size;
     }
+    seal_reader_close(&reader);
+    return bytes_read < 0 ? 1 : 0;
+}
 
-    MD5_Final(md5_result, &md5_context);
-    fclose(file);
+// MD5 des données en clair des copies chiffrées de cette exécution, calculés pendant leur chiffrement :
+// le log de la sauvegarde les reprend au lieu de déchiffrer chaque copie. Une entrée n'est reprise
+// que pour l'inode, la taille stockée et la date de modification de la copie qu'elle décrit
+typedef struct {
+    dev_t dev;
+    ino_t ino;
+    off_t stored_size;
+    struct timespec mtime;
+    off_t size;               // Taille en clair
+    unsigned char md5[MD5_DIGEST_LENGTH];
+    int used;
+} SealedDigest;
+
+static SealedDigest *sealed_digests = NULL;
+static size_t sealed_digest_capacity = 0;
+static size_t sealed_digest_count = 0;
+static pthread_mutex_t sealed_digest_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static size_t sealed_digest_slot(const SealedDigest *table, size_t capacity, dev_t dev, ino_t ino) {
+    size_t slot = ((size_t)dev * 31 + (size_t)ino) % capacity;
+    while (table[slot].used && (table[slot].dev != dev || table[slot].ino != ino)) {
+        slot = (slot + 1) % capacity;
+    }
+    return slot;
+}
+
+// Fonction pour retenir le MD5 des size octets en clair de la copie chiffrée décrite par st
+static void remember_sealed_digest(const struct stat *st, off_t size, const unsigned char *md5) {
+    pthread_mutex_lock(&sealed_digest_lock);
+    // Agrandir la table au-delà de 70 % de remplissage
+    if ((sealed_digest_count + 1) * 10 > sealed_digest_capacity * 7) {
+        size_t capacity = sealed_digest_capacity ? sealed_digest_capacity * 2 : 1024;
+        SealedDigest *grown = calloc(capacity, sizeof(SealedDigest));
+        if (!grown) {
+            pthread_mutex_unlock(&sealed_digest_lock);
+            return;
+        }
+        for (size_t i = 0; i < sealed_digest_capacity; i++) {
+            if (sealed_digests[i].used) {
+                const SealedDigest *entry = &sealed_digests[i];
+                grown[sealed_digest_slot(grown, capacity, entry->dev, entry->ino)] = *entry;
+            }
+        }
+        free(sealed_digests);
+        sealed_digests = grown;
+        sealed_digest_capacity = capacity;
+    }
+
+    SealedDigest *entry = &sealed_digests[sealed_digest_slot(sealed_digests, sealed_digest_capacity, st->st_dev, st->st_ino)];
+    if (!entry->used) {
+        sealed_digest_count++;
+    }
+    entry->dev = st->st_dev;
+    entry->ino = st->st_ino;
+    entry->stored_size = st->st_size;
+    entry->mtime = st->st_mtim;
+    entry->size = size;
+    memcpy(entry->md5, md5, MD5_DIGEST_LENGTH);
+    entry->used = 1;
+    pthread_mutex_unlock(&sealed_digest_lock);
+}
+
+// Fonction pour retrouver le MD5 retenu pour la copie chiffrée décrite par st ; retourne -1 s'il est inconnu
+static int find_sealed_digest(const struct stat *st, unsigned char *md5, off_t *size) {
+    int result = -1;
+    pthread_mutex_lock(&sealed_digest_lock);
+    if (sealed_digest_capacity > 0) {
+        const SealedDigest *entry = &sealed_digests[sealed_digest_slot(sealed_digests, sealed_digest_capacity,
+                                                                       st->st_dev, st->st_ino)];
+        if (entry->used && entry->stored_size == st->st_size && entry->mtime.tv_sec == st->st_mtim.tv_sec &&
+            entry->mtime.tv_nsec == st->st_mtim.tv_nsec) {
+            memcpy(md5, entry->md5, MD5_DIGEST_LENGTH);
+            *size = entry->size;
+            result = 0;
+        }
+    }
+    pthread_mutex_unlock(&sealed_digest_lock);
+    return result;
+}
+
+int file_md5(const char *file_path, unsigned char *md5_result) {
+    return plain_file_md5(file_path, md5_result, NULL);
+}
+
+// Fonction pour calculer le MD5 d'un fichier stocké dans une sauvegarde
+// Les empreintes de ses chunks sont calculées pendant la même lecture (sur plusieurs cœurs pour un
+// gros fichier) et enregistrées dans sa recette, qui permet à la sauvegarde suivante de reconnaître
+// un ajout en fin de fichier sans relire cette copie ; une copie qui a déjà sa recette (lien dur
+// vers une sauvegarde précédente) n'est pas relue. Une copie chiffrée n'a pas de recette : les
+// empreintes de ses chunks en clair ne sont pas écrites dans le répertoire de sauvegarde
+static int stored_file_md5(const char *file_path, const struct stat *st, unsigned char *md5_result, off_t *size) {
+    // Une copie chiffrée pendant cette sauvegarde a été hachée en même temps
+    if (seal_enabled() && find_sealed_digest(st, md5_result, size) == 0) {
+        return 0;
+    }
+    if (st->st_size < RECIPE_MIN_SIZE || seal_enabled()) {
+        return plain_file_md5(file_path, md5_result, size);
+    }
+    // Une copie déjà décrite par sa recette (même taille et même date de modification) reprend
+    // le MD5 qui y est enregistré sans être relue
+    FileRecipe recipe;
+    if (read_file_recipe(st, &recipe) == 0) {
+        memcpy(md5_result, recipe.md5, MD5_DIGEST_LENGTH);
+        *size = recipe.size;
+        free_file_recipe(&recipe);
+        return 0;
+    }
+    int fd = open(file_path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) {
+        return plain_file_md5(file_path, md5_result, size);
+    }
+
+    // La recette est écrite au fil de la lecture ; sans recette (ou avec une recette périmée de
+    // cet inode), le MD5 est calculé par une lecture simple
+    if (seal_is_sealed(fd, 0, -1) || create_file_recipe(st, &recipe) != 0) {
+        close(fd);
+        remove_file_recipe(st);
+        return plain_file_md5(file_path, md5_result, size);
+    }
+    int result = deduplicate_file(fd, st->st_size, &recipe);
+    close(fd);
+    if (result < 0) {
+        free_file_recipe(&recipe);
+        remove_file_recipe(st);
+        return plain_file_md5(file_path, md5_result, size);
+    }
+
+    memcpy(md5_result, recipe.md5, MD5_DIGEST_LENGTH);
+    *size = recipe.size;
+    if (write_file_recipe(st, &recipe) != 0) {
+        remove_file_recipe(st);
+    }
+    free_file_recipe(&recipe);
     return 0;
 }
 
 // Fonction pour récupérer les informations d'un fichier et remplir un log_element
+// Les liens symboliques ne sont pas suivis : leur MD5 et leur taille sont ceux de leur cible (texte)
 int create_log_element_from_file(const char *file_path, log_element *element) {
     struct stat file_stat;
 
     // Récupérer les métadonnées du fichier
-    if (stat(file_path, &file_stat) != 0) {
+    if (lstat(file_path, &file_stat) != 0) {
         perror("Erreur lors de la récupération des métadonnées du fichier");
         return 1;
     }
 
+    if (read_file_metadata(file_path, &file_stat, element) != 0) {
+        return 1;
+    }
+
     // Remplir le champ path
     element->path = strdup(file_path);
 
@@ -121,17 +528,29 @@ int create_log_element_from_file(const char *file_path, log_element *element) {
     struct tm *mod_time = localtime(&file_stat.st_mtime);
     if (!mod_time) {
         perror("Erreur lors de la conversion de la date");
-        free(element->path);
+        free((char *)element->path);
+        free_file_metadata(element);
         return 1;
     }
     strftime(date_buffer, sizeof(date_buffer), "%Y-%m-%d-%H:%M:%S", mod_time);
     element->date = strdup(date_buffer);
+    element->size = file_stat.st_size;
 
     // Calculer le MD5
-    if (file_md5(file_path, element->md5) != 0) {
+    int md5_error = 0;
+    if (S_ISLNK(file_stat.st_mode)) {
+        compute_md5(element->link_target, strlen(element->link_target), element->md5);
+    } else if (S_ISREG(file_stat.st_mode)) {
+        // Taille en clair pour une copie stockée chiffrée
+        md5_error = stored_file_md5(file_path, &file_stat, element->md5, &element->size);
+    } else {
+        md5_error = plain_file_md5(file_path, element->md5, NULL);
+    }
+    if (md5_error != 0) {
         fprintf(stderr, "Erreur lors du calcul du MD5\n");
-        free(element->path);
+        free((char *)element->path);
         free(element->date);
+        free_file_metadata(element);
         return 1;
     }
 
@@ -195,6 +614,12 @@ void write_log_element(log_element *elt, FILE *logfile, const char *backup_log)
         fprintf(logfile, "%02x", elt->md5[i]);
     }
 
+    // Écrire la taille du fichier
+    fprintf(logfile, ";%lld", (long long)elt->size);
+
+    // Écrire les métadonnées (mode, propriétaire, dates, lien, attributs étendus)
+    write_metadata_fields(logfile, elt);
+
     // Ajouter une nouvelle ligne
     fprintf(logfile, "\n");
 }
@@ -207,50 +632,64 @@ void write_log_element(log_element *elt, FILE *logfile, const char *backup_log)
 #endif
 
 
-// Fonction pour calculer récursivement la taille d'un dossier
-off_t calculate_folder_size(const char *folder_path) {
-    struct dirent *entry;
-    struct stat file_stat;
-    DIR *dp = opendir(folder_path);
+// Fonction pour créer un répertoire et tous ses parents manquants
+int make_parent_dirs(const char *dir) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s", dir);
+
+    for (char *p = path + 1; ; p++) {
+        if (*p == '/' || *p == '\0') {
+            char saved = *p;
+            *p = '\0';
+            if (mkdir(path, 0755) == -1 && errno != EEXIST) {
+                return -1;
+            }
+            *p = saved;
+            if (saved == '\0') break;
+        }
+    }
+    return 0;
+}
 
-    if (!dp) {
+// Fonction récursive de calcul de la taille du dossier name, relatif au descripteur parent_fd
+static off_t folder_size_at(int parent_fd, const char *name) {
+    DirListing listing;
+    if (dir_listing_open(parent_fd, name, &listing) != 0) {
         perror("Erreur lors de l'ouverture du répertoire");
         return 0;
     }
 
     off_t total_size = 0;
-
-    while ((entry = readdir(dp)) != NULL) {
-        // Ignorer les entrées spéciales "." et ".."
-        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
-            continue;
-
-        // Construire le chemin complet pour chaque élément
-        char full_path[512];
-        snprintf(full_path, sizeof(full_path), "%s/%s", folder_path, entry->d_name);
-
-        // Récupérer les informations sur l'élément
-        if (stat(full_path, &file_stat) == 0) {
-            if (S_ISDIR(file_stat.st_mode)) {
-                // Si c'est un répertoire, appeler récursivement la fonction
-                total_size += calculate_folder_size(full_path);
-            } else if (S_ISREG(file_stat.st_mode)) {
-                // Si c'est un fichier, ajouter sa taille
-                total_size += file_stat.st_size;
+    for (int i = 0; i < listing.count; i++) {
+        DirEntry *entry = &listing.entries[i];
+
+        if (dir_entry_is_dir(&listing, entry)) {
+            // Si c'est un répertoire, appeler récursivement la fonction
+            total_size += folder_size_at(listing.fd, entry->name);
+        } else if (entry->type == DT_REG || entry->type == DT_UNKNOWN) {
+            // Si c'est un fichier, ajouter sa taille réellement allouée (fichiers creux)
+            struct stat file_stat;
+            if (dir_entry_stat(&listing, entry, &file_stat) == 0 && S_ISREG(file_stat.st_mode)) {
+                off_t allocated = (off_t)file_stat.st_blocks * 512;
+                total_size += allocated < file_stat.st_size ? allocated : file_stat.st_size;
             }
         }
     }
 
-    closedir(dp);
+    dir_listing_close(&listing);
     return total_size;
 }
 
+// Fonction pour calculer récursivement la taille d'un dossier
+off_t calculate_folder_size(const char *folder_path) {
+    return folder_size_at(AT_FDCWD, folder_path);
+}
+
 BackupInfo *find_backup_logs(const char *directory, int *count) {
-    struct dirent *entry;
-    struct stat file_stat, log_stat;
-    DIR *dp = opendir(directory);
+    struct stat log_stat;
+    DirListing listing;
 
-    if (!dp) {
+    if (dir_listing_open(AT_FDCWD, directory, &listing) != 0) {
         perror("Erreur lors de l'ouverture du répertoire");
         return NULL;
     }
@@ -258,39 +697,33 @@ BackupInfo *find_backup_logs(const char *directory, int *count) {
     BackupInfo *results = NULL;
     *count = 0;
 
-    while ((entry = readdir(dp)) != NULL) {
-        // Ignorer les entrées spéciales "." et ".."
-        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
-            continue;
-
-        // Construire le chemin complet pour chaque élément
-        char full_path[512];
-        snprintf(full_path, sizeof(full_path), "%s/%s", directory, entry->d_name);
+    for (int i = 0; i < listing.count; i++) {
+        DirEntry *entry = &listing.entries[i];
 
         // Vérifier si c'est un répertoire
-        if (stat(full_path, &file_stat) == 0 && S_ISDIR(file_stat.st_mode)) {
-            // Construire le chemin vers le fichier `.backup_log`
-            char log_path[512];
-            snprintf(log_path, sizeof(log_path), "%s/.backup_log", full_path);
+        if (!dir_entry_is_dir(&listing, entry)) {
+            continue;
+        }
 
-            // Vérifier si le fichier `.backup_log` existe
-            if (stat(log_path, &log_stat) == 0 && S_ISREG(log_stat.st_mode)) {
-                // Allouer de la mémoire pour stocker les résultats
-                results = realloc(results, (*count + 1) * sizeof(BackupInfo));
+        // Vérifier si le fichier `.backup_log` existe, relativement au répertoire ouvert
+        char log_name[PATH_MAX];
+        snprintf(log_name, sizeof(log_name), "%s/.backup_log", entry->name);
+        if (fstatat(listing.fd, log_name, &log_stat, AT_SYMLINK_NOFOLLOW) == 0 && S_ISREG(log_stat.st_mode)) {
+            // Allouer de la mémoire pour stocker les résultats
+            results = realloc(results, (*count + 1) * sizeof(BackupInfo));
 
-                // Remplir les informations sur le dossier et le fichier
-                strncpy(results[*count].folder_name, entry->d_name, sizeof(results[*count].folder_name) - 1);
-                results[*count].creation_time = log_stat.st_ctime;
+            // Remplir les informations sur le dossier et le fichier
+            snprintf(results[*count].folder_name, sizeof(results[*count].folder_name), "%s", entry->name);
+            results[*count].creation_time = log_stat.st_ctime;
 
-                // Calculer la taille totale du dossier
-                results[*count].folder_size = calculate_folder_size(full_path);
+            // Calculer la taille totale du dossier
+            results[*count].folder_size = folder_size_at(listing.fd, entry->name);
 
-                (*count)++;
-            }
+            (*count)++;
         }
     }
 
-    closedir(dp);
+    dir_listing_close(&listing);
     return results;
 }
 
@@ -314,78 +747,246 @@ void print_backup_info(BackupInfo *infos, int count) {
 void copy_file(const char *src, const char *dest);
 
 // Fonction pour copier un fichier
+// Les trous des fichiers creux sont conservés, ainsi que permissions, propriétaire,
+// attributs étendus et dates de modification
 void copy_single_file(const char *src_file, const char *dest_file) {
-    FILE *src_fp = fopen(src_file, "rb");
-    if (!src_fp) {
+    int src_fd = open(src_file, O_RDONLY | O_NOFOLLOW);
+    struct stat src_stat;
+    if (src_fd < 0 || fstat(src_fd, &src_stat) != 0) {
         perror("Error opening source file");
+        if (src_fd >= 0) close(src_fd);
         return;
     }
 
-    FILE *dest_fp = fopen(dest_file, "wb");
-    if (!dest_fp) {
+    // Supprimer la destination plutôt que l'écraser : elle peut être un lien dur
+    // partagé avec une sauvegarde précédente
+    unlink(dest_file);
+    int dest_fd = open(dest_file, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (dest_fd < 0) {
         perror("Error opening destination file");
-        fclose(src_fp);
+        close(src_fd);
         return;
     }
-    char buffer[1024];
-    size_t bytes;
-    while ((bytes = fread(buffer, 1, sizeof(buffer), src_fp)) > 0) {
-        fwrite(buffer, 1, bytes, dest_fp);
+
+    // Avec --encrypt-key, la copie est chiffrée segment par segment et hachée pendant la même lecture
+    unsigned char md5[MD5_DIGEST_LENGTH];
+    int copied = seal_enabled() ? seal_copy(src_fd, dest_fd, 0, src_stat.st_size, md5)
+                                : copy_sparse(src_fd, dest_fd, src_stat.st_size);
+    if (copied != 0) {
+        perror("Error copying file data");
+    }
+    copy_fd_metadata(src_fd, dest_fd, &src_stat);
+    // Le MD5 n'est retenu que pour une copie complète (la source a pu raccourcir pendant la copie)
+    struct stat dest_stat;
+    if (seal_enabled() && copied == 0 && fstat(dest_fd, &dest_stat) == 0 &&
+        dest_stat.st_size == seal_stored_size(src_stat.st_size)) {
+        remember_sealed_digest(&dest_stat, src_stat.st_size, md5);
     }
+    // Les gros fichiers partent sur disque pendant la suite de la sauvegarde
+    durable_start_writeback(dest_fd, seal_enabled() ? seal_stored_size(src_stat.st_size) : src_stat.st_size);
 
-    fclose(src_fp);
-    fclose(dest_fp);
+    close(src_fd);
+    close(dest_fd);
 }
 
-// Fonction pour copier un dossier et son contenu
-void copy_directory(const char *src, const char *dest) {
-    DIR *dir = opendir(src);
-    if (!dir) {
+// Fonction pour savoir si les blocs [offset, offset + len) de la source et de sa copie précédente sont identiques
+// La copie précédente est lue en clair (déchiffrée si elle est stockée chiffrée)
+static int ranges_equal(int src_fd, SealReader *prev, off_t offset, size_t len, unsigned char *buf1, unsigned char *buf2) {
+    ssize_t read1 = pread(src_fd, buf1, len, offset);
+    ssize_t read2 = seal_reader_read(prev, buf2, len, offset);
+    if (read1 > 0) {
+        throttle_consume(THROTTLE_READ, read1);
+    }
+    return read1 == (ssize_t)len && read2 == (ssize_t)len && memcmp(buf1, buf2, len) == 0;
+}
+
+// Fonction pour reconnaître un fichier qui n'a fait que grandir depuis sa copie précédente
+// Tout l'ancien contenu est vérifié : le début de la source est comparé à la recette de la copie
+// précédente (enregistrée lors de la sauvegarde qui l'a écrite, sans relire cette copie) ou, si elle
+// n'en a pas (copie chiffrée, sauvegarde plus ancienne), directement à la copie précédente
+static int is_pure_append(int src_fd, const struct stat *prev_stat, SealReader *prev) {
+    off_t prev_size = prev->size;
+    FileRecipe stored;
+    if (!seal_enabled() && read_file_recipe(prev_stat, &stored) == 0) {
+        // La recette relue est comparée bloc par bloc à celle du début de la source
+        int append = deduplicate_file(src_fd, prev_size, &stored) >= 0;
+        free_file_recipe(&stored);
+        return append;
+    }
+
+    unsigned char *buf1 = malloc(APPEND_CHECK_SIZE), *buf2 = malloc(APPEND_CHECK_SIZE);
+    int append = buf1 && buf2;
+    for (off_t offset = 0; append && offset < prev_size; offset += APPEND_CHECK_SIZE) {
+        size_t len = (prev_size - offset < APPEND_CHECK_SIZE) ? (size_t)(prev_size - offset) : APPEND_CHECK_SIZE;
+        append = ranges_equal(src_fd, prev, offset, len, buf1, buf2);
+    }
+    free(buf1);
+    free(buf2);
+    return append;
+}
+
+// Fonction pour reprendre dans dest_fd l'ancien contenu de la copie précédente puis y ajouter la fin de la source
+// Une copie chiffrée est reprise jusqu'à son dernier segment complet, la suite est chiffrée depuis la source
+static int copy_appended_data(int src_fd, int prev_fd, int dest_fd, off_t prev_size, off_t src_size) {
+    if (!seal_enabled()) {
+        if (ioctl(dest_fd, FICLONE, prev_fd) != 0 && copy_sparse_range(prev_fd, dest_fd, 0, prev_size) != 0) {
+            return -1;
+        }
+        return copy_sparse_range(src_fd, dest_fd, prev_size, src_size);
+    }
+
+    off_t kept = prev_size / SEAL_SEGMENT_SIZE * SEAL_SEGMENT_SIZE;
+    off_t kept_stored = seal_stored_size(kept);
+    if (ioctl(dest_fd, FICLONE, prev_fd) == 0) {
+        if (ftruncate(dest_fd, kept_stored) != 0) {
+            return -1;
+        }
+    } else if (copy_sparse_range(prev_fd, dest_fd, 0, kept_stored) != 0) {
+        return -1;
+    }
+    return seal_copy(src_fd, dest_fd, kept, src_size, NULL);
+}
+
+// Fonction pour copier un fichier qui n'a fait que grandir depuis sa copie précédente (journaux, logs)
+// L'ancien contenu est repris de previous_file (cloné si le système de fichiers le permet) après
+// avoir vérifié le début de src_file, seule la fin ajoutée est copiée. previous_file peut être dest_file (lien dur vers la
+// sauvegarde précédente) : il n'est jamais modifié.
+// Retourne 0 si la copie est faite, -1 si ce n'est pas un simple ajout (la copie complète reste à faire)
+int copy_appended_file(const char *src_file, const char *previous_file, const char *dest_file) {
+    int src_fd = open(src_file, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    int prev_fd = src_fd >= 0 ? open(previous_file, O_RDONLY | O_NOFOLLOW | O_CLOEXEC) : -1;
+    struct stat src_stat, prev_stat;
+    SealReader prev;
+    int result = -1;
+
+    // La copie précédente doit être stockée comme la nouvelle (chiffrée avec --encrypt-key, en clair sinon)
+    if (prev_fd >= 0 && fstat(src_fd, &src_stat) == 0 && fstat(prev_fd, &prev_stat) == 0 &&
+        S_ISREG(src_stat.st_mode) && S_ISREG(prev_stat.st_mode) &&
+        seal_is_sealed(prev_fd, 0, -1) == seal_enabled() && seal_reader_attach(&prev, prev_fd, 0, -1) == 0) {
+        off_t prev_size = prev.size;
+        if (prev_size >= APPEND_MIN_SIZE && src_stat.st_size > prev_size && is_pure_append(src_fd, &prev_stat, &prev)) {
+            // previous_file reste lisible par son descripteur même si c'est le chemin remplacé
+            unlink(dest_file);
+            // Lecture et écriture : la suite d'une copie chiffrée reprend son en-tête
+            int dest_fd = open(dest_file, O_RDWR | O_CREAT | O_TRUNC, 0600);
+            if (dest_fd >= 0) {
+                result = copy_appended_data(src_fd, prev_fd, dest_fd, prev_size, src_stat.st_size);
+                if (result == 0) {
+                    copy_fd_metadata(src_fd, dest_fd, &src_stat);
+                    durable_start_writeback(dest_fd, src_stat.st_size);
+                    printf("Ajout en fin de fichier : %s (%lld octets copiés sur %lld)\n", src_file,
+                           (long long)(src_stat.st_size - prev_size), (long long)src_stat.st_size);
+                }
+                close(dest_fd);
+            }
+        }
+        seal_reader_close(&prev);
+    }
+
+    if (prev_fd >= 0) close(prev_fd);
+    if (src_fd >= 0) close(src_fd);
+    return result;
+}
+
+// Fonction pour copier un fichier planifié ; arg associe chaque inode source
+// déjà copié à son chemin de destination pour recréer les liens durs
+static void copy_scheduled_file(const ReadJob *job, void *arg) {
+    InodeMap *inodes = arg;
+    // Un fichier déjà copié sous un autre nom devient un lien dur vers cette copie
+    const char *first = job->st.st_nlink > 1 ? inode_map_find_or_add(inodes, &job->st, job->dest) : NULL;
+    if (first) {
+        unlink(job->dest);
+    }
+    if (!first || link(first, job->dest) != 0) {
+        copy_single_file(job->path, job->dest);
+    }
+}
+
+// Fonction récursive de copie d'un dossier
+// src et dest sont les chemins complets du parcours ; le dossier source est lu par son
+// descripteur (parent_fd, name) pour éviter de résoudre tout le chemin à chaque entrée
+// Les entrées exclues par les filtres de scope ne sont pas copiées (ni parcourues)
+// Les copies de fichiers passent par reads, qui les ordonne selon --read-order
+static void copy_directory_links(int parent_fd, const char *name, PathBuffer *src, PathBuffer *dest,
+                                 ReadScheduler *reads, const FilterScope *scope) {
+    DirListing listing;
+    if (dir_listing_open(parent_fd, name, &listing) != 0) {
         perror("Error opening source directory");
         return;
     }
 
     // Créer le répertoire de destination si nécessaire
-    if (mkdir(dest, 0755) == -1 && errno != EEXIST) {
+    if (mkdir(dest->buf, 0755) == -1 && errno != EEXIST) {
         perror("Error creating destination directory");
-        closedir(dir);
+        dir_listing_close(&listing);
         return;
     }
 
-    struct dirent *entry;
-    char src_path[1024], dest_path[1024];
+    for (int i = 0; i < listing.count; i++) {
+        DirEntry *entry = &listing.entries[i];
 
-    while ((entry = readdir(dir)) != NULL) {
-        // Ignorer les entrées "." et ".."
-        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+        struct stat statbuf;
+        if (dir_entry_stat(&listing, entry, &statbuf) == -1) {
+            perror("Error getting file info");
             continue;
         }
 
-        snprintf(src_path, sizeof(src_path), "%s/%s", src, entry->d_name);
-        snprintf(dest_path, sizeof(dest_path), "%s/%s", dest, entry->d_name);
-
-        struct stat statbuf;
-        if (stat(src_path, &statbuf) == -1) {
-            perror("Error getting file info");
+        if (filter_scope_excludes(scope, entry->name, S_ISDIR(statbuf.st_mode))) {
             continue;
         }
 
+        size_t src_len = path_buffer_push(src, entry->name);
+        size_t dest_len = path_buffer_push(dest, entry->name);
+
         if (S_ISDIR(statbuf.st_mode)) {
             // Si c'est un répertoire, appeler récursivement
-            copy_directory(src_path, dest_path);
+            FilterScope child;
+            filter_scope_enter(&child, scope, src->buf, entry->name);
+            copy_directory_links(listing.fd, entry->name, src, dest, reads, &child);
+            filter_scope_leave(&child);
+        } else if (S_ISLNK(statbuf.st_mode)) {
+            // Un lien symbolique est recréé tel quel, sans suivre sa cible
+            copy_symlink(src->buf, dest->buf);
         } else if (S_ISREG(statbuf.st_mode)) {
-            // Si c'est un fichier, copier le fichier
-            copy_single_file(src_path, dest_path);
+            read_scheduler_add(reads, src->buf, &statbuf, dest->buf);
         }
+        // Les fichiers spéciaux (périphériques, tubes, sockets) ne sont pas sauvegardés
+
+        path_buffer_pop(src, src_len);
+        path_buffer_pop(dest, dest_len);
+    }
+
+    // Les dates du dossier sont fixées après la copie de son contenu
+    struct stat dir_stat;
+    if (fstat(listing.fd, &dir_stat) == 0) {
+        read_scheduler_defer_dir(reads, src->buf, dest->buf, &dir_stat);
     }
+    dir_listing_close(&listing);
+}
 
-    closedir(dir);
+// Fonction pour copier un dossier et son contenu
+void copy_directory(const char *src, const char *dest) {
+    InodeMap inodes;
+    FilterScope scope;
+    PathBuffer src_path, dest_path;
+    ReadScheduler reads;
+    inode_map_init(&inodes);
+    read_scheduler_init(&reads, copy_scheduled_file, &inodes);
+    path_buffer_init(&src_path, src);
+    path_buffer_init(&dest_path, dest);
+    filter_scope_enter(&scope, NULL, src, NULL);
+    copy_directory_links(AT_FDCWD, src, &src_path, &dest_path, &reads, &scope);
+    filter_scope_leave(&scope);
+    read_scheduler_finish(&reads);
+    path_buffer_free(&src_path);
+    path_buffer_free(&dest_path);
+    inode_map_free(&inodes);
 }
 
 // Fonction principale pour copier un dossier source dans un dossier destination
 void copy_file(const char *src, const char *dest) {
     struct stat statbuf;
-    if (stat(src, &statbuf) == -1) {
+    if (lstat(src, &statbuf) == -1) {
         perror("Error getting source file/directory info");
         return;
     }
@@ -393,6 +994,9 @@ void copy_file(const char *src, const char *dest) {
     if (S_ISDIR(statbuf.st_mode)) {
         // Si c'est un répertoire, copier le répertoire
         copy_directory(src, dest);
+    } else if (S_ISLNK(statbuf.st_mode)) {
+        // Si c'est un lien symbolique, le recréer
+        copy_symlink(src, dest);
     } else if (S_ISREG(statbuf.st_mode)) {
         // Si c'est un fichier, copier le fichier
         copy_single_file(src, dest);
@@ -6,11 +6,39 @@
 #include <time.h>        // Pour time_t
 #include <sys/types.h>   // Pour off_t
 
+// Nombre de lignes du .backup_log entre deux entrées de son index (.backup_index)
+#define BACKUP_INDEX_STRIDE 64
+
+// Métadonnées des répertoires d'une sauvegarde par manifeste (dont l'arborescence est incomplète)
+#define BACKUP_DIRS ".backup_dirs"
+
+// Log trié d'une sauvegarde en cours : la sauvegarde n'existe qu'une fois renommé en .backup_log
+#define BACKUP_LOG_PENDING ".backup_log.tmp"
+
+// Taille minimale d'un fichier pour que seul son ajout en fin de fichier soit copié (1 Mo)
+#define APPEND_MIN_SIZE (1024 * 1024)
+
+// Taille des blocs de l'ancienne copie comparés à la source quand elle n'a pas de recette (64 Ko)
+#define APPEND_CHECK_SIZE (64 * 1024)
+
+// Longueur maximale d'une ligne du .backup_log (métadonnées et attributs étendus compris)
+#define BACKUP_LOG_LINE_MAX 8192
+
 // Structure pour une ligne du fichier log
 typedef struct log_element {
     const char *path; // Chemin du fichier/dossier
     unsigned char md5[MD5_DIGEST_LENGTH]; // MD5 du fichier dédupliqué
     char *date; // Date de dernière modification
+    off_t size; // Taille du fichier en octets (-1 si absente du log)
+    time_t mtime; // Date de dernière modification du fichier
+    long mtime_nsec; // Partie nanosecondes de mtime
+    mode_t mode; // Type et permissions (0 si absents du log)
+    uid_t uid; // Propriétaire
+    gid_t gid; // Groupe
+    char *link_target; // Cible d'un lien symbolique (NULL sinon)
+    char *hardlink; // Premier chemin de la sauvegarde partageant le même inode (NULL sinon)
+    char *xattrs; // Attributs étendus encodés "nom=hex,..." (NULL si aucun)
+    char *stored; // Sauvegarde contenant les données, si ce n'est pas celle du log (NULL sinon)
     struct log_element *next;
     struct log_element *prev;
 } log_element;
@@ -28,12 +56,18 @@ typedef struct {
 } BackupInfo;
 
 log_t read_backup_log(const char *logfile);
+void free_backup_log(log_t *logs);
+log_element **sort_backup_log(log_t *logs, int *count);
+int index_backup_log(const char *snapshot_dir, const char *unsorted_log);
+log_t read_backup_log_prefix(const char *snapshot_dir, const char *prefix);
 void update_backup_log(const char *logfile, log_t *logs);
 void write_log_element(log_element *elt, FILE *logfile, const char *backup_log);
 void list_files(const char *path);
 void copy_single_file(const char *src_file, const char *dest_file);
+int copy_appended_file(const char *src_file, const char *previous_file, const char *dest_file);
 void copy_directory(const char *src, const char *dest);
 void copy_file(const char *src, const char *dest);
+int make_parent_dirs(const char *dir);
 BackupInfo *find_backup_logs(const char *directory, int *count);
 void print_backup_info(BackupInfo *infos, int count);
 
@@ -0,0 +1,578 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "filter.h"
+
+// Nombre d'alvéoles des tables de noms et de suffixes
+#define FILTER_HASH_SIZE 256
+
+// Longueur maximale d'un suffixe indexé ("*.o", "*.tmp"...) ; au-delà le motif est un glob
+#define FILTER_MAX_SUFFIX 63
+
+// Éléments d'un glob compilé
+typedef enum {
+    TOKEN_LITERAL,   // Texte exact
+    TOKEN_ANY,       // ?  : un caractère autre que '/'
+    TOKEN_CLASS,     // [...] : un caractère d'un ensemble
+    TOKEN_STAR,      // *  : suite de caractères sans '/'
+    TOKEN_GLOBSTAR,  // ** : suite quelconque de caractères
+    TOKEN_GLOBDIR    // **/ : zéro ou plusieurs répertoires
+} TokenType;
+
+typedef struct {
+    TokenType type;
+    char *literal;
+    size_t len;
+    unsigned char set[32];    // Bitmap des caractères d'une classe
+    int negate;
+} GlobToken;
+
+typedef struct {
+    int include;              // 1 pour une règle d'inclusion (--include ou "!motif")
+    int dir_only;             // 1 si le motif se termine par '/'
+    int anchored;             // 1 si le motif contient un '/' : comparé au chemin relatif
+    GlobToken *tokens;
+    int token_count;
+} FilterRule;
+
+// Liste d'index de règles
+typedef struct {
+    int *items;
+    int count;
+} RuleList;
+
+typedef struct HashEntry {
+    char *key;
+    RuleList rules;
+    struct HashEntry *next;
+} HashEntry;
+
+// Nœud de l'arbre des chemins littéraux ancrés ("build/cache", "tmp")
+typedef struct TrieNode {
+    char *component;
+    struct TrieNode **children;
+    int child_count;
+    RuleList rules;
+} TrieNode;
+
+struct FilterSet {
+    FilterRule *rules;        // Règles dans l'ordre : la dernière qui correspond l'emporte
+    int count;
+    int capacity;
+    HashEntry *names[FILTER_HASH_SIZE];    // Noms littéraux non ancrés
+    HashEntry *suffixes[FILTER_HASH_SIZE]; // Motifs "*suffixe" non ancrés
+    uint64_t suffix_lengths;               // Longueurs de suffixes présentes dans la table
+    TrieNode root;                         // Chemins littéraux ancrés
+    RuleList globs;                        // Motifs généraux, évalués par le glob compilé
+    size_t base_len;                       // Longueur du chemin du répertoire de la règle
+};
+
+// Règles de la ligne de commande
+static FilterSet *global_rules = NULL;
+
+static unsigned int hash_string(const char *text, size_t len) {
+    unsigned int hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ (unsigned char)text[i]) * 16777619u;
+    }
+    return hash % FILTER_HASH_SIZE;
+}
+
+static void rule_list_add(RuleList *list, int index) {
+    int *grown = realloc(list->items, (list->count + 1) * sizeof(int));
+    if (!grown) {
+        perror("Erreur d'allocation mémoire pour les filtres");
+        return;
+    }
+    list->items = grown;
+    list->items[list->count++] = index;
+}
+
+static void hash_add(HashEntry **table, const char *key, int index) {
+    unsigned int bucket = hash_string(key, strlen(key));
+    HashEntry *entry = table[bucket];
+    while (entry && strcmp(entry->key, key) != 0) {
+        entry = entry->next;
+    }
+    if (!entry) {
+        entry = calloc(1, sizeof(HashEntry));
+        if (!entry) return;
+        entry->key = strdup(key);
+        entry->next = table[bucket];
+        table[bucket] = entry;
+    }
+    rule_list_add(&entry->rules, index);
+}
+
+static const RuleList *hash_find(HashEntry *const *table, const char *key, size_t len) {
+    for (HashEntry *entry = table[hash_string(key, len)]; entry; entry = entry->next) {
+        if (strncmp(entry->key, key, len) == 0 && entry->key[len] == '\0') {
+            return &entry->rules;
+        }
+    }
+    return NULL;
+}
+
+static TrieNode *trie_child(TrieNode *node, const char *component, size_t len, int create) {
+    for (int i = 0; i < node->child_count; i++) {
+        if (strncmp(node->children[i]->component, component, len) == 0 && node->children[i]->component[len] == '\0') {
+            return node->children[i];
+        }
+    }
+    if (!create) return NULL;
+
+    TrieNode **grown = realloc(node->children, (node->child_count + 1) * sizeof(TrieNode *));
+    TrieNode *child = calloc(1, sizeof(TrieNode));
+    if (!grown || !child) {
+        free(child);
+        if (grown) node->children = grown;
+        return NULL;
+    }
+    child->component = strndup(component, len);
+    node->children = grown;
+    node->children[node->child_count++] = child;
+    return child;
+}
+
+// Fonction pour compiler un motif glob en suite d'éléments
+static int compile_glob(const char *pattern, FilterRule *rule) {
+    size_t len = strlen(pattern);
+    rule->tokens = calloc(len + 1, sizeof(GlobToken));
+    rule->token_count = 0;
+    if (!rule->tokens) return -1;
+
+    const char *p = pattern;
+    while (*p) {
+        GlobToken *tok = &rule->tokens[rule->token_count++];
+        if (p[0] == '*' && p[1] == '*') {
+            p += 2;
+            while (*p == '*') p++;
+            if (*p == '/') {
+                tok->type = TOKEN_GLOBDIR;
+                p++;
+            } else {
+                tok->type = TOKEN_GLOBSTAR;
+            }
+        } else if (*p == '*') {
+            tok->type = TOKEN_STAR;
+            while (*p == '*') p++;
+        } else if (*p == '?') {
+            tok->type = TOKEN_ANY;
+            p++;
+        } else if (*p == '[' && strchr(p + 1, ']')) {
+            tok->type = TOKEN_CLASS;
+            p++;
+            if (*p == '!' || *p == '^') {
+                tok->negate = 1;
+                p++;
+            }
+            // Un ']' en première position fait partie de la classe
+            int first = 1;
+            while (*p && (*p != ']' || first)) {
+                unsigned char lo = (unsigned char)*p, hi = lo;
+                if (p[1] == '-' && p[2] && p[2] != ']') {
+                    hi = (unsigned char)p[2];
+                    p += 2;
+                }
+                for (unsigned int c = lo; c <= hi; c++) {
+                    tok->set[c / 8] |= 1 << (c % 8);
+                }
+                p++;
+                first = 0;
+            }
+            if (*p == ']') p++;
+        } else {
+            // Texte littéral jusqu'au prochain joker ('\' protège le caractère suivant)
+            tok->type = TOKEN_LITERAL;
+            tok->literal = malloc(strlen(p) + 1);
+            if (!tok->literal) return -1;
+            while (*p && !strchr("*?[", *p)) {
+                if (*p == '\\' && p[1]) p++;
+                tok->literal[tok->len++] = *p++;
+            }
+            if (tok->len == 0) {
+                // '[' sans ']' fermant : caractère littéral
+                tok->literal[tok->len++] = *p++;
+            }
+            tok->literal[tok->len] = '\0';
+        }
+    }
+    return 0;
+}
+
+// Fonction pour comparer un chemin à un glob compilé
+static int glob_match(const GlobToken *tok, int count, const char *text) {
+    for (; count > 0; tok++, count--) {
+        switch (tok->type) {
+            case TOKEN_LITERAL:
+                if (strncmp(text, tok->literal, tok->len) != 0) return 0;
+                text += tok->len;
+                break;
+            case TOKEN_ANY:
+                if (*text == '\0' || *text == '/') return 0;
+                text++;
+                break;
+            case TOKEN_CLASS: {
+                unsigned char c = (unsigned char)*text;
+                if (c == '\0' || c == '/') return 0;
+                int in_set = (tok->set[c / 8] >> (c % 8)) & 1;
+                if (in_set == tok->negate) return 0;
+                text++;
+                break;
+            }
+            case TOKEN_STAR:
+            case TOKEN_GLOBSTAR:
+                // Essayer toutes les longueurs possibles pour la suite du motif
+                for (const char *p = text; ; p++) {
+                    if (glob_match(tok + 1, count - 1, p)) return 1;
+                    if (*p == '\0' || (tok->type == TOKEN_STAR && *p == '/')) return 0;
+                }
+            case TOKEN_GLOBDIR:
+                // Zéro répertoire, puis après chaque '/'
+                if (glob_match(tok + 1, count - 1, text)) return 1;
+                for (const char *p = text; *p; p++) {
+                    if (*p == '/' && glob_match(tok + 1, count - 1, p + 1)) return 1;
+                }
+                return 0;
+        }
+    }
+    return *text == '\0';
+}
+
+static FilterSet *filter_set_new(size_t base_len) {
+    FilterSet *set = calloc(1, sizeof(FilterSet));
+    if (set) {
+        set->base_len = base_len;
+    }
+    return set;
+}
+
+static void free_trie(TrieNode *node) {
+    for (int i = 0; i < node->child_count; i++) {
+        free_trie(node->children[i]);
+        free(node->children[i]);
+    }
+    free(node->children);
+    free(node->component);
+    free(node->rules.items);
+}
+
+static void free_hash(HashEntry **table) {
+    for (int i = 0; i < FILTER_HASH_SIZE; i++) {
+        HashEntry *entry = table[i];
+        while (entry) {
+            HashEntry *next = entry->next;
+            free(entry->key);
+            free(entry->rules.items);
+            free(entry);
+            entry = next;
+        }
+    }
+}
+
+static void filter_set_free(FilterSet *set) {
+    if (!set) return;
+    for (int i = 0; i < set->count; i++) {
+        for (int j = 0; j < set->rules[i].token_count; j++) {
+            free(set->rules[i].tokens[j].literal);
+        }
+        free(set->rules[i].tokens);
+    }
+    free(set->rules);
+    free_hash(set->names);
+    free_hash(set->suffixes);
+    free_trie(&set->root);
+    free(set->globs.items);
+    free(set);
+}
+
+// Fonction pour compiler une règle et l'indexer selon sa forme
+static int filter_set_add(FilterSet *set, const char *text, int include) {
+    char pattern[PATH_MAX];
+    snprintf(pattern, sizeof(pattern), "%s", text);
+
+    if (pattern[0] == '!') {
+        include = !include;
+        memmove(pattern, pattern + 1, strlen(pattern));
+    }
+
+    FilterRule rule;
+    memset(&rule, 0, sizeof(rule));
+    rule.include = include;
+
+    size_t len = strlen(pattern);
+    while (len > 1 && pattern[len - 1] == '/') {
+        rule.dir_only = 1;
+        pattern[--len] = '\0';
+    }
+    char *body = pattern;
+    if (strchr(body, '/')) {
+        rule.anchored = 1;
+        while (*body == '/') body++;
+    }
+    if (*body == '\0') {
+        return -1;
+    }
+
+    if (set->count == set->capacity) {
+        set->capacity = set->capacity ? set->capacity * 2 : 16;
+        FilterRule *grown = realloc(set->rules, set->capacity * sizeof(FilterRule));
+        if (!grown) {
+            perror("Erreur d'allocation mémoire pour les filtres");
+            return -1;
+        }
+        set->rules = grown;
+    }
+
+    int index = set->count;
+    int has_wildcard = strpbrk(body, "*?[\\") != NULL;
+
+    if (!rule.anchored && !has_wildcard) {
+        // Nom exact à n'importe quelle profondeur : table de noms
+        hash_add(set->names, body, index);
+    } else if (!rule.anchored && body[0] == '*' && body[1] && !strpbrk(body + 1, "*?[\\") &&
+               strlen(body + 1) <= FILTER_MAX_SUFFIX) {
+        // "*suffixe" : table des suffixes, consultée pour les seules longueurs présentes
+        hash_add(set->suffixes, body + 1, index);
+        set->suffix_lengths |= (uint64_t)1 << strlen(body + 1);
+    } else if (rule.anchored && !has_wildcard) {
+        // Chemin exact depuis le répertoire de la règle : arbre des composants
+        TrieNode *node = &set->root;
+        for (const char *p = body; node && *p; ) {
+            size_t component_len = strcspn(p, "/");
+            if (component_len > 0) {
+                node = trie_child(node, p, component_len, 1);
+            }
+            p += component_len;
+            while (*p == '/') p++;
+        }
+        if (!node) return -1;
+        rule_list_add(&node->rules, index);
+    } else {
+        if (compile_glob(body, &rule) != 0) {
+            free(rule.tokens);
+            return -1;
+        }
+        rule_list_add(&set->globs, index);
+    }
+
+    set->rules[set->count++] = rule;
+    return 0;
+}
+
+// Fonction pour retenir la règle la plus récente d'une liste qui s'applique à l'entrée
+static void consider(const FilterSet *set, const RuleList *list, int is_dir, int *best) {
+    if (!list) return;
+    for (int i = 0; i < list->count; i++) {
+        int index = list->items[i];
+        if (set->rules[index].dir_only && !is_dir) continue;
+        if (index > *best) *best = index;
+    }
+}
+
+// Fonction pour évaluer un ensemble de règles
+// Retourne 1 si l'entrée est exclue, 0 si elle est incluse, -1 si aucune règle ne s'applique
+static int filter_set_match(const FilterSet *set, const char *relative, const char *name, int is_dir) {
+    int best = -1;
+    size_t name_len = strlen(name);
+
+    consider(set, hash_find(set->names, name, name_len), is_dir, &best);
+
+    if (set->suffix_lengths) {
+        for (size_t len = 1; len <= name_len && len <= FILTER_MAX_SUFFIX; len++) {
+            if (set->suffix_lengths & ((uint64_t)1 << len)) {
+                const char *suffix = name + name_len - len;
+                consider(set, hash_find(set->suffixes, suffix, len), is_dir, &best);
+            }
+        }
+    }
+
+    if (set->root.child_count > 0) {
+        const TrieNode *node = &set->root;
+        for (const char *p = relative; node && *p; ) {
+            size_t component_len = strcspn(p, "/");
+            node = trie_child((TrieNode *)node, p, component_len, 0);
+            p += component_len;
+            if (*p == '/') p++;
+        }
+        if (node && node != &set->root) {
+            consider(set, &node->rules, is_dir, &best);
+        }
+    }
+
+    for (int i = 0; i < set->globs.count; i++) {
+        int index = set->globs.items[i];
+        const FilterRule *rule = &set->rules[index];
+        if (index <= best || (rule->dir_only && !is_dir)) continue;
+        if (glob_match(rule->tokens, rule->token_count, rule->anchored ? relative : name)) {
+            best = index;
+        }
+    }
+
+    if (best < 0) return -1;
+    return set->rules[best].include ? 0 : 1;
+}
+
+// Fonction pour lire un fichier de règles (lignes vides et commentaires '#' ignorés)
+static int filter_set_load(FilterSet *set, const char *file, int include) {
+    FILE *fp = fopen(file, "r");
+    if (!fp) {
+        return -1;
+    }
+
+    char line[PATH_MAX];
+    while (fgets(line, sizeof(line), fp)) {
+        size_t len = strcspn(line, "\r\n");
+        line[len] = '\0';
+        while (len > 0 && line[len - 1] == ' ') {
+            line[--len] = '\0';
+        }
+        if (len == 0 || line[0] == '#') continue;
+        filter_set_add(set, line, include);
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+// Fonction pour ajouter une règle globale (--exclude, ou --include si include vaut 1)
+int filter_add_rule(const char *pattern, int include) {
+    if (!global_rules && !(global_rules = filter_set_new(0))) {
+        return -1;
+    }
+    return filter_set_add(global_rules, pattern, include);
+}
+
+// Fonction pour ajouter les règles globales d'un fichier (--exclude-from), une par ligne
+int filter_add_rules_from(const char *file) {
+    if (!global_rules && !(global_rules = filter_set_new(0))) {
+        return -1;
+    }
+    if (filter_set_load(global_rules, file, 0) != 0) {
+        perror("Erreur lors de l'ouverture du fichier d'exclusions");
+        return -1;
+    }
+    return 0;
+}
+
+// Fonction pour supprimer toutes les règles globales
+void filter_clear(void) {
+    filter_set_free(global_rules);
+    global_rules = NULL;
+}
+
+// Fonction pour entrer dans un répertoire du parcours
+void filter_scope_enter(FilterScope *scope, const FilterScope *parent, const char *dir_path, const char *name) {
+    scope->parent = parent;
+    scope->rules = NULL;
+    if (parent && name) {
+        scope->path_len = parent->path_len
+            ? (size_t)snprintf(scope->path, sizeof(scope->path), "%s/%s", parent->path, name)
+            : (size_t)snprintf(scope->path, sizeof(scope->path), "%s", name);
+        if (scope->path_len >= sizeof(scope->path)) scope->path_len = sizeof(scope->path) - 1;
+    } else {
+        scope->path[0] = '\0';
+        scope->path_len = 0;
+    }
+
+    char ignore_path[PATH_MAX];
+    snprintf(ignore_path, sizeof(ignore_path), "%s/%s", dir_path, FILTER_IGNORE_FILE);
+    FilterSet *set = filter_set_new(scope->path_len);
+    if (set && filter_set_load(set, ignore_path, 0) == 0 && set->count > 0) {
+        scope->rules = set;
+    } else {
+        filter_set_free(set);
+    }
+}
+
+// Fonction pour savoir si l'entrée name du répertoire de scope est exclue
+int filter_scope_excludes(const FilterScope *scope, const char *name, int is_dir) {
+    char relative[PATH_MAX];
+    int has_rules = global_rules != NULL;
+    for (const FilterScope *s = scope; s && !has_rules; s = s->parent) {
+        has_rules = s->rules != NULL;
+    }
+    if (!has_rules) {
+        return 0;
+    }
+
+    int len = scope->path_len ? snprintf(relative, sizeof(relative), "%s/%s", scope->path, name)
+                              : snprintf(relative, sizeof(relative), "%s", name);
+    if (len < 0 || (size_t)len >= sizeof(relative)) {
+        // Chemin trop long pour être comparé aux motifs (ni sauvegardé) : l'entrée n'est pas filtrée
+        return 0;
+    }
+
+    // Les options de la ligne de commande l'emportent, puis le .backupignore le plus proche
+    if (global_rules) {
+        int result = filter_set_match(global_rules, relative, name, is_dir);
+        if (result >= 0) return result;
+    }
+    for (const FilterScope *s = scope; s; s = s->parent) {
+        if (!s->rules) continue;
+        const char *local = relative + (s->rules->base_len ? s->rules->base_len + 1 : 0);
+        int result = filter_set_match(s->rules, local, name, is_dir);
+        if (result >= 0) return result;
+    }
+    return 0;
+}
+
+// Fonction pour quitter un répertoire du parcours
+void filter_scope_leave(FilterScope *scope) {
+    filter_set_free(scope->rules);
+    scope->rules = NULL;
+}
+
+// Fonction pour ouvrir les portées des répertoires parents de relative (relatif à root)
+FilterScope *filter_scope_open_path(const char *root, const char *relative, int is_dir, int *depth) {
+    int components = 1;
+    for (const char *p = relative; *p; p++) {
+        if (*p == '/') components++;
+    }
+
+    FilterScope *chain = malloc(components * sizeof(FilterScope));
+    if (!chain) {
+        return NULL;
+    }
+    filter_scope_enter(&chain[0], NULL, root, NULL);
+    int opened = 1;
+
+    char dir_path[PATH_MAX];
+    snprintf(dir_path, sizeof(dir_path), "%s", root);
+    const char *name = relative;
+    for (;;) {
+        const char *slash = strchr(name, '/');
+        char component[PATH_MAX];
+        size_t len = slash ? (size_t)(slash - name) : strlen(name);
+        if (len >= sizeof(component)) len = sizeof(component) - 1;
+        memcpy(component, name, len);
+        component[len] = '\0';
+
+        // Les composants intermédiaires sont des répertoires ; le dernier a le type donné
+        if (filter_scope_excludes(&chain[opened - 1], component, slash ? 1 : is_dir)) {
+            filter_scope_close_path(chain, opened);
+            return NULL;
+        }
+        if (!slash) {
+            break;
+        }
+
+        size_t dir_len = strlen(dir_path);
+        snprintf(dir_path + dir_len, sizeof(dir_path) - dir_len, "/%s", component);
+        filter_scope_enter(&chain[opened], &chain[opened - 1], dir_path, component);
+        opened++;
+        name = slash + 1;
+    }
+
+    *depth = opened;
+    return chain;
+}
+
+// Fonction pour libérer les portées ouvertes par filter_scope_open_path
+void filter_scope_close_path(FilterScope *chain, int depth) {
+    for (int i = depth - 1; i >= 0; i--) {
+        filter_scope_leave(&chain[i]);
+    }
+    free(chain);
+}
@@ -0,0 +1,50 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <stddef.h>
+#include <limits.h>
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+// Nom des fichiers de règles propres à un répertoire (syntaxe proche de .gitignore)
+#define FILTER_IGNORE_FILE ".backupignore"
+
+// Ensemble de règles compilées (options de la ligne de commande ou un .backupignore)
+typedef struct FilterSet FilterSet;
+
+// Position d'un parcours dans l'arborescence source : chaque niveau de récursion
+// possède sa portée, qui garde les règles du .backupignore de son répertoire
+typedef struct FilterScope {
+    const struct FilterScope *parent;
+    FilterSet *rules;         // Règles du .backupignore du répertoire (NULL si absent)
+    char path[PATH_MAX];      // Chemin relatif à la racine du parcours ("" pour la racine)
+    size_t path_len;
+} FilterScope;
+
+// Fonction pour ajouter une règle globale (--exclude, ou --include si include vaut 1)
+// Retourne 0 en cas de succès
+int filter_add_rule(const char *pattern, int include);
+// Fonction pour ajouter les règles globales d'un fichier (--exclude-from), une par ligne
+int filter_add_rules_from(const char *file);
+// Fonction pour supprimer toutes les règles globales
+void filter_clear(void);
+
+// Fonction pour entrer dans un répertoire du parcours ; name vaut NULL pour la racine
+// Le .backupignore du répertoire, s'il existe, est compilé pour ses descendants
+void filter_scope_enter(FilterScope *scope, const FilterScope *parent, const char *dir_path, const char *name);
+// Fonction pour savoir si l'entrée name du répertoire de scope est exclue
+// Un répertoire exclu n'est pas parcouru : tout son sous-arbre est ignoré
+int filter_scope_excludes(const FilterScope *scope, const char *name, int is_dir);
+// Fonction pour quitter un répertoire du parcours
+void filter_scope_leave(FilterScope *scope);
+
+// Fonction pour ouvrir les portées de la racine et des répertoires parents de relative
+// Retourne un tableau de *depth portées (la dernière est celle du répertoire parent),
+// ou NULL si relative ou l'un de ses parents est exclu
+FilterScope *filter_scope_open_path(const char *root, const char *relative, int is_dir, int *depth);
+// Fonction pour libérer les portées ouvertes par filter_scope_open_path
+void filter_scope_close_path(FilterScope *chain, int depth);
+
+#endif // FILTER_H
@@ -5,13 +5,52 @@
 #include "file_handler.h"
 #include "deduplication.h"
 #include "backup_manager.h"
+#include "network.h"
+#include "snapshot_fs.h"
+#include "chunk_cache.h"
+#include "verify.h"
+#include "throttle.h"
+#include "filter.h"
+#include "change_journal.h"
+#include "read_scheduler.h"
+#include "cache_io.h"
+#include "stream_backup.h"
+#include "tar_stream.h"
+#include "seal.h"
+#include "catalog.h"
 
 void print_usage(const char *prog_name) {
     printf("Usage: %s [options]\n", prog_name);
     printf("Options:\n");
     printf("  --backup <source_dir> <backup_dir>      Crée une sauvegarde du répertoire source dans le répertoire de sauvegarde.\n");
-    printf("  --restore <source_backup> <restore_dir> Restaure une sauvegarde.\n");
+    printf("  --backup-stdin <nom> <backup_dir>       Sauvegarde l'entrée standard (pg_dump, mysqldump...) sous le nom indiqué dans une nouvelle sauvegarde.\n");
+    printf("  --import-tar <backup_dir>               Crée une sauvegarde à partir d'une archive tar lue sur l'entrée standard (fichiers inchangés dédupliqués).\n");
+    printf("  --exclude <motif> / --include <motif>   Exclut (ou réinclut) les chemins correspondant au motif lors de la sauvegarde.\n");
+    printf("  --exclude-from <fichier>                Lit des motifs d'exclusion depuis un fichier (un par ligne, syntaxe de %s).\n", FILTER_IGNORE_FILE);
+    printf("  --journal                               Avec --backup : ne relit que les chemins consignés par --watch.\n");
+    printf("  --manifest-only                         Avec --backup : sauvegarde incrémentale réduite à son log, seuls les fichiers modifiés sont copiés.\n");
+    printf("  --pack                                  Avec --backup : regroupe les fichiers de moins de 64 Ko dans de gros conteneurs indexés (implique --manifest-only).\n");
+    printf("  --append-tails                          Avec --backup : ne copie que la fin ajoutée des fichiers qui n'ont fait que grandir (journaux, logs), le début étant vérifié par la recette de la copie précédente.\n");
+    printf("  --threads <n>                           Avec --backup : nombre de threads copiant les fichiers modifiés (nombre de cœurs par défaut).\n");
+    printf("  --watch <source_dir> <backup_dir>       Observe la source et consigne ses modifications pour les sauvegardes --journal.\n");
+    printf("  --full-every <heures>                   Intervalle entre deux parcours complets de réconciliation (24 h par défaut).\n");
+    printf("  --read-order <directory|inode|extent>   Ordre de lecture des fichiers : répertoire (SSD), inode ou extent physique (disques rotatifs).\n");
+    printf("  --cache-mode <normal|dontneed|direct>   Lectures de sauvegarde et de vérification sans évincer le cache de pages des autres processus.\n");
+    printf("  --limit-read / --limit-write / --limit-net <Mo/s> Débits maximaux de lecture, d'écriture et de réception réseau, tous threads confondus.\n");
+    printf("  --nice <n> / --ionice <idle|be[:n]|rt[:n]> Priorités processeur et d'E/S de la sauvegarde ou de la vérification.\n");
+    printf("  --adaptive                              Avec --backup : réduit les débits quand la latence du disque source augmente.\n");
+    printf("  --restore <source_backup> <restore_dir> [--path <motif>] [--s-serveur <adresse> --s-port <port>] Restaure une sauvegarde (ou seulement les fichiers correspondant au motif).\n");
+    printf("  --streams <n>                           Avec --restore et --s-serveur : nombre de connexions parallèles entre lesquelles les fichiers sont répartis (%d par défaut).\n", NET_DEFAULT_STREAMS);
+    printf("  --net-buffer <Ko>                       Taille des tampons des sockets (réglage automatique du noyau par défaut).\n");
+    printf("  --restore-stdout <source_backup> <nom>  Écrit sur la sortie standard le fichier d'une sauvegarde (flux sauvegardé par --backup-stdin).\n");
+    printf("  --export-tar <source_backup> [--threads <n>] Écrit une sauvegarde sur la sortie standard au format tar.\n");
     printf("  --list-backups <backup_dir> [--s-serveur <adresse> --s-port <port>] Liste les sauvegardes locales ou distantes.\n");
+    printf("  --diff <snapshot_a> <snapshot_b> [--s-serveur <adresse> --s-port <port>] Affiche les différences entre deux sauvegardes.\n");
+    printf("  --find <backup_dir> <motif> [--s-serveur <adresse> --s-port <port>] Liste les versions des chemins correspondant au motif (préfixe ou glob) et les sauvegardes qui les contiennent.\n");
+    printf("  --mount <backup_dir> <mountpoint>       Monte les sauvegardes en lecture seule (FUSE).\n");
+    printf("  --verify <backup_dir> [--threads <n>] [--max-read <Mo/s>] [--ionice <idle|be[:n]|rt[:n]>] Vérifie l'intégrité des sauvegardes.\n");
+    printf("  --encrypt-key <fichier>                 Chiffre les données stockées (AES-256-GCM ou ChaCha20-Poly1305) avec la clé du fichier (32 octets ou 64 chiffres hexadécimaux) ; nécessaire pour relire un dépôt chiffré.\n");
+    printf("  --cache-size <Mo>                       Taille du cache de chunks utilisé pour les lectures (64 Mo par défaut).\n");
     printf("  --help                                  Affiche cette aide.\n");
 }
 
@@ -24,12 +63,62 @@ int main(int argc, char *argv[]) {
     const char *backup_id = NULL;
     const char *restore_dir = NULL;
     const char *server_address = NULL;
+    const char *diff_a = NULL;
+    const char *diff_b = NULL;
+    const char *find_dir = NULL;
+    const char *find_pattern = NULL;
+    const char *restore_pattern = NULL;
+    const char *verify_dir = NULL;
+    VerifyOptions verify_options = {0, 0, IO_CLASS_NONE, 0};
     int server_port = -1;
+    int use_journal = 0;
+    int use_adaptive = 0;
+    const char *stream_name = NULL;
+    const char *stream_backup_dir = NULL;
+    const char *stream_backup_id = NULL;
+    const char *export_backup_id = NULL;
+    const char *import_backup_dir = NULL;
+    const char *watch_dir = NULL;
+    const char *watch_backup_dir = NULL;
+    const char *mount_dir = NULL;
+    const char *mountpoint = NULL;
 
     struct option long_options[] = {
         {"backup", required_argument, NULL, 'b'},
+        {"backup-stdin", required_argument, NULL, 'B'},
+        {"restore-stdout", required_argument, NULL, 'O'},
+        {"export-tar", required_argument, NULL, 'E'},
+        {"import-tar", required_argument, NULL, 'U'},
+        {"journal", no_argument, NULL, 'j'},
+        {"manifest-only", no_argument, NULL, 'M'},
+        {"append-tails", no_argument, NULL, 'T'},
+        {"pack", no_argument, NULL, 'K'},
+        {"watch", required_argument, NULL, 'w'},
+        {"full-every", required_argument, NULL, 'F'},
+        {"read-order", required_argument, NULL, 'o'},
+        {"cache-mode", required_argument, NULL, 'C'},
+        {"limit-read", required_argument, NULL, 'L'},
+        {"limit-write", required_argument, NULL, 'W'},
+        {"limit-net", required_argument, NULL, 'N'},
+        {"nice", required_argument, NULL, 'n'},
+        {"adaptive", no_argument, NULL, 'A'},
         {"restore", required_argument, NULL, 'r'},
+        {"exclude", required_argument, NULL, 'x'},
+        {"include", required_argument, NULL, 'I'},
+        {"exclude-from", required_argument, NULL, 'X'},
         {"list-backups", required_argument, NULL, 'l'},
+        {"diff", required_argument, NULL, 'd'},
+        {"find", required_argument, NULL, 'f'},
+        {"path", required_argument, NULL, 'P'},
+        {"mount", required_argument, NULL, 'm'},
+        {"encrypt-key", required_argument, NULL, 'k'},
+        {"cache-size", required_argument, NULL, 'c'},
+        {"verify", required_argument, NULL, 'v'},
+        {"threads", required_argument, NULL, 't'},
+        {"max-read", required_argument, NULL, 'R'},
+        {"ionice", required_argument, NULL, 'i'},
+        {"streams", required_argument, NULL, 'S'},
+        {"net-buffer", required_argument, NULL, 'G'},
         {"s-serveur", required_argument, NULL, 's'},
         {"s-port", required_argument, NULL, 'p'},
         {"help", no_argument, NULL, 'h'},
@@ -41,31 +130,184 @@ int main(int argc, char *argv[]) {
         return EXIT_FAILURE;
     }
 
-    while ((opt = getopt_long(argc, argv, "b:r:l:s:p:h", long_options, &option_index)) != -1) {
+    while ((opt = getopt_long(argc, argv, "b:B:O:E:U:jMTKw:F:o:C:L:W:N:n:Ar:x:I:X:l:d:f:P:m:k:c:v:t:R:i:S:G:s:p:h", long_options, &option_index)) != -1) {
         switch (opt) {
-            case 'b': // --backup
+            case 'b': // --backup (exécutée après la boucle pour prendre en compte les filtres)
                 if (optind < argc) {
                     source_dir = optarg;
-                    backup_directory = argv[optind];
-                    create_backup(source_dir, backup_directory);
+                    backup_directory = argv[optind++];
                 } else {
                     printf("Erreur : --backup nécessite deux arguments <source_dir> <backup_dir>\n");
                     return EXIT_FAILURE;
                 }
                 break;
-            case 'r': // --restore
+            case 'B': // --backup-stdin (exécutée après la boucle, comme --backup)
+                if (optind < argc) {
+                    stream_name = optarg;
+                    stream_backup_dir = argv[optind++];
+                } else {
+                    printf("Erreur : --backup-stdin nécessite deux arguments <nom> <backup_dir>\n");
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'O': // --restore-stdout
+                if (optind < argc) {
+                    stream_backup_id = optarg;
+                    stream_name = argv[optind++];
+                } else {
+                    fprintf(stderr, "Erreur : --restore-stdout nécessite deux arguments <source_backup> <nom>\n");
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'E': // --export-tar (exécutée après la boucle pour prendre en compte --threads)
+                export_backup_id = optarg;
+                break;
+            case 'U': // --import-tar
+                import_backup_dir = optarg;
+                break;
+            case 'j': // --journal
+                use_journal = 1;
+                break;
+            case 'M': // --manifest-only
+                set_manifest_snapshots(1);
+                break;
+            case 'T': // --append-tails
+                set_append_tails(1);
+                break;
+            case 'K': // --pack
+                set_pack_small_files(1);
+                break;
+            case 'w': // --watch (exécutée après la boucle, comme --backup)
+                if (optind < argc) {
+                    watch_dir = optarg;
+                    watch_backup_dir = argv[optind++];
+                } else {
+                    printf("Erreur : --watch nécessite deux arguments <source_dir> <backup_dir>\n");
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'F': // --full-every (en heures)
+                change_journal_set_full_interval((long)(atof(optarg) * 3600));
+                break;
+            case 'o': { // --read-order
+                ReadOrder order;
+                if (parse_read_order(optarg, &order) != 0) {
+                    printf("Erreur : ordre de lecture invalide (directory, inode ou extent)\n");
+                    return EXIT_FAILURE;
+                }
+                read_scheduler_set_order(order);
+                break;
+            }
+            case 'C': { // --cache-mode
+                CacheMode mode;
+                if (parse_cache_mode(optarg, &mode) != 0) {
+                    printf("Erreur : mode de cache invalide (normal, dontneed ou direct)\n");
+                    return EXIT_FAILURE;
+                }
+                cache_io_set_mode(mode);
+                break;
+            }
+            case 'L': // --limit-read (en Mo/s)
+                throttle_set_limit(THROTTLE_READ, atof(optarg) * 1024 * 1024);
+                break;
+            case 'W': // --limit-write (en Mo/s)
+                throttle_set_limit(THROTTLE_WRITE, atof(optarg) * 1024 * 1024);
+                break;
+            case 'N': // --limit-net (en Mo/s)
+                throttle_set_limit(THROTTLE_NETWORK, atof(optarg) * 1024 * 1024);
+                break;
+            case 'n': // --nice (appliqué tout de suite : les threads créés ensuite en héritent)
+                if (set_cpu_priority(atoi(optarg)) != 0) {
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'A': // --adaptive (activé après la boucle, sur le périphérique de la source)
+                use_adaptive = 1;
+                break;
+            case 'r': // --restore (exécutée après la boucle pour prendre en compte --path)
                 if (optind < argc) {
                     backup_id = optarg;
                     restore_dir = argv[optind];
-                    restore_backup(backup_id, restore_dir);
                 } else {
                     printf("Erreur : --restore nécessite deux arguments <backup_id> <restore_dir>\n");
                     return EXIT_FAILURE;
                 }
                 break;
+            case 'x': // --exclude
+            case 'I': // --include
+                if (filter_add_rule(optarg, opt == 'I') != 0) {
+                    printf("Erreur : motif invalide : %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'X': // --exclude-from
+                if (filter_add_rules_from(optarg) != 0) {
+                    return EXIT_FAILURE;
+                }
+                break;
             case 'l': // --list-backups
                 backup_dir = optarg;
                 break;
+            case 'd': // --diff
+                if (optind < argc) {
+                    diff_a = optarg;
+                    diff_b = argv[optind++];
+                } else {
+                    printf("Erreur : --diff nécessite deux arguments <snapshot_a> <snapshot_b>\n");
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'f': // --find
+                if (optind < argc) {
+                    find_dir = optarg;
+                    find_pattern = argv[optind++];
+                } else {
+                    printf("Erreur : --find nécessite deux arguments <backup_dir> <motif>\n");
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'm': // --mount (exécutée après la boucle pour prendre en compte --encrypt-key et --cache-size)
+                if (optind < argc) {
+                    mount_dir = optarg;
+                    mountpoint = argv[optind++];
+                } else {
+                    printf("Erreur : --mount nécessite deux arguments <backup_dir> <mountpoint>\n");
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'k': // --encrypt-key (chargée tout de suite)
+                if (seal_load_key(optarg) != 0) {
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'c': // --cache-size (en Mo)
+                chunk_cache_init((size_t)atol(optarg) * 1024 * 1024);
+                break;
+            case 'v': // --verify
+                verify_dir = optarg;
+                break;
+            case 't': // --threads (vérification et copies des sauvegardes incrémentales)
+                verify_options.threads = atoi(optarg);
+                set_sync_threads(verify_options.threads);
+                break;
+            case 'R': // --max-read (en Mo/s)
+                verify_options.max_read_rate = atof(optarg) * 1024 * 1024;
+                break;
+            case 'i': // --ionice
+                if (parse_io_priority(optarg, &verify_options.io_class, &verify_options.io_level) != 0) {
+                    printf("Erreur : priorité d'E/S invalide (idle, be[:0-7] ou rt[:0-7])\n");
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'P': // --path
+                restore_pattern = optarg;
+                break;
+            case 'S': // --streams (connexions parallèles des restaurations depuis le serveur)
+                network_set_streams(atoi(optarg));
+                break;
+            case 'G': // --net-buffer (en Ko)
+                network_set_socket_buffer(atoi(optarg) * 1024);
+                break;
             case 's': // --s-serveur
                 server_address = optarg;
                 break;
@@ -81,12 +323,55 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    // Gestion de l'option --backup après la boucle
+    if (source_dir && backup_directory) {
+        // La priorité d'E/S du processus est héritée par les threads de la sauvegarde
+        set_io_priority(verify_options.io_class, verify_options.io_level);
+        if (use_adaptive) {
+            throttle_enable_adaptive(source_dir);
+        }
+        create_backup_journaled(source_dir, backup_directory, use_journal);
+    }
+
+    // Gestion des options --backup-stdin et --restore-stdout après la boucle
+    if (stream_name && stream_backup_dir) {
+        set_io_priority(verify_options.io_class, verify_options.io_level);
+        if (backup_stdin(stream_name, stream_backup_dir) != 0) {
+            return EXIT_FAILURE;
+        }
+    }
+    if (stream_name && stream_backup_id) {
+        if (restore_stdout(stream_backup_id, stream_name) != 0) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Gestion des options --export-tar et --import-tar après la boucle
+    if (export_backup_id) {
+        if (export_tar(export_backup_id, verify_options.threads) != 0) {
+            return EXIT_FAILURE;
+        }
+    }
+    if (import_backup_dir) {
+        set_io_priority(verify_options.io_class, verify_options.io_level);
+        if (import_tar(import_backup_dir) != 0) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Gestion de l'option --restore après la boucle
+    if (backup_id && restore_dir) {
+        if (server_address && server_port > 0) {
+            restore_backup_remote(server_address, server_port, backup_id, restore_dir, restore_pattern);
+        } else {
+            restore_backup_paths(backup_id, restore_dir, restore_pattern);
+        }
+    }
+
     // Gestion de l'option --list-backups après la boucle
     if (backup_dir) {
         if (server_address && server_port > 0) {
-            int count = 0;
-            BackupInfo *infos = find_backup_logs_remote(server_address, server_port, backup_dir, &count);
-
+            find_backup_logs_remote(server_address, server_port, backup_dir);
         } else {
             // Liste les sauvegardes locales
             const char *directory = backup_dir;
@@ -95,6 +380,44 @@ int main(int argc, char *argv[]) {
             printf("Nombre de dossiers de backup: %d\n\n", count);
             print_backup_info(infos, count);
         }
-    }  
+    }
+
+    // Gestion de l'option --verify après la boucle (les options de débit peuvent suivre)
+    if (verify_dir) {
+        int problems = verify_backups(verify_dir, &verify_options);
+        if (problems != 0) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Gestion de l'option --diff après la boucle (le serveur peut être indiqué après)
+    if (diff_a && diff_b) {
+        if (server_address && server_port > 0) {
+            diff_backups_remote(server_address, server_port, diff_a, diff_b);
+        } else {
+            diff_backups(diff_a, diff_b, stdout);
+        }
+    }
+
+    // Gestion de l'option --find après la boucle (le serveur peut être indiqué après)
+    if (find_dir && find_pattern) {
+        if (server_address && server_port > 0) {
+            find_in_catalog_remote(server_address, server_port, find_dir, find_pattern);
+        } else if (catalog_find(find_dir, find_pattern, stdout) < 0) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Gestion des options --watch et --mount après la boucle (bloquent jusqu'à SIGINT ou SIGTERM)
+    if (watch_dir && watch_backup_dir) {
+        if (watch_source(watch_dir, watch_backup_dir) != 0) {
+            return EXIT_FAILURE;
+        }
+    }
+    if (mount_dir && mountpoint) {
+        if (mount_backups(mount_dir, mountpoint) != 0) {
+            return EXIT_FAILURE;
+        }
+    }
     return EXIT_SUCCESS;
 }
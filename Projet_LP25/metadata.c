@@ -0,0 +1,450 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/xattr.h>
+#include "metadata.h"
+#include "cache_io.h"
+#include "throttle.h"
+#include "deduplication.h"
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+// Caractères encodés en %XX dans les champs texte du log
+#define ESCAPED_CHARS ";%\n\r,="
+
+// Fonction pour initialiser une table d'inodes vide
+void inode_map_init(InodeMap *map) {
+    map->entries = NULL;
+    map->capacity = 0;
+    map->count = 0;
+}
+
+// Fonction pour libérer une table d'inodes
+void inode_map_free(InodeMap *map) {
+    for (size_t i = 0; i < map->capacity; i++) {
+        free(map->entries[i].path);
+    }
+    free(map->entries);
+    inode_map_init(map);
+}
+
+static size_t inode_slot(const InodeMap *map, dev_t dev, ino_t ino) {
+    size_t slot = ((size_t)dev * 31 + (size_t)ino) % map->capacity;
+    while (map->entries[slot].path &&
+           (map->entries[slot].dev != dev || map->entries[slot].ino != ino)) {
+        slot = (slot + 1) % map->capacity;
+    }
+    return slot;
+}
+
+// Fonction pour retrouver le premier chemin associé à un inode, ou l'enregistrer avec path
+const char *inode_map_find_or_add(InodeMap *map, const struct stat *st, const char *path) {
+    // Agrandir la table au-delà de 70 % de remplissage
+    if ((map->count + 1) * 10 > map->capacity * 7) {
+        InodeMap grown = { calloc(map->capacity ? map->capacity * 2 : 1024, sizeof(InodeEntry)),
+                           map->capacity ? map->capacity * 2 : 1024, map->count };
+        if (!grown.entries) {
+            return NULL;
+        }
+        for (size_t i = 0; i < map->capacity; i++) {
+            if (map->entries[i].path) {
+                grown.entries[inode_slot(&grown, map->entries[i].dev, map->entries[i].ino)] = map->entries[i];
+            }
+        }
+        free(map->entries);
+        *map = grown;
+    }
+
+    size_t slot = inode_slot(map, st->st_dev, st->st_ino);
+    if (map->entries[slot].path) {
+        return map->entries[slot].path;
+    }
+    map->entries[slot].dev = st->st_dev;
+    map->entries[slot].ino = st->st_ino;
+    map->entries[slot].path = strdup(path);
+    map->count++;
+    return NULL;
+}
+
+// Fonction pour écrire une chaîne en encodant les séparateurs du log
+static void write_escaped(FILE *out, const char *text) {
+    for (const char *p = text; p && *p; p++) {
+        if (strchr(ESCAPED_CHARS, *p)) {
+            fprintf(out, "%%%02X", (unsigned char)*p);
+        } else {
+            fputc(*p, out);
+        }
+    }
+}
+
+// Fonction pour décoder sur place une chaîne encodée par write_escaped
+static char *unescape(char *text) {
+    char *out = text;
+    for (char *p = text; *p; p++) {
+        unsigned int value;
+        if (*p == '%' && sscanf(p + 1, "%2x", &value) == 1) {
+            *out++ = (char)value;
+            p += 2;
+        } else {
+            *out++ = *p;
+        }
+    }
+    *out = '\0';
+    return text;
+}
+
+// Fonction pour encoder les attributs étendus d'un fichier sous la forme "nom=hex,nom=hex"
+static char *encode_xattrs(const char *path) {
+    ssize_t list_size = llistxattr(path, NULL, 0);
+    if (list_size <= 0 || list_size > XATTR_LIST_MAX_SIZE) {
+        return NULL;
+    }
+
+    char *names = malloc(list_size);
+    if (!names || (list_size = llistxattr(path, names, list_size)) <= 0) {
+        free(names);
+        return NULL;
+    }
+
+    char *encoded = NULL;
+    size_t encoded_size = 0;
+    FILE *out = open_memstream(&encoded, &encoded_size);
+    if (!out) {
+        free(names);
+        return NULL;
+    }
+
+    unsigned char value[XATTR_LIST_MAX_SIZE];
+    int first = 1;
+    for (char *name = names; name < names + list_size; name += strlen(name) + 1) {
+        ssize_t value_size = lgetxattr(path, name, value, sizeof(value));
+        if (value_size < 0) continue;
+
+        if (!first) fputc(',', out);
+        first = 0;
+        write_escaped(out, name);
+        fputc('=', out);
+        for (ssize_t i = 0; i < value_size; i++) {
+            fprintf(out, "%02x", value[i]);
+        }
+    }
+    fclose(out);
+    free(names);
+
+    if (first) {
+        free(encoded);
+        return NULL;
+    }
+    return encoded;
+}
+
+// Fonction pour appliquer des attributs étendus encodés par encode_xattrs
+static void apply_xattrs(const char *path, const char *encoded) {
+    char *copy = strdup(encoded);
+    char *cursor = copy;
+    char *item;
+    unsigned char value[XATTR_LIST_MAX_SIZE];
+
+    while (copy && (item = strsep(&cursor, ",")) != NULL) {
+        char *hex = strchr(item, '=');
+        if (!hex) continue;
+        *hex++ = '\0';
+
+        size_t value_size = 0;
+        while (hex[value_size * 2] && hex[value_size * 2 + 1] && value_size < sizeof(value)) {
+            sscanf(&hex[value_size * 2], "%2hhx", &value[value_size]);
+            value_size++;
+        }
+        // Les espaces de noms réservés (security.*, trusted.*) peuvent être refusés : non bloquant
+        lsetxattr(path, unescape(item), value, value_size, 0);
+    }
+    free(copy);
+}
+
+// Fonction pour copier les attributs étendus d'un fichier ouvert vers un autre
+static void copy_fd_xattrs(int src_fd, int dest_fd) {
+    ssize_t list_size = flistxattr(src_fd, NULL, 0);
+    if (list_size <= 0 || list_size > XATTR_LIST_MAX_SIZE) {
+        return;
+    }
+
+    char *names = malloc(list_size);
+    unsigned char *value = malloc(XATTR_LIST_MAX_SIZE);
+    if (names && value && (list_size = flistxattr(src_fd, names, list_size)) > 0) {
+        for (char *name = names; name < names + list_size; name += strlen(name) + 1) {
+            ssize_t value_size = fgetxattr(src_fd, name, value, XATTR_LIST_MAX_SIZE);
+            if (value_size >= 0) {
+                fsetxattr(dest_fd, name, value, value_size, 0);
+            }
+        }
+    }
+    free(names);
+    free(value);
+}
+
+// Fonction pour remplir les métadonnées d'un élément de log à partir d'un lstat
+int read_file_metadata(const char *path, const struct stat *st, log_element *elt) {
+    elt->mode = st->st_mode;
+    elt->uid = st->st_uid;
+    elt->gid = st->st_gid;
+    elt->mtime = st->st_mtim.tv_sec;
+    elt->mtime_nsec = st->st_mtim.tv_nsec;
+    elt->link_target = NULL;
+    elt->hardlink = NULL;
+    elt->stored = NULL;
+    elt->xattrs = encode_xattrs(path);
+
+    if (S_ISLNK(st->st_mode)) {
+        char target[PATH_MAX];
+        ssize_t len = readlink(path, target, sizeof(target) - 1);
+        if (len < 0) {
+            perror("Erreur lors de la lecture du lien symbolique");
+            free(elt->xattrs);
+            elt->xattrs = NULL;
+            return -1;
+        }
+        target[len] = '\0';
+        elt->link_target = strdup(target);
+    }
+    return 0;
+}
+
+// Fonction pour libérer les champs de métadonnées alloués d'un élément de log
+void free_file_metadata(log_element *elt) {
+    free(elt->link_target);
+    free(elt->hardlink);
+    free(elt->xattrs);
+    free(elt->stored);
+    elt->link_target = elt->hardlink = elt->xattrs = elt->stored = NULL;
+}
+
+// Fonction pour écrire les champs de métadonnées d'un élément dans une ligne du log
+// Format : ;mode(octal);uid;gid;mtime(s.ns);cible du lien;lien dur vers;attributs étendus[;sauvegarde de stockage]
+void write_metadata_fields(FILE *logfile, const log_element *elt) {
+    fprintf(logfile, ";%o;%u;%u;%lld.%09ld;", (unsigned int)elt->mode, (unsigned int)elt->uid,
+            (unsigned int)elt->gid, (long long)elt->mtime, elt->mtime_nsec);
+    write_escaped(logfile, elt->link_target);
+    fputc(';', logfile);
+    write_escaped(logfile, elt->hardlink);
+    fputc(';', logfile);
+    if (elt->xattrs) {
+        fputs(elt->xattrs, logfile);
+    }
+    if (elt->stored) {
+        fprintf(logfile, ";%s", elt->stored);
+    }
+}
+
+// Fonction pour lire les champs de métadonnées d'une ligne du log
+// Les logs écrits avant l'ajout des métadonnées laissent mode à 0
+void parse_metadata_fields(char **cursor, log_element *elt) {
+    elt->mode = 0;
+    elt->uid = 0;
+    elt->gid = 0;
+    elt->mtime_nsec = 0;
+    elt->link_target = NULL;
+    elt->hardlink = NULL;
+    elt->xattrs = NULL;
+    elt->stored = NULL;
+
+    char *mode_str = strsep(cursor, ";");
+    char *uid_str = strsep(cursor, ";");
+    char *gid_str = strsep(cursor, ";");
+    char *mtime_str = strsep(cursor, ";");
+    char *target_str = strsep(cursor, ";");
+    char *hardlink_str = strsep(cursor, ";");
+    char *xattrs_str = strsep(cursor, ";");
+    char *stored_str = strsep(cursor, ";"); // Sauvegardes par manifeste seulement
+    if (!mode_str || !uid_str || !gid_str || !mtime_str) {
+        return;
+    }
+
+    elt->mode = (mode_t)strtoul(mode_str, NULL, 8);
+    elt->uid = (uid_t)strtoul(uid_str, NULL, 10);
+    elt->gid = (gid_t)strtoul(gid_str, NULL, 10);
+    char *dot;
+    elt->mtime = (time_t)strtoll(mtime_str, &dot, 10);
+    if (*dot == '.') {
+        elt->mtime_nsec = strtol(dot + 1, NULL, 10);
+    }
+    if (target_str && *target_str) elt->link_target = strdup(unescape(target_str));
+    if (hardlink_str && *hardlink_str) elt->hardlink = strdup(unescape(hardlink_str));
+    if (xattrs_str && *xattrs_str) elt->xattrs = strdup(xattrs_str);
+    if (stored_str && *stored_str) elt->stored = strdup(stored_str);
+}
+
+// Fonction pour appliquer les métadonnées enregistrées à un fichier restauré
+void apply_file_metadata(const char *path, const log_element *elt) {
+    if (elt->mode == 0) {
+        return; // Log sans métadonnées
+    }
+
+    // Le propriétaire d'abord : chown efface les bits setuid/setgid
+    if (lchown(path, elt->uid, elt->gid) == -1 && errno != EPERM) {
+        perror("Erreur lors du changement de propriétaire");
+    }
+    if (!S_ISLNK(elt->mode) && chmod(path, elt->mode & 07777) == -1) {
+        perror("Erreur lors du changement de permissions");
+    }
+    if (elt->xattrs) {
+        apply_xattrs(path, elt->xattrs);
+    }
+
+    struct timespec times[2];
+    times[0].tv_sec = times[1].tv_sec = elt->mtime;
+    times[0].tv_nsec = times[1].tv_nsec = elt->mtime_nsec;
+    utimensat(AT_FDCWD, path, times, AT_SYMLINK_NOFOLLOW);
+}
+
+// Fonction pour écrire size octets à offset en laissant des trous à la place des chunks nuls
+// (la plage de la destination ne doit contenir aucune donnée) ; les chunks non nuls consécutifs
+// sont écrits en une seule fois
+static int pwrite_sparse(int fd, const unsigned char *data, size_t size, off_t offset) {
+    size_t start = 0;
+    while (start < size) {
+        size_t len = size - start < CHUNK_SIZE ? size - start : CHUNK_SIZE;
+        if (chunk_is_hole(data + start, len)) {
+            start += len;
+            continue;
+        }
+        size_t end = start + len;
+        while (end < size) {
+            len = size - end < CHUNK_SIZE ? size - end : CHUNK_SIZE;
+            if (chunk_is_hole(data + end, len)) break;
+            end += len;
+        }
+        if (pwrite(fd, data + start, end - start, offset + start) != (ssize_t)(end - start)) {
+            return -1;
+        }
+        throttle_consume(THROTTLE_WRITE, end - start);
+        // Le chunk nul qui a arrêté la série est déjà compté : il est sauté sans être réexaminé
+        start = end < size ? end + len : end;
+    }
+    return 0;
+}
+
+// Fonction pour copier une plage [start, end) d'un fichier à la même position
+// Les chunks nuls de la source deviennent des trous de la copie (fixés par le ftruncate final)
+static int copy_range(CacheReader *reader, int dest_fd, off_t start, off_t end) {
+    off_t written = start;
+    while (start < end) {
+        size_t to_read = (end - start < (off_t)(CACHE_IO_BUFFER_SIZE / 2)) ? (size_t)(end - start) : CACHE_IO_BUFFER_SIZE / 2;
+        const unsigned char *data;
+        ssize_t bytes = cache_reader_pread(reader, start, to_read, &data);
+        if (bytes <= 0) {
+            return bytes < 0 ? -1 : 0;
+        }
+        if (pwrite_sparse(dest_fd, data, bytes, start) != 0) {
+            return -1;
+        }
+        start += bytes;
+
+        // Les pages écrites de la copie quittent aussi le cache (hors mode normal)
+        if (start - written >= CACHE_IO_RELEASE_BYTES) {
+            cache_io_release_written(dest_fd, written, start);
+            written = start;
+        }
+    }
+    cache_io_release_written(dest_fd, written, start);
+    return 0;
+}
+
+int copy_sparse(int src_fd, int dest_fd, off_t size) {
+    return copy_sparse_range(src_fd, dest_fd, 0, size);
+}
+
+// Fonction pour copier la plage [start, size) d'un fichier à la même position en conservant ses trous
+int copy_sparse_range(int src_fd, int dest_fd, off_t start, off_t size) {
+    CacheReader reader;
+    if (cache_reader_attach(&reader, src_fd) != 0) {
+        return -1;
+    }
+
+    int result = 0;
+    off_t position = start;
+    while (position < size) {
+        off_t data_start = lseek(src_fd, position, SEEK_DATA);
+        if (data_start < 0) {
+            if (errno == ENXIO) break; // Plus de données : la fin du fichier est un trou
+            // SEEK_DATA non supporté par le système de fichiers : copie complète
+            result = copy_range(&reader, dest_fd, position, size);
+            break;
+        }
+
+        off_t data_end = lseek(src_fd, data_start, SEEK_HOLE);
+        if (data_end < 0 || data_end > size) data_end = size;
+        if (copy_range(&reader, dest_fd, data_start, data_end) != 0) {
+            result = -1;
+            break;
+        }
+        position = data_end;
+    }
+    cache_reader_close(&reader);
+
+    // Fixer la taille : crée le trou final éventuel
+    if (result != 0) {
+        return result;
+    }
+    return ftruncate(dest_fd, size);
+}
+
+// Fonction pour copier propriétaire, permissions, attributs étendus et dates d'un fichier ouvert
+void copy_fd_metadata(int src_fd, int dest_fd, const struct stat *st) {
+    // Sans privilèges, le changement de propriétaire échoue : le fichier reste à l'utilisateur courant
+    if (fchown(dest_fd, st->st_uid, st->st_gid) == -1 && errno != EPERM) {
+        perror("Erreur lors du changement de propriétaire");
+    }
+    fchmod(dest_fd, st->st_mode & 07777);
+    copy_fd_xattrs(src_fd, dest_fd);
+
+    struct timespec times[2] = { st->st_atim, st->st_mtim };
+    futimens(dest_fd, times);
+}
+
+// Fonction pour copier propriétaire, permissions et dates d'un chemin (sans suivre les liens)
+void copy_path_metadata(const char *src, const char *dest, const struct stat *st) {
+    if (lchown(dest, st->st_uid, st->st_gid) == -1 && errno != EPERM) {
+        perror("Erreur lors du changement de propriétaire");
+    }
+    if (!S_ISLNK(st->st_mode)) {
+        chmod(dest, st->st_mode & 07777);
+    }
+
+    char *xattrs = encode_xattrs(src);
+    if (xattrs) {
+        apply_xattrs(dest, xattrs);
+        free(xattrs);
+    }
+
+    struct timespec times[2] = { st->st_atim, st->st_mtim };
+    utimensat(AT_FDCWD, dest, times, AT_SYMLINK_NOFOLLOW);
+}
+
+// Fonction pour recréer un lien symbolique à l'identique
+int copy_symlink(const char *src, const char *dest) {
+    char target[PATH_MAX];
+    struct stat st;
+
+    ssize_t len = readlink(src, target, sizeof(target) - 1);
+    if (len < 0 || lstat(src, &st) != 0) {
+        perror("Erreur lors de la lecture du lien symbolique");
+        return -1;
+    }
+    target[len] = '\0';
+
+    unlink(dest);
+    if (symlink(target, dest) == -1) {
+        perror("Erreur lors de la création du lien symbolique");
+        return -1;
+    }
+    copy_path_metadata(src, dest, &st);
+    return 0;
+}
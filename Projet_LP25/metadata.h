@@ -0,0 +1,58 @@
+#ifndef METADATA_H
+#define METADATA_H
+
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "file_handler.h"
+
+// Taille maximale des attributs étendus d'un fichier conservés dans le log
+#define XATTR_LIST_MAX_SIZE 65536
+
+// Table (périphérique, inode) -> premier chemin rencontré, pour reconstituer les liens durs
+typedef struct {
+    dev_t dev;
+    ino_t ino;
+    char *path;               // NULL si l'emplacement est libre
+} InodeEntry;
+
+typedef struct {
+    InodeEntry *entries;
+    size_t capacity;
+    size_t count;
+} InodeMap;
+
+// Fonction pour initialiser une table d'inodes vide
+void inode_map_init(InodeMap *map);
+// Fonction pour libérer une table d'inodes
+void inode_map_free(InodeMap *map);
+// Fonction pour retrouver le premier chemin associé à un inode, ou l'enregistrer avec path
+// Retourne le chemin déjà connu, ou NULL si l'inode vient d'être ajouté
+const char *inode_map_find_or_add(InodeMap *map, const struct stat *st, const char *path);
+
+// Fonction pour remplir les métadonnées d'un élément de log (mode, propriétaire, dates,
+// cible de lien symbolique, attributs étendus) à partir d'un lstat
+int read_file_metadata(const char *path, const struct stat *st, log_element *elt);
+// Fonction pour libérer les champs de métadonnées alloués d'un élément de log
+void free_file_metadata(log_element *elt);
+// Fonction pour écrire les champs de métadonnées d'un élément dans une ligne du log
+void write_metadata_fields(FILE *logfile, const log_element *elt);
+// Fonction pour lire les champs de métadonnées d'une ligne du log (cursor est avancé avec strsep)
+void parse_metadata_fields(char **cursor, log_element *elt);
+// Fonction pour appliquer les métadonnées enregistrées à un fichier restauré
+void apply_file_metadata(const char *path, const log_element *elt);
+
+// Fonction pour copier les données d'un fichier en conservant ses trous (SEEK_DATA/SEEK_HOLE)
+// Les chunks entièrement nuls de la source ne sont pas écrits : ils deviennent aussi des trous
+int copy_sparse(int src_fd, int dest_fd, off_t size);
+// Fonction pour copier la plage [start, size) d'un fichier à la même position en conservant ses trous
+// (la taille de la destination est fixée à size ; la plage ne doit encore contenir aucune donnée)
+int copy_sparse_range(int src_fd, int dest_fd, off_t start, off_t size);
+// Fonction pour copier propriétaire, permissions, attributs étendus et dates d'un fichier ouvert
+void copy_fd_metadata(int src_fd, int dest_fd, const struct stat *st);
+// Fonction pour copier propriétaire, permissions et dates d'un chemin (sans suivre les liens)
+void copy_path_metadata(const char *src, const char *dest, const struct stat *st);
+// Fonction pour recréer un lien symbolique à l'identique
+int copy_symlink(const char *src, const char *dest);
+
+#endif // METADATA_H
@@ -2,24 +2,46 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
 #include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
 #include <time.h>
+#include <libgen.h>
 #include "file_handler.h"
+#include "metadata.h"
+#include "network.h"
+#include "throttle.h"
+#include "seal.h"
+#include "deduplication.h"
 
 #define BUFFER_SIZE 1024
 
-// Fonction pour récupérer les informations sur les sauvegardes depuis un serveur
-void find_backup_logs_remote(const char *server_address, int server_port, const char *backup_dir) {
+// Taille des lectures des réponses texte du serveur
+#define RESPONSE_BUFFER_SIZE (64 * 1024)
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+// Nombre de connexions parallèles des restaurations (--streams) et taille des tampons des sockets (--net-buffer)
+static int stream_count = NET_DEFAULT_STREAMS;
+static int socket_buffer = 0;
+
+// Fonction pour ouvrir une connexion vers le serveur de sauvegarde
+// Retourne le descripteur du socket ou -1 en cas d'erreur
+static int connect_to_server(const char *server_address, int server_port) {
     int sockfd;
     struct sockaddr_in server_addr;
-    char buffer[BUFFER_SIZE];
-    int bytes_received;
 
     // Création du socket
     sockfd = socket(AF_INET, SOCK_STREAM, 0);
     if (sockfd < 0) {
         perror("Erreur lors de la création du socket");
-        return;
+        return -1;
     }
 
     server_addr.sin_family = AF_INET;
@@ -27,36 +49,722 @@ void find_backup_logs_remote(const char *server_address, int server_port, const
     if (inet_pton(AF_INET, server_address, &server_addr.sin_addr) <= 0) {
         perror("Adresse du serveur invalide");
         close(sockfd);
-        return;
+        return -1;
     }
 
     // Connexion au serveur
     if (connect(sockfd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
         perror("Erreur lors de la connexion au serveur");
         close(sockfd);
-        return;
+        return -1;
     }
 
-    // Envoyer le chemin du répertoire au serveur
-    send(sockfd, backup_dir, strlen(backup_dir), 0);
+    return sockfd;
+}
+
+// Fonction pour afficher la réponse du serveur jusqu'au marqueur de fin "FIN"
+static void print_server_response(int sockfd) {
+    char buffer[RESPONSE_BUFFER_SIZE];
+    int bytes_received;
 
-    // Recevoir et afficher les données ligne par ligne
-    printf("Logs des sauvegardes reçus du serveur :\n");
     while ((bytes_received = recv(sockfd, buffer, sizeof(buffer) - 1, 0)) > 0) {
+        throttle_consume(THROTTLE_NETWORK, bytes_received);
         buffer[bytes_received] = '\0'; // Terminer la chaîne reçue
-        if (strcmp(buffer, "FIN") == 0) break; // Fin de transmission
+        // Le marqueur de fin peut arriver collé aux dernières données
+        if (bytes_received >= 3 && strcmp(buffer + bytes_received - 3, "FIN") == 0) {
+            buffer[bytes_received - 3] = '\0';
+            printf("%s", buffer);
+            break;
+        }
         printf("%s", buffer);
     }
 
     if (bytes_received < 0) {
         perror("Erreur lors de la réception des données");
     }
+}
+
+// Fonction pour récupérer les informations sur les sauvegardes depuis un serveur
+void find_backup_logs_remote(const char *server_address, int server_port, const char *backup_dir) {
+    int sockfd = connect_to_server(server_address, server_port);
+    if (sockfd < 0) {
+        return;
+    }
+
+    // Envoyer le chemin du répertoire au serveur
+    send(sockfd, backup_dir, strlen(backup_dir), 0);
+
+    // Recevoir et afficher les données ligne par ligne
+    printf("Logs des sauvegardes reçus du serveur :\n");
+    print_server_response(sockfd);
 
     close(sockfd);
 }
 
+// Fonction pour demander au serveur la différence entre deux sauvegardes
+void diff_backups_remote(const char *server_address, int server_port,
+                         const char *snapshot_a, const char *snapshot_b) {
+    int sockfd = connect_to_server(server_address, server_port);
+    if (sockfd < 0) {
+        return;
+    }
+
+    // Requête au format "DIFF\n<sauvegarde A>\n<sauvegarde B>"
+    char request[BUFFER_SIZE];
+    int len = snprintf(request, sizeof(request), "%s\n%s\n%s", REQUEST_DIFF, snapshot_a, snapshot_b);
+    if (len >= (int)sizeof(request)) {
+        fprintf(stderr, "Chemins de sauvegarde trop longs pour la requête\n");
+        close(sockfd);
+        return;
+    }
+    send(sockfd, request, len, 0);
+
+    print_server_response(sockfd);
+    close(sockfd);
+}
+
+// Fonction pour chercher dans le catalogue d'un répertoire de sauvegarde du serveur les sauvegardes
+// contenant les chemins correspondant au motif
+void find_in_catalog_remote(const char *server_address, int server_port, const char *backup_dir,
+                            const char *pattern) {
+    int sockfd = connect_to_server(server_address, server_port);
+    if (sockfd < 0) {
+        return;
+    }
+
+    // Requête au format "FIND\n<backup_dir>\n<motif>"
+    char request[BUFFER_SIZE];
+    int len = snprintf(request, sizeof(request), "%s\n%s\n%s", REQUEST_FIND, backup_dir, pattern);
+    if (len >= (int)sizeof(request)) {
+        fprintf(stderr, "Requête de recherche trop longue\n");
+        close(sockfd);
+        return;
+    }
+    send(sockfd, request, len, 0);
+
+    print_server_response(sockfd);
+    close(sockfd);
+}
+
+// Fichier annoncé par le serveur, reconstitué à partir de morceaux reçus dans n'importe quel ordre
+typedef struct {
+    char *path;               // Chemin relatif dans la sauvegarde
+    char *dest_path;
+    long long size;           // Taille stockée (chiffrée ou non)
+    int fd;                   // Destination (-1 si refusée : les morceaux reçus sont ignorés)
+    int remaining;            // Morceaux pas encore écrits
+    int unreadable;           // 1 si le serveur n'a pas pu lire l'un de ses morceaux
+} RemoteFile;
+
+// Morceau d'un fichier à demander sur l'un des flux
+typedef struct {
+    int file;
+    long long offset;
+    long long length;
+} RemotePiece;
+
+// Élément ou répertoire annoncé par le serveur, recréé (liens) et complété (métadonnées) après les transferts
+typedef struct {
+    char *path;
+    int dir;                  // 1 pour un répertoire
+    log_element meta;         // Mode, propriétaire, dates, cible de lien, premier chemin d'un lien dur
+} RemoteEntry;
+
+// Lot de morceaux consécutifs demandés ensemble sur un flux
+typedef struct {
+    int first;
+    int count;
+} RemoteBatch;
+
+// État partagé entre les flux d'une restauration depuis le serveur
+typedef struct {
+    const char *server_address;
+    int server_port;
+    char request[BUFFER_SIZE];  // Requête d'ouverture d'un flux
+    int request_len;
+    RemoteFile *files;
+    int file_count;
+    RemoteEntry *entries;
+    int entry_count;
+    RemotePiece *pieces;
+    int piece_count;
+    int next_piece;           // Prochain morceau à demander
+    RemoteBatch *retry;       // Lots d'un flux interrompu, à redemander sur un autre flux
+    int retry_count;
+    int retry_capacity;
+    int in_flight;            // Lots demandés dont les réponses ne sont pas encore toutes reçues
+    int restored;
+    int unreadable;           // Fichiers que le serveur n'a pas pu lire
+    long long received;
+    int failed_streams;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;   // Un lot est terminé ou remis en attente
+} RemoteRestore;
+
+// Fonction pour choisir le nombre de connexions parallèles des restaurations depuis le serveur
+void network_set_streams(int streams) {
+    stream_count = streams > 0 ? streams : 1;
+}
+
+// Fonction pour fixer la taille des tampons d'émission et de réception des sockets (0 : réglage automatique)
+void network_set_socket_buffer(int bytes) {
+    socket_buffer = bytes > 0 ? bytes : 0;
+}
+
+// Fonction pour régler un socket de transfert
+void network_tune_socket(int sockfd) {
+    // Les lots de requêtes partent immédiatement, sans attendre l'acquittement des envois précédents
+    int one = 1;
+    setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    // Une taille fixée désactive le réglage automatique du noyau, qui peut monter plus haut
+    // sur les liens à fort produit débit × latence : elle n'est appliquée que sur demande
+    if (socket_buffer > 0) {
+        static int warned = 0;
+        int actual = 0;
+        socklen_t len = sizeof(actual);
+        setsockopt(sockfd, SOL_SOCKET, SO_SNDBUF, &socket_buffer, sizeof(socket_buffer));
+        setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &socket_buffer, sizeof(socket_buffer));
+        if (getsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &actual, &len) == 0 && actual < socket_buffer &&
+            !__atomic_exchange_n(&warned, 1, __ATOMIC_RELAXED)) {
+            fprintf(stderr, "Tampons des sockets limités à %d octets par le noyau (net.core.rmem_max)\n", actual);
+        }
+    }
+}
+
+// Fonction pour envoyer len octets sur le socket ; retourne 0 en cas de succès
+static int send_all(int sockfd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t sent = send(sockfd, data, len, 0);
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent <= 0) {
+            perror("Erreur lors de l'envoi au serveur");
+            return -1;
+        }
+        data += sent;
+        len -= sent;
+    }
+    return 0;
+}
+
+// Fonction pour lire la liste des fichiers à restaurer ("FILE <taille> <chemin>" jusqu'à "FIN")
+static int read_remote_manifest(RemoteRestore *restore, const char *backup_id, const char *pattern) {
+    int sockfd = connect_to_server(restore->server_address, restore->server_port);
+    if (sockfd < 0) {
+        return -1;
+    }
+
+    char request[BUFFER_SIZE];
+    int len = snprintf(request, sizeof(request), "%s\n%s\n%s", REQUEST_MANIFEST, backup_id, pattern ? pattern : "");
+    if (send_all(sockfd, request, len) != 0) {
+        close(sockfd);
+        return -1;
+    }
+
+    FILE *in = fdopen(sockfd, "r");
+    if (!in) {
+        perror("Erreur lors de la lecture de la réponse du serveur");
+        close(sockfd);
+        return -1;
+    }
+
+    char header[PATH_MAX + 64];
+    char *fields = NULL;
+    size_t fields_size = 0;
+    int capacity = 0, entry_capacity = 0, complete = 0;
+    while (fgets(header, sizeof(header), in)) {
+        header[strcspn(header, "\n")] = 0;
+        if (strcmp(header, "FIN") == 0) {
+            complete = 1;
+            break;
+        }
+
+        // Métadonnées d'un élément ou d'un répertoire : la ligne suivante porte ses champs
+        int dir = strncmp(header, "DIR ", 4) == 0;
+        if (dir || strncmp(header, "ENTRY ", 6) == 0) {
+            if (getline(&fields, &fields_size, in) <= 0 || fields[0] != ';') {
+                fprintf(stderr, "Réponse du serveur invalide : %s\n", header);
+                break;
+            }
+            fields[strcspn(fields, "\n")] = 0;
+            if (restore->entry_count == entry_capacity) {
+                entry_capacity = entry_capacity ? entry_capacity * 2 : 256;
+                RemoteEntry *grown = realloc(restore->entries, entry_capacity * sizeof(RemoteEntry));
+                if (!grown) {
+                    perror("Erreur d'allocation mémoire pour la restauration");
+                    break;
+                }
+                restore->entries = grown;
+            }
+            RemoteEntry *entry = &restore->entries[restore->entry_count++];
+            char *cursor = fields + 1;
+            entry->path = strdup(header + (dir ? 4 : 6));
+            entry->dir = dir;
+            parse_metadata_fields(&cursor, &entry->meta);
+            continue;
+        }
+
+        long long size;
+        int path_start = 0;
+        if (sscanf(header, "FILE %lld %n", &size, &path_start) != 1 || path_start == 0 || size < 0) {
+            fprintf(stderr, "Réponse du serveur invalide : %s\n", header);
+            break;
+        }
+        if (restore->file_count == capacity) {
+            capacity = capacity ? capacity * 2 : 256;
+            RemoteFile *grown = realloc(restore->files, capacity * sizeof(RemoteFile));
+            if (!grown) {
+                perror("Erreur d'allocation mémoire pour la restauration");
+                break;
+            }
+            restore->files = grown;
+        }
+        RemoteFile *file = &restore->files[restore->file_count++];
+        file->path = strdup(header + path_start);
+        file->dest_path = NULL;
+        file->size = size;
+        file->fd = -1;
+        file->remaining = 0;
+        file->unreadable = 0;
+    }
+    free(fields);
+    fclose(in);
+    return complete ? 0 : -1;
+}
+
+// Fonction pour savoir si un chemin annoncé par le serveur reste dans le répertoire de restauration :
+// relatif et sans composant ".." (un nom comme "a..b" est accepté)
+static int safe_remote_path(const char *path) {
+    if (path[0] == '\0' || path[0] == '/') {
+        return 0;
+    }
+    for (const char *part = path; part; part = strchr(part, '/') ? strchr(part, '/') + 1 : NULL) {
+        size_t len = strcspn(part, "/");
+        if (len == 2 && strncmp(part, "..", 2) == 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Fonction pour terminer un fichier dont tous les morceaux ont été écrits
+static void finish_remote_file(RemoteRestore *restore, RemoteFile *file) {
+    if (file->fd < 0) {
+        return;
+    }
+    int ok = close(file->fd) == 0;
+    file->fd = -1;
+    if (file->unreadable) {
+        // Une copie incomplète ne doit pas passer pour le fichier restauré
+        fprintf(stderr, "Fichier illisible sur le serveur, non restauré : %s\n", file->path);
+        unlink(file->dest_path);
+        pthread_mutex_lock(&restore->lock);
+        restore->unreadable++;
+        pthread_mutex_unlock(&restore->lock);
+        return;
+    }
+    if (!ok) {
+        perror("Erreur lors de l'écriture du fichier restauré");
+        return;
+    }
+    // Le serveur transmet les données telles qu'elles sont stockées : une copie chiffrée est déchiffrée ici
+    if (seal_unseal_file(file->dest_path) != 0) {
+        fprintf(stderr, "Impossible de déchiffrer %s\n", file->dest_path);
+        return;
+    }
+    printf("Restauration de %s\n", file->dest_path);
+    pthread_mutex_lock(&restore->lock);
+    restore->restored++;
+    pthread_mutex_unlock(&restore->lock);
+}
+
+// Fonction pour créer les fichiers de destination à leur taille finale et les découper en morceaux
+static int prepare_remote_files(RemoteRestore *restore, const char *restore_dir) {
+    int capacity = 0;
+    for (int i = 0; i < restore->file_count; i++) {
+        RemoteFile *file = &restore->files[i];
+
+        // Refuser les chemins qui sortiraient du répertoire de restauration
+        char dest_path[PATH_MAX];
+        snprintf(dest_path, sizeof(dest_path), "%s/%s", restore_dir, file->path);
+        file->dest_path = strdup(dest_path);
+        if (!safe_remote_path(file->path)) {
+            fprintf(stderr, "Chemin refusé : %s\n", file->path);
+        } else {
+            char dest_dir[PATH_MAX];
+            snprintf(dest_dir, sizeof(dest_dir), "%s", dest_path);
+            dirname(dest_dir);
+            if (make_parent_dirs(dest_dir) == -1 ||
+                (file->fd = open(dest_path, O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0 ||
+                ftruncate(file->fd, file->size) != 0) {
+                perror("Erreur lors de la création du fichier restauré");
+                if (file->fd >= 0) close(file->fd);
+                file->fd = -1;
+            }
+        }
+
+        // Les morceaux d'un fichier refusé sont tout de même demandés : le serveur est à jour,
+        // seul le client écarte les données
+        for (long long offset = 0; offset < file->size; offset += NET_PIECE_SIZE) {
+            if (restore->piece_count == capacity) {
+                capacity = capacity ? capacity * 2 : 1024;
+                RemotePiece *grown = realloc(restore->pieces, capacity * sizeof(RemotePiece));
+                if (!grown) {
+                    perror("Erreur d'allocation mémoire pour la restauration");
+                    return -1;
+                }
+                restore->pieces = grown;
+            }
+            RemotePiece *piece = &restore->pieces[restore->piece_count++];
+            piece->file = i;
+            piece->offset = offset;
+            piece->length = file->size - offset < NET_PIECE_SIZE ? file->size - offset : NET_PIECE_SIZE;
+            file->remaining++;
+        }
+        if (file->remaining == 0) {
+            finish_remote_file(restore, file);
+        }
+    }
+    return 0;
+}
 
+// Fonction pour réserver le prochain lot de morceaux consécutifs ; retourne leur nombre (0 : plus rien à demander)
+// Les lots remis en attente par un flux interrompu passent en premier. Avec wait, un flux sans lot en
+// cours attend que les autres flux aient terminé les leurs, qui peuvent encore être remis en attente
+static int take_batch(RemoteRestore *restore, int *first, int wait) {
+    pthread_mutex_lock(&restore->lock);
+    int count = 0;
+    while (1) {
+        if (restore->retry_count > 0) {
+            RemoteBatch *batch = &restore->retry[--restore->retry_count];
+            *first = batch->first;
+            count = batch->count;
+            break;
+        }
+        long long bytes = 0;
+        *first = restore->next_piece;
+        while (*first + count < restore->piece_count && count < NET_BATCH_PIECES && bytes < NET_BATCH_BYTES) {
+            bytes += restore->pieces[*first + count].length;
+            count++;
+        }
+        restore->next_piece += count;
+        if (count > 0 || !wait || restore->in_flight == 0) {
+            break;
+        }
+        pthread_cond_wait(&restore->changed, &restore->lock);
+    }
+    if (count > 0) {
+        restore->in_flight++;
+    }
+    pthread_mutex_unlock(&restore->lock);
+    return count;
+}
 
+// Fonction pour terminer un lot réservé ; les morceaux [first + done, first + count) non reçus
+// sont remis en attente pour les autres flux
+static void end_batch(RemoteRestore *restore, int first, int count, int done) {
+    pthread_mutex_lock(&restore->lock);
+    if (done < count) {
+        if (restore->retry_count == restore->retry_capacity) {
+            int capacity = restore->retry_capacity ? restore->retry_capacity * 2 : 16;
+            RemoteBatch *grown = realloc(restore->retry, capacity * sizeof(RemoteBatch));
+            if (grown) {
+                restore->retry = grown;
+                restore->retry_capacity = capacity;
+            }
+        }
+        if (restore->retry_count < restore->retry_capacity) {
+            restore->retry[restore->retry_count].first = first + done;
+            restore->retry[restore->retry_count].count = count - done;
+            restore->retry_count++;
+        }
+    }
+    restore->in_flight--;
+    pthread_cond_broadcast(&restore->changed);
+    pthread_mutex_unlock(&restore->lock);
+}
 
+// Fonction pour envoyer en un seul message les requêtes d'un lot, suivies de "FLUSH"
+static int send_batch(int sockfd, RemoteRestore *restore, int first, int count) {
+    char *text = malloc((size_t)count * 64 + 16);
+    if (!text) {
+        perror("Erreur d'allocation mémoire pour la restauration");
+        return -1;
+    }
+    int len = 0;
+    for (int i = first; i < first + count; i++) {
+        const RemotePiece *piece = &restore->pieces[i];
+        len += sprintf(text + len, "GET %d %lld %lld\n", piece->file, piece->offset, piece->length);
+    }
+    len += sprintf(text + len, "FLUSH\n");
+    int result = send_all(sockfd, text, len);
+    free(text);
+    return result;
+}
 
+// Fonction pour recevoir les réponses d'un lot et écrire chaque morceau à sa place dans son fichier
+// Retourne le nombre de morceaux reçus (moins que count si la connexion est interrompue)
+static int receive_batch(FILE *in, RemoteRestore *restore, int first, int count, unsigned char *buffer) {
+    for (int i = first; i < first + count; i++) {
+        const RemotePiece *piece = &restore->pieces[i];
+        RemoteFile *file = &restore->files[piece->file];
+        char header[128];
+        int file_index, unreadable = 0;
+        long long offset, length;
+        if (!fgets(header, sizeof(header), in)) {
+            fprintf(stderr, "Connexion interrompue pendant la réception de %s\n", file->path);
+            return i - first;
+        }
+        if (sscanf(header, "ILLISIBLE %d %lld %lld", &file_index, &offset, &length) == 3) {
+            unreadable = 1;
+        } else if (sscanf(header, "DATA %d %lld %lld", &file_index, &offset, &length) != 3) {
+            file_index = -1;
+        }
+        if (file_index != piece->file || offset != piece->offset || length != piece->length) {
+            fprintf(stderr, "Réponse du serveur invalide pendant la restauration\n");
+            return i - first;
+        }
+        if (!unreadable && fread(buffer, 1, length, in) != (size_t)length) {
+            fprintf(stderr, "Connexion interrompue pendant la réception de %s\n", file->path);
+            return i - first;
+        }
+        if (!unreadable) {
+            throttle_consume(THROTTLE_NETWORK, length);
+        }
 
+        // Les morceaux arrivent sur plusieurs flux : chacun est écrit à son offset
+        if (!unreadable && file->fd >= 0) {
+            for (long long written = 0; written < length;) {
+                ssize_t bytes = pwrite(file->fd, buffer + written, length - written, offset + written);
+                if (bytes <= 0) {
+                    perror("Erreur lors de l'écriture du fichier restauré");
+                    break;
+                }
+                written += bytes;
+            }
+            throttle_consume(THROTTLE_WRITE, length);
+        }
+
+        pthread_mutex_lock(&restore->lock);
+        if (unreadable) {
+            file->unreadable = 1;
+        } else {
+            restore->received += length;
+        }
+        int done = --file->remaining == 0;
+        pthread_mutex_unlock(&restore->lock);
+        if (done) {
+            finish_remote_file(restore, file);
+        }
+    }
+    return count;
+}
+
+// Thread d'un flux : demande les lots de morceaux restants en gardant toujours un lot d'avance
+static void *remote_stream_worker(void *arg) {
+    RemoteRestore *restore = (RemoteRestore *)arg;
+    int ok = 0;
+    FILE *in = NULL;
+    unsigned char *buffer = malloc(NET_PIECE_SIZE);
+
+    int sockfd = connect_to_server(restore->server_address, restore->server_port);
+    if (sockfd >= 0 && buffer) {
+        network_tune_socket(sockfd);
+        in = send_all(sockfd, restore->request, restore->request_len) == 0 ? fdopen(dup(sockfd), "r") : NULL;
+    }
+
+    // Le serveur confirme qu'il transmet la même liste de fichiers que le manifeste
+    char line[64];
+    int file_count;
+    if (in && fgets(line, sizeof(line), in) && sscanf(line, "OK %d", &file_count) == 1) {
+        if (file_count == restore->file_count) {
+            ok = 1;
+        } else {
+            fprintf(stderr, "Liste de fichiers du serveur modifiée pendant la restauration\n");
+        }
+    }
+
+    // Un flux interrompu remet ses lots en attente : les autres flux les redemandent
+    int first, count = ok ? take_batch(restore, &first, 1) : 0;
+    if (count > 0 && send_batch(sockfd, restore, first, count) != 0) {
+        end_batch(restore, first, count, 0);
+        ok = 0;
+    }
+    while (ok && count > 0) {
+        // Le lot suivant est demandé avant de recevoir le lot en cours
+        int next_first, next_count = take_batch(restore, &next_first, 0);
+        if (next_count > 0 && send_batch(sockfd, restore, next_first, next_count) != 0) {
+            end_batch(restore, next_first, next_count, 0);
+            next_count = 0;
+            ok = 0;
+        }
+        int received = ok ? receive_batch(in, restore, first, count, buffer) : 0;
+        end_batch(restore, first, count, received);
+        if (received < count) {
+            if (next_count > 0) end_batch(restore, next_first, next_count, 0);
+            ok = 0;
+            break;
+        }
+        // Sans lot d'avance, le flux attend les lots que d'autres flux pourraient remettre en attente
+        if (next_count == 0) {
+            next_count = take_batch(restore, &next_first, 1);
+            if (next_count > 0 && send_batch(sockfd, restore, next_first, next_count) != 0) {
+                end_batch(restore, next_first, next_count, 0);
+                ok = 0;
+            }
+        }
+        first = next_first;
+        count = next_count;
+    }
+    if (ok) {
+        ok = send_all(sockfd, "END\n", 4) == 0 && fgets(line, sizeof(line), in) && strcmp(line, "FIN\n") == 0;
+    }
+
+    if (!ok) {
+        pthread_mutex_lock(&restore->lock);
+        restore->failed_streams++;
+        pthread_mutex_unlock(&restore->lock);
+    }
+    if (in) fclose(in);
+    if (sockfd >= 0) close(sockfd);
+    free(buffer);
+    return NULL;
+}
+
+// Fonction pour recréer les liens et les répertoires annoncés par le serveur, puis appliquer les métadonnées
+// Les liens durs sont faits vers leur premier chemin une fois toutes les données reçues ; les
+// répertoires reçoivent leurs dates en dernier (la création de leur contenu les modifie)
+static void restore_remote_entries(RemoteRestore *restore, const char *restore_dir) {
+    for (int pass = 0; pass < 3; pass++) {
+        for (int i = 0; i < restore->entry_count; i++) {
+            RemoteEntry *entry = &restore->entries[i];
+            const log_element *meta = &entry->meta;
+            char dest_path[PATH_MAX], first_path[PATH_MAX], dest_dir[PATH_MAX];
+            int len = snprintf(dest_path, sizeof(dest_path), "%s/%s", restore_dir, entry->path);
+            if (!safe_remote_path(entry->path) || (meta->hardlink && !safe_remote_path(meta->hardlink)) ||
+                len < 0 || (size_t)len >= sizeof(dest_path)) {
+                if (pass == 0) fprintf(stderr, "Chemin refusé : %s\n", entry->path);
+                continue;
+            }
+
+            if (pass == 0 && entry->dir) {
+                // Les répertoires vides n'ont pas d'autre occasion d'être créés
+                if (make_parent_dirs(dest_path) == -1) {
+                    perror("Erreur lors de la création du répertoire restauré");
+                }
+            } else if (pass == 0 && (meta->link_target || meta->hardlink)) {
+                snprintf(dest_dir, sizeof(dest_dir), "%s", dest_path);
+                if (make_parent_dirs(dirname(dest_dir)) == -1) {
+                    perror("Erreur lors de la création du répertoire restauré");
+                    continue;
+                }
+                unlink(dest_path);
+                if (meta->link_target) {
+                    if (symlink(meta->link_target, dest_path) == -1) {
+                        perror("Erreur lors de la création du lien symbolique");
+                        continue;
+                    }
+                    printf("Création du lien %s -> %s\n", dest_path, meta->link_target);
+                } else {
+                    snprintf(first_path, sizeof(first_path), "%s/%s", restore_dir, meta->hardlink);
+                    if (link(first_path, dest_path) == -1) {
+                        perror("Erreur lors de la création du lien dur");
+                        continue;
+                    }
+                    printf("Création du lien dur %s -> %s\n", dest_path, first_path);
+                }
+                restore->restored++;
+            } else if (pass == 1 && !entry->dir && !meta->hardlink) {
+                // Un fichier écarté (illisible, refusé) n'existe pas : rien à compléter
+                struct stat st;
+                if (lstat(dest_path, &st) == 0) {
+                    apply_file_metadata(dest_path, meta);
+                }
+            } else if (pass == 2 && entry->dir) {
+                apply_file_metadata(dest_path, meta);
+            }
+        }
+    }
+}
+
+// Fonction pour restaurer depuis le serveur les fichiers d'une sauvegarde correspondant au motif
+// Les fichiers sont découpés en morceaux répartis entre plusieurs connexions (--streams), chacune
+// demandant ses morceaux par lots : une seule connexion TCP ne remplit pas un lien à forte latence
+void restore_backup_remote(const char *server_address, int server_port, const char *backup_id,
+                           const char *restore_dir, const char *pattern) {
+    RemoteRestore restore;
+    memset(&restore, 0, sizeof(restore));
+    restore.server_address = server_address;
+    restore.server_port = server_port;
+    restore.request_len = snprintf(restore.request, sizeof(restore.request), "%s\n%s\n%s", REQUEST_STREAM,
+                                   backup_id, pattern ? pattern : "");
+    if (restore.request_len >= (int)sizeof(restore.request)) {
+        fprintf(stderr, "Requête de restauration trop longue\n");
+        return;
+    }
+    pthread_mutex_init(&restore.lock, NULL);
+    pthread_cond_init(&restore.changed, NULL);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    int listed = read_remote_manifest(&restore, backup_id, pattern) == 0 &&
+                 prepare_remote_files(&restore, restore_dir) == 0;
+    if (listed) {
+        int thread_count = stream_count < restore.piece_count ? stream_count : restore.piece_count;
+
+        pthread_t *threads = malloc(thread_count * sizeof(pthread_t));
+        int launched = 0;
+        for (int i = 0; threads && i < thread_count && restore.piece_count > 0; i++) {
+            if (pthread_create(&threads[launched], NULL, remote_stream_worker, &restore) == 0) {
+                launched++;
+            }
+        }
+        if (launched == 0 && restore.piece_count > 0) {
+            remote_stream_worker(&restore);
+        }
+        for (int i = 0; i < launched; i++) {
+            pthread_join(threads[i], NULL);
+        }
+        free(threads);
+    } else {
+        fprintf(stderr, "Impossible d'obtenir la liste des fichiers à restaurer\n");
+    }
+
+    // Un flux interrompu laisse des morceaux non reçus : ces fichiers sont signalés incomplets
+    for (int i = 0; i < restore.file_count; i++) {
+        RemoteFile *file = &restore.files[i];
+        if (file->fd >= 0) {
+            fprintf(stderr, "Fichier incomplet : %s\n", file->dest_path);
+            close(file->fd);
+        }
+        free(file->path);
+        free(file->dest_path);
+    }
+    if (listed) {
+        restore_remote_entries(&restore, restore_dir);
+    }
+    for (int i = 0; i < restore.entry_count; i++) {
+        free(restore.entries[i].path);
+        free_file_metadata(&restore.entries[i].meta);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("%d fichiers restaurés depuis le serveur (%lld octets en %.2f s", restore.restored, restore.received, elapsed);
+    if (restore.failed_streams > 0) {
+        printf(", %d flux interrompu(s)", restore.failed_streams);
+    }
+    if (restore.unreadable > 0) {
+        printf(", %d fichier(s) illisible(s) sur le serveur", restore.unreadable);
+    }
+    printf(").\n");
+    print_dedup_stats(stdout);
+
+    free(restore.files);
+    free(restore.entries);
+    free(restore.pieces);
+    free(restore.retry);
+    pthread_cond_destroy(&restore.changed);
+    pthread_mutex_destroy(&restore.lock);
+}
@@ -1,6 +1,56 @@
 #ifndef NETWORK_H
 #define NETWORK_H
 
+// Préfixe des requêtes de comparaison de sauvegardes envoyées au serveur
+// (toute autre requête est interprétée comme un répertoire de sauvegardes à lister)
+#define REQUEST_DIFF "DIFF"
+
+// Préfixe des requêtes de restauration ("RESTORE\n<sauvegarde>\n<motif>") : le serveur répond
+// par une suite d'enregistrements "FILE <taille> <chemin>\n<données>" terminée par "FIN\n"
+#define REQUEST_RESTORE "RESTORE"
+
+// Préfixe des recherches dans le catalogue des chemins ("FIND\n<backup_dir>\n<motif>") : le serveur
+// répond par le résultat de catalog_find terminé par "FIN"
+#define REQUEST_FIND "FIND"
+
+// Restauration parallèle : le client demande d'abord la liste des fichiers ("MANIFEST\n<sauvegarde>\n<motif>",
+// réponse "FILE <taille stockée> <chemin>" par fichier, puis "ENTRY <chemin>" par élément et "DIR <chemin>"
+// par répertoire, chacun suivi de ses champs de métadonnées au format du log, puis "FIN\n"), puis ouvre plusieurs flux
+// ("STREAM\n<sauvegarde>\n<motif>", réponse "OK <nombre de fichiers>\n") sur lesquels il envoie par lots
+// des requêtes "GET <numéro> <offset> <taille>" suivies de "FLUSH" ; chaque réponse "DATA <numéro> <offset>
+// <taille>\n<données>" arrive dans l'ordre des requêtes du flux, ou "ILLISIBLE <numéro> <offset> <taille>\n"
+// (sans données) si le serveur ne peut pas lire la plage. "END" termine le flux (réponse "FIN\n")
+#define REQUEST_MANIFEST "MANIFEST"
+#define REQUEST_STREAM "STREAM"
+
+// Taille des morceaux de fichier répartis entre les flux (multiple de CHUNK_SIZE)
+#define NET_PIECE_SIZE (512 * 1024)
+
+// Taille maximale d'un lot de requêtes (en morceaux et en octets demandés) ; chaque flux garde
+// deux lots en attente pour que le serveur ait toujours le suivant à traiter pendant un aller-retour
+#define NET_BATCH_PIECES 64
+#define NET_BATCH_BYTES (2 * 1024 * 1024)
+
+// Nombre de flux parallèles par défaut d'une restauration depuis le serveur
+#define NET_DEFAULT_STREAMS 4
+
+// Tampon d'écriture du serveur : les réponses d'un lot de petits fichiers partent en quelques gros envois
+#define NET_SEND_BUFFER (256 * 1024)
+
+// Fonction pour choisir le nombre de connexions parallèles des restaurations depuis le serveur
+void network_set_streams(int streams);
+// Fonction pour fixer la taille des tampons d'émission et de réception des sockets (0 : réglage
+// automatique du noyau, conseillé sauf si net.core.rmem_max / wmem_max ont été augmentés)
+void network_set_socket_buffer(int bytes);
+// Fonction pour régler un socket de transfert (TCP_NODELAY, tampons) ; utilisée par le client et le serveur
+void network_tune_socket(int sockfd);
+
 void find_backup_logs_remote(const char *server_address, int server_port, const char *backup_dir);
+void diff_backups_remote(const char *server_address, int server_port,
+                         const char *snapshot_a, const char *snapshot_b);
+void restore_backup_remote(const char *server_address, int server_port, const char *backup_id,
+                           const char *restore_dir, const char *pattern);
+void find_in_catalog_remote(const char *server_address, int server_port, const char *backup_dir,
+                            const char *pattern);
 
-#endif // NETWORK_H
\ No newline at end of file
+#endif // NETWORK_H
@@ -0,0 +1,248 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <openssl/evp.h>
+#include "pack.h"
+#include "throttle.h"
+#include "seal.h"
+
+// Fonction pour écrire tout un tampon dans le conteneur en cours
+static int pack_write(PackWriter *writer, const void *data, size_t size) {
+    const unsigned char *bytes = data;
+    while (size > 0) {
+        ssize_t written = write(writer->fd, bytes, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            perror("Erreur lors de l'écriture du conteneur");
+            return -1;
+        }
+        throttle_consume(THROTTLE_WRITE, written);
+        bytes += written;
+        size -= written;
+    }
+    return 0;
+}
+
+// Fonction pour écrire les données en attente du conteneur en cours
+static int pack_flush(PackWriter *writer) {
+    if (writer->used == 0) {
+        return 0;
+    }
+    int result = pack_write(writer, writer->buffer, writer->used);
+    writer->used = 0;
+    return result;
+}
+
+// Fonction pour terminer le conteneur en cours : données restantes, index puis fin du conteneur
+static int pack_close_container(PackWriter *writer) {
+    if (writer->fd < 0) {
+        return 0;
+    }
+    PackTrailer trailer;
+    memset(&trailer, 0, sizeof(trailer));
+    memcpy(trailer.magic, PACK_MAGIC, sizeof(trailer.magic));
+    trailer.index_offset = writer->offset;
+    trailer.count = writer->count;
+
+    int result = pack_flush(writer);
+    if (result == 0) result = pack_write(writer, writer->index, writer->index_len);
+    if (result == 0) result = pack_write(writer, &trailer, sizeof(trailer));
+    close(writer->fd);
+    writer->fd = -1;
+    writer->index_len = 0;
+    writer->count = 0;
+    return result;
+}
+
+// Fonction pour commencer un nouveau conteneur
+static int pack_open_container(PackWriter *writer) {
+    char path[PATH_MAX];
+    writer->number++;
+    int len = snprintf(path, sizeof(path), "%s/pack-%06d", writer->dir, writer->number);
+    if (len < 0 || (size_t)len >= sizeof(path)) {
+        fprintf(stderr, "Chemin du conteneur trop long : %s\n", writer->dir);
+        return -1;
+    }
+    writer->fd = open(path, O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if (writer->fd < 0) {
+        perror("Erreur lors de la création du conteneur");
+        return -1;
+    }
+    writer->offset = 0;
+    return 0;
+}
+
+// Fonction pour préparer l'écriture des conteneurs d'une sauvegarde
+int pack_writer_init(PackWriter *writer, const char *snapshot_path, const char *snapshot_name) {
+    memset(writer, 0, sizeof(*writer));
+    writer->fd = -1;
+    writer->snapshot_name = snapshot_name;
+    snprintf(writer->dir, sizeof(writer->dir), "%s/%s", snapshot_path, PACK_DIR);
+    if (mkdir(writer->dir, 0755) != 0 && errno != EEXIST) {
+        perror("Erreur lors de la création du répertoire des conteneurs");
+        return -1;
+    }
+    writer->buffer = malloc(PACK_BUFFER_SIZE);
+    // Avec --encrypt-key, chaque fichier est lu en clair puis chiffré dans le tampon d'écriture
+    writer->plain = seal_enabled() ? malloc(PACK_FILE_MAX) : NULL;
+    if (!writer->buffer || (seal_enabled() && !writer->plain)) {
+        perror("Erreur d'allocation mémoire pour les conteneurs");
+        return -1;
+    }
+    return 0;
+}
+
+// Fonction pour ajouter un fichier au conteneur en cours
+off_t pack_writer_add(PackWriter *writer, int fd, off_t size, const char *relative,
+                      unsigned char *md5, char *ref, size_t ref_size) {
+    if (size < 0 || size > PACK_FILE_MAX) {
+        return -1;
+    }
+    off_t stored_max = writer->plain ? seal_stored_size(size) : size;
+    if (writer->fd >= 0 && writer->offset + stored_max > PACK_CONTAINER_SIZE && pack_close_container(writer) != 0) {
+        return -1;
+    }
+    if (writer->fd < 0 && pack_open_container(writer) != 0) {
+        return -1;
+    }
+    if (writer->used + stored_max > PACK_BUFFER_SIZE && pack_flush(writer) != 0) {
+        return -1;
+    }
+
+    // Le fichier est lu directement à la suite des données en attente (ou à part s'il est chiffré)
+    unsigned char *data = writer->plain ? writer->plain : writer->buffer + writer->used;
+    off_t length = 0;
+    while (length < size) {
+        ssize_t bytes = read(fd, data + length, size - length);
+        if (bytes < 0) {
+            if (errno == EINTR) continue;
+            perror("Erreur lors de la lecture du fichier à regrouper");
+            return -1;
+        }
+        if (bytes == 0) break; // Fichier raccourci depuis son parcours
+        length += bytes;
+    }
+    throttle_consume(THROTTLE_READ, length);
+    EVP_Digest(data, length, md5, NULL, EVP_md5(), NULL);
+
+    // Taille occupée dans le conteneur (données chiffrées avec --encrypt-key)
+    off_t stored = length;
+    if (writer->plain) {
+        stored = seal_buffer(data, length, writer->buffer + writer->used);
+        if (stored < 0) {
+            fprintf(stderr, "Erreur lors du chiffrement du fichier à regrouper\n");
+            return -1;
+        }
+    }
+
+    // Ligne de l'index du conteneur
+    size_t line_size = strlen(relative) + 64;
+    if (writer->index_len + line_size > writer->index_capacity) {
+        size_t capacity = writer->index_capacity ? writer->index_capacity * 2 : 64 * 1024;
+        while (capacity < writer->index_len + line_size) capacity *= 2;
+        char *grown = realloc(writer->index, capacity);
+        if (!grown) {
+            perror("Erreur d'allocation mémoire pour l'index du conteneur");
+            return -1;
+        }
+        writer->index = grown;
+        writer->index_capacity = capacity;
+    }
+    writer->index_len += snprintf(writer->index + writer->index_len, line_size, "%lld;%lld;%s\n",
+                                  (long long)writer->offset, (long long)stored, relative);
+
+    snprintf(ref, ref_size, "%s/%s/pack-%06d@%lld", writer->snapshot_name, PACK_DIR, writer->number,
+             (long long)writer->offset);
+    writer->used += stored;
+    writer->offset += stored;
+    writer->count++;
+    writer->packed++;
+    return length;
+}
+
+// Fonction pour terminer le dernier conteneur et libérer l'écriture
+int pack_writer_finish(PackWriter *writer) {
+    int result = pack_close_container(writer);
+    free(writer->buffer);
+    free(writer->plain);
+    free(writer->index);
+    writer->buffer = NULL;
+    writer->plain = NULL;
+    writer->index = NULL;
+    return result;
+}
+
+// Une référence vers un conteneur a la forme "<sauvegarde>/.packs/pack-NNNNNN@<offset>"
+int pack_ref_is_packed(const char *stored) {
+    return stored && strchr(stored, '@') != NULL;
+}
+
+// Fonction pour retrouver les données d'un élément du log de la sauvegarde snapshot
+// Un fichier repris par une sauvegarde par manifeste est stocké dans une sauvegarde voisine (elt->stored),
+// un fichier regroupé est une plage d'un conteneur
+void stored_data_locate(const char *backup_dir, const char *snapshot, const log_element *elt, StoredData *data) {
+    data->offset = 0;
+    data->length = -1;
+    if (!pack_ref_is_packed(elt->stored)) {
+        snprintf(data->path, sizeof(data->path), "%s/%s/%s", backup_dir, elt->stored ? elt->stored : snapshot, elt->path);
+        return;
+    }
+    const char *at = strrchr(elt->stored, '@');
+    snprintf(data->path, sizeof(data->path), "%s/%.*s", backup_dir, (int)(at - elt->stored), elt->stored);
+    data->offset = strtoll(at + 1, NULL, 10);
+    data->length = elt->size > 0 ? elt->size : 0;
+}
+
+// Fonction pour lire length octets à offset dans fd ; retourne le nombre d'octets lus
+static size_t pack_pread(int fd, unsigned char *buffer, size_t length, off_t offset) {
+    size_t done = 0;
+    while (done < length) {
+        ssize_t bytes = pread(fd, buffer + done, length - done, offset + done);
+        if (bytes < 0 && errno == EINTR) continue;
+        if (bytes <= 0) break;
+        done += bytes;
+    }
+    throttle_consume(THROTTLE_READ, done);
+    return done;
+}
+
+// Fonction pour lire les données d'un fichier regroupé
+// Les données chiffrées sont déchiffrées (--encrypt-key nécessaire)
+ssize_t pack_read_entry(const StoredData *data, unsigned char *buffer, size_t size) {
+    int fd = open(data->path, O_RDONLY | O_NOFOLLOW);
+    if (fd < 0) {
+        return -1;
+    }
+    size_t length = (size_t)data->length < size ? (size_t)data->length : size;
+    ssize_t done;
+    if (seal_is_sealed(fd, data->offset, data->length)) {
+        SealReader reader;
+        done = -1;
+        if (seal_reader_attach(&reader, fd, data->offset, data->length) == 0) {
+            done = seal_reader_read(&reader, buffer, length, 0);
+            seal_reader_close(&reader);
+        }
+    } else {
+        done = pack_pread(fd, buffer, length, data->offset);
+    }
+    close(fd);
+    // Un conteneur tronqué est signalé comme illisible
+    return done == (ssize_t)length ? done : -1;
+}
+
+// Fonction pour lire les données d'un fichier regroupé telles qu'elles sont stockées (chiffrées ou non)
+ssize_t pack_read_stored(const StoredData *data, unsigned char *buffer, size_t size) {
+    int fd = open(data->path, O_RDONLY | O_NOFOLLOW);
+    if (fd < 0) {
+        return -1;
+    }
+    size_t length = seal_is_sealed(fd, data->offset, data->length) ? (size_t)seal_stored_size(data->length)
+                                                                    : (size_t)data->length;
+    ssize_t done = length <= size ? (ssize_t)pack_pread(fd, buffer, length, data->offset) : -1;
+    close(fd);
+    return done == (ssize_t)length ? done : -1;
+}
@@ -0,0 +1,81 @@
+#ifndef PACK_H
+#define PACK_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <openssl/md5.h>
+#include "file_handler.h"
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+// Répertoire des conteneurs dans une sauvegarde
+#define PACK_DIR ".packs"
+
+// Taille maximale d'un fichier regroupé dans un conteneur
+#define PACK_FILE_MAX (64 * 1024)
+
+// Place maximale occupée dans un conteneur par un fichier regroupé chiffré (en-tête, nonce et tag)
+#define PACK_STORED_MAX (PACK_FILE_MAX + 128)
+
+// Taille à partir de laquelle un nouveau conteneur est commencé
+#define PACK_CONTAINER_SIZE (64 * 1024 * 1024)
+
+// Taille du tampon d'écriture des conteneurs (écritures séquentielles en gros blocs)
+#define PACK_BUFFER_SIZE (1024 * 1024)
+
+// Signature de la fin d'un conteneur
+#define PACK_MAGIC "LP25PACK"
+
+// Un conteneur contient les données des fichiers bout à bout, puis son index texte
+// (une ligne "offset;taille;chemin" par fichier) et enfin cette structure
+typedef struct {
+    char magic[8];
+    uint64_t index_offset;    // Début de l'index dans le conteneur
+    uint64_t count;           // Nombre de fichiers du conteneur
+} PackTrailer;
+
+// Écriture des conteneurs d'une sauvegarde (à utiliser depuis un seul thread)
+typedef struct {
+    char dir[PATH_MAX];       // Répertoire des conteneurs
+    const char *snapshot_name;
+    int number;               // Numéro du conteneur en cours
+    int fd;                   // Conteneur en cours (-1 si aucun)
+    off_t offset;             // Taille du conteneur en cours
+    unsigned char *buffer;    // Données pas encore écrites
+    unsigned char *plain;     // Fichier lu en clair avant son chiffrement (--encrypt-key, sinon NULL)
+    size_t used;
+    char *index;              // Index du conteneur en cours
+    size_t index_len, index_capacity;
+    uint64_t count;
+    int packed;               // Nombre total de fichiers regroupés
+} PackWriter;
+
+// Emplacement des données d'un fichier sauvegardé
+typedef struct {
+    char path[PATH_MAX];      // Fichier stocké ou conteneur
+    off_t offset;             // Début des données
+    off_t length;             // Taille des données (-1 : tout le fichier)
+} StoredData;
+
+// Fonction pour préparer l'écriture des conteneurs de la sauvegarde snapshot_path (nommée snapshot_name)
+int pack_writer_init(PackWriter *writer, const char *snapshot_path, const char *snapshot_name);
+// Fonction pour ajouter au conteneur les size premiers octets de fd, enregistrés sous le chemin relative
+// Calcule leur MD5 et écrit dans ref la référence à placer dans le log ; retourne la taille ajoutée ou -1
+off_t pack_writer_add(PackWriter *writer, int fd, off_t size, const char *relative,
+                      unsigned char *md5, char *ref, size_t ref_size);
+// Fonction pour terminer le dernier conteneur et libérer l'écriture ; retourne 0 en cas de succès
+int pack_writer_finish(PackWriter *writer);
+
+// Fonction pour savoir si la sauvegarde désignée par un élément du log est un conteneur
+int pack_ref_is_packed(const char *stored);
+// Fonction pour retrouver les données d'un élément du log de la sauvegarde snapshot
+void stored_data_locate(const char *backup_dir, const char *snapshot, const log_element *elt, StoredData *data);
+// Fonction pour lire les données d'un fichier regroupé (au plus size octets) ; retourne la taille lue ou -1
+ssize_t pack_read_entry(const StoredData *data, unsigned char *buffer, size_t size);
+// Fonction pour lire les données d'un fichier regroupé telles qu'elles sont stockées, chiffrées ou non
+// (au plus size octets, PACK_STORED_MAX suffit) ; retourne la taille lue ou -1
+ssize_t pack_read_stored(const StoredData *data, unsigned char *buffer, size_t size);
+
+#endif // PACK_H
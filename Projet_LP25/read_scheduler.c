@@ -0,0 +1,225 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#include <linux/fiemap.h>
+#include "read_scheduler.h"
+#include "metadata.h"
+
+static ReadOrder read_order = READ_ORDER_DIRECTORY;
+
+// Fonction pour choisir l'ordre de lecture des parcours suivants
+void read_scheduler_set_order(ReadOrder order) {
+    read_order = order;
+}
+
+// Fonction pour lire un ordre de lecture ("directory", "inode" ou "extent")
+int parse_read_order(const char *text, ReadOrder *order) {
+    if (strcmp(text, "directory") == 0) {
+        *order = READ_ORDER_DIRECTORY;
+    } else if (strcmp(text, "inode") == 0) {
+        *order = READ_ORDER_INODE;
+    } else if (strcmp(text, "extent") == 0) {
+        *order = READ_ORDER_EXTENT;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+// Fonction pour retrouver l'adresse physique du premier extent d'un fichier
+// Retourne 0 si elle est inconnue (fichier vide, données en ligne, FIEMAP non supporté)
+static unsigned long long first_extent(const char *path) {
+    int fd = open(path, O_RDONLY | O_NOFOLLOW | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        return 0;
+    }
+
+    struct {
+        struct fiemap map;
+        struct fiemap_extent extent;
+    } request;
+    memset(&request, 0, sizeof(request));
+    request.map.fm_start = 0;
+    request.map.fm_length = FIEMAP_MAX_OFFSET;
+    request.map.fm_extent_count = 1;
+
+    unsigned long long physical = 0;
+    if (ioctl(fd, FS_IOC_FIEMAP, &request.map) == 0 && request.map.fm_mapped_extents > 0 &&
+        !(request.extent.fe_flags & FIEMAP_EXTENT_UNKNOWN)) {
+        physical = request.extent.fe_physical;
+    }
+    close(fd);
+    return physical;
+}
+
+static int compare_jobs(const void *a, const void *b) {
+    const ReadJob *job1 = a, *job2 = b;
+    if (job1->key != job2->key) {
+        return job1->key < job2->key ? -1 : 1;
+    }
+    // Les chemins d'un même inode restent dans l'ordre du parcours (copie puis liens durs)
+    return job1->seq < job2->seq ? -1 : job1->seq > job2->seq;
+}
+
+// Fonction pour annoncer au noyau la lecture prochaine d'un fichier
+static void prefetch(const ReadJob *job) {
+    if (!S_ISREG(job->st.st_mode) || job->st.st_size == 0) {
+        return;
+    }
+    int fd = open(job->path, O_RDONLY | O_NOFOLLOW | O_NONBLOCK | O_CLOEXEC);
+    if (fd >= 0) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+        close(fd);
+    }
+}
+
+// Fonction pour préparer une file de lectures
+void read_scheduler_init(ReadScheduler *sched, ReadJobFunction function, void *arg) {
+    memset(sched, 0, sizeof(*sched));
+    sched->order = read_order;
+    sched->function = function;
+    sched->arg = arg;
+    sched->workers = 1;
+    pthread_mutex_init(&sched->lock, NULL);
+}
+
+// Fonction pour traiter chaque lot avec plusieurs threads
+void read_scheduler_set_workers(ReadScheduler *sched, int workers) {
+    sched->workers = workers > 1 ? workers : 1;
+}
+
+// Les fichiers sont mis en attente pour être triés ou répartis entre les threads
+static int read_scheduler_batched(const ReadScheduler *sched) {
+    return sched->order != READ_ORDER_DIRECTORY || sched->workers > 1;
+}
+
+// Fonction pour ajouter la lecture de path
+void read_scheduler_add(ReadScheduler *sched, const char *path, const struct stat *st, const char *dest) {
+    ReadJob job;
+    job.path = (char *)path;
+    job.dest = (char *)dest;
+    job.st = *st;
+    job.seq = sched->seq++;
+    job.key = 0;
+
+    if (!read_scheduler_batched(sched)) {
+        sched->function(&job, sched->arg);
+        return;
+    }
+
+    if (!sched->jobs) {
+        sched->jobs = malloc(READ_SCHEDULER_WINDOW * sizeof(ReadJob));
+        if (!sched->jobs) {
+            sched->function(&job, sched->arg);
+            return;
+        }
+    }
+
+    if (sched->order == READ_ORDER_EXTENT) {
+        job.key = first_extent(path);
+    }
+    if (job.key == 0 && sched->order != READ_ORDER_DIRECTORY) {
+        // Sans extent connu, l'inode donne une bonne approximation de l'emplacement
+        job.key = (unsigned long long)st->st_ino;
+    }
+    job.path = strdup(path);
+    job.dest = dest ? strdup(dest) : NULL;
+    sched->jobs[sched->count++] = job;
+
+    if (sched->count == READ_SCHEDULER_WINDOW) {
+        read_scheduler_flush(sched);
+    }
+}
+
+// Thread de traitement d'un lot : prend les fichiers un par un dans l'ordre du lot
+static void *read_scheduler_worker(void *arg) {
+    ReadScheduler *sched = arg;
+    for (;;) {
+        pthread_mutex_lock(&sched->lock);
+        int i = sched->next++;
+        pthread_mutex_unlock(&sched->lock);
+        if (i >= sched->count) break;
+
+        if (i + READ_SCHEDULER_LOOKAHEAD < sched->count) {
+            prefetch(&sched->jobs[i + READ_SCHEDULER_LOOKAHEAD]);
+        }
+        sched->function(&sched->jobs[i], sched->arg);
+        free(sched->jobs[i].path);
+        free(sched->jobs[i].dest);
+    }
+    return NULL;
+}
+
+// Fonction pour traiter les lectures en attente, triées dans l'ordre choisi
+void read_scheduler_flush(ReadScheduler *sched) {
+    if (sched->count == 0) {
+        return;
+    }
+    qsort(sched->jobs, sched->count, sizeof(ReadJob), compare_jobs);
+
+    // Le noyau lit en avance les fichiers suivants pendant le traitement du fichier courant
+    for (int i = 0; i < sched->count && i < READ_SCHEDULER_LOOKAHEAD; i++) {
+        prefetch(&sched->jobs[i]);
+    }
+
+    sched->next = 0;
+    int workers = sched->workers < sched->count ? sched->workers : sched->count;
+    pthread_t threads[workers > 1 ? workers - 1 : 1];
+    int launched = 0;
+    for (int i = 0; i < workers - 1; i++) {
+        if (pthread_create(&threads[launched], NULL, read_scheduler_worker, sched) == 0) {
+            launched++;
+        }
+    }
+    // Le thread du parcours traite aussi le lot
+    read_scheduler_worker(sched);
+    for (int i = 0; i < launched; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    sched->count = 0;
+}
+
+// Fonction pour copier les métadonnées du répertoire src sur dest après les lectures en attente
+void read_scheduler_defer_dir(ReadScheduler *sched, const char *src, const char *dest, const struct stat *st) {
+    if (!read_scheduler_batched(sched)) {
+        copy_path_metadata(src, dest, st);
+        return;
+    }
+    if (sched->dir_count == sched->dir_capacity) {
+        int capacity = sched->dir_capacity ? sched->dir_capacity * 2 : 64;
+        DeferredDir *grown = realloc(sched->dirs, capacity * sizeof(DeferredDir));
+        if (!grown) {
+            copy_path_metadata(src, dest, st);
+            return;
+        }
+        sched->dirs = grown;
+        sched->dir_capacity = capacity;
+    }
+    DeferredDir *dir = &sched->dirs[sched->dir_count++];
+    dir->src = strdup(src);
+    dir->dest = strdup(dest);
+    dir->st = *st;
+}
+
+// Fonction pour terminer un parcours : lectures restantes puis métadonnées des répertoires
+void read_scheduler_finish(ReadScheduler *sched) {
+    read_scheduler_flush(sched);
+    free(sched->jobs);
+    sched->jobs = NULL;
+
+    // Les répertoires ont été ajoutés après leur contenu : les plus profonds d'abord
+    for (int i = 0; i < sched->dir_count; i++) {
+        copy_path_metadata(sched->dirs[i].src, sched->dirs[i].dest, &sched->dirs[i].st);
+        free(sched->dirs[i].src);
+        free(sched->dirs[i].dest);
+    }
+    free(sched->dirs);
+    sched->dirs = NULL;
+    sched->dir_count = sched->dir_capacity = 0;
+    pthread_mutex_destroy(&sched->lock);
+}
@@ -0,0 +1,76 @@
+#ifndef READ_SCHEDULER_H
+#define READ_SCHEDULER_H
+
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+// Nombre de fichiers accumulés avant d'être triés et lus
+#define READ_SCHEDULER_WINDOW 1024
+
+// Nombre de fichiers annoncés à l'avance au noyau (posix_fadvise WILLNEED)
+#define READ_SCHEDULER_LOOKAHEAD 8
+
+// Ordre de lecture des fichiers lors des parcours de sauvegarde
+typedef enum {
+    READ_ORDER_DIRECTORY,     // Ordre du répertoire, sans attente (SSD)
+    READ_ORDER_INODE,         // Par numéro d'inode (proche de l'ordre physique sur ext4/XFS)
+    READ_ORDER_EXTENT         // Par adresse physique du premier extent (FIEMAP), disques rotatifs
+} ReadOrder;
+
+// Lecture planifiée d'un fichier
+typedef struct {
+    char *path;               // Fichier lu
+    char *dest;               // Destination associée (copie, comparaison), NULL sinon
+    struct stat st;
+    unsigned long long key;   // Clé de tri (inode ou adresse physique)
+    unsigned long seq;        // Ordre d'ajout, pour un tri stable
+} ReadJob;
+
+typedef void (*ReadJobFunction)(const ReadJob *job, void *arg);
+
+// Métadonnées de répertoire à appliquer une fois toutes les lectures terminées
+typedef struct {
+    char *src;
+    char *dest;
+    struct stat st;
+} DeferredDir;
+
+// File de lectures en attente d'un parcours
+typedef struct {
+    ReadOrder order;
+    ReadJobFunction function;
+    void *arg;
+    ReadJob *jobs;
+    int count;
+    unsigned long seq;
+    DeferredDir *dirs;
+    int dir_count;
+    int dir_capacity;
+    int workers;              // Threads traitant chaque lot (1 = dans le thread du parcours)
+    int next;                 // Prochain fichier du lot à traiter par les threads
+    pthread_mutex_t lock;
+} ReadScheduler;
+
+// Fonction pour choisir l'ordre de lecture des parcours suivants
+void read_scheduler_set_order(ReadOrder order);
+// Fonction pour lire un ordre de lecture ("directory", "inode" ou "extent") ; retourne 0 si valide
+int parse_read_order(const char *text, ReadOrder *order);
+
+// Fonction pour préparer une file de lectures ; function est appelée pour chaque fichier
+void read_scheduler_init(ReadScheduler *sched, ReadJobFunction function, void *arg);
+// Fonction pour traiter chaque lot avec workers threads (function doit alors pouvoir être appelée
+// en parallèle) ; les fichiers sont pris dans l'ordre de lecture choisi
+void read_scheduler_set_workers(ReadScheduler *sched, int workers);
+// Fonction pour ajouter la lecture de path (dest peut valoir NULL)
+// En ordre de répertoire, function est appelée immédiatement
+void read_scheduler_add(ReadScheduler *sched, const char *path, const struct stat *st, const char *dest);
+// Fonction pour copier les métadonnées du répertoire src sur dest après les lectures en attente
+// (écrire dans un répertoire modifie sa date)
+void read_scheduler_defer_dir(ReadScheduler *sched, const char *src, const char *dest, const struct stat *st);
+// Fonction pour traiter les lectures en attente, trier dans l'ordre choisi
+void read_scheduler_flush(ReadScheduler *sched);
+// Fonction pour terminer un parcours : lectures restantes puis métadonnées des répertoires
+void read_scheduler_finish(ReadScheduler *sched);
+
+#endif // READ_SCHEDULER_H
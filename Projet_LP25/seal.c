@@ -0,0 +1,624 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <ctype.h>
+#include <sys/stat.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/crypto.h>
+#include <openssl/rand.h>
+#include "seal.h"
+#include "deduplication.h"
+#include "throttle.h"
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+// Clés dérivées de la clé du dépôt (chargées une fois, avant le démarrage des threads)
+static int key_loaded = 0;
+static unsigned char data_key[SEAL_KEY_SIZE];    // Dérivation des clés des fichiers
+static unsigned char check_value[SEAL_KEY_SIZE]; // Empreinte écrite dans SEAL_CHECK_FILE
+static uint8_t seal_cipher = SEAL_CIPHER_AES_256_GCM;
+
+// Fonction pour dériver une clé de la clé du dépôt
+static void derive_key(const unsigned char *master, const char *label, unsigned char *out) {
+    unsigned int len = SEAL_KEY_SIZE;
+    HMAC(EVP_sha256(), master, SEAL_KEY_SIZE, (const unsigned char *)label, strlen(label), out, &len);
+}
+
+// Fonction pour lire un chiffre hexadécimal ; retourne -1 si ce n'en est pas un
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    c = (char)tolower((unsigned char)c);
+    return c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+}
+
+// Fonction pour charger la clé du dépôt
+int seal_load_key(const char *key_file) {
+    FILE *file = fopen(key_file, "rb");
+    if (!file) {
+        perror("Erreur lors de l'ouverture du fichier de clé");
+        return -1;
+    }
+    unsigned char content[2 * SEAL_KEY_SIZE + 8];
+    size_t len = fread(content, 1, sizeof(content), file);
+    fclose(file);
+
+    unsigned char master[SEAL_KEY_SIZE];
+    while (len > 0 && isspace(content[len - 1])) len--;
+    if (len == SEAL_KEY_SIZE) {
+        memcpy(master, content, SEAL_KEY_SIZE);
+    } else if (len == 2 * SEAL_KEY_SIZE) {
+        for (size_t i = 0; i < SEAL_KEY_SIZE; i++) {
+            int high = hex_value(content[2 * i]), low = hex_value(content[2 * i + 1]);
+            if (high < 0 || low < 0) {
+                len = 0;
+                break;
+            }
+            master[i] = (unsigned char)(high << 4 | low);
+        }
+    }
+    if (len != SEAL_KEY_SIZE && len != 2 * SEAL_KEY_SIZE) {
+        fprintf(stderr, "Clé invalide : %s doit contenir 32 octets ou 64 chiffres hexadécimaux\n", key_file);
+        OPENSSL_cleanse(content, sizeof(content));
+        return -1;
+    }
+
+    derive_key(master, "LP25 data key", data_key);
+    derive_key(master, "LP25 key check", check_value);
+    OPENSSL_cleanse(master, sizeof(master));
+    OPENSSL_cleanse(content, sizeof(content));
+
+#if defined(__x86_64__) || defined(__i386__)
+    // Sans AES-NI, ChaCha20-Poly1305 est plusieurs fois plus rapide qu'AES-GCM
+    __builtin_cpu_init();
+    seal_cipher = __builtin_cpu_supports("aes") ? SEAL_CIPHER_AES_256_GCM : SEAL_CIPHER_CHACHA20_POLY1305;
+#endif
+    key_loaded = 1;
+    return 0;
+}
+
+int seal_enabled(void) {
+    return key_loaded;
+}
+
+// Fonction pour vérifier que la clé chargée est celle du répertoire de sauvegarde
+int seal_check_repository(const char *backup_dir, int writing) {
+    char path[PATH_MAX], expected[2 * SEAL_KEY_SIZE + 1];
+    snprintf(path, sizeof(path), "%s/%s", backup_dir, SEAL_CHECK_FILE);
+    for (int i = 0; i < SEAL_KEY_SIZE; i++) {
+        snprintf(expected + 2 * i, 3, "%02x", check_value[i]);
+    }
+
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        if (!key_loaded || !writing) {
+            return 0; // Répertoire en clair, ou empreinte pas encore écrite
+        }
+        file = fopen(path, "w");
+        if (!file || fprintf(file, "%s %s\n", SEAL_MAGIC, expected) < 0 || fclose(file) != 0) {
+            perror("Erreur lors de l'écriture de l'empreinte de la clé");
+            return -1;
+        }
+        return 0;
+    }
+
+    char line[128] = "";
+    char *read = fgets(line, sizeof(line), file);
+    fclose(file);
+    if (!key_loaded) {
+        fprintf(stderr, "Le répertoire de sauvegarde %s est chiffré : --encrypt-key est nécessaire\n", backup_dir);
+        return -1;
+    }
+    const char *value = read ? strchr(line, ' ') : NULL;
+    if (!value || strncmp(value + 1, expected, strlen(expected)) != 0) {
+        fprintf(stderr, "La clé de chiffrement ne correspond pas au répertoire de sauvegarde %s\n", backup_dir);
+        return -1;
+    }
+    return 0;
+}
+
+off_t seal_stored_size(off_t size) {
+    off_t segments = (size + SEAL_SEGMENT_SIZE - 1) / SEAL_SEGMENT_SIZE;
+    return (off_t)sizeof(SealHeader) + size + segments * SEAL_SEGMENT_OVERHEAD;
+}
+
+// Une copie faite avant (ou sans) --encrypt-key n'a pas la taille d'une copie chiffrée : elle est refaite
+int seal_size_matches(off_t stored, off_t size) {
+    return stored == (key_loaded ? seal_stored_size(size) : size);
+}
+
+// Fonction pour lire l'en-tête des données à base dans fd ; retourne 1 s'il décrit des données chiffrées
+// La taille annoncée doit correspondre à celle du fichier (ou de la plage) : un fichier en clair
+// commençant par la signature n'est pas pris pour un fichier chiffré
+static int read_header(int fd, off_t base, off_t length, SealHeader *header) {
+    struct stat st;
+    if (fstat(fd, &st) != 0 || pread(fd, header, sizeof(*header), base) != (ssize_t)sizeof(*header) ||
+        memcmp(header->magic, SEAL_MAGIC, sizeof(header->magic)) != 0 ||
+        (header->version != SEAL_VERSION && header->version != SEAL_VERSION_NO_AAD) ||
+        (header->cipher != SEAL_CIPHER_AES_256_GCM && header->cipher != SEAL_CIPHER_CHACHA20_POLY1305)) {
+        return 0;
+    }
+    if (length >= 0) {
+        return (off_t)header->size == length && st.st_size - base >= seal_stored_size(length);
+    }
+    return st.st_size - base == seal_stored_size(header->size);
+}
+
+int seal_is_sealed(int fd, off_t base, off_t length) {
+    SealHeader header;
+    return read_header(fd, base, length, &header);
+}
+
+// Fonction pour préparer un contexte de chiffrement (encrypt = 1) ou de déchiffrement d'un fichier
+// La clé du fichier est dérivée de la clé du dépôt et du sel de son en-tête : les nonces aléatoires
+// d'un fichier ne risquent pas de répéter ceux d'un autre
+static EVP_CIPHER_CTX *seal_context(uint8_t cipher, const unsigned char *salt, int encrypt) {
+    unsigned char key[SEAL_KEY_SIZE];
+    unsigned int len = SEAL_KEY_SIZE;
+    HMAC(EVP_sha256(), data_key, SEAL_KEY_SIZE, salt, SEAL_SALT_SIZE, key, &len);
+
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    const EVP_CIPHER *evp = cipher == SEAL_CIPHER_CHACHA20_POLY1305 ? EVP_chacha20_poly1305() : EVP_aes_256_gcm();
+    if (ctx && (encrypt ? EVP_EncryptInit_ex(ctx, evp, NULL, key, NULL)
+                        : EVP_DecryptInit_ex(ctx, evp, NULL, key, NULL)) != 1) {
+        EVP_CIPHER_CTX_free(ctx);
+        ctx = NULL;
+    }
+    OPENSSL_cleanse(key, sizeof(key));
+    return ctx;
+}
+
+// Fonction pour remplir l'en-tête d'un fichier chiffré
+static void fill_header(SealHeader *header, uint8_t version, uint8_t cipher, const unsigned char *salt, off_t size) {
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, SEAL_MAGIC, sizeof(header->magic));
+    header->version = version;
+    header->cipher = cipher;
+    header->size = size;
+    memcpy(header->salt, salt, SEAL_SALT_SIZE);
+}
+
+// Fonction pour authentifier avec le segment index l'en-tête de son fichier (signature, version,
+// algorithme, sel) et son numéro : un segment déplacé ou repris d'un autre fichier, ou un en-tête
+// modifié, font échouer la vérification du tag. La taille, écrite en dernier, est contrôlée à part
+// (elle doit correspondre à la taille du fichier). Les fichiers de version 1 n'ont pas ces données
+static int segment_aad(EVP_CIPHER_CTX *ctx, int encrypt, uint8_t version, uint8_t cipher,
+                       const unsigned char *salt, off_t index) {
+    if (version == SEAL_VERSION_NO_AAD) {
+        return 0;
+    }
+    unsigned char aad[sizeof(((SealHeader *)0)->magic) + 2 + SEAL_SALT_SIZE + 8];
+    size_t position = sizeof(((SealHeader *)0)->magic);
+    memcpy(aad, SEAL_MAGIC, position);
+    aad[position++] = version;
+    aad[position++] = cipher;
+    memcpy(aad + position, salt, SEAL_SALT_SIZE);
+    position += SEAL_SALT_SIZE;
+    for (int i = 0; i < 8; i++) {
+        aad[position++] = (unsigned char)((uint64_t)index >> (8 * i));
+    }
+    int len;
+    return (encrypt ? EVP_EncryptUpdate(ctx, NULL, &len, aad, sizeof(aad))
+                    : EVP_DecryptUpdate(ctx, NULL, &len, aad, sizeof(aad))) == 1 ? 0 : -1;
+}
+
+// Fonction pour chiffrer le segment index d'un fichier : out reçoit le nonce, les données chiffrées puis le tag
+static int seal_segment(EVP_CIPHER_CTX *ctx, uint8_t version, uint8_t cipher, const unsigned char *salt, off_t index,
+                        const unsigned char *plain, size_t len, unsigned char *out) {
+    int written, final;
+    if (RAND_bytes(out, SEAL_NONCE_SIZE) != 1 ||
+        EVP_EncryptInit_ex(ctx, NULL, NULL, NULL, out) != 1 ||
+        segment_aad(ctx, 1, version, cipher, salt, index) != 0 ||
+        EVP_EncryptUpdate(ctx, out + SEAL_NONCE_SIZE, &written, plain, (int)len) != 1 ||
+        EVP_EncryptFinal_ex(ctx, out + SEAL_NONCE_SIZE + written, &final) != 1 ||
+        EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG, SEAL_TAG_SIZE, out + SEAL_NONCE_SIZE + len) != 1) {
+        return -1;
+    }
+    return 0;
+}
+
+// Fonction pour déchiffrer le segment index, de len octets en clair ; retourne -1 si le tag est invalide
+static int unseal_segment(const SealReader *reader, off_t index, const unsigned char *in, size_t len,
+                          unsigned char *plain) {
+    EVP_CIPHER_CTX *ctx = reader->ctx;
+    int written, final;
+    if (EVP_DecryptInit_ex(ctx, NULL, NULL, NULL, in) != 1 ||
+        segment_aad(ctx, 0, reader->version, reader->cipher, reader->salt, index) != 0 ||
+        EVP_DecryptUpdate(ctx, plain, &written, in + SEAL_NONCE_SIZE, (int)len) != 1 ||
+        EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG, SEAL_TAG_SIZE, (void *)(in + SEAL_NONCE_SIZE + len)) != 1 ||
+        EVP_DecryptFinal_ex(ctx, plain + written, &final) != 1) {
+        return -1;
+    }
+    return 0;
+}
+
+// Fonction pour lire en clair les données d'un descripteur déjà ouvert
+int seal_reader_attach(SealReader *reader, int fd, off_t base, off_t length) {
+    memset(reader, 0, sizeof(*reader));
+    reader->base = base;
+    reader->segment_index = -1;
+
+    SealHeader header;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        return -1;
+    }
+    reader->size = length >= 0 ? length : st.st_size - base;
+    if (read_header(fd, base, length, &header)) {
+        if (!key_loaded) {
+            fprintf(stderr, "Données chiffrées : --encrypt-key est nécessaire pour les lire\n");
+            errno = EACCES;
+            return -1;
+        }
+        reader->sealed = 1;
+        reader->size = header.size;
+        reader->version = header.version;
+        reader->cipher = header.cipher;
+        memcpy(reader->salt, header.salt, SEAL_SALT_SIZE);
+        reader->ctx = seal_context(header.cipher, header.salt, 0);
+        reader->segment = malloc(SEAL_SEGMENT_SIZE);
+        reader->sealed_segment = malloc(SEAL_SEGMENT_SIZE + SEAL_SEGMENT_OVERHEAD);
+        if (!reader->ctx || !reader->segment || !reader->sealed_segment) {
+            EVP_CIPHER_CTX_free(reader->ctx);
+            free(reader->segment);
+            free(reader->sealed_segment);
+            return -1;
+        }
+    }
+    if (cache_reader_attach(&reader->raw, fd) != 0) {
+        EVP_CIPHER_CTX_free(reader->ctx);
+        free(reader->segment);
+        free(reader->sealed_segment);
+        return -1;
+    }
+    return 0;
+}
+
+// Fonction pour ouvrir en clair les données d'un fichier stocké
+int seal_reader_open(SealReader *reader, const char *path, off_t base, off_t length) {
+    int fd = open(path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    if (seal_reader_attach(reader, fd, base, length) != 0) {
+        close(fd);
+        return -1;
+    }
+    reader->raw.owns_fd = 1;
+    return 0;
+}
+
+// Fonction pour lire et déchiffrer le segment index
+static int load_segment(SealReader *reader, off_t index) {
+    off_t start = index * SEAL_SEGMENT_SIZE;
+    size_t len = reader->size - start < SEAL_SEGMENT_SIZE ? (size_t)(reader->size - start) : SEAL_SEGMENT_SIZE;
+    off_t raw_offset = reader->base + (off_t)sizeof(SealHeader) + index * (SEAL_SEGMENT_SIZE + SEAL_SEGMENT_OVERHEAD);
+    size_t raw_len = len + SEAL_SEGMENT_OVERHEAD;
+
+    // Le segment est déchiffré directement dans le tampon du lecteur de cache s'il y est entier
+    const unsigned char *sealed = NULL;
+    for (size_t done = 0; done < raw_len; ) {
+        const unsigned char *data;
+        ssize_t bytes = cache_reader_pread(&reader->raw, raw_offset + done, raw_len - done, &data);
+        if (bytes <= 0) {
+            errno = bytes < 0 ? errno : EIO;
+            return -1;
+        }
+        if (done == 0 && (size_t)bytes == raw_len) {
+            sealed = data;
+            break;
+        }
+        memcpy(reader->sealed_segment + done, data, bytes);
+        done += bytes;
+        sealed = reader->sealed_segment;
+    }
+    if (unseal_segment(reader, index, sealed, len, reader->segment) != 0) {
+        fprintf(stderr, "Données chiffrées altérées ou clé incorrecte (segment %lld)\n", (long long)index);
+        errno = EBADMSG;
+        return -1;
+    }
+    reader->segment_index = index;
+    reader->segment_len = len;
+    return 0;
+}
+
+// Fonction pour lire au plus len octets en clair à offset
+ssize_t seal_reader_pread(SealReader *reader, off_t offset, size_t len, const unsigned char **data) {
+    if (offset >= reader->size) {
+        return 0;
+    }
+    if (len > (size_t)(reader->size - offset)) {
+        len = reader->size - offset;
+    }
+    if (!reader->sealed) {
+        return cache_reader_pread(&reader->raw, reader->base + offset, len, data);
+    }
+
+    off_t index = offset / SEAL_SEGMENT_SIZE;
+    if (index != reader->segment_index && load_segment(reader, index) != 0) {
+        return -1;
+    }
+    size_t skip = offset - index * SEAL_SEGMENT_SIZE;
+    *data = reader->segment + skip;
+    return reader->segment_len - skip < len ? (ssize_t)(reader->segment_len - skip) : (ssize_t)len;
+}
+
+// Fonction pour copier len octets en clair à offset dans buffer
+ssize_t seal_reader_read(SealReader *reader, void *buffer, size_t len, off_t offset) {
+    size_t done = 0;
+    while (done < len) {
+        const unsigned char *data;
+        ssize_t bytes = seal_reader_pread(reader, offset + done, len - done, &data);
+        if (bytes < 0) return -1;
+        if (bytes == 0) break;
+        memcpy((unsigned char *)buffer + done, data, bytes);
+        done += bytes;
+    }
+    return done;
+}
+
+// Fonction pour écrire dans dest_fd les données en clair
+int seal_reader_copy(SealReader *reader, int dest_fd) {
+    for (off_t offset = 0; offset < reader->size; ) {
+        const unsigned char *data;
+        ssize_t bytes = seal_reader_pread(reader, offset, SEAL_SEGMENT_SIZE, &data);
+        if (bytes <= 0) return -1;
+        for (ssize_t done = 0; done < bytes; ) {
+            size_t len = bytes - done < CHUNK_SIZE ? (size_t)(bytes - done) : CHUNK_SIZE;
+            if (!chunk_is_hole(data + done, len)) {
+                if (pwrite(dest_fd, data + done, len, offset + done) != (ssize_t)len) return -1;
+                throttle_consume(THROTTLE_WRITE, len);
+            }
+            done += len;
+        }
+        offset += bytes;
+    }
+    // Fixe la taille finale (trou final éventuel)
+    return ftruncate(dest_fd, reader->size);
+}
+
+// Fonction pour terminer la lecture
+void seal_reader_close(SealReader *reader) {
+    cache_reader_close(&reader->raw);
+    EVP_CIPHER_CTX_free(reader->ctx);
+    free(reader->segment);
+    free(reader->sealed_segment);
+    reader->ctx = NULL;
+    reader->segment = reader->sealed_segment = NULL;
+}
+
+// Fonction pour commencer l'écriture chiffrée de fd
+int seal_writer_open(SealWriter *writer, int fd, off_t start) {
+    memset(writer, 0, sizeof(*writer));
+    writer->fd = fd;
+    writer->size = start;
+    writer->released = seal_stored_size(start);
+    writer->version = SEAL_VERSION;
+    writer->cipher = seal_cipher;
+    if (!key_loaded || start % SEAL_SEGMENT_SIZE != 0) {
+        return -1;
+    }
+    if (start > 0) {
+        // Suite d'un fichier déjà chiffré : même version, même algorithme et même clé que ses premiers segments
+        SealHeader header;
+        if (pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+            memcmp(header.magic, SEAL_MAGIC, sizeof(header.magic)) != 0 ||
+            (header.version != SEAL_VERSION && header.version != SEAL_VERSION_NO_AAD)) {
+            return -1;
+        }
+        writer->version = header.version;
+        writer->cipher = header.cipher;
+        memcpy(writer->salt, header.salt, SEAL_SALT_SIZE);
+    } else if (RAND_bytes(writer->salt, SEAL_SALT_SIZE) != 1) {
+        return -1;
+    }
+    writer->ctx = seal_context(writer->cipher, writer->salt, 1);
+    writer->segment = malloc(SEAL_SEGMENT_SIZE);
+    writer->sealed_segment = malloc(SEAL_SEGMENT_SIZE + SEAL_SEGMENT_OVERHEAD);
+    if (!writer->ctx || !writer->segment || !writer->sealed_segment) {
+        EVP_CIPHER_CTX_free(writer->ctx);
+        free(writer->segment);
+        free(writer->sealed_segment);
+        return -1;
+    }
+    return 0;
+}
+
+// Fonction pour chiffrer et écrire le segment index, de len octets en clair
+static int write_segment(SealWriter *writer, const unsigned char *plain, size_t len, off_t index) {
+    off_t position = (off_t)sizeof(SealHeader) + index * (SEAL_SEGMENT_SIZE + SEAL_SEGMENT_OVERHEAD);
+    size_t sealed_len = len + SEAL_SEGMENT_OVERHEAD;
+    if (seal_segment(writer->ctx, writer->version, writer->cipher, writer->salt, index, plain, len,
+                     writer->sealed_segment) != 0) {
+        return -1;
+    }
+    for (size_t done = 0; done < sealed_len; ) {
+        ssize_t written = pwrite(writer->fd, writer->sealed_segment + done, sealed_len - done, position + done);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        throttle_consume(THROTTLE_WRITE, written);
+        done += written;
+    }
+
+    // Les pages écrites quittent aussi le cache (hors mode normal)
+    if (position + (off_t)sealed_len - writer->released >= CACHE_IO_RELEASE_BYTES) {
+        cache_io_release_written(writer->fd, writer->released, position + sealed_len);
+        writer->released = position + sealed_len;
+    }
+    return 0;
+}
+
+// Fonction pour chiffrer et écrire le segment en cours
+static int flush_segment(SealWriter *writer) {
+    if (writer->used == 0) {
+        return 0;
+    }
+    off_t index = (writer->size - writer->used) / SEAL_SEGMENT_SIZE;
+    size_t len = writer->used;
+    writer->used = 0;
+    return write_segment(writer, writer->segment, len, index);
+}
+
+// Fonction pour chiffrer et écrire size octets à la suite des précédents
+// Les segments complets sont chiffrés directement depuis data, sans passer par le tampon du segment
+int seal_writer_write(SealWriter *writer, const void *data, size_t size) {
+    const unsigned char *bytes = data;
+    while (size > 0) {
+        if (writer->used == 0 && size >= SEAL_SEGMENT_SIZE) {
+            if (write_segment(writer, bytes, SEAL_SEGMENT_SIZE, writer->size / SEAL_SEGMENT_SIZE) != 0) {
+                return -1;
+            }
+            writer->size += SEAL_SEGMENT_SIZE;
+            bytes += SEAL_SEGMENT_SIZE;
+            size -= SEAL_SEGMENT_SIZE;
+            continue;
+        }
+        size_t len = SEAL_SEGMENT_SIZE - writer->used;
+        if (len > size) len = size;
+        memcpy(writer->segment + writer->used, bytes, len);
+        writer->used += len;
+        writer->size += len;
+        bytes += len;
+        size -= len;
+        if (writer->used == SEAL_SEGMENT_SIZE && flush_segment(writer) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Fonction pour écrire le dernier segment et l'en-tête, et fixer la taille du fichier
+int seal_writer_finish(SealWriter *writer) {
+    int result = flush_segment(writer);
+
+    SealHeader header;
+    fill_header(&header, writer->version, writer->cipher, writer->salt, writer->size);
+    if (result == 0 && (pwrite(writer->fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+                        ftruncate(writer->fd, seal_stored_size(writer->size)) != 0)) {
+        result = -1;
+    }
+    cache_io_release_written(writer->fd, writer->released, seal_stored_size(writer->size));
+
+    EVP_CIPHER_CTX_free(writer->ctx);
+    free(writer->segment);
+    free(writer->sealed_segment);
+    writer->ctx = NULL;
+    writer->segment = writer->sealed_segment = NULL;
+    return result;
+}
+
+// Fonction pour chiffrer dans dest_fd la plage [start, size) de src_fd
+int seal_copy(int src_fd, int dest_fd, off_t start, off_t size, unsigned char *md5) {
+    CacheReader reader;
+    SealWriter writer;
+    EVP_MD_CTX *md5_ctx = NULL;
+    if (md5 && (!(md5_ctx = EVP_MD_CTX_new()) || EVP_DigestInit_ex(md5_ctx, EVP_md5(), NULL) != 1)) {
+        EVP_MD_CTX_free(md5_ctx);
+        return -1;
+    }
+    if (cache_reader_attach(&reader, src_fd) != 0) {
+        EVP_MD_CTX_free(md5_ctx);
+        return -1;
+    }
+    if (seal_writer_open(&writer, dest_fd, start) != 0) {
+        cache_reader_close(&reader);
+        EVP_MD_CTX_free(md5_ctx);
+        return -1;
+    }
+
+    int result = 0;
+    for (off_t position = start; position < size; ) {
+        const unsigned char *data;
+        size_t len = size - position < CACHE_IO_BUFFER_SIZE / 2 ? (size_t)(size - position) : CACHE_IO_BUFFER_SIZE / 2;
+        ssize_t bytes = cache_reader_pread(&reader, position, len, &data);
+        if (bytes < 0) {
+            result = -1;
+            break;
+        }
+        if (bytes == 0) break; // Fichier raccourci pendant la copie
+        if (md5_ctx) {
+            EVP_DigestUpdate(md5_ctx, data, bytes);
+        }
+        if (seal_writer_write(&writer, data, bytes) != 0) {
+            result = -1;
+            break;
+        }
+        position += bytes;
+    }
+    if (seal_writer_finish(&writer) != 0) {
+        result = -1;
+    }
+    if (md5_ctx) {
+        EVP_DigestFinal_ex(md5_ctx, md5, NULL);
+        EVP_MD_CTX_free(md5_ctx);
+    }
+    cache_reader_close(&reader);
+    return result;
+}
+
+// Fonction pour chiffrer size octets en mémoire (fichiers regroupés dans un conteneur)
+ssize_t seal_buffer(const unsigned char *data, size_t size, unsigned char *out) {
+    unsigned char salt[SEAL_SALT_SIZE];
+    EVP_CIPHER_CTX *ctx = NULL;
+    if (!key_loaded || RAND_bytes(salt, SEAL_SALT_SIZE) != 1 || !(ctx = seal_context(seal_cipher, salt, 1))) {
+        return -1;
+    }
+
+    SealHeader header;
+    fill_header(&header, SEAL_VERSION, seal_cipher, salt, size);
+    memcpy(out, &header, sizeof(header));
+
+    size_t position = sizeof(header);
+    for (size_t done = 0; done < size; done += SEAL_SEGMENT_SIZE) {
+        size_t len = size - done < SEAL_SEGMENT_SIZE ? size - done : SEAL_SEGMENT_SIZE;
+        if (seal_segment(ctx, SEAL_VERSION, seal_cipher, salt, done / SEAL_SEGMENT_SIZE, data + done, len,
+                         out + position) != 0) {
+            EVP_CIPHER_CTX_free(ctx);
+            return -1;
+        }
+        position += len + SEAL_SEGMENT_OVERHEAD;
+    }
+    EVP_CIPHER_CTX_free(ctx);
+    return position;
+}
+
+// Fonction pour déchiffrer en place un fichier reçu chiffré
+// Le serveur transmet les données telles qu'elles sont stockées : il n'a pas besoin de la clé
+int seal_unseal_file(const char *path) {
+    SealReader reader;
+    int fd = open(path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    if (!seal_is_sealed(fd, 0, -1)) {
+        close(fd);
+        return 0;
+    }
+    if (seal_reader_attach(&reader, fd, 0, -1) != 0) {
+        close(fd);
+        return -1;
+    }
+    reader.raw.owns_fd = 1;
+
+    char tmp_path[PATH_MAX];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.unseal", path);
+    int dest_fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW, 0600);
+    int result = dest_fd >= 0 ? seal_reader_copy(&reader, dest_fd) : -1;
+    if (dest_fd >= 0) close(dest_fd);
+    seal_reader_close(&reader);
+    if (result == 0 && rename(tmp_path, path) != 0) {
+        result = -1;
+    }
+    if (result != 0) {
+        unlink(tmp_path);
+    }
+    return result;
+}
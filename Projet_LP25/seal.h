@@ -0,0 +1,124 @@
+#ifndef SEAL_H
+#define SEAL_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include "cache_io.h"
+
+// Fichier d'un répertoire de sauvegarde chiffré : empreinte de la clé (jamais la clé elle-même),
+// pour refuser une mauvaise clé ou une sauvegarde en clair dans un répertoire chiffré
+#define SEAL_CHECK_FILE ".backup_seal"
+
+// Signature d'un fichier stocké chiffré
+#define SEAL_MAGIC "LP25SEAL"
+#define SEAL_VERSION 2
+// Version des fichiers dont les segments n'authentifient ni l'en-tête ni leur numéro (relus seulement)
+#define SEAL_VERSION_NO_AAD 1
+
+// Tailles de la clé (fichier --encrypt-key), du sel d'un fichier, du nonce et du tag d'authentification
+#define SEAL_KEY_SIZE 32
+#define SEAL_SALT_SIZE 16
+#define SEAL_NONCE_SIZE 12
+#define SEAL_TAG_SIZE 16
+
+// Taille des segments chiffrés indépendamment : une lecture partielle (montage, --append-tails)
+// ne déchiffre que les segments concernés
+#define SEAL_SEGMENT_SIZE (64 * 1024)
+
+// Octets ajoutés à chaque segment (nonce et tag)
+#define SEAL_SEGMENT_OVERHEAD (SEAL_NONCE_SIZE + SEAL_TAG_SIZE)
+
+// Algorithmes de chiffrement authentifié
+typedef enum {
+    SEAL_CIPHER_AES_256_GCM = 1,          // Choisi si le processeur a les instructions AES (AES-NI)
+    SEAL_CIPHER_CHACHA20_POLY1305 = 2     // Plus rapide en logiciel sur les processeurs sans AES-NI
+} SealCipher;
+
+// En-tête d'un fichier stocké chiffré, suivi des segments (nonce aléatoire, données chiffrées, tag)
+// Chaque fichier a sa propre clé, dérivée de la clé du dépôt et de son sel
+typedef struct {
+    char magic[8];
+    uint8_t version;
+    uint8_t cipher;           // SealCipher
+    uint8_t reserved[6];
+    uint64_t size;            // Taille des données en clair
+    unsigned char salt[SEAL_SALT_SIZE];
+} SealHeader;
+
+// Lecture en clair d'un fichier stocké, chiffré ou non (plage d'un conteneur ou fichier entier)
+typedef struct {
+    CacheReader raw;          // Lectures du fichier stocké (--cache-mode)
+    int sealed;               // 1 si les données sont chiffrées
+    off_t base;               // Début des données dans le fichier
+    off_t size;               // Taille des données en clair
+    void *ctx;                // Contexte de déchiffrement
+    uint8_t version;          // En-tête du fichier, authentifié avec chaque segment
+    uint8_t cipher;
+    unsigned char salt[SEAL_SALT_SIZE];
+    unsigned char *segment;   // Dernier segment déchiffré
+    unsigned char *sealed_segment;
+    off_t segment_index;      // Numéro de ce segment (-1 si aucun)
+    size_t segment_len;
+} SealReader;
+
+// Écriture chiffrée d'un fichier stocké, segment par segment
+typedef struct {
+    int fd;
+    off_t size;               // Octets en clair reçus
+    void *ctx;                // Contexte de chiffrement
+    unsigned char *segment;   // Segment en cours de remplissage
+    unsigned char *sealed_segment;
+    size_t used;
+    uint8_t version;          // Celle de l'en-tête repris pour la suite d'un fichier
+    uint8_t cipher;
+    unsigned char salt[SEAL_SALT_SIZE];
+    off_t released;           // Début de la zone écrite pas encore libérée du cache
+} SealWriter;
+
+// Fonction pour charger la clé du dépôt (32 octets bruts ou 64 chiffres hexadécimaux) ; retourne 0 en cas de succès
+int seal_load_key(const char *key_file);
+// Fonction pour savoir si les nouvelles données stockées sont chiffrées (clé chargée)
+int seal_enabled(void);
+// Fonction pour vérifier que la clé chargée est celle du répertoire de sauvegarde backup_dir
+// writing : une sauvegarde va y être écrite (l'empreinte de la clé est créée au premier usage)
+// Retourne -1 si la clé manque ou ne correspond pas
+int seal_check_repository(const char *backup_dir, int writing);
+// Fonction pour calculer la taille stockée de size octets chiffrés
+off_t seal_stored_size(off_t size);
+// Fonction pour savoir si un fichier stocké de stored octets correspond à un fichier source de size octets
+int seal_size_matches(off_t stored, off_t size);
+// Fonction pour savoir si les données à base dans fd sont chiffrées
+// length est la taille en clair attendue (plage d'un conteneur), -1 pour un fichier entier
+int seal_is_sealed(int fd, off_t base, off_t length);
+
+// Fonction pour ouvrir en clair les données d'un fichier stocké (length : comme pour seal_is_sealed)
+int seal_reader_open(SealReader *reader, const char *path, off_t base, off_t length);
+// Fonction pour lire en clair les données d'un descripteur déjà ouvert (qui reste à fermer par l'appelant)
+int seal_reader_attach(SealReader *reader, int fd, off_t base, off_t length);
+// Fonction pour lire au plus len octets en clair à offset ; *data pointe dans le tampon du lecteur
+// Retourne le nombre d'octets lus, 0 à la fin des données, -1 en cas d'erreur (données altérées)
+ssize_t seal_reader_pread(SealReader *reader, off_t offset, size_t len, const unsigned char **data);
+// Fonction pour copier len octets en clair à offset dans buffer ; retourne le nombre d'octets copiés ou -1
+ssize_t seal_reader_read(SealReader *reader, void *buffer, size_t len, off_t offset);
+// Fonction pour écrire dans dest_fd les données en clair (les chunks nuls y deviennent des trous)
+int seal_reader_copy(SealReader *reader, int dest_fd);
+// Fonction pour terminer la lecture
+void seal_reader_close(SealReader *reader);
+
+// Fonction pour commencer l'écriture chiffrée de fd ; start est la taille en clair déjà stockée,
+// multiple de SEAL_SEGMENT_SIZE (0 pour un nouveau fichier) : la suite reprend alors l'en-tête de fd
+int seal_writer_open(SealWriter *writer, int fd, off_t start);
+// Fonction pour chiffrer et écrire size octets à la suite des précédents
+int seal_writer_write(SealWriter *writer, const void *data, size_t size);
+// Fonction pour écrire le dernier segment et l'en-tête, et fixer la taille du fichier
+int seal_writer_finish(SealWriter *writer);
+// Fonction pour chiffrer dans dest_fd la plage [start, size) de src_fd (start multiple de SEAL_SEGMENT_SIZE)
+// md5 (NULL si inutile) reçoit le MD5 des données en clair copiées, calculé pendant le chiffrement
+int seal_copy(int src_fd, int dest_fd, off_t start, off_t size, unsigned char *md5);
+// Fonction pour chiffrer size octets en mémoire ; out doit contenir seal_stored_size(size) octets
+// Retourne la taille chiffrée ou -1
+ssize_t seal_buffer(const unsigned char *data, size_t size, unsigned char *out);
+// Fonction pour déchiffrer en place un fichier reçu chiffré (restauration depuis un serveur)
+int seal_unseal_file(const char *path);
+
+#endif // SEAL_H
@@ -6,13 +6,139 @@
 #include <dirent.h>
 #include <sys/stat.h>
 #include <time.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <signal.h>
 #include "file_handler.h"
+#include "backup_manager.h"
+#include "network.h"
+#include "chunk_cache.h"
+#include "catalog.h"
 
 #define PORT 8080
 #define BUFFER_SIZE 1024
 
 // Fonction qui calcule la taille totale d'un dossier
 off_t calculate_folder_size(const char *path);
+void print_backup_info_remote(BackupInfo *infos, int count, int client_socket);
+
+// Fonction pour traiter une requête "DIFF\n<sauvegarde A>\n<sauvegarde B>"
+void handle_diff_request(char *request, int client_socket) {
+    strtok(request, "\n"); // Ignorer le préfixe de la requête
+    char *snapshot_a = strtok(NULL, "\n");
+    char *snapshot_b = strtok(NULL, "\n");
+
+    if (!snapshot_a || !snapshot_b) {
+        const char *message = "Requête de comparaison invalide.\n";
+        send(client_socket, message, strlen(message), 0);
+    } else {
+        printf("Comparaison demandée : %s -> %s\n", snapshot_a, snapshot_b);
+        // Le résultat est écrit directement dans le socket
+        FILE *out = fdopen(dup(client_socket), "w");
+        if (out) {
+            diff_backups(snapshot_a, snapshot_b, out);
+            fclose(out);
+        }
+    }
+
+    send(client_socket, "FIN", strlen("FIN"), 0);
+}
+
+// Fonction pour traiter une requête "FIND\n<backup_dir>\n<motif>" à l'aide du catalogue des chemins
+void handle_find_request(char *request, int client_socket) {
+    strtok(request, "\n"); // Ignorer le préfixe de la requête
+    char *backup_dir = strtok(NULL, "\n");
+    char *pattern = strtok(NULL, "\n");
+
+    if (!backup_dir || !pattern) {
+        const char *message = "Requête de recherche invalide.\n";
+        send(client_socket, message, strlen(message), 0);
+    } else {
+        printf("Recherche demandée : %s dans %s\n", pattern, backup_dir);
+        FILE *out = fdopen(dup(client_socket), "w");
+        if (out) {
+            catalog_find(backup_dir, pattern, out);
+            fclose(out);
+        }
+    }
+
+    send(client_socket, "FIN", strlen("FIN"), 0);
+}
+
+// Fonction pour lire une requête "<préfixe>\n<sauvegarde>\n<motif>" (motif vide : NULL)
+static void parse_backup_request(char *request, char **backup_id, char **pattern) {
+    *backup_id = strchr(request, '\n');
+    *pattern = NULL;
+    if (*backup_id) {
+        (*backup_id)++;
+        *pattern = strchr(*backup_id, '\n');
+        if (*pattern) {
+            *(*pattern)++ = '\0';
+            if (**pattern == '\0') *pattern = NULL;
+        }
+    }
+}
+
+// Fonction pour traiter une requête "RESTORE\n<sauvegarde>\n<motif>"
+// Les fichiers sont lus à travers le cache de chunks partagé entre les clients
+void handle_restore_request(char *request, int client_socket) {
+    char *backup_id, *pattern;
+    parse_backup_request(request, &backup_id, &pattern);
+
+    FILE *out = fdopen(dup(client_socket), "w");
+    if (!out) {
+        perror("Erreur lors de l'ouverture du flux client");
+        return;
+    }
+    if (backup_id && *backup_id) {
+        printf("Restauration demandée : %s (%s)\n", backup_id, pattern ? pattern : "tout");
+        send_backup_files(backup_id, pattern, out);
+    }
+    fprintf(out, "FIN\n");
+    fclose(out);
+    chunk_cache_print_stats(stdout);
+}
+
+// Fonction pour traiter une requête "MANIFEST\n<sauvegarde>\n<motif>" (liste des fichiers d'une restauration parallèle)
+void handle_manifest_request(char *request, int client_socket) {
+    char *backup_id, *pattern;
+    parse_backup_request(request, &backup_id, &pattern);
+
+    FILE *out = fdopen(dup(client_socket), "w");
+    if (!out) {
+        perror("Erreur lors de l'ouverture du flux client");
+        return;
+    }
+    if (backup_id && *backup_id) {
+        printf("Restauration parallèle demandée : %s (%s)\n", backup_id, pattern ? pattern : "tout");
+        send_backup_manifest(backup_id, pattern, out);
+    }
+    fprintf(out, "FIN\n");
+    fclose(out);
+}
+
+// Fonction pour traiter une requête "STREAM\n<sauvegarde>\n<motif>" : l'un des flux d'une restauration parallèle
+void handle_stream_request(char *request, int client_socket) {
+    char *backup_id, *pattern;
+    parse_backup_request(request, &backup_id, &pattern);
+    network_tune_socket(client_socket);
+
+    FILE *in = fdopen(dup(client_socket), "r");
+    FILE *out = fdopen(dup(client_socket), "w");
+    if (!in || !out) {
+        perror("Erreur lors de l'ouverture du flux client");
+        if (in) fclose(in);
+        if (out) fclose(out);
+        return;
+    }
+    // Les réponses d'un lot de petits fichiers s'accumulent jusqu'au "FLUSH" du client
+    setvbuf(out, NULL, _IOFBF, NET_SEND_BUFFER);
+    if (backup_id && *backup_id) {
+        serve_backup_ranges(backup_id, pattern, in, out);
+    }
+    fclose(out);
+    fclose(in);
+}
 
 // Fonction principale pour gérer un client
 void handle_client(int client_socket) {
@@ -25,6 +151,27 @@ void handle_client(int client_socket) {
     }
 
     directory[valread] = '\0'; // Terminer la chaîne reçue
+
+    if (strncmp(directory, REQUEST_DIFF "\n", strlen(REQUEST_DIFF) + 1) == 0) {
+        handle_diff_request(directory, client_socket);
+        return;
+    }
+    if (strncmp(directory, REQUEST_RESTORE "\n", strlen(REQUEST_RESTORE) + 1) == 0) {
+        handle_restore_request(directory, client_socket);
+        return;
+    }
+    if (strncmp(directory, REQUEST_FIND "\n", strlen(REQUEST_FIND) + 1) == 0) {
+        handle_find_request(directory, client_socket);
+        return;
+    }
+    if (strncmp(directory, REQUEST_MANIFEST "\n", strlen(REQUEST_MANIFEST) + 1) == 0) {
+        handle_manifest_request(directory, client_socket);
+        return;
+    }
+    if (strncmp(directory, REQUEST_STREAM "\n", strlen(REQUEST_STREAM) + 1) == 0) {
+        handle_stream_request(directory, client_socket);
+        return;
+    }
     printf("Chemin reçu du client : %s\n", directory);
 
     // Appeler la fonction find_backup_logs pour le chemin reçu
@@ -92,13 +239,33 @@ void print_backup_info_remote(BackupInfo *infos, int count, int client_socket) {
 }
 
 
+// Thread d'une connexion : les flux d'une restauration parallèle sont servis simultanément
+static void *client_thread(void *arg) {
+    int client_socket = (int)(intptr_t)arg;
+    handle_client(client_socket);
+    close(client_socket);
+    printf("Connexion fermée.\n");
+    return NULL;
+}
+
 // Fonction principale du serveur
-int main() {
+// Usage : serveur [taille du cache de chunks en Mo] [taille des tampons des sockets en Ko]
+int main(int argc, char *argv[]) {
     int server_fd, client_socket;
     struct sockaddr_in address;
     int opt = 1;
     int addrlen = sizeof(address);
 
+    if (argc > 1) {
+        chunk_cache_init((size_t)atol(argv[1]) * 1024 * 1024);
+    }
+    if (argc > 2) {
+        network_set_socket_buffer(atoi(argv[2]) * 1024);
+    }
+
+    // Un client qui ferme l'un de ses flux ne doit interrompre que ce flux, pas tout le serveur
+    signal(SIGPIPE, SIG_IGN);
+
     // Créer le socket serveur
     if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) == 0) {
         perror("Erreur lors de la création du socket");
@@ -124,8 +291,8 @@ int main() {
         exit(EXIT_FAILURE);
     }
 
-    // Mettre le serveur en écoute
-    if (listen(server_fd, 3) < 0) {
+    // Mettre le serveur en écoute (les flux parallèles d'un client se connectent en même temps)
+    if (listen(server_fd, 64) < 0) {
         perror("Erreur lors du listen");
         close(server_fd);
         exit(EXIT_FAILURE);
@@ -141,9 +308,12 @@ int main() {
         }
 
         printf("Nouvelle connexion acceptée.\n");
-        handle_client(client_socket);
-        close(client_socket);
-        printf("Connexion fermée.\n");
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, client_thread, (void *)(intptr_t)client_socket) == 0) {
+            pthread_detach(thread);
+        } else {
+            client_thread((void *)(intptr_t)client_socket);
+        }
     }
 
     close(server_fd);
@@ -0,0 +1,578 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "snapshot_fs.h"
+
+#ifdef HAVE_FUSE
+
+#define FUSE_USE_VERSION 31
+#include <fuse.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <limits.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "file_handler.h"
+#include "deduplication.h"
+#include "chunk_cache.h"
+#include "pack.h"
+#include "seal.h"
+#include "metadata.h"
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+// Sauvegarde exposée dans le montage ; son log n'est lu qu'au premier accès
+typedef struct {
+    char name[256];          // Nom du dossier de sauvegarde
+    time_t creation_time;    // Date de création du .backup_log
+    int loaded;              // 1 une fois le log lu et trié
+    log_t logs;
+    log_element **entries;   // Éléments du log triés par chemin
+    int count;
+    char **dirs;             // Lignes de .backup_dirs triées par chemin (sauvegarde par manifeste)
+    int dir_count;
+} MountedSnapshot;
+
+// Fichier ouvert dans le montage
+typedef struct {
+    int fd;                  // Fichier stocké dans la sauvegarde
+    struct stat st;          // Identifie les blocs du fichier dans le cache de chunks
+    off_t next_block;        // Bloc attendu si la lecture est séquentielle (protégé par lock)
+    unsigned char *packed;   // Contenu d'un fichier regroupé, lu entièrement à l'ouverture (NULL sinon)
+    ssize_t packed_size;
+    SealReader *sealed;      // Lecture déchiffrée d'un fichier stocké chiffré (NULL sinon)
+    pthread_mutex_t lock;    // Protège next_block et le segment déchiffré de sealed (lectures concurrentes de FUSE)
+} OpenFile;
+
+static struct {
+    char backup_dir[PATH_MAX];
+    MountedSnapshot *snapshots;
+    int count;
+    pthread_mutex_t lock;
+} fs = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+// Fonction pour lister les sauvegardes (dossiers contenant un .backup_log) sans lire leur contenu
+static int load_snapshot_list(const char *backup_dir) {
+    DIR *dp = opendir(backup_dir);
+    if (!dp) {
+        perror("Erreur lors de l'ouverture du répertoire de sauvegarde");
+        return -1;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(dp)) != NULL) {
+        if (entry->d_name[0] == '.') continue;
+
+        char log_path[PATH_MAX];
+        struct stat log_stat;
+        snprintf(log_path, sizeof(log_path), "%s/%s/.backup_log", backup_dir, entry->d_name);
+        if (stat(log_path, &log_stat) != 0 || !S_ISREG(log_stat.st_mode)) continue;
+
+        MountedSnapshot *grown = realloc(fs.snapshots, (fs.count + 1) * sizeof(MountedSnapshot));
+        if (!grown) {
+            perror("Erreur d'allocation mémoire");
+            break;
+        }
+        fs.snapshots = grown;
+        MountedSnapshot *snap = &fs.snapshots[fs.count++];
+        memset(snap, 0, sizeof(*snap));
+        snprintf(snap->name, sizeof(snap->name), "%s", entry->d_name);
+        snap->creation_time = log_stat.st_ctime;
+    }
+
+    closedir(dp);
+    return 0;
+}
+
+// Fonction pour comparer deux lignes de .backup_dirs (ou un chemin et une ligne) par leur chemin
+static int compare_dir_lines(const void *a, const void *b) {
+    const char *line1 = *(const char **)a, *line2 = *(const char **)b;
+    size_t len1 = strcspn(line1, ";"), len2 = strcspn(line2, ";");
+    int cmp = strncmp(line1, line2, len1 < len2 ? len1 : len2);
+    return cmp ? cmp : (len1 > len2) - (len1 < len2);
+}
+
+// Fonction pour lire le .backup_dirs d'une sauvegarde par manifeste : ses répertoires vides
+// n'apparaissent pas dans le log (absent pour une sauvegarde complète)
+static void load_snapshot_dirs(MountedSnapshot *snap) {
+    char dirs_path[PATH_MAX];
+    int len = snprintf(dirs_path, sizeof(dirs_path), "%s/%s/%s", fs.backup_dir, snap->name, BACKUP_DIRS);
+    if (len < 0 || (size_t)len >= sizeof(dirs_path)) return;
+    FILE *file = fopen(dirs_path, "r");
+    if (!file) return;
+
+    int capacity = 0;
+    char *line = NULL;
+    size_t line_size = 0;
+    ssize_t line_len;
+    while ((line_len = getline(&line, &line_size, file)) > 0) {
+        if (line[line_len - 1] == '\n') line[line_len - 1] = '\0';
+        if (snap->dir_count == capacity) {
+            capacity = capacity ? capacity * 2 : 256;
+            char **grown = realloc(snap->dirs, capacity * sizeof(char *));
+            if (!grown) {
+                perror("Erreur d'allocation mémoire");
+                break;
+            }
+            snap->dirs = grown;
+        }
+        char *copy = strdup(line);
+        if (!copy) break;
+        snap->dirs[snap->dir_count++] = copy;
+    }
+    free(line);
+    fclose(file);
+    qsort(snap->dirs, snap->dir_count, sizeof(char *), compare_dir_lines);
+}
+
+// Fonction pour lire et trier le log d'une sauvegarde au premier accès
+static void load_snapshot(MountedSnapshot *snap) {
+    pthread_mutex_lock(&fs.lock);
+    if (!snap->loaded) {
+        char log_path[PATH_MAX];
+        snprintf(log_path, sizeof(log_path), "%s/%s/.backup_log", fs.backup_dir, snap->name);
+        snap->logs = read_backup_log(log_path);
+        snap->entries = sort_backup_log(&snap->logs, &snap->count);
+        load_snapshot_dirs(snap);
+        snap->loaded = 1;
+    }
+    pthread_mutex_unlock(&fs.lock);
+}
+
+// Fonction pour séparer un chemin du montage en sauvegarde et chemin relatif
+// Retourne NULL pour la racine ou une sauvegarde inconnue
+static MountedSnapshot *resolve_path(const char *path, const char **relative) {
+    const char *name = path + 1;
+    size_t name_len = strcspn(name, "/");
+    *relative = name[name_len] == '/' ? name + name_len + 1 : "";
+
+    for (int i = 0; i < fs.count; i++) {
+        if (strlen(fs.snapshots[i].name) == name_len && strncmp(fs.snapshots[i].name, name, name_len) == 0) {
+            load_snapshot(&fs.snapshots[i]);
+            return &fs.snapshots[i];
+        }
+    }
+    return NULL;
+}
+
+// Premier élément dont le chemin est >= key (recherche dichotomique)
+static int lower_bound(MountedSnapshot *snap, const char *key) {
+    int low = 0, high = snap->count;
+    while (low < high) {
+        int mid = (low + high) / 2;
+        if (strcmp(snap->entries[mid]->path, key) < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+// Fonction pour savoir si relative est le préfixe d'au moins un chemin du log
+static int has_entries_below(MountedSnapshot *snap, const char *relative) {
+    char key[PATH_MAX];
+    int len = snprintf(key, sizeof(key), "%s/", relative);
+    if (len < 0 || (size_t)len >= sizeof(key)) return 0;
+    int i = lower_bound(snap, key);
+    return i < snap->count && strncmp(snap->entries[i]->path, key, len) == 0;
+}
+
+// Fonction pour trouver la ligne de .backup_dirs d'un répertoire (NULL s'il n'y figure pas)
+static const char *find_dir(MountedSnapshot *snap, const char *relative) {
+    if (!snap->dirs) return NULL;
+    char **found = bsearch(&relative, snap->dirs, snap->dir_count, sizeof(char *), compare_dir_lines);
+    return found ? *found : NULL;
+}
+
+// Fonction pour savoir si relative est un répertoire de la sauvegarde
+// (préfixe d'au moins un chemin, ou répertoire enregistré dans .backup_dirs)
+static int is_directory(MountedSnapshot *snap, const char *relative) {
+    if (relative[0] == '\0') return 1;
+    return has_entries_below(snap, relative) || find_dir(snap, relative) != NULL;
+}
+
+// Fonction pour trouver l'élément du log correspondant exactement à un fichier
+static log_element *find_entry(MountedSnapshot *snap, const char *relative) {
+    int i = lower_bound(snap, relative);
+    if (i < snap->count && strcmp(snap->entries[i]->path, relative) == 0) {
+        return snap->entries[i];
+    }
+    return NULL;
+}
+
+static int snapshot_fs_getattr(const char *path, struct stat *st, struct fuse_file_info *fi) {
+    (void)fi;
+    memset(st, 0, sizeof(*st));
+
+    if (strcmp(path, "/") == 0) {
+        st->st_mode = S_IFDIR | 0555;
+        st->st_nlink = 2;
+        return 0;
+    }
+
+    const char *relative;
+    MountedSnapshot *snap = resolve_path(path, &relative);
+    if (!snap) return -ENOENT;
+
+    // Les attributs sont issus du log, sans accéder aux données sauvegardées
+    log_element *elt = find_entry(snap, relative);
+    if (elt) {
+        st->st_mode = S_IFREG | 0444;
+        st->st_nlink = 1;
+        st->st_size = elt->size;
+        st->st_mtime = elt->mtime;
+        if (elt->mode != 0) {
+            // Permissions et propriétaire d'origine, sans droit d'écriture
+            st->st_mode = (elt->link_target ? S_IFLNK | 0777 : S_IFREG | (elt->mode & 07555));
+            st->st_uid = elt->uid;
+            st->st_gid = elt->gid;
+            st->st_mtim.tv_nsec = elt->mtime_nsec;
+        }
+        if (elt->size < 0) {
+            // Ancien log sans taille : la lire sur le fichier stocké
+            char stored_path[PATH_MAX];
+            struct stat stored;
+            snprintf(stored_path, sizeof(stored_path), "%s/%s/%s", fs.backup_dir, elt->stored ? elt->stored : snap->name, relative);
+            st->st_size = stat(stored_path, &stored) == 0 ? stored.st_size : 0;
+        }
+        return 0;
+    }
+
+    if (is_directory(snap, relative)) {
+        st->st_mode = S_IFDIR | 0555;
+        st->st_nlink = 2;
+        st->st_mtime = snap->creation_time;
+
+        // Permissions et dates d'origine pour un répertoire d'une sauvegarde par manifeste
+        const char *line = find_dir(snap, relative);
+        char *copy = line ? strdup(line) : NULL;
+        if (copy) {
+            char *cursor = copy + strcspn(copy, ";") + 1;
+            log_element dir;
+            parse_metadata_fields(&cursor, &dir);
+            if (dir.mode != 0) {
+                st->st_mode = S_IFDIR | (dir.mode & 07555);
+                st->st_uid = dir.uid;
+                st->st_gid = dir.gid;
+                st->st_mtime = dir.mtime;
+                st->st_mtim.tv_nsec = dir.mtime_nsec;
+            }
+            free_file_metadata(&dir);
+            free(copy);
+        }
+        return 0;
+    }
+    return -ENOENT;
+}
+
+static int snapshot_fs_readlink(const char *path, char *buf, size_t size) {
+    const char *relative;
+    MountedSnapshot *snap = resolve_path(path, &relative);
+    log_element *elt = snap ? find_entry(snap, relative) : NULL;
+    if (!elt) return -ENOENT;
+    if (!elt->link_target) return -EINVAL;
+
+    snprintf(buf, size, "%s", elt->link_target);
+    return 0;
+}
+
+static int snapshot_fs_readdir(const char *path, void *buf, fuse_fill_dir_t filler, off_t offset,
+                               struct fuse_file_info *fi, enum fuse_readdir_flags flags) {
+    (void)offset;
+    (void)fi;
+    (void)flags;
+
+    filler(buf, ".", NULL, 0, 0);
+    filler(buf, "..", NULL, 0, 0);
+
+    // La racine contient une entrée par sauvegarde
+    if (strcmp(path, "/") == 0) {
+        for (int i = 0; i < fs.count; i++) {
+            filler(buf, fs.snapshots[i].name, NULL, 0, 0);
+        }
+        return 0;
+    }
+
+    const char *relative;
+    MountedSnapshot *snap = resolve_path(path, &relative);
+    if (!snap || !is_directory(snap, relative)) return -ENOENT;
+
+    char prefix[PATH_MAX];
+    int prefix_len = relative[0] ? snprintf(prefix, sizeof(prefix), "%s/", relative) : 0;
+    prefix[prefix_len] = '\0';
+
+    // Les descendants du répertoire sont contigus dans le log trié :
+    // chaque composant fils n'est émis qu'une fois
+    char name[256] = "";
+    for (int i = lower_bound(snap, prefix); i < snap->count; i++) {
+        const char *entry_path = snap->entries[i]->path;
+        if (strncmp(entry_path, prefix, prefix_len) != 0) break;
+
+        const char *child = entry_path + prefix_len;
+        size_t child_len = strcspn(child, "/");
+        if (child_len >= sizeof(name)) continue;
+        if (strncmp(name, child, child_len) == 0 && name[child_len] == '\0') continue;
+
+        memcpy(name, child, child_len);
+        name[child_len] = '\0';
+        filler(buf, name, NULL, 0, 0);
+    }
+
+    // Sous-répertoires de .backup_dirs sans fichier (ceux qui en contiennent ont été émis ci-dessus)
+    if (snap->dirs) {
+        const char *key = prefix;
+        int low = 0, high = snap->dir_count;
+        while (low < high) {
+            int mid = (low + high) / 2;
+            if (compare_dir_lines(&snap->dirs[mid], &key) < 0) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        for (int i = low; i < snap->dir_count; i++) {
+            const char *line = snap->dirs[i];
+            if (strncmp(line, prefix, prefix_len) != 0) break;
+
+            const char *child = line + prefix_len;
+            size_t child_len = strcspn(child, ";");
+            if (child_len == 0 || child_len >= sizeof(name) || memchr(child, '/', child_len)) continue;
+
+            char child_path[PATH_MAX];
+            int len = snprintf(child_path, sizeof(child_path), "%.*s", (int)(prefix_len + child_len), line);
+            if (len < 0 || (size_t)len >= sizeof(child_path) || has_entries_below(snap, child_path)) continue;
+
+            memcpy(name, child, child_len);
+            name[child_len] = '\0';
+            filler(buf, name, NULL, 0, 0);
+        }
+    }
+    return 0;
+}
+
+static int snapshot_fs_open(const char *path, struct fuse_file_info *fi) {
+    if ((fi->flags & O_ACCMODE) != O_RDONLY) return -EROFS;
+
+    const char *relative;
+    MountedSnapshot *snap = resolve_path(path, &relative);
+    log_element *elt = snap ? find_entry(snap, relative) : NULL;
+    if (!elt) return -ENOENT;
+    if (elt->link_target) return -ELOOP;
+
+    StoredData stored;
+    stored_data_locate(fs.backup_dir, snap->name, elt, &stored);
+
+    OpenFile *file = calloc(1, sizeof(OpenFile));
+    if (!file) return -ENOMEM;
+
+    if (stored.length >= 0) {
+        // Un fichier regroupé est petit : sa plage du conteneur est gardée en mémoire
+        file->fd = -1;
+        file->packed = malloc(PACK_FILE_MAX);
+        file->packed_size = file->packed ? pack_read_entry(&stored, file->packed, PACK_FILE_MAX) : -1;
+        if (file->packed_size < 0) {
+            free(file->packed);
+            free(file);
+            return -EIO;
+        }
+        fi->fh = (uint64_t)(uintptr_t)file;
+        fi->keep_cache = 1;
+        return 0;
+    }
+
+    file->fd = open(stored.path, O_RDONLY | O_NOFOLLOW);
+    if (file->fd < 0 || fstat(file->fd, &file->st) != 0) {
+        int err = errno;
+        if (file->fd >= 0) close(file->fd);
+        free(file);
+        return -err;
+    }
+    file->next_block = 0;
+
+    // Une copie chiffrée est lue segment par segment, hors du cache de chunks (qui garderait du clair)
+    if (seal_is_sealed(file->fd, 0, -1)) {
+        file->sealed = malloc(sizeof(SealReader));
+        if (!file->sealed || seal_reader_attach(file->sealed, file->fd, 0, -1) != 0) {
+            free(file->sealed);
+            close(file->fd);
+            free(file);
+            return -EIO;
+        }
+    }
+    pthread_mutex_init(&file->lock, NULL);
+
+    fi->fh = (uint64_t)(uintptr_t)file;
+    fi->keep_cache = 1; // Le contenu d'une sauvegarde ne change jamais
+    return 0;
+}
+
+// Fonction pour copier un bloc depuis le cache de chunks ; retourne sa taille ou -1 s'il est absent
+static ssize_t cache_lookup(OpenFile *file, off_t block, char *out, size_t skip, size_t len) {
+    unsigned char key[CHUNK_CACHE_KEY_SIZE];
+    unsigned char data[CHUNK_SIZE];
+    chunk_cache_file_key(&file->st, block, key);
+
+    ssize_t size = chunk_cache_get(key, data);
+    if (size > 0 && skip < (size_t)size) {
+        memcpy(out, data + skip, ((size_t)size - skip < len) ? (size_t)size - skip : len);
+    }
+    return size;
+}
+
+// Fonction pour lire count blocs consécutifs du fichier stocké et les placer dans le cache
+static int fill_blocks(OpenFile *file, off_t first_block, int count) {
+    unsigned char *buffer = malloc((size_t)count * CHUNK_SIZE);
+    if (!buffer) return -ENOMEM;
+
+    ssize_t bytes_read = pread(file->fd, buffer, (size_t)count * CHUNK_SIZE, first_block * CHUNK_SIZE);
+    if (bytes_read < 0) {
+        int err = errno;
+        free(buffer);
+        return -err;
+    }
+
+    for (ssize_t done = 0; done < bytes_read; done += CHUNK_SIZE, first_block++) {
+        size_t size = (bytes_read - done < CHUNK_SIZE) ? (size_t)(bytes_read - done) : CHUNK_SIZE;
+        unsigned char key[CHUNK_CACHE_KEY_SIZE];
+        chunk_cache_file_key(&file->st, first_block, key);
+        chunk_cache_put(key, buffer + done, size);
+    }
+
+    free(buffer);
+    return 0;
+}
+
+static int snapshot_fs_read(const char *path, char *buf, size_t size, off_t offset, struct fuse_file_info *fi) {
+    (void)path;
+    OpenFile *file = (OpenFile *)(uintptr_t)fi->fh;
+
+    if (file->packed) {
+        if (offset >= file->packed_size) return 0;
+        size_t available = file->packed_size - offset;
+        size_t len = size < available ? size : available;
+        memcpy(buf, file->packed + offset, len);
+        return (int)len;
+    }
+
+    if (file->sealed) {
+        pthread_mutex_lock(&file->lock);
+        ssize_t bytes = seal_reader_read(file->sealed, buf, size, offset);
+        pthread_mutex_unlock(&file->lock);
+        return bytes < 0 ? -EIO : (int)bytes;
+    }
+
+    off_t first_block = offset / CHUNK_SIZE;
+    off_t last_block = (offset + size - 1) / CHUNK_SIZE;
+
+    // FUSE peut lire le même fichier depuis plusieurs threads : le bloc attendu est lu
+    // et avancé en une seule fois
+    pthread_mutex_lock(&file->lock);
+    int sequential = first_block == file->next_block;
+    file->next_block = last_block + 1;
+    pthread_mutex_unlock(&file->lock);
+    size_t copied = 0;
+
+    for (off_t block = first_block; block <= last_block; block++) {
+        size_t skip = (block == first_block) ? offset % CHUNK_SIZE : 0;
+        size_t len = size - copied;
+        ssize_t block_size = cache_lookup(file, block, buf + copied, skip, len);
+
+        if (block_size < 0) {
+            // Bloc absent : lire la fin de la requête, plus une fenêtre d'anticipation si la lecture est séquentielle
+            int count = (int)(last_block - block + 1);
+            if (sequential && count < FS_READ_AHEAD_BLOCKS) count = FS_READ_AHEAD_BLOCKS;
+            int err = fill_blocks(file, block, count);
+            if (err < 0) return err;
+            block_size = cache_lookup(file, block, buf + copied, skip, len);
+            if (block_size < 0) {
+                // Le bloc a déjà été évincé par une lecture concurrente : lecture directe
+                block_size = pread(file->fd, buf + copied, len, block * CHUNK_SIZE + skip);
+                if (block_size < 0) return -errno;
+                copied += block_size;
+                if ((size_t)block_size < len) break;
+                continue;
+            }
+        }
+
+        if ((size_t)block_size <= skip) break; // Fin du fichier
+        size_t available = block_size - skip;
+        copied += available < len ? available : len;
+        if (block_size < CHUNK_SIZE) break; // Dernier bloc du fichier
+    }
+
+    return (int)copied;
+}
+
+static int snapshot_fs_release(const char *path, struct fuse_file_info *fi) {
+    (void)path;
+    OpenFile *file = (OpenFile *)(uintptr_t)fi->fh;
+    if (file->sealed) {
+        seal_reader_close(file->sealed);
+        free(file->sealed);
+    }
+    if (file->fd >= 0) {
+        pthread_mutex_destroy(&file->lock);
+        close(file->fd);
+    }
+    free(file->packed);
+    free(file);
+    return 0;
+}
+
+static const struct fuse_operations snapshot_fs_operations = {
+    .getattr = snapshot_fs_getattr,
+    .readlink = snapshot_fs_readlink,
+    .readdir = snapshot_fs_readdir,
+    .open = snapshot_fs_open,
+    .read = snapshot_fs_read,
+    .release = snapshot_fs_release,
+};
+
+// Fonction pour monter toutes les sauvegardes d'un répertoire en lecture seule (FUSE)
+int mount_backups(const char *backup_dir, const char *mountpoint) {
+    if (!realpath(backup_dir, fs.backup_dir)) {
+        perror("Le répertoire de sauvegarde spécifié est inaccessible");
+        return -1;
+    }
+
+    if (seal_check_repository(fs.backup_dir, 0) != 0 || load_snapshot_list(fs.backup_dir) != 0) {
+        return -1;
+    }
+
+    printf("Montage de %d sauvegardes sur %s (Ctrl-C pour démonter)\n", fs.count, mountpoint);
+
+    // Exécution au premier plan : le montage dure tant que la commande tourne
+    char *fuse_argv[] = { "backup", "-f", "-o", "ro,fsname=backup", (char *)mountpoint, NULL };
+    int ret = fuse_main(5, fuse_argv, &snapshot_fs_operations, NULL);
+
+    for (int i = 0; i < fs.count; i++) {
+        free(fs.snapshots[i].entries);
+        free_backup_log(&fs.snapshots[i].logs);
+        for (int j = 0; j < fs.snapshots[i].dir_count; j++) {
+            free(fs.snapshots[i].dirs[j]);
+        }
+        free(fs.snapshots[i].dirs);
+    }
+    free(fs.snapshots);
+    chunk_cache_print_stats(stdout);
+    chunk_cache_destroy();
+    return ret;
+}
+
+#else
+
+// Fonction de remplacement lorsque le programme est compilé sans libfuse3
+int mount_backups(const char *backup_dir, const char *mountpoint) {
+    (void)backup_dir;
+    (void)mountpoint;
+    fprintf(stderr, "Montage indisponible : programme compilé sans support FUSE (make FUSE=1)\n");
+    return -1;
+}
+
+#endif // HAVE_FUSE
@@ -0,0 +1,11 @@
+#ifndef SNAPSHOT_FS_H
+#define SNAPSHOT_FS_H
+
+// Nombre de blocs lus par anticipation lors d'une lecture séquentielle
+#define FS_READ_AHEAD_BLOCKS 32
+
+// Fonction pour monter toutes les sauvegardes d'un répertoire en lecture seule (FUSE)
+// Bloque jusqu'au démontage ; retourne 0 en cas de succès
+int mount_backups(const char *backup_dir, const char *mountpoint);
+
+#endif // SNAPSHOT_FS_H
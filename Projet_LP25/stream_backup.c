@@ -0,0 +1,518 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <libgen.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <openssl/md5.h>
+#include <openssl/evp.h>
+#include "stream_backup.h"
+#include "backup_manager.h"
+#include "deduplication.h"
+#include "file_handler.h"
+#include "metadata.h"
+#include "durable.h"
+#include "throttle.h"
+#include "pack.h"
+#include "seal.h"
+#include "catalog.h"
+
+// File de blocs entre le thread qui lit un descripteur et celui qui traite les données
+typedef struct {
+    int fd;                   // Descripteur lu par le thread de lecture
+    unsigned char *blocks[STREAM_QUEUE_BLOCKS];
+    size_t sizes[STREAM_QUEUE_BLOCKS];
+    int head;                 // Prochain bloc à traiter
+    int count;                // Blocs remplis en attente
+    int done;                 // Fin du flux atteinte (ou erreur de lecture)
+    int error;                // errno de la lecture en erreur (0 sinon)
+    int stopped;              // Le traitement a été abandonné
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t filled, freed;
+} StreamQueue;
+
+// Thread de lecture : remplit les blocs libres de la file jusqu'à la fin du flux
+static void *stream_reader(void *arg) {
+    StreamQueue *queue = arg;
+    for (;;) {
+        pthread_mutex_lock(&queue->lock);
+        while (queue->count == STREAM_QUEUE_BLOCKS && !queue->stopped) {
+            pthread_cond_wait(&queue->freed, &queue->lock);
+        }
+        int slot = (queue->head + queue->count) % STREAM_QUEUE_BLOCKS;
+        int stopped = queue->stopped;
+        pthread_mutex_unlock(&queue->lock);
+        if (stopped) {
+            return NULL;
+        }
+
+        // Le bloc est rempli hors verrou : il n'est pas lu avant d'être compté dans la file
+        size_t size = 0;
+        int error = 0;
+        while (size < STREAM_BLOCK_SIZE) {
+            ssize_t bytes = read(queue->fd, queue->blocks[slot] + size, STREAM_BLOCK_SIZE - size);
+            if (bytes < 0) {
+                if (errno == EINTR) continue;
+                error = errno;
+                break;
+            }
+            if (bytes == 0) break;
+            size += bytes;
+        }
+        throttle_consume(THROTTLE_READ, size);
+
+        pthread_mutex_lock(&queue->lock);
+        queue->sizes[slot] = size;
+        if (size > 0) {
+            queue->count++;
+        }
+        if (size < STREAM_BLOCK_SIZE) {
+            queue->done = 1;
+            queue->error = error;
+        }
+        int done = queue->done;
+        pthread_cond_signal(&queue->filled);
+        pthread_mutex_unlock(&queue->lock);
+        if (done) {
+            return NULL;
+        }
+    }
+}
+
+// Fonction pour démarrer la lecture de fd par un thread dédié ; retourne 0 en cas de succès
+static int stream_queue_start(StreamQueue *queue, int fd) {
+    memset(queue, 0, sizeof(*queue));
+    queue->fd = fd;
+    for (int i = 0; i < STREAM_QUEUE_BLOCKS; i++) {
+        queue->blocks[i] = malloc(STREAM_BLOCK_SIZE);
+        if (!queue->blocks[i]) {
+            perror("Erreur d'allocation mémoire pour la file du flux");
+            for (int j = 0; j < i; j++) free(queue->blocks[j]);
+            return -1;
+        }
+    }
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->filled, NULL);
+    pthread_cond_init(&queue->freed, NULL);
+    if (pthread_create(&queue->thread, NULL, stream_reader, queue) != 0) {
+        perror("Erreur lors du lancement du thread de lecture");
+        for (int i = 0; i < STREAM_QUEUE_BLOCKS; i++) free(queue->blocks[i]);
+        pthread_mutex_destroy(&queue->lock);
+        pthread_cond_destroy(&queue->filled);
+        pthread_cond_destroy(&queue->freed);
+        return -1;
+    }
+    return 0;
+}
+
+// Fonction pour attendre le prochain bloc ; retourne sa taille, 0 à la fin du flux, -1 en cas d'erreur
+static ssize_t stream_queue_next(StreamQueue *queue, const unsigned char **data) {
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == 0 && !queue->done) {
+        pthread_cond_wait(&queue->filled, &queue->lock);
+    }
+    ssize_t size;
+    if (queue->count > 0) {
+        *data = queue->blocks[queue->head];
+        size = queue->sizes[queue->head];
+    } else {
+        size = queue->error ? -1 : 0;
+        errno = queue->error;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return size;
+}
+
+// Fonction pour rendre au thread de lecture le bloc qui vient d'être traité
+static void stream_queue_release(StreamQueue *queue) {
+    pthread_mutex_lock(&queue->lock);
+    queue->head = (queue->head + 1) % STREAM_QUEUE_BLOCKS;
+    queue->count--;
+    pthread_cond_signal(&queue->freed);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+// Fonction pour arrêter le thread de lecture et libérer la file
+static void stream_queue_stop(StreamQueue *queue) {
+    pthread_mutex_lock(&queue->lock);
+    queue->stopped = 1;
+    pthread_cond_signal(&queue->freed);
+    pthread_mutex_unlock(&queue->lock);
+    pthread_join(queue->thread, NULL);
+
+    for (int i = 0; i < STREAM_QUEUE_BLOCKS; i++) {
+        free(queue->blocks[i]);
+    }
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->filled);
+    pthread_cond_destroy(&queue->freed);
+}
+
+// Fonction pour écrire entièrement size octets dans fd
+static int write_all(int fd, const unsigned char *data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += written;
+        size -= written;
+    }
+    return 0;
+}
+
+// Fonction pour savoir si le chunk commençant à data + offset est nul
+static int zero_chunk(const unsigned char *data, size_t size, size_t offset) {
+    size_t len = size - offset < CHUNK_SIZE ? size - offset : CHUNK_SIZE;
+    return chunk_is_hole(data + offset, len);
+}
+
+// Fonction pour écrire un bloc du flux en laissant des trous à la place des chunks nuls
+// Les chunks non nuls consécutifs sont écrits en une seule fois ; chaque chunk n'est examiné qu'une fois
+static int write_sparse_block(int fd, const unsigned char *data, size_t size) {
+    size_t start = 0;
+    int zero = size > 0 && zero_chunk(data, size, 0);
+    while (start < size) {
+        size_t end = start;
+        int next_zero = zero;
+        while (end < size && next_zero == zero) {
+            end += size - end < CHUNK_SIZE ? size - end : CHUNK_SIZE;
+            next_zero = end < size && zero_chunk(data, size, end);
+        }
+        if (zero) {
+            if (lseek(fd, end - start, SEEK_CUR) < 0) return -1;
+        } else {
+            if (write_all(fd, data + start, end - start) != 0) return -1;
+            throttle_consume(THROTTLE_WRITE, end - start);
+        }
+        start = end;
+        zero = next_zero;
+    }
+    return 0;
+}
+
+// Un nom de flux est un chemin relatif, sans composant "..", ni caractère réservé du log
+static int valid_stream_name(const char *name) {
+    if (name[0] == '\0' || name[0] == '/' || strpbrk(name, ";\n")) {
+        return 0;
+    }
+    for (const char *part = name; part; part = strchr(part, '/') ? strchr(part, '/') + 1 : NULL) {
+        size_t len = strcspn(part, "/");
+        if (len == 0 || (len == 1 && part[0] == '.') || (len == 2 && strncmp(part, "..", 2) == 0)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int compare_names_desc(const void *a, const void *b) {
+    return strcmp(*(char *const *)b, *(char *const *)a);
+}
+
+// Fonction pour retrouver la dernière sauvegarde du flux name dans backup_dir
+// Remplit snapshot avec son nom ; retourne le log contenant l'élément (*found), vide si aucune
+static log_t find_previous_stream(const char *backup_dir, const char *name, char *snapshot, size_t size,
+                                  log_element **found) {
+    log_t logs = {NULL, NULL};
+    *found = NULL;
+    DIR *dp = opendir(backup_dir);
+    if (!dp) {
+        return logs;
+    }
+
+    char **names = NULL;
+    int count = 0, capacity = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dp)) != NULL) {
+        if (entry->d_name[0] == '.') continue;
+        char log_path[PATH_MAX];
+        snprintf(log_path, sizeof(log_path), "%s/%s/.backup_log", backup_dir, entry->d_name);
+        if (access(log_path, F_OK) != 0) continue;
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            char **grown = realloc(names, capacity * sizeof(char *));
+            if (!grown) break;
+            names = grown;
+        }
+        names[count++] = strdup(entry->d_name);
+    }
+    closedir(dp);
+
+    // Les noms de sauvegarde sont des dates : la plus récente d'abord
+    qsort(names, count, sizeof(char *), compare_names_desc);
+    for (int i = 0; i < count && !*found; i++) {
+        char snapshot_path[PATH_MAX];
+        snprintf(snapshot_path, sizeof(snapshot_path), "%s/%s", backup_dir, names[i]);
+        logs = read_backup_log_prefix(snapshot_path, name);
+        for (log_element *elt = logs.head; elt; elt = elt->next) {
+            if (strcmp(elt->path, name) == 0 && !elt->link_target) {
+                *found = elt;
+                snprintf(snapshot, size, "%s", names[i]);
+                break;
+            }
+        }
+        if (!*found) {
+            free_backup_log(&logs);
+        }
+    }
+
+    for (int i = 0; i < count; i++) free(names[i]);
+    free(names);
+    return logs;
+}
+
+// Fonction pour sauvegarder l'entrée standard sous le nom name dans une nouvelle sauvegarde
+// Le flux est lu par un thread dédié pendant que le thread principal le hache et l'écrit ;
+// la sauvegarde ne contient que ce fichier et ne sert pas de base aux sauvegardes --backup suivantes
+int backup_stdin(const char *name, const char *backup_dir) {
+    if (!valid_stream_name(name)) {
+        fprintf(stderr, "Nom de flux invalide : %s\n", name);
+        return -1;
+    }
+    struct stat backup_stat;
+    if (stat(backup_dir, &backup_stat) == -1 || !S_ISDIR(backup_stat.st_mode)) {
+        fprintf(stderr, "Le répertoire de sauvegarde spécifié est inaccessible : %s\n", backup_dir);
+        return -1;
+    }
+    if (seal_check_repository(backup_dir, 1) != 0) {
+        return -1;
+    }
+
+    char previous_name[256];
+    log_element *previous;
+    log_t previous_log = find_previous_stream(backup_dir, name, previous_name, sizeof(previous_name), &previous);
+
+    char backup_name[64], snapshot_path[PATH_MAX], dest_path[PATH_MAX], parent[PATH_MAX];
+    generate_backup_name(backup_name, sizeof(backup_name));
+    snprintf(snapshot_path, sizeof(snapshot_path), "%s/%s", backup_dir, backup_name);
+    int dest_len = snprintf(dest_path, sizeof(dest_path), "%s/%s", snapshot_path, name);
+    if (dest_len < 0 || (size_t)dest_len >= sizeof(dest_path)) {
+        fprintf(stderr, "Nom de flux trop long : %s\n", name);
+        free_backup_log(&previous_log);
+        return -1;
+    }
+    snprintf(parent, sizeof(parent), "%s", dest_path);
+    if (mkdir(snapshot_path, 0755) == -1) {
+        perror("Erreur lors de la création du répertoire de sauvegarde");
+        free_backup_log(&previous_log);
+        return -1;
+    }
+    // À partir d'ici, toute erreur supprime la sauvegarde incomplète
+    if (make_parent_dirs(dirname(parent)) == -1) {
+        perror("Erreur lors de la création du répertoire de sauvegarde");
+        free_backup_log(&previous_log);
+        abandon_snapshot(snapshot_path);
+        return -1;
+    }
+
+    int fd = open(dest_path, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW, 0600);
+    StreamQueue queue;
+    if (fd < 0 || stream_queue_start(&queue, STDIN_FILENO) != 0) {
+        perror("Erreur lors de la création du fichier du flux");
+        if (fd >= 0) close(fd);
+        free_backup_log(&previous_log);
+        abandon_snapshot(snapshot_path);
+        return -1;
+    }
+
+    // Avec --encrypt-key, le flux est chiffré segment par segment au fil de sa lecture
+    SealWriter writer;
+    int sealed = seal_enabled();
+    if (sealed && seal_writer_open(&writer, fd, 0) != 0) {
+        perror("Erreur lors de la création du fichier du flux");
+        stream_queue_stop(&queue);
+        close(fd);
+        free_backup_log(&previous_log);
+        abandon_snapshot(snapshot_path);
+        return -1;
+    }
+
+    EVP_MD_CTX *md5_ctx = EVP_MD_CTX_new();
+    off_t total = 0;
+    const unsigned char *data;
+    ssize_t size = 0;
+    int result = md5_ctx && EVP_DigestInit_ex(md5_ctx, EVP_md5(), NULL) == 1 ? 0 : -1;
+    while (result == 0 && (size = stream_queue_next(&queue, &data)) > 0) {
+        EVP_DigestUpdate(md5_ctx, data, size);
+        if ((sealed ? seal_writer_write(&writer, data, size) : write_sparse_block(fd, data, size)) != 0) {
+            perror("Erreur lors de l'écriture du flux");
+            result = -1;
+            break;
+        }
+        total += size;
+        stream_queue_release(&queue);
+    }
+    if (size < 0) {
+        perror("Erreur lors de la lecture de l'entrée standard");
+        result = -1;
+    }
+    stream_queue_stop(&queue);
+
+    // Fixe la taille finale (trou final éventuel) ; l'en-tête d'une copie chiffrée est écrit en dernier
+    struct stat st;
+    if (sealed && seal_writer_finish(&writer) != 0 && result == 0) {
+        perror("Erreur lors de l'écriture du flux");
+        result = -1;
+    }
+    if (result == 0 && ((!sealed && ftruncate(fd, total) != 0) || fstat(fd, &st) != 0)) {
+        perror("Erreur lors de l'écriture du flux");
+        result = -1;
+    }
+    close(fd);
+    log_element elt;
+    if (result != 0 || read_file_metadata(dest_path, &st, &elt) != 0) {
+        EVP_MD_CTX_free(md5_ctx);
+        free_backup_log(&previous_log);
+        abandon_snapshot(snapshot_path);
+        return -1;
+    }
+    EVP_DigestFinal_ex(md5_ctx, elt.md5, NULL);
+    EVP_MD_CTX_free(md5_ctx);
+
+    char date[64];
+    struct tm *mod_time = localtime(&st.st_mtime);
+    if (!mod_time || strftime(date, sizeof(date), "%Y-%m-%d-%H:%M:%S", mod_time) == 0) {
+        snprintf(date, sizeof(date), "%lld", (long long)st.st_mtime);
+    }
+    elt.path = dest_path;
+    elt.date = date;
+    elt.size = total;
+
+    // Flux identique à sa dernière sauvegarde : la ligne désigne la sauvegarde qui stocke déjà les données
+    if (previous && previous->size == total && memcmp(previous->md5, elt.md5, MD5_DIGEST_LENGTH) == 0) {
+        elt.stored = strdup(previous->stored ? previous->stored : previous_name);
+        unlink(dest_path);
+        // Les répertoires créés pour le nom du flux sont vides : ils sont retirés
+        snprintf(parent, sizeof(parent), "%s", dest_path);
+        for (char *dir = dirname(parent); strlen(dir) > strlen(snapshot_path) && rmdir(dir) == 0; dir = dirname(dir)) {
+        }
+        printf("Flux identique à la sauvegarde %s : données non dupliquées\n", previous_name);
+    }
+    free_backup_log(&previous_log);
+
+    // Le log n'a qu'une ligne : il est trié et indexé en place, puis publié après l'écriture des données
+    char log_pending[PATH_MAX], log_path[PATH_MAX];
+    FILE *logfile = NULL;
+    if (snprintf(log_pending, sizeof(log_pending), "%s/%s", snapshot_path, BACKUP_LOG_PENDING) < (int)sizeof(log_pending) &&
+        snprintf(log_path, sizeof(log_path), "%s/.backup_log", snapshot_path) < (int)sizeof(log_path)) {
+        logfile = fopen(log_pending, "w");
+    }
+    if (!logfile) {
+        perror("Erreur lors de l'écriture du log du flux");
+        free_file_metadata(&elt);
+        abandon_snapshot(snapshot_path);
+        return -1;
+    }
+    write_log_element(&elt, logfile, backup_dir);
+    fclose(logfile);
+    free_file_metadata(&elt);
+
+    if (index_backup_log(snapshot_path, log_pending) != 0 ||
+        durable_sync_filesystem(snapshot_path) != 0 ||
+        durable_publish(log_pending, log_path) != 0) {
+        abandon_snapshot(snapshot_path);
+        return -1;
+    }
+    if (catalog_update(backup_dir) != 0) {
+        fprintf(stderr, "Catalogue non mis à jour : il sera complété à la prochaine recherche\n");
+    }
+
+    printf("Flux sauvegardé : %s (%lld octets) dans %s\n", name, (long long)total, snapshot_path);
+    print_dedup_stats(stdout);
+    return 0;
+}
+
+// Fonction pour écrire sur la sortie standard le fichier name de la sauvegarde backup_id
+// Les messages vont sur la sortie d'erreur : la sortie standard ne contient que les données
+int restore_stdout(const char *backup_id, const char *name) {
+    log_t logs = read_backup_log_prefix(backup_id, name);
+    log_element *elt = logs.head;
+    while (elt && (strcmp(elt->path, name) != 0 || elt->link_target)) {
+        elt = elt->next;
+    }
+    if (!elt) {
+        fprintf(stderr, "Fichier introuvable dans la sauvegarde : %s\n", name);
+        free_backup_log(&logs);
+        return -1;
+    }
+
+    char parent[PATH_MAX], snapshot[PATH_MAX];
+    snprintf(parent, sizeof(parent), "%s", backup_id);
+    snprintf(snapshot, sizeof(snapshot), "%s", backup_id);
+    StoredData stored;
+    stored_data_locate(dirname(parent), basename(snapshot), elt, &stored);
+    free_backup_log(&logs);
+
+    int result = 0;
+    if (stored.length >= 0) {
+        // Fichier regroupé dans un conteneur : il est petit, lu d'un bloc
+        unsigned char *packed = malloc(PACK_FILE_MAX);
+        ssize_t size = packed ? pack_read_entry(&stored, packed, PACK_FILE_MAX) : -1;
+        if (size < 0 || write_all(STDOUT_FILENO, packed, size) != 0) {
+            perror("Erreur lors de l'écriture du flux");
+            result = -1;
+        }
+        free(packed);
+        return result;
+    }
+
+    int fd = open(stored.path, O_RDONLY | O_NOFOLLOW);
+    if (fd >= 0) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+
+    // Une copie chiffrée est déchiffrée segment par segment (le noyau lit en avance grâce à POSIX_FADV_SEQUENTIAL)
+    if (fd >= 0 && seal_is_sealed(fd, 0, -1)) {
+        SealReader reader;
+        if (seal_reader_attach(&reader, fd, 0, -1) != 0) {
+            close(fd);
+            return -1;
+        }
+        const unsigned char *plain;
+        ssize_t bytes = 0;
+        for (off_t offset = 0; offset < reader.size; offset += bytes) {
+            bytes = seal_reader_pread(&reader, offset, SEAL_SEGMENT_SIZE, &plain);
+            if (bytes <= 0 || write_all(STDOUT_FILENO, plain, bytes) != 0) {
+                perror("Erreur lors de l'écriture du flux");
+                result = -1;
+                break;
+            }
+        }
+        seal_reader_close(&reader);
+        close(fd);
+        return result;
+    }
+    StreamQueue queue;
+    if (fd < 0 || stream_queue_start(&queue, fd) != 0) {
+        perror("Erreur lors de l'ouverture du fichier sauvegardé");
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+
+    // Le fichier est lu en avance par le thread de lecture pendant que le consommateur du flux écrit
+    const unsigned char *data;
+    ssize_t size;
+    while ((size = stream_queue_next(&queue, &data)) > 0) {
+        if (write_all(STDOUT_FILENO, data, size) != 0) {
+            perror("Erreur lors de l'écriture du flux");
+            result = -1;
+            break;
+        }
+        stream_queue_release(&queue);
+    }
+    if (size < 0) {
+        perror("Erreur lors de la lecture du fichier sauvegardé");
+        result = -1;
+    }
+    stream_queue_stop(&queue);
+    close(fd);
+    return result;
+}
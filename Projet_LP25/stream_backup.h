@@ -0,0 +1,19 @@
+#ifndef STREAM_BACKUP_H
+#define STREAM_BACKUP_H
+
+// Taille des blocs échangés entre le thread de lecture du flux et celui d'écriture
+#define STREAM_BLOCK_SIZE (1024 * 1024)
+
+// Nombre de blocs en attente : le producteur du flux (pg_dump, mysqldump...) n'attend
+// que si l'écriture de la sauvegarde a tout ce retard
+#define STREAM_QUEUE_BLOCKS 32
+
+// Fonction pour sauvegarder l'entrée standard sous le nom name dans une nouvelle sauvegarde de backup_dir
+// Un flux identique à la dernière sauvegarde de name n'est pas stocké une seconde fois
+// Retourne 0 en cas de succès
+int backup_stdin(const char *name, const char *backup_dir);
+// Fonction pour écrire sur la sortie standard le fichier name de la sauvegarde backup_id
+// Retourne 0 en cas de succès
+int restore_stdout(const char *backup_id, const char *name);
+
+#endif // STREAM_BACKUP_H
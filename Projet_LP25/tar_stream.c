@@ -0,0 +1,1253 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <libgen.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <openssl/md5.h>
+#include <openssl/evp.h>
+#include "tar_stream.h"
+#include "backup_manager.h"
+#include "file_handler.h"
+#include "metadata.h"
+#include "durable.h"
+#include "throttle.h"
+#include "pack.h"
+#include "seal.h"
+#include "catalog.h"
+
+// En-tête ustar (un bloc de 512 octets)
+typedef struct {
+    char name[100];
+    char mode[8];
+    char uid[8];
+    char gid[8];
+    char size[12];
+    char mtime[12];
+    char chksum[8];
+    char typeflag;
+    char linkname[100];
+    char magic[6];
+    char version[2];
+    char uname[32];
+    char gname[32];
+    char devmajor[8];
+    char devminor[8];
+    char prefix[155];
+    char pad[12];
+} TarHeader;
+
+static const char zero_block[TAR_BLOCK_SIZE];
+
+// Fonction pour écrire une valeur en octal dans un champ numérique ; retourne -1 si elle ne tient pas
+static int tar_octal(char *field, size_t len, unsigned long long value) {
+    char buffer[32];
+    int written = snprintf(buffer, sizeof(buffer), "%0*llo", (int)len - 1, value);
+    if (written >= (int)len) {
+        return -1;
+    }
+    memcpy(field, buffer, len);
+    return 0;
+}
+
+// Fonction pour calculer la somme de contrôle d'un en-tête (champ chksum compté comme des espaces)
+static unsigned int tar_sum(const TarHeader *header) {
+    TarHeader copy = *header;
+    memset(copy.chksum, ' ', sizeof(copy.chksum));
+    unsigned int sum = 0;
+    const unsigned char *bytes = (const unsigned char *)&copy;
+    for (size_t i = 0; i < sizeof(copy); i++) {
+        sum += bytes[i];
+    }
+    return sum;
+}
+
+// Fonction pour lire un champ numérique (octal, ou base 256 pour les grandes valeurs de GNU tar)
+static unsigned long long tar_number(const char *field, size_t len) {
+    if ((unsigned char)field[0] & 0x80) {
+        unsigned long long value = (unsigned char)field[0] & 0x7f;
+        for (size_t i = 1; i < len; i++) {
+            value = (value << 8) | (unsigned char)field[i];
+        }
+        return value;
+    }
+    char buffer[32];
+    size_t n = strnlen(field, len);
+    memcpy(buffer, field, n);
+    buffer[n] = '\0';
+    return strtoull(buffer, NULL, 8);
+}
+
+// Fonction pour compléter les données écrites jusqu'à la fin de leur dernier bloc
+static void tar_pad(FILE *out, off_t size) {
+    size_t rest = size % TAR_BLOCK_SIZE;
+    if (rest) {
+        fwrite(zero_block, 1, TAR_BLOCK_SIZE - rest, out);
+    }
+}
+
+// Fonction pour ajouter un enregistrement "longueur clé=valeur\n" à un en-tête pax
+// La longueur annoncée compte ses propres chiffres
+static void pax_record(char *buffer, size_t *len, size_t capacity, const char *key, const char *value) {
+    size_t base = strlen(key) + strlen(value) + 3;
+    size_t total = base + 1;
+    while (total != base + (size_t)snprintf(NULL, 0, "%zu", total)) {
+        total = base + snprintf(NULL, 0, "%zu", total);
+    }
+    if (*len + total < capacity) {
+        *len += snprintf(buffer + *len, capacity - *len, "%zu %s=%s\n", total, key, value);
+    }
+}
+
+// Fonction pour écrire l'en-tête d'un élément ; un en-tête pax le précède si un champ ne tient pas en ustar
+static void tar_write_header(FILE *out, const char *path, char type, const log_element *meta, off_t size,
+                             const char *link) {
+    TarHeader header;
+    memset(&header, 0, sizeof(header));
+    char pax[3 * PATH_MAX];
+    size_t pax_len = 0;
+    char value[64];
+
+    if (strlen(path) < sizeof(header.name)) {
+        memcpy(header.name, path, strlen(path));
+    } else {
+        pax_record(pax, &pax_len, sizeof(pax), "path", path);
+        memcpy(header.name, path, sizeof(header.name) - 1);
+    }
+    if (link) {
+        if (strlen(link) < sizeof(header.linkname)) {
+            memcpy(header.linkname, link, strlen(link));
+        } else {
+            pax_record(pax, &pax_len, sizeof(pax), "linkpath", link);
+            memcpy(header.linkname, link, sizeof(header.linkname) - 1);
+        }
+    }
+    if (tar_octal(header.size, sizeof(header.size), size) != 0) {
+        snprintf(value, sizeof(value), "%lld", (long long)size);
+        pax_record(pax, &pax_len, sizeof(pax), "size", value);
+        tar_octal(header.size, sizeof(header.size), 0);
+    }
+    if (tar_octal(header.uid, sizeof(header.uid), meta->uid) != 0) {
+        snprintf(value, sizeof(value), "%u", (unsigned int)meta->uid);
+        pax_record(pax, &pax_len, sizeof(pax), "uid", value);
+        tar_octal(header.uid, sizeof(header.uid), 0);
+    }
+    if (tar_octal(header.gid, sizeof(header.gid), meta->gid) != 0) {
+        snprintf(value, sizeof(value), "%u", (unsigned int)meta->gid);
+        pax_record(pax, &pax_len, sizeof(pax), "gid", value);
+        tar_octal(header.gid, sizeof(header.gid), 0);
+    }
+    if (meta->mtime < 0 || tar_octal(header.mtime, sizeof(header.mtime), meta->mtime) != 0) {
+        snprintf(value, sizeof(value), "%lld", (long long)meta->mtime);
+        pax_record(pax, &pax_len, sizeof(pax), "mtime", value);
+        tar_octal(header.mtime, sizeof(header.mtime), 0);
+    }
+    tar_octal(header.mode, sizeof(header.mode), meta->mode & 07777);
+    header.typeflag = type;
+    memcpy(header.magic, "ustar", 6);
+    memcpy(header.version, "00", 2);
+
+    if (pax_len > 0) {
+        TarHeader extended;
+        memset(&extended, 0, sizeof(extended));
+        snprintf(extended.name, sizeof(extended.name), "PaxHeaders/%.80s", path);
+        tar_octal(extended.mode, sizeof(extended.mode), 0644);
+        tar_octal(extended.uid, sizeof(extended.uid), 0);
+        tar_octal(extended.gid, sizeof(extended.gid), 0);
+        tar_octal(extended.size, sizeof(extended.size), pax_len);
+        tar_octal(extended.mtime, sizeof(extended.mtime), 0);
+        extended.typeflag = 'x';
+        memcpy(extended.magic, "ustar", 6);
+        memcpy(extended.version, "00", 2);
+        snprintf(extended.chksum, sizeof(extended.chksum), "%06o", tar_sum(&extended));
+        extended.chksum[7] = ' ';
+        fwrite(&extended, 1, sizeof(extended), out);
+        fwrite(pax, 1, pax_len, out);
+        tar_pad(out, pax_len);
+    }
+
+    snprintf(header.chksum, sizeof(header.chksum), "%06o", tar_sum(&header));
+    header.chksum[7] = ' ';
+    fwrite(&header, 1, sizeof(header), out);
+}
+
+// Élément lu en avance par un thread de l'export
+typedef struct {
+    int index;                // Élément chargé dans cet emplacement (-1 si libre)
+    unsigned char *data;      // Contenu (NULL : copié ensuite par le thread d'écriture)
+    ssize_t size;             // Taille du contenu, -1 si illisible
+} ExportSlot;
+
+// Export d'une sauvegarde : les threads lisent les fichiers en avance, le thread principal écrit dans l'ordre
+typedef struct {
+    log_element **entries;
+    int count;
+    char backup_dir[PATH_MAX];
+    char snapshot[PATH_MAX];
+    ExportSlot slots[TAR_EXPORT_WINDOW];
+    int next;                 // Prochain élément à lire
+    int written;              // Éléments déjà écrits
+    int stopped;
+    pthread_mutex_t lock;
+    pthread_cond_t loaded, advanced;
+} TarExport;
+
+// Fonction pour lire entièrement un petit fichier stocké (déchiffré s'il est chiffré)
+// Retourne -1 s'il doit être copié par blocs
+static ssize_t read_small_file(const char *path, unsigned char **data) {
+    *data = NULL;
+    int fd = open(path, O_RDONLY | O_NOFOLLOW);
+    SealReader reader;
+    if (fd < 0 || seal_reader_attach(&reader, fd, 0, -1) != 0) {
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    if (reader.size > TAR_PREFETCH_MAX) {
+        // Le noyau lit le début du fichier pendant l'écriture des éléments précédents
+        seal_reader_close(&reader);
+        posix_fadvise(fd, 0, TAR_PREFETCH_MAX, POSIX_FADV_WILLNEED);
+        close(fd);
+        return -1;
+    }
+
+    off_t size = reader.size;
+    *data = malloc(size ? size : 1);
+    ssize_t done = *data ? seal_reader_read(&reader, *data, size, 0) : -1;
+    seal_reader_close(&reader);
+    close(fd);
+    if (!*data || done < size) {
+        free(*data);
+        *data = NULL;
+        return -1;
+    }
+    throttle_consume(THROTTLE_READ, done);
+    return done;
+}
+
+// Thread de l'export : lit les éléments dans l'ordre, au plus TAR_EXPORT_WINDOW en avance sur l'écriture
+static void *export_worker(void *arg) {
+    TarExport *export = arg;
+    for (;;) {
+        pthread_mutex_lock(&export->lock);
+        while (!export->stopped && export->next < export->count &&
+               export->next >= export->written + TAR_EXPORT_WINDOW) {
+            pthread_cond_wait(&export->advanced, &export->lock);
+        }
+        if (export->stopped || export->next >= export->count) {
+            pthread_mutex_unlock(&export->lock);
+            return NULL;
+        }
+        int index = export->next++;
+        pthread_mutex_unlock(&export->lock);
+
+        ExportSlot slot = { index, NULL, 0 };
+        const log_element *elt = export->entries[index];
+        if (!elt->link_target && !elt->hardlink) {
+            StoredData data;
+            stored_data_locate(export->backup_dir, export->snapshot, elt, &data);
+            if (data.length >= 0) {
+                slot.data = malloc(data.length ? data.length : 1);
+                slot.size = slot.data ? pack_read_entry(&data, slot.data, data.length) : -1;
+            } else {
+                slot.size = read_small_file(data.path, &slot.data);
+                if (!slot.data) slot.size = 0;
+            }
+        }
+
+        pthread_mutex_lock(&export->lock);
+        export->slots[index % TAR_EXPORT_WINDOW] = slot;
+        pthread_cond_broadcast(&export->loaded);
+        pthread_mutex_unlock(&export->lock);
+    }
+}
+
+// Répertoire d'une sauvegarde par manifeste (ligne de .backup_dirs)
+typedef struct {
+    char *path;
+    log_element meta;
+    int emitted;
+} ExportDir;
+
+static int compare_export_dirs(const void *a, const void *b) {
+    return strcmp(((const ExportDir *)a)->path, ((const ExportDir *)b)->path);
+}
+
+// Fonction pour ajouter un répertoire à la liste de l'export
+static ExportDir *add_export_dir(ExportDir **dirs, int *count, int *capacity, const char *path) {
+    if (*count == *capacity) {
+        int grown_capacity = *capacity ? *capacity * 2 : 256;
+        ExportDir *grown = realloc(*dirs, grown_capacity * sizeof(ExportDir));
+        if (!grown) return NULL;
+        *dirs = grown;
+        *capacity = grown_capacity;
+    }
+    ExportDir *dir = &(*dirs)[(*count)++];
+    memset(dir, 0, sizeof(*dir));
+    dir->path = strdup(path);
+    return dir;
+}
+
+// Fonction pour relever les répertoires stockés d'une sauvegarde complète (y compris les répertoires vides)
+static void scan_export_dirs(const char *backup_id, const char *relative, ExportDir **dirs, int *count,
+                             int *capacity) {
+    char dir_path[PATH_MAX];
+    snprintf(dir_path, sizeof(dir_path), "%s/%s", backup_id, relative);
+    DIR *dp = opendir(dir_path);
+    if (!dp) {
+        return;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dp)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0 ||
+            (!relative[0] && strcmp(entry->d_name, PACK_DIR) == 0)) {
+            continue;
+        }
+        char child[PATH_MAX], child_path[PATH_MAX];
+        if (snprintf(child, sizeof(child), "%s%s%s", relative, relative[0] ? "/" : "", entry->d_name) >= (int)sizeof(child) ||
+            snprintf(child_path, sizeof(child_path), "%s/%s", backup_id, child) >= (int)sizeof(child_path)) {
+            continue;
+        }
+        struct stat st;
+        if (lstat(child_path, &st) != 0 || !S_ISDIR(st.st_mode)) continue;
+        ExportDir *dir = add_export_dir(dirs, count, capacity, child);
+        if (dir) {
+            dir->meta.mode = st.st_mode;
+            dir->meta.uid = st.st_uid;
+            dir->meta.gid = st.st_gid;
+            dir->meta.mtime = st.st_mtime;
+            dir->meta.mtime_nsec = st.st_mtim.tv_nsec;
+        }
+        scan_export_dirs(backup_id, child, dirs, count, capacity);
+    }
+    closedir(dp);
+}
+
+// Fonction pour charger les répertoires d'une sauvegarde, triés par chemin
+// Leurs métadonnées viennent de .backup_dirs pour une sauvegarde par manifeste, des répertoires stockés sinon
+static ExportDir *load_export_dirs(const char *backup_id, int *count) {
+    ExportDir *dirs = NULL;
+    int capacity = 0;
+    *count = 0;
+    char dirs_path[PATH_MAX];
+    snprintf(dirs_path, sizeof(dirs_path), "%s/%s", backup_id, BACKUP_DIRS);
+    FILE *file = fopen(dirs_path, "r");
+    if (!file) {
+        scan_export_dirs(backup_id, "", &dirs, count, &capacity);
+    } else {
+        char line[BACKUP_LOG_LINE_MAX];
+        while (fgets(line, sizeof(line), file)) {
+            line[strcspn(line, "\n")] = '\0';
+            char *cursor = line;
+            char *path = strsep(&cursor, ";");
+            ExportDir *dir = cursor ? add_export_dir(&dirs, count, &capacity, path) : NULL;
+            if (dir) parse_metadata_fields(&cursor, &dir->meta);
+        }
+        fclose(file);
+    }
+    if (dirs) qsort(dirs, *count, sizeof(ExportDir), compare_export_dirs);
+    return dirs;
+}
+
+// Fonction pour écrire l'en-tête d'un répertoire
+static void export_directory(FILE *out, const char *path, ExportDir *dirs, int dir_count) {
+    log_element meta;
+    memset(&meta, 0, sizeof(meta));
+    meta.mode = S_IFDIR | 0755;
+    ExportDir key = { (char *)path, meta, 0 };
+    ExportDir *found = dirs ? bsearch(&key, dirs, dir_count, sizeof(ExportDir), compare_export_dirs) : NULL;
+    if (found && found->emitted) {
+        return; // Parent d'un lien dur reporté, déjà écrit
+    }
+    if (found) {
+        found->emitted = 1;
+        if (found->meta.mode != 0) meta = found->meta;
+    }
+
+    char name[PATH_MAX];
+    snprintf(name, sizeof(name), "%s/", path);
+    tar_write_header(out, name, '5', &meta, 0, NULL);
+}
+
+// Fonction pour écrire les répertoires parents de path pas encore écrits
+// Le log est trié par chemin : le contenu d'un répertoire y est contigu, open_dir suffit à s'en souvenir
+static void export_parents(FILE *out, const char *path, char *open_dir, ExportDir *dirs, int dir_count) {
+    char parent[PATH_MAX];
+    snprintf(parent, sizeof(parent), "%s", path);
+    char *slash = strrchr(parent, '/');
+    if (!slash) {
+        open_dir[0] = '\0';
+        return;
+    }
+    *slash = '\0';
+
+    for (char *end = strchr(parent, '/'); ; end = strchr(end + 1, '/')) {
+        size_t len = end ? (size_t)(end - parent) : strlen(parent);
+        int emitted = strncmp(open_dir, parent, len) == 0 && (open_dir[len] == '\0' || open_dir[len] == '/');
+        if (!emitted) {
+            char dir[PATH_MAX];
+            snprintf(dir, sizeof(dir), "%.*s", (int)len, parent);
+            export_directory(out, dir, dirs, dir_count);
+        }
+        if (!end) break;
+    }
+    snprintf(open_dir, PATH_MAX, "%s", parent);
+}
+
+// Fonction pour écrire les données d'un fichier trop grand pour être lu en avance
+static int export_stream_file(FILE *out, const char *path, const log_element *elt) {
+    int fd = open(path, O_RDONLY | O_NOFOLLOW);
+    SealReader reader;
+    if (fd < 0 || seal_reader_attach(&reader, fd, 0, -1) != 0) {
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    off_t size = reader.size;
+    tar_write_header(out, elt->path, '0', elt, size, NULL);
+
+    // Lectures en clair (une copie chiffrée est déchiffrée segment par segment)
+    const unsigned char *data;
+    off_t done = 0;
+    while (done < size) {
+        ssize_t bytes = seal_reader_pread(&reader, done, TAR_PREFETCH_MAX, &data);
+        if (bytes <= 0) break;
+        throttle_consume(THROTTLE_READ, bytes);
+        fwrite(data, 1, bytes, out);
+        done += bytes;
+    }
+    seal_reader_close(&reader);
+    close(fd);
+    // Fichier raccourci (ou illisible) pendant l'export : la taille annoncée est complétée par des zéros
+    for (; done < size; done += TAR_BLOCK_SIZE) {
+        fwrite(zero_block, 1, size - done < TAR_BLOCK_SIZE ? size - done : TAR_BLOCK_SIZE, out);
+    }
+    tar_pad(out, size);
+    return 0;
+}
+
+// Fonction pour écrire sur la sortie standard la sauvegarde backup_id au format tar
+// Les messages vont sur la sortie d'erreur : la sortie standard ne contient que l'archive
+int export_tar(const char *backup_id, int threads) {
+    // Les copies d'un répertoire chiffré ne peuvent être relues qu'avec sa clé
+    char repository[PATH_MAX];
+    snprintf(repository, sizeof(repository), "%s", backup_id);
+    if (seal_check_repository(dirname(repository), 0) != 0) {
+        return -1;
+    }
+
+    char log_path[PATH_MAX];
+    snprintf(log_path, sizeof(log_path), "%s/.backup_log", backup_id);
+    log_t logs = read_backup_log(log_path);
+    int sorted_count;
+    log_element **sorted = sort_backup_log(&logs, &sorted_count);
+    if (!sorted) {
+        free_backup_log(&logs);
+        return -1;
+    }
+
+    TarExport export;
+    memset(&export, 0, sizeof(export));
+    char parent[PATH_MAX], name[PATH_MAX];
+    snprintf(parent, sizeof(parent), "%s", backup_id);
+    snprintf(name, sizeof(name), "%s", backup_id);
+    snprintf(export.backup_dir, sizeof(export.backup_dir), "%s", dirname(parent));
+    snprintf(export.snapshot, sizeof(export.snapshot), "%s", basename(name));
+
+    // Un lien dur suit son premier chemin dans l'archive : s'il le précède dans l'ordre du log,
+    // il est reporté après tous les autres éléments
+    export.entries = malloc((sorted_count + 1) * sizeof(log_element *));
+    for (int pass = 0; export.entries && pass < 2; pass++) {
+        for (int i = 0; i < sorted_count; i++) {
+            int deferred = sorted[i]->hardlink && strcmp(sorted[i]->hardlink, sorted[i]->path) > 0;
+            if (deferred == pass) {
+                export.entries[export.count++] = sorted[i];
+            }
+        }
+    }
+    free(sorted);
+    for (int i = 0; i < TAR_EXPORT_WINDOW; i++) {
+        export.slots[i].index = -1;
+    }
+    pthread_mutex_init(&export.lock, NULL);
+    pthread_cond_init(&export.loaded, NULL);
+    pthread_cond_init(&export.advanced, NULL);
+
+    if (threads <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (int)cpus : 1;
+    }
+    if (threads > TAR_EXPORT_WINDOW) threads = TAR_EXPORT_WINDOW;
+    pthread_t workers[TAR_EXPORT_WINDOW];
+    int launched = 0;
+    for (int i = 0; i < threads; i++) {
+        if (pthread_create(&workers[launched], NULL, export_worker, &export) == 0) {
+            launched++;
+        }
+    }
+
+    int dir_count;
+    ExportDir *dirs = load_export_dirs(backup_id, &dir_count);
+    char open_dir[PATH_MAX] = "";
+    FILE *out = stdout;
+    setvbuf(out, NULL, _IOFBF, TAR_PREFETCH_MAX);
+    int problems = launched == 0 ? -1 : 0;
+
+    for (int i = 0; i < export.count && launched > 0; i++) {
+        ExportSlot *slot = &export.slots[i % TAR_EXPORT_WINDOW];
+        pthread_mutex_lock(&export.lock);
+        while (slot->index != i) {
+            pthread_cond_wait(&export.loaded, &export.lock);
+        }
+        pthread_mutex_unlock(&export.lock);
+
+        log_element *elt = export.entries[i];
+        log_element meta = *elt;
+        if (meta.mode == 0) {
+            meta.mode = elt->link_target ? S_IFLNK | 0777 : S_IFREG | 0644; // Ancien log sans métadonnées
+        }
+        export_parents(out, elt->path, open_dir, dirs, dir_count);
+        if (elt->link_target) {
+            tar_write_header(out, elt->path, '2', &meta, 0, elt->link_target);
+        } else if (elt->hardlink) {
+            tar_write_header(out, elt->path, '1', &meta, 0, elt->hardlink);
+        } else if (slot->data && slot->size >= 0) {
+            tar_write_header(out, elt->path, '0', &meta, slot->size, NULL);
+            fwrite(slot->data, 1, slot->size, out);
+            tar_pad(out, slot->size);
+        } else {
+            StoredData data;
+            stored_data_locate(export.backup_dir, export.snapshot, elt, &data);
+            if (slot->size < 0 || data.length >= 0 || export_stream_file(out, data.path, &meta) != 0) {
+                fprintf(stderr, "Fichier illisible, absent de l'archive : %s\n", elt->path);
+                problems = -1;
+            }
+        }
+
+        pthread_mutex_lock(&export.lock);
+        free(slot->data);
+        slot->data = NULL;
+        slot->index = -1;
+        export.written++;
+        pthread_cond_broadcast(&export.advanced);
+        pthread_mutex_unlock(&export.lock);
+    }
+
+    pthread_mutex_lock(&export.lock);
+    export.stopped = 1;
+    pthread_cond_broadcast(&export.advanced);
+    pthread_mutex_unlock(&export.lock);
+    for (int i = 0; i < launched; i++) {
+        pthread_join(workers[i], NULL);
+    }
+
+    // Répertoires vides
+    for (int i = 0; i < dir_count; i++) {
+        if (!dirs[i].emitted) {
+            export_directory(out, dirs[i].path, dirs, dir_count);
+        }
+    }
+    for (int i = 0; i < dir_count; i++) {
+        free(dirs[i].path);
+        free_file_metadata(&dirs[i].meta);
+    }
+    free(dirs);
+
+    // Fin de l'archive : deux blocs nuls
+    fwrite(zero_block, 1, TAR_BLOCK_SIZE, out);
+    fwrite(zero_block, 1, TAR_BLOCK_SIZE, out);
+    if (fflush(out) != 0) {
+        perror("Erreur lors de l'écriture de l'archive");
+        problems = -1;
+    }
+
+    pthread_mutex_destroy(&export.lock);
+    pthread_cond_destroy(&export.loaded);
+    pthread_cond_destroy(&export.advanced);
+    free(export.entries);
+    free_backup_log(&logs);
+    return problems;
+}
+
+// Fichier déjà importé (cible possible d'un lien dur de l'archive)
+typedef struct {
+    char *path;
+    unsigned char md5[MD5_DIGEST_LENGTH];
+    off_t size;
+    char *stored;             // Sauvegarde stockant les données (NULL : dans la nouvelle sauvegarde)
+    log_element meta;
+} ImportedFile;
+
+// Import d'une archive dans une nouvelle sauvegarde
+typedef struct {
+    const char *backup_dir;
+    char snapshot_path[PATH_MAX];
+    char previous[256];       // Sauvegarde la plus récente, base de la déduplication ("" si aucune)
+    log_t previous_log;
+    log_element **previous_entries;
+    int previous_count;
+    FILE *log;
+    FILE *dirs;
+    ImportedFile *files;
+    int file_count, file_capacity;
+    unsigned char *buffer, *compare;
+    int written, reused, links, directories;
+} TarImport;
+
+// Fonction pour lire exactement size octets de l'archive ; retourne 0 en cas de succès
+static int read_exact(FILE *in, void *buffer, size_t size) {
+    if (fread(buffer, 1, size, in) != size) {
+        return -1;
+    }
+    throttle_consume(THROTTLE_READ, size);
+    return 0;
+}
+
+// Fonction pour sauter size octets de données et leur bourrage
+static int skip_data(FILE *in, unsigned char *buffer, off_t size) {
+    off_t total = size + (TAR_BLOCK_SIZE - size % TAR_BLOCK_SIZE) % TAR_BLOCK_SIZE;
+    while (total > 0) {
+        size_t len = total < TAR_IMPORT_BUFFER_SIZE ? (size_t)total : TAR_IMPORT_BUFFER_SIZE;
+        if (read_exact(in, buffer, len) != 0) return -1;
+        total -= len;
+    }
+    return 0;
+}
+
+// Fonction pour lire les données d'un en-tête pax ou GNU (nom long) ; retourne une chaîne allouée
+static char *read_extension(FILE *in, off_t size) {
+    if (size < 0 || size > 16 * PATH_MAX) {
+        return NULL;
+    }
+    off_t padded = size + (TAR_BLOCK_SIZE - size % TAR_BLOCK_SIZE) % TAR_BLOCK_SIZE;
+    char *data = malloc(padded + 1);
+    if (!data || read_exact(in, data, padded) != 0) {
+        free(data);
+        return NULL;
+    }
+    data[size] = '\0';
+    return data;
+}
+
+// Attributs d'un en-tête pax, appliqués à l'élément suivant
+typedef struct {
+    char *path;
+    char *linkpath;
+    long long size, uid, gid;
+    long long mtime;
+    long mtime_nsec;
+    int has_size, has_uid, has_gid, has_mtime;
+} PaxAttributes;
+
+static void pax_clear(PaxAttributes *pax) {
+    free(pax->path);
+    free(pax->linkpath);
+    memset(pax, 0, sizeof(*pax));
+}
+
+// Fonction pour lire les enregistrements "longueur clé=valeur\n" d'un en-tête pax
+static void pax_parse(char *data, size_t size, PaxAttributes *pax) {
+    for (size_t offset = 0; offset < size; ) {
+        char *record = data + offset;
+        size_t len = strtoul(record, NULL, 10);
+        char *key = strchr(record, ' ');
+        if (len == 0 || offset + len > size || !key) break;
+        record[len - 1] = '\0';
+        char *value = strchr(++key, '=');
+        if (value) {
+            *value++ = '\0';
+            if (strcmp(key, "path") == 0) {
+                free(pax->path);
+                pax->path = strdup(value);
+            } else if (strcmp(key, "linkpath") == 0) {
+                free(pax->linkpath);
+                pax->linkpath = strdup(value);
+            } else if (strcmp(key, "size") == 0) {
+                pax->size = strtoll(value, NULL, 10);
+                pax->has_size = 1;
+            } else if (strcmp(key, "uid") == 0) {
+                pax->uid = strtoll(value, NULL, 10);
+                pax->has_uid = 1;
+            } else if (strcmp(key, "gid") == 0) {
+                pax->gid = strtoll(value, NULL, 10);
+                pax->has_gid = 1;
+            } else if (strcmp(key, "mtime") == 0) {
+                char *dot;
+                pax->mtime = strtoll(value, &dot, 10);
+                pax->has_mtime = 1;
+                if (*dot == '.') {
+                    // Partie fractionnaire ramenée à 9 chiffres
+                    char digits[10] = "000000000";
+                    size_t n = strspn(dot + 1, "0123456789");
+                    memcpy(digits, dot + 1, n < 9 ? n : 9);
+                    pax->mtime_nsec = strtol(digits, NULL, 10);
+                }
+            }
+        }
+        offset += len;
+    }
+}
+
+// Fonction pour ramener le nom d'un élément à un chemin relatif sûr
+// Retourne 1 pour la racine de l'archive, -1 pour un nom refusé (composant "..", caractère réservé du log)
+static int normalize_member_name(char *name) {
+    while (strncmp(name, "./", 2) == 0 || name[0] == '/') {
+        size_t skip = name[0] == '/' ? 1 : 2;
+        memmove(name, name + skip, strlen(name + skip) + 1);
+    }
+    size_t len = strlen(name);
+    while (len > 0 && name[len - 1] == '/') {
+        name[--len] = '\0';
+    }
+    if (len == 0 || strcmp(name, ".") == 0) {
+        return 1;
+    }
+    if (strpbrk(name, ";\n")) {
+        return -1;
+    }
+    for (const char *part = name; part; part = strchr(part, '/') ? strchr(part, '/') + 1 : NULL) {
+        size_t part_len = strcspn(part, "/");
+        if (part_len == 0 || (part_len == 1 && part[0] == '.') || (part_len == 2 && strncmp(part, "..", 2) == 0)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int compare_previous(const void *key, const void *elt) {
+    return strcmp((const char *)key, (*(log_element *const *)elt)->path);
+}
+
+// Fonction pour retrouver les données d'un fichier de même chemin et de même taille dans la sauvegarde précédente
+static const log_element *import_previous(const TarImport *import, const char *path, off_t size) {
+    if (!import->previous_entries) {
+        return NULL;
+    }
+    log_element **found = bsearch(path, import->previous_entries, import->previous_count, sizeof(log_element *),
+                                  compare_previous);
+    if (!found || (*found)->link_target || (*found)->hardlink || (*found)->size != size) {
+        return NULL;
+    }
+    return *found;
+}
+
+// Fonction pour construire le chemin d'un élément dans la nouvelle sauvegarde
+// Retourne -1 si le chemin dépasse PATH_MAX (l'élément n'est pas importé)
+static int import_path(const TarImport *import, const char *path, char *out, size_t size) {
+    int len = snprintf(out, size, "%s/%s", import->snapshot_path, path);
+    if (len < 0 || (size_t)len >= size) {
+        fprintf(stderr, "Chemin trop long, élément ignoré : %s\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+// Fonction pour écrire la ligne du log d'un élément importé
+static void import_log_line(TarImport *import, const char *path, log_element *elt) {
+    char full_path[PATH_MAX], date[64];
+    if (import_path(import, path, full_path, sizeof(full_path)) != 0) {
+        return;
+    }
+    struct tm *mod_time = localtime(&elt->mtime);
+    if (!mod_time || strftime(date, sizeof(date), "%Y-%m-%d-%H:%M:%S", mod_time) == 0) {
+        snprintf(date, sizeof(date), "%lld", (long long)elt->mtime);
+    }
+    elt->path = full_path;
+    elt->date = date;
+    write_log_element(elt, import->log, import->backup_dir);
+    elt->path = NULL;
+    elt->date = NULL;
+}
+
+// Fonction pour ouvrir le fichier path de la nouvelle sauvegarde (ses répertoires parents sont créés)
+static int import_create(TarImport *import, const char *path) {
+    char dest[PATH_MAX], parent[PATH_MAX];
+    if (import_path(import, path, dest, sizeof(dest)) != 0) {
+        return -1;
+    }
+    snprintf(parent, sizeof(parent), "%s", dest);
+    make_parent_dirs(dirname(parent));
+    unlink(dest);
+    int fd = open(dest, O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW, 0600);
+    if (fd < 0) {
+        perror("Erreur lors de la création du fichier importé");
+    }
+    return fd;
+}
+
+// Fonction pour écrire entièrement size octets à la position offset
+static int pwrite_all(int fd, const unsigned char *data, size_t size, off_t offset) {
+    while (size > 0) {
+        ssize_t written = pwrite(fd, data, size, offset);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        throttle_consume(THROTTLE_WRITE, written);
+        data += written;
+        size -= written;
+        offset += written;
+    }
+    return 0;
+}
+
+// Fonction pour appliquer au fichier importé les métadonnées de son en-tête
+static void import_metadata(int fd, const log_element *meta) {
+    if (fchown(fd, meta->uid, meta->gid) == -1 && errno != EPERM) {
+        perror("Erreur lors du changement de propriétaire");
+    }
+    fchmod(fd, meta->mode & 07777);
+    struct timespec times[2];
+    times[0].tv_sec = times[1].tv_sec = meta->mtime;
+    times[0].tv_nsec = times[1].tv_nsec = meta->mtime_nsec;
+    futimens(fd, times);
+}
+
+// Fonction pour mémoriser un fichier importé (cible possible d'un lien dur)
+static void import_remember(TarImport *import, const char *path, const log_element *elt) {
+    if (import->file_count == import->file_capacity) {
+        int capacity = import->file_capacity ? import->file_capacity * 2 : 1024;
+        ImportedFile *grown = realloc(import->files, capacity * sizeof(ImportedFile));
+        if (!grown) return;
+        import->files = grown;
+        import->file_capacity = capacity;
+    }
+    ImportedFile *file = &import->files[import->file_count++];
+    file->path = strdup(path);
+    memcpy(file->md5, elt->md5, MD5_DIGEST_LENGTH);
+    file->size = elt->size;
+    file->stored = elt->stored ? strdup(elt->stored) : NULL;
+    file->meta = *elt;
+    file->meta.link_target = file->meta.hardlink = file->meta.xattrs = file->meta.stored = NULL;
+}
+
+// Fonction pour créer le fichier importé path ; avec --encrypt-key, ses données passent par writer
+static int import_open_output(TarImport *import, const char *path, SealWriter *writer) {
+    int fd = import_create(import, path);
+    if (fd >= 0 && seal_enabled() && seal_writer_open(writer, fd, 0) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Fonction pour écrire les size octets suivants du fichier importé (à la position offset)
+static int import_write(int fd, SealWriter *writer, const unsigned char *data, size_t size, off_t offset) {
+    return seal_enabled() ? seal_writer_write(writer, data, size) : pwrite_all(fd, data, size, offset);
+}
+
+// Fonction pour reprendre dans le fichier importé les size premiers octets de la copie précédente
+static int import_copy_prefix(TarImport *import, int dest_fd, SealWriter *writer, const unsigned char *previous_packed,
+                              SealReader *previous, off_t size) {
+    if (previous_packed) {
+        return import_write(dest_fd, writer, previous_packed, size, 0);
+    }
+    if (!seal_enabled()) {
+        return copy_sparse_range(previous->raw.fd, dest_fd, 0, size);
+    }
+    // Copie chiffrée : le début commun est relu en clair puis rechiffré à la suite
+    for (off_t done = 0; done < size; ) {
+        size_t len = size - done < TAR_IMPORT_BUFFER_SIZE ? (size_t)(size - done) : TAR_IMPORT_BUFFER_SIZE;
+        if (seal_reader_read(previous, import->compare, len, done) != (ssize_t)len ||
+            seal_writer_write(writer, import->compare, len) != 0) {
+            return -1;
+        }
+        done += len;
+    }
+    return 0;
+}
+
+// Fonction pour importer un fichier régulier de size octets
+// Tant que ses données sont identiques au fichier de même chemin de la sauvegarde précédente, rien n'est
+// écrit ; à la première différence, le début commun est recopié depuis la sauvegarde précédente
+// La copie précédente est comparée en clair, qu'elle soit chiffrée ou non
+static int import_file(TarImport *import, FILE *in, const char *path, log_element *meta, off_t size) {
+    const log_element *previous = import_previous(import, path, size);
+    StoredData previous_data;
+    int previous_fd = -1;
+    SealReader previous_reader;
+    unsigned char *previous_packed = NULL;
+    int same = 0;
+    if (previous) {
+        stored_data_locate(import->backup_dir, import->previous, previous, &previous_data);
+        if (previous_data.length >= 0) {
+            previous_packed = malloc(PACK_FILE_MAX);
+            same = previous_packed && pack_read_entry(&previous_data, previous_packed, PACK_FILE_MAX) == size;
+        } else {
+            previous_fd = open(previous_data.path, O_RDONLY | O_NOFOLLOW);
+            if (previous_fd >= 0 && seal_reader_attach(&previous_reader, previous_fd, 0, -1) != 0) {
+                close(previous_fd);
+                previous_fd = -1;
+            }
+            same = previous_fd >= 0 && previous_reader.size == size;
+            if (same) posix_fadvise(previous_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        }
+    }
+
+    EVP_MD_CTX *md5_ctx = EVP_MD_CTX_new();
+    SealWriter writer;
+    int dest_fd = -1;
+    int result = md5_ctx && EVP_DigestInit_ex(md5_ctx, EVP_md5(), NULL) == 1 ? 0 : -1;
+    for (off_t done = 0; done < size && result == 0; ) {
+        size_t len = size - done < TAR_IMPORT_BUFFER_SIZE ? (size_t)(size - done) : TAR_IMPORT_BUFFER_SIZE;
+        if (read_exact(in, import->buffer, len) != 0) {
+            fprintf(stderr, "Archive tronquée : %s\n", path);
+            result = -1;
+            break;
+        }
+        EVP_DigestUpdate(md5_ctx, import->buffer, len);
+
+        if (same) {
+            if (previous_packed) {
+                same = memcmp(previous_packed + done, import->buffer, len) == 0;
+            } else {
+                same = seal_reader_read(&previous_reader, import->compare, len, done) == (ssize_t)len &&
+                       memcmp(import->compare, import->buffer, len) == 0;
+            }
+            if (!same && done > 0) {
+                // Première différence : le début commun est repris de la copie précédente
+                dest_fd = import_open_output(import, path, &writer);
+                if (dest_fd < 0 ||
+                    import_copy_prefix(import, dest_fd, &writer, previous_packed, &previous_reader, done) != 0) {
+                    result = -1;
+                    break;
+                }
+            }
+        }
+        if (!same) {
+            if (dest_fd < 0 && (dest_fd = import_open_output(import, path, &writer)) < 0) {
+                result = -1;
+                break;
+            }
+            if (import_write(dest_fd, &writer, import->buffer, len, done) != 0) {
+                perror("Erreur lors de l'écriture du fichier importé");
+                result = -1;
+            }
+        }
+        done += len;
+    }
+    if (previous_fd >= 0) {
+        seal_reader_close(&previous_reader);
+        close(previous_fd);
+    }
+    free(previous_packed);
+    if (result == 0 && size % TAR_BLOCK_SIZE) {
+        result = read_exact(in, import->buffer, TAR_BLOCK_SIZE - size % TAR_BLOCK_SIZE);
+    }
+
+    log_element elt = *meta;
+    if (result == 0 && EVP_DigestFinal_ex(md5_ctx, elt.md5, NULL) != 1) {
+        result = -1;
+    }
+    EVP_MD_CTX_free(md5_ctx);
+    elt.size = size;
+    if (result == 0 && previous && same) {
+        // Identique : la ligne désigne la sauvegarde qui stocke déjà les données
+        elt.stored = strdup(previous->stored ? previous->stored : import->previous);
+        import->reused++;
+    } else if (result == 0) {
+        if (dest_fd < 0) dest_fd = import_open_output(import, path, &writer);
+        // Fixe la taille finale ; une copie chiffrée reçoit son dernier segment et son en-tête
+        if (dest_fd < 0 || (seal_enabled() ? seal_writer_finish(&writer) : ftruncate(dest_fd, size)) != 0) {
+            result = -1;
+        } else {
+            import_metadata(dest_fd, meta);
+            import->written++;
+        }
+    } else if (dest_fd >= 0 && seal_enabled()) {
+        seal_writer_finish(&writer); // Libère le chiffrement d'une copie abandonnée
+    }
+    if (dest_fd >= 0) close(dest_fd);
+    if (result != 0) {
+        free(elt.stored);
+        return -1;
+    }
+
+    import_log_line(import, path, &elt);
+    import_remember(import, path, &elt);
+    free(elt.stored);
+    return 0;
+}
+
+// Fonction pour importer un lien dur de l'archive vers un fichier déjà importé
+// Si la cible n'est pas stockée dans la nouvelle sauvegarde, ses données y sont recopiées
+static void import_hardlink(TarImport *import, const char *path, const char *target) {
+    ImportedFile *file = NULL;
+    for (int i = import->file_count - 1; i >= 0 && !file; i--) {
+        if (strcmp(import->files[i].path, target) == 0) file = &import->files[i];
+    }
+    if (!file) {
+        fprintf(stderr, "Lien dur vers un fichier absent de l'archive : %s -> %s\n", path, target);
+        return;
+    }
+
+    char dest[PATH_MAX], first[PATH_MAX], parent[PATH_MAX];
+    if (import_path(import, path, dest, sizeof(dest)) != 0 || import_path(import, target, first, sizeof(first)) != 0) {
+        return;
+    }
+    snprintf(parent, sizeof(parent), "%s", dest);
+    make_parent_dirs(dirname(parent));
+    if (!file->stored) {
+        if (link(first, dest) != 0) {
+            perror("Erreur lors de la création du lien dur");
+            return;
+        }
+    } else {
+        log_element source = file->meta;
+        source.path = file->path;
+        source.stored = file->stored;
+        StoredData data;
+        stored_data_locate(import->backup_dir, import->previous, &source, &data);
+        int dest_fd = import_create(import, path);
+        if (dest_fd < 0) return;
+        if (data.length >= 0) {
+            // Fichier regroupé : stocké à part, chiffré comme les autres copies avec --encrypt-key
+            ssize_t size = pack_read_entry(&data, import->buffer, PACK_FILE_MAX);
+            if (size > 0 && seal_enabled()) {
+                ssize_t sealed = seal_buffer(import->buffer, size, import->compare);
+                if (sealed > 0) pwrite_all(dest_fd, import->compare, sealed, 0);
+            } else if (size > 0) {
+                pwrite_all(dest_fd, import->buffer, size, 0);
+            }
+        } else {
+            int src_fd = open(data.path, O_RDONLY | O_NOFOLLOW);
+            struct stat src_stat;
+            if (src_fd >= 0) {
+                // Copie telle qu'elle est stockée (chiffrée ou non)
+                if (fstat(src_fd, &src_stat) == 0) copy_sparse(src_fd, dest_fd, src_stat.st_size);
+                close(src_fd);
+            }
+        }
+        import_metadata(dest_fd, &file->meta);
+        close(dest_fd);
+    }
+
+    log_element elt = file->meta;
+    memcpy(elt.md5, file->md5, MD5_DIGEST_LENGTH);
+    elt.size = file->size;
+    elt.hardlink = (char *)target;
+    import_log_line(import, path, &elt);
+    import->links++;
+}
+
+// Fonction pour retrouver la sauvegarde la plus récente de backup_dir et charger son log trié
+static void load_previous_snapshot(TarImport *import) {
+    DIR *dp = opendir(import->backup_dir);
+    if (!dp) {
+        return;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dp)) != NULL) {
+        if (entry->d_name[0] == '.') continue;
+        char log_path[PATH_MAX];
+        snprintf(log_path, sizeof(log_path), "%s/%s/.backup_log", import->backup_dir, entry->d_name);
+        // Les noms de sauvegarde sont des dates : la plus grande est la plus récente
+        if (access(log_path, F_OK) == 0 && strcmp(entry->d_name, import->previous) > 0) {
+            snprintf(import->previous, sizeof(import->previous), "%s", entry->d_name);
+        }
+    }
+    closedir(dp);
+
+    if (import->previous[0]) {
+        char log_path[PATH_MAX];
+        snprintf(log_path, sizeof(log_path), "%s/%s/.backup_log", import->backup_dir, import->previous);
+        import->previous_log = read_backup_log(log_path);
+        import->previous_entries = sort_backup_log(&import->previous_log, &import->previous_count);
+    }
+}
+
+// Fonction pour créer dans backup_dir une sauvegarde à partir d'un flux tar lu sur l'entrée standard
+// La sauvegarde est écrite comme une sauvegarde par manifeste : répertoires dans .backup_dirs, fichiers
+// inchangés désignant la sauvegarde qui les stocke. Comme --backup-stdin, elle ne remplace pas le log de
+// travail et ne sert donc pas de base aux sauvegardes --backup suivantes
+int import_tar(const char *backup_dir) {
+    struct stat backup_stat;
+    if (stat(backup_dir, &backup_stat) == -1 || !S_ISDIR(backup_stat.st_mode)) {
+        fprintf(stderr, "Le répertoire de sauvegarde spécifié est inaccessible : %s\n", backup_dir);
+        return -1;
+    }
+    if (seal_check_repository(backup_dir, 1) != 0) {
+        return -1;
+    }
+
+    TarImport import;
+    memset(&import, 0, sizeof(import));
+    import.backup_dir = backup_dir;
+    load_previous_snapshot(&import);
+
+    char backup_name[64], log_pending[PATH_MAX], log_path[PATH_MAX], dirs_path[PATH_MAX];
+    generate_backup_name(backup_name, sizeof(backup_name));
+    snprintf(import.snapshot_path, sizeof(import.snapshot_path), "%s/%s", backup_dir, backup_name);
+    if (snprintf(log_pending, sizeof(log_pending), "%s/%s", import.snapshot_path, BACKUP_LOG_PENDING) >= (int)sizeof(log_pending) ||
+        snprintf(log_path, sizeof(log_path), "%s/.backup_log", import.snapshot_path) >= (int)sizeof(log_path) ||
+        snprintf(dirs_path, sizeof(dirs_path), "%s/%s", import.snapshot_path, BACKUP_DIRS) >= (int)sizeof(dirs_path)) {
+        fprintf(stderr, "Chemin du répertoire de sauvegarde trop long : %s\n", backup_dir);
+        free(import.previous_entries);
+        free_backup_log(&import.previous_log);
+        return -1;
+    }
+    if (mkdir(import.snapshot_path, 0755) == -1) {
+        perror("Erreur lors de la création du répertoire de sauvegarde");
+        free(import.previous_entries);
+        free_backup_log(&import.previous_log);
+        return -1;
+    }
+    import.log = fopen(log_pending, "w");
+    import.dirs = fopen(dirs_path, "w");
+    import.buffer = malloc(TAR_IMPORT_BUFFER_SIZE);
+    import.compare = malloc(TAR_IMPORT_BUFFER_SIZE);
+
+    FILE *in = stdin;
+    setvbuf(in, NULL, _IOFBF, TAR_IMPORT_BUFFER_SIZE);
+    PaxAttributes pax;
+    memset(&pax, 0, sizeof(pax));
+    char *long_name = NULL, *long_link = NULL;
+    int result = import.log && import.dirs && import.buffer && import.compare ? 0 : -1;
+    if (result != 0) {
+        perror("Erreur lors de la préparation de l'import");
+    }
+
+    TarHeader header;
+    while (result == 0 && read_exact(in, &header, sizeof(header)) == 0) {
+        if (memcmp(&header, zero_block, sizeof(header)) == 0) {
+            break; // Fin de l'archive
+        }
+        if (tar_number(header.chksum, sizeof(header.chksum)) != tar_sum(&header)) {
+            fprintf(stderr, "En-tête tar invalide\n");
+            result = -1;
+            break;
+        }
+        off_t size = pax.has_size ? pax.size : (off_t)tar_number(header.size, sizeof(header.size));
+
+        // En-têtes d'extension : ils décrivent l'élément suivant
+        if (header.typeflag == 'x' || header.typeflag == 'L' || header.typeflag == 'K') {
+            char *data = read_extension(in, size);
+            if (!data) {
+                fprintf(stderr, "En-tête d'extension tar invalide\n");
+                result = -1;
+                break;
+            }
+            if (header.typeflag == 'x') {
+                pax_parse(data, size, &pax);
+                free(data);
+            } else if (header.typeflag == 'L') {
+                free(long_name);
+                long_name = data;
+            } else {
+                free(long_link);
+                long_link = data;
+            }
+            continue;
+        }
+
+        char name[PATH_MAX], link_target[PATH_MAX];
+        if (pax.path || long_name) {
+            snprintf(name, sizeof(name), "%s", pax.path ? pax.path : long_name);
+        } else if (memcmp(header.magic, "ustar", 5) == 0 && header.prefix[0]) {
+            snprintf(name, sizeof(name), "%.*s/%.*s", (int)strnlen(header.prefix, sizeof(header.prefix)), header.prefix,
+                     (int)strnlen(header.name, sizeof(header.name)), header.name);
+        } else {
+            snprintf(name, sizeof(name), "%.*s", (int)strnlen(header.name, sizeof(header.name)), header.name);
+        }
+        if (pax.linkpath || long_link) {
+            snprintf(link_target, sizeof(link_target), "%s", pax.linkpath ? pax.linkpath : long_link);
+        } else {
+            snprintf(link_target, sizeof(link_target), "%.*s", (int)strnlen(header.linkname, sizeof(header.linkname)),
+                     header.linkname);
+        }
+
+        log_element meta;
+        memset(&meta, 0, sizeof(meta));
+        meta.mode = tar_number(header.mode, sizeof(header.mode)) & 07777;
+        meta.uid = pax.has_uid ? (uid_t)pax.uid : (uid_t)tar_number(header.uid, sizeof(header.uid));
+        meta.gid = pax.has_gid ? (gid_t)pax.gid : (gid_t)tar_number(header.gid, sizeof(header.gid));
+        meta.mtime = pax.has_mtime ? pax.mtime : (time_t)tar_number(header.mtime, sizeof(header.mtime));
+        meta.mtime_nsec = pax.has_mtime ? pax.mtime_nsec : 0;
+        pax_clear(&pax);
+        free(long_name);
+        free(long_link);
+        long_name = long_link = NULL;
+
+        int status = normalize_member_name(name);
+        char type = header.typeflag;
+        int has_data = type == '0' || type == '\0' || type == '7';
+        if (status != 0) {
+            if (status < 0) fprintf(stderr, "Nom refusé dans l'archive : %s\n", name);
+            result = skip_data(in, import.buffer, has_data ? size : 0);
+            continue;
+        }
+
+        if (has_data) {
+            meta.mode |= S_IFREG;
+            result = import_file(&import, in, name, &meta, size);
+        } else if (type == '5') {
+            meta.mode |= S_IFDIR;
+            fputs(name, import.dirs);
+            write_metadata_fields(import.dirs, &meta);
+            fputc('\n', import.dirs);
+            import.directories++;
+        } else if (type == '2') {
+            char dest[PATH_MAX], parent[PATH_MAX];
+            if (import_path(&import, name, dest, sizeof(dest)) != 0) {
+                continue;
+            }
+            snprintf(parent, sizeof(parent), "%s", dest);
+            make_parent_dirs(dirname(parent));
+            if (symlink(link_target, dest) != 0) {
+                perror("Erreur lors de la création du lien symbolique");
+            }
+            meta.mode |= S_IFLNK;
+            meta.link_target = link_target;
+            meta.size = strlen(link_target);
+            EVP_Digest(link_target, strlen(link_target), meta.md5, NULL, EVP_md5(), NULL);
+            import_log_line(&import, name, &meta);
+            import.written++;
+        } else if (type == '1') {
+            normalize_member_name(link_target);
+            import_hardlink(&import, name, link_target);
+        } else {
+            // Périphériques, tubes nommés, en-têtes globaux : non sauvegardés
+            if (type == '3' || type == '4' || type == '6') {
+                fprintf(stderr, "Élément spécial ignoré : %s\n", name);
+            }
+            result = skip_data(in, import.buffer, (type == 'g' || type == 'V' || has_data) ? size : 0);
+        }
+    }
+    pax_clear(&pax);
+    free(long_name);
+    free(long_link);
+
+    if (import.log) fclose(import.log);
+    if (import.dirs) fclose(import.dirs);
+    free(import.buffer);
+    free(import.compare);
+    for (int i = 0; i < import.file_count; i++) {
+        free(import.files[i].path);
+        free(import.files[i].stored);
+    }
+    free(import.files);
+    free(import.previous_entries);
+    free_backup_log(&import.previous_log);
+
+    if (result != 0 ||
+        index_backup_log(import.snapshot_path, log_pending) != 0 ||
+        durable_sync_filesystem(import.snapshot_path) != 0 ||
+        durable_publish(log_pending, log_path) != 0) {
+        abandon_snapshot(import.snapshot_path);
+        return -1;
+    }
+    if (catalog_update(backup_dir) != 0) {
+        fprintf(stderr, "Catalogue non mis à jour : il sera complété à la prochaine recherche\n");
+    }
+
+    printf("Import tar : %d élément(s) écrit(s), %d repris de la sauvegarde %s, %d lien(s) dur(s), %d répertoire(s)\n",
+           import.written, import.reused, import.previous[0] ? import.previous : "(aucune)", import.links,
+           import.directories);
+    printf("Sauvegarde terminée : %s\n", import.snapshot_path);
+    return 0;
+}
@@ -0,0 +1,24 @@
+#ifndef TAR_STREAM_H
+#define TAR_STREAM_H
+
+// Taille d'un bloc tar (en-têtes et bourrage des données)
+#define TAR_BLOCK_SIZE 512
+
+// Nombre d'éléments lus en avance par les threads de l'export, écrits ensuite dans l'ordre du log
+#define TAR_EXPORT_WINDOW 32
+
+// Taille maximale d'un fichier lu entièrement en mémoire par un thread de l'export
+// Au-delà, le fichier est annoncé au noyau (POSIX_FADV_WILLNEED) puis copié par le thread d'écriture
+#define TAR_PREFETCH_MAX (1024 * 1024)
+
+// Taille des blocs lus dans un flux tar importé
+#define TAR_IMPORT_BUFFER_SIZE (1024 * 1024)
+
+// Fonction pour écrire sur la sortie standard la sauvegarde backup_id au format tar (ustar, pax si nécessaire)
+// threads est le nombre de threads lisant les fichiers en avance (0 = nombre de cœurs) ; retourne 0 en cas de succès
+int export_tar(const char *backup_id, int threads);
+// Fonction pour créer dans backup_dir une sauvegarde à partir d'un flux tar lu sur l'entrée standard
+// Les fichiers identiques à la dernière sauvegarde ne sont pas réécrits ; retourne 0 en cas de succès
+int import_tar(const char *backup_dir);
+
+#endif // TAR_STREAM_H
@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+# Relais TCP simulant un lien à forte latence (utilisé par tests/latency_check.sh quand tc netem est
+# indisponible) : chaque sens de chaque connexion est retardé de <délai> ms et ne garde au plus que
+# <fenêtre> Ko en transit, comme une connexion TCP limitée par sa fenêtre (débit <= fenêtre / délai)
+# Usage : delay_proxy.py <port d'écoute> <port du serveur> <délai en ms> <fenêtre en Ko>
+
+import socket
+import sys
+import threading
+import time
+from collections import deque
+
+
+def relay(src, dst, delay, window):
+    # Les données lues attendent leur heure de livraison ; la lecture s'arrête quand la fenêtre est pleine
+    queue = deque()
+    state = {"bytes": 0, "closed": False}
+    cond = threading.Condition()
+
+    def reader():
+        while True:
+            with cond:
+                while state["bytes"] >= window:
+                    cond.wait()
+            try:
+                data = src.recv(65536)
+            except OSError:
+                data = b""
+            with cond:
+                if not data:
+                    state["closed"] = True
+                else:
+                    queue.append((time.monotonic() + delay, data))
+                    state["bytes"] += len(data)
+                cond.notify_all()
+            if not data:
+                return
+
+    def writer():
+        while True:
+            with cond:
+                while not queue and not state["closed"]:
+                    cond.wait()
+                if not queue:
+                    break
+                due, data = queue[0]
+            pause = due - time.monotonic()
+            if pause > 0:
+                time.sleep(pause)
+            try:
+                dst.sendall(data)
+            except OSError:
+                break
+            with cond:
+                queue.popleft()
+                state["bytes"] -= len(data)
+                cond.notify_all()
+        try:
+            dst.shutdown(socket.SHUT_WR)
+        except OSError:
+            pass
+
+    threading.Thread(target=reader, daemon=True).start()
+    threading.Thread(target=writer, daemon=True).start()
+
+
+def main():
+    listen_port, server_port = int(sys.argv[1]), int(sys.argv[2])
+    delay, window = int(sys.argv[3]) / 1000.0, int(sys.argv[4]) * 1024
+
+    listener = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    listener.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    listener.bind(("127.0.0.1", listen_port))
+    listener.listen(64)
+    print("Relais en écoute sur le port %d" % listen_port, flush=True)
+    while True:
+        client, _ = listener.accept()
+        server = socket.create_connection(("127.0.0.1", server_port))
+        relay(client, server, delay, window)
+        relay(server, client, delay, window)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,75 @@
+#!/bin/sh
+# Mesure des restaurations depuis le serveur sur un lien à forte latence (make check-latency) : restaure
+# la même sauvegarde avec 1, 4 et 8 flux, affiche les durées et vérifie chaque restauration
+# La latence est ajoutée par tc netem sur lo si possible (root), par tests/delay_proxy.py sinon
+# Usage : tests/latency_check.sh <exécutable backup> <exécutable serveur> [délai en ms] [fenêtre en Ko]
+
+BACKUP=$(realpath "${1:-./backup}")
+SERVER=$(realpath "${2:-./serveur}")
+DELAY=${3:-25}
+WINDOW=${4:-256}
+PROXY=$(dirname "$(realpath "$0")")/delay_proxy.py
+WORK=$(mktemp -d)
+PORT=8080
+NETEM=0
+status=0
+
+cleanup() {
+    [ "$NETEM" -eq 1 ] && tc qdisc del dev lo root 2>/dev/null
+    [ -n "$PROXY_PID" ] && kill "$PROXY_PID" 2>/dev/null && wait "$PROXY_PID" 2>/dev/null
+    [ -n "$SERVER_PID" ] && kill "$SERVER_PID" 2>/dev/null && wait "$SERVER_PID" 2>/dev/null
+    rm -rf "$WORK"
+}
+trap cleanup EXIT
+
+# Fonction pour attendre qu'un journal contienne le message de mise en écoute (au plus 10 secondes)
+wait_listening() {
+    for i in 1 2 3 4 5 6 7 8 9 10; do
+        grep -q "en écoute" "$1" && return 0
+        sleep 1
+    done
+    echo "ÉCHEC : $1 inactif"
+    cat "$1"
+    return 1
+}
+
+# Source : un gros fichier réparti en morceaux et de nombreux petits fichiers
+mkdir -p "$WORK/src/petits" "$WORK/backups"
+head -c 48000000 /dev/urandom > "$WORK/src/gros.bin"
+for i in $(seq 1 300); do
+    head -c 8000 /dev/urandom > "$WORK/src/petits/f$i"
+done
+"$BACKUP" --backup "$WORK/src" "$WORK/backups" > /dev/null || exit 1
+LATEST=$(ls "$WORK/backups" | grep -v '^\.' | tail -n 1)
+SIZE=$(du -sb "$WORK/src" | cut -f1)
+
+(cd "$WORK" && exec stdbuf -oL "$SERVER") > "$WORK/serveur.log" 2>&1 &
+SERVER_PID=$!
+wait_listening "$WORK/serveur.log" || exit 1
+
+if tc qdisc add dev lo root netem delay "${DELAY}ms" 2>/dev/null; then
+    NETEM=1
+    echo "Latence : tc netem, ${DELAY} ms par sens"
+else
+    PORT=9090
+    python3 "$PROXY" "$PORT" 8080 "$DELAY" "$WINDOW" > "$WORK/relais.log" 2>&1 &
+    PROXY_PID=$!
+    wait_listening "$WORK/relais.log" || exit 1
+    echo "Latence : relais, ${DELAY} ms par sens, fenêtre de ${WINDOW} Ko par connexion"
+fi
+
+for streams in 1 4 8; do
+    mkdir -p "$WORK/r$streams"
+    start=$(date +%s.%N)
+    "$BACKUP" --restore "$WORK/backups/$LATEST" "$WORK/r$streams" \
+        --s-serveur 127.0.0.1 --s-port "$PORT" --streams "$streams" > /dev/null
+    end=$(date +%s.%N)
+    if diff -r "$WORK/src" "$WORK/r$streams" > /dev/null; then
+        awk -v s="$start" -v e="$end" -v n="$streams" -v size="$SIZE" \
+            'BEGIN { printf "%d flux : %.2f s (%.1f Mo/s)\n", n, e - s, size / 1000000 / (e - s) }'
+    else
+        echo "ÉCHEC : restauration sur $streams flux différente de la source"
+        status=1
+    fi
+done
+exit "$status"
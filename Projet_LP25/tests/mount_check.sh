@@ -0,0 +1,58 @@
+#!/bin/sh
+# Vérification du montage FUSE (make FUSE=1 check-mount) : monte deux sauvegardes (complète puis par
+# manifeste) et compare leur contenu, répertoires vides compris, avec la source
+# Usage : tests/mount_check.sh <exécutable backup>
+
+BACKUP=$(realpath "${1:-./backup}")
+WORK=$(mktemp -d)
+MOUNT="$WORK/mnt"
+status=1
+
+cleanup() {
+    fusermount3 -u "$MOUNT" 2>/dev/null || fusermount -u "$MOUNT" 2>/dev/null
+    [ -n "$MOUNT_PID" ] && wait "$MOUNT_PID" 2>/dev/null
+    rm -rf "$WORK"
+}
+trap cleanup EXIT
+
+mkdir -p "$WORK/src/dir/empty" "$WORK/src/vide" "$WORK/backups" "$MOUNT"
+echo "petit fichier" > "$WORK/src/dir/small.txt"
+head -c 3000000 /dev/urandom > "$WORK/src/large.bin"
+ln -s dir/small.txt "$WORK/src/lien"
+
+"$BACKUP" --backup "$WORK/src" "$WORK/backups" > /dev/null || exit 1
+sleep 1
+echo "ajouté" > "$WORK/src/dir/new.txt"
+"$BACKUP" --manifest-only --backup "$WORK/src" "$WORK/backups" > /dev/null || exit 1
+LATEST=$(ls "$WORK/backups" | tail -n 1)
+
+"$BACKUP" --mount "$WORK/backups" "$MOUNT" > "$WORK/mount.log" 2>&1 &
+MOUNT_PID=$!
+
+# Attendre que le montage soit actif (au plus 10 secondes)
+for i in 1 2 3 4 5 6 7 8 9 10; do
+    [ -d "$MOUNT/$LATEST" ] && break
+    sleep 1
+done
+if [ ! -d "$MOUNT/$LATEST" ]; then
+    echo "ÉCHEC : montage inactif"
+    cat "$WORK/mount.log"
+    exit 1
+fi
+
+# Contenu, liens symboliques et répertoires vides de la dernière sauvegarde
+if diff -r --no-dereference "$WORK/src" "$MOUNT/$LATEST"; then
+    # Lectures concurrentes d'un même fichier
+    cmp "$WORK/src/large.bin" "$MOUNT/$LATEST/large.bin" &
+    first=$!
+    cmp "$WORK/src/large.bin" "$MOUNT/$LATEST/large.bin" &
+    second=$!
+    wait "$first" && wait "$second" && status=0
+fi
+
+if [ "$status" -eq 0 ]; then
+    echo "Montage : OK"
+else
+    echo "ÉCHEC : contenu monté différent de la source"
+fi
+exit "$status"
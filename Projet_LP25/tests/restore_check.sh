@@ -0,0 +1,129 @@
+#!/bin/sh
+# Vérification des restaurations (make check) : sauvegarde puis restaure une même source dans chaque mode
+# (complète, par manifeste, regroupée, chiffrée, tar, depuis le serveur) et compare le résultat avec la
+# source : contenu, liens symboliques, liens physiques, droits, dates de modification et répertoires vides
+# Usage : tests/restore_check.sh <exécutable backup> <exécutable serveur>
+
+BACKUP=$(realpath "${1:-./backup}")
+SERVER=$(realpath "${2:-./serveur}")
+WORK=$(mktemp -d)
+failures=0
+
+cleanup() {
+    [ -n "$SERVER_PID" ] && kill "$SERVER_PID" 2>/dev/null && wait "$SERVER_PID" 2>/dev/null
+    rm -rf "$WORK"
+}
+trap cleanup EXIT
+
+# Source : petits et gros fichiers, répertoires vides, lien symbolique, lien physique, droits
+# particuliers et un nom contenant ".." (qui n'est pas un composant "..")
+mkdir -p "$WORK/src/dir/sub" "$WORK/src/vide/aussi_vide" "$WORK/src/prive"
+echo "petit fichier" > "$WORK/src/dir/small.txt"
+echo "nom avec points" > "$WORK/src/dir/a..b"
+head -c 3000000 /dev/urandom > "$WORK/src/large.bin"
+head -c 20000 /dev/urandom > "$WORK/src/dir/sub/moyen.bin"
+: > "$WORK/src/dir/empty.txt"
+ln -s dir/small.txt "$WORK/src/lien"
+ln "$WORK/src/large.bin" "$WORK/src/dir/physique.bin"
+chmod 700 "$WORK/src/prive"
+echo "secret" > "$WORK/src/prive/cle.txt"
+chmod 600 "$WORK/src/prive/cle.txt"
+chmod 755 "$WORK/src/dir/sub/moyen.bin"
+# Les dates sont à la seconde près, la seule précision du format tar
+find "$WORK/src" -type f -exec touch -d "2024-01-01 10:00:00" {} +
+head -c 32 /dev/urandom > "$WORK/key"
+for dir in plain manifest pack sealed tar r_plain r_manifest r_pack r_sealed r_tar \
+           r_remote_plain r_remote_manifest r_remote_sealed; do
+    mkdir -p "$WORK/$dir"
+done
+
+# Fonction pour décrire un arbre (type, droits, nombre de liens, date de modification) sans sa racine
+describe() {
+    (cd "$1" && find . -mindepth 1 ! -type l -printf "%p %y %m %n %T@\n" && find . -type l -printf "%p %l\n") | sort
+}
+
+# Fonction pour comparer une restauration avec la source et afficher le résultat du mode
+check() {
+    name=$1
+    restored=$2
+    if diff -r --no-dereference "$WORK/src" "$restored" > "$WORK/$name.diff" 2>&1 &&
+       describe "$WORK/src" > "$WORK/$name.src" && describe "$restored" > "$WORK/$name.out" &&
+       diff "$WORK/$name.src" "$WORK/$name.out" >> "$WORK/$name.diff"; then
+        echo "Restauration $name : OK"
+    else
+        echo "ÉCHEC : restauration $name différente de la source"
+        cat "$WORK/$name.diff"
+        failures=$((failures + 1))
+    fi
+}
+
+# Fonction pour fixer les dates des répertoires de la source (modifiées par la préparation)
+settle() {
+    find "$WORK/src" -mindepth 1 -type d -exec touch -d "2024-01-02 08:00:00" {} +
+}
+
+# Fonction pour créer deux sauvegardes (la seconde après une modification) et afficher le nom de la
+# dernière ; la source est remise dans le même état avant chaque mode
+backup_twice() {
+    dir=$1
+    shift
+    echo "petit fichier" > "$WORK/src/dir/small.txt"
+    settle
+    "$BACKUP" "$@" --backup "$WORK/src" "$dir" > /dev/null || return 1
+    sleep 1
+    echo "modifié" >> "$WORK/src/dir/small.txt"
+    touch -d "2024-01-01 12:00:00" "$WORK/src/dir/small.txt"
+    settle
+    "$BACKUP" "$@" --backup "$WORK/src" "$dir" > /dev/null || return 1
+    latest=$(ls "$dir" | grep -v '^\.' | tail -n 1)
+    [ -n "$latest" ] && echo "$latest"
+}
+
+LATEST=$(backup_twice "$WORK/plain") || { echo "ÉCHEC : sauvegarde impossible"; exit 1; }
+"$BACKUP" --restore "$WORK/plain/$LATEST" "$WORK/r_plain" > /dev/null
+check complète "$WORK/r_plain"
+
+LATEST=$(backup_twice "$WORK/manifest" --manifest-only) || exit 1
+"$BACKUP" --restore "$WORK/manifest/$LATEST" "$WORK/r_manifest" > /dev/null
+check manifeste "$WORK/r_manifest"
+
+LATEST=$(backup_twice "$WORK/pack" --pack) || exit 1
+"$BACKUP" --restore "$WORK/pack/$LATEST" "$WORK/r_pack" > /dev/null
+check regroupée "$WORK/r_pack"
+
+LATEST=$(backup_twice "$WORK/sealed" --encrypt-key "$WORK/key" --pack) || exit 1
+"$BACKUP" --encrypt-key "$WORK/key" --restore "$WORK/sealed/$LATEST" "$WORK/r_sealed" > /dev/null
+check chiffrée "$WORK/r_sealed"
+if "$BACKUP" --verify "$WORK/sealed" > /dev/null 2>&1; then
+    echo "ÉCHEC : dépôt chiffré vérifié sans clé"
+    failures=$((failures + 1))
+fi
+
+"$BACKUP" --export-tar "$WORK/plain/$(ls "$WORK/plain" | grep -v '^\.' | tail -n 1)" > "$WORK/snapshot.tar" &&
+    "$BACKUP" --import-tar "$WORK/tar" < "$WORK/snapshot.tar" > /dev/null
+LATEST=$(ls "$WORK/tar" | grep -v '^\.' | tail -n 1)
+"$BACKUP" --restore "$WORK/tar/$LATEST" "$WORK/r_tar" > /dev/null
+check tar "$WORK/r_tar"
+
+# Restaurations depuis le serveur (complète, par manifeste, chiffrée) sur plusieurs flux
+(cd "$WORK" && exec stdbuf -oL "$SERVER") > "$WORK/serveur.log" 2>&1 &
+SERVER_PID=$!
+
+# Attendre que le serveur écoute (au plus 10 secondes)
+for i in 1 2 3 4 5 6 7 8 9 10; do
+    grep -q "en écoute" "$WORK/serveur.log" && break
+    sleep 1
+done
+if ! grep -q "en écoute" "$WORK/serveur.log"; then
+    echo "ÉCHEC : serveur inactif"
+    cat "$WORK/serveur.log"
+    exit 1
+fi
+for mode in plain manifest sealed; do
+    LATEST=$(ls "$WORK/$mode" | grep -v '^\.' | tail -n 1)
+    "$BACKUP" --encrypt-key "$WORK/key" --restore "$WORK/$mode/$LATEST" "$WORK/r_remote_$mode" \
+        --s-serveur 127.0.0.1 --s-port 8080 --streams 4 > /dev/null
+    check "distante_$mode" "$WORK/r_remote_$mode"
+done
+
+[ "$failures" -eq 0 ]
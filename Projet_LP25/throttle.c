@@ -0,0 +1,275 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/syscall.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <sys/resource.h>
+#include "throttle.h"
+
+// Cible de ioprio_set : processus (ou thread) désigné par son identifiant
+#define IOPRIO_WHO_PROCESS 1
+#define IOPRIO_CLASS_SHIFT 13
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+// Limiteurs globaux (lecture, écriture, réseau), illimités par défaut
+static RateLimiter limiters[THROTTLE_COUNT] = {
+    {PTHREAD_MUTEX_INITIALIZER, 0, 0, 0, {0, 0}},
+    {PTHREAD_MUTEX_INITIALIZER, 0, 0, 0, {0, 0}},
+    {PTHREAD_MUTEX_INITIALIZER, 0, 0, 0, {0, 0}}
+};
+
+// État du mode adaptatif (lectures et écritures seulement : le réseau ne charge pas la source)
+typedef struct {
+    int enabled;
+    char stat_path[PATH_MAX];         // /sys/dev/block/<majeur>:<mineur>/stat du périphérique source
+    pthread_mutex_t lock;
+    struct timespec last;             // Dernier échantillon
+    unsigned long long ios, ticks;    // Compteurs du périphérique au dernier échantillon
+    double baseline;                  // Latence de référence en ms par E/S
+    double ceiling[2];                // Limites fixées par l'utilisateur (0 = illimité)
+    double peak[2];                   // Meilleur débit observé sans limitation
+    long long bytes[2];               // Octets décomptés depuis le dernier échantillon
+} AdaptiveThrottle;
+
+static AdaptiveThrottle adaptive = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+static double elapsed_seconds(const struct timespec *from, const struct timespec *to) {
+    return (to->tv_sec - from->tv_sec) + (to->tv_nsec - from->tv_nsec) / 1e9;
+}
+
+// Fonction pour initialiser un limiteur de débit (bytes_per_sec = 0 pour ne rien limiter)
+void rate_limiter_init(RateLimiter *limiter, double bytes_per_sec) {
+    pthread_mutex_init(&limiter->lock, NULL);
+    limiter->rate = bytes_per_sec;
+    // Une seconde de débit peut être consommée d'un coup après une pause
+    limiter->burst = bytes_per_sec;
+    limiter->tokens = limiter->burst;
+    clock_gettime(CLOCK_MONOTONIC, &limiter->last);
+}
+
+// Fonction pour changer le débit d'un limiteur en cours d'utilisation
+void rate_limiter_set_rate(RateLimiter *limiter, double bytes_per_sec) {
+    pthread_mutex_lock(&limiter->lock);
+    if (limiter->rate <= 0) {
+        // Passage d'illimité à limité : le seau repart plein à partir de maintenant
+        limiter->tokens = bytes_per_sec;
+        clock_gettime(CLOCK_MONOTONIC, &limiter->last);
+    } else if (limiter->tokens > bytes_per_sec) {
+        limiter->tokens = bytes_per_sec;
+    }
+    limiter->rate = bytes_per_sec;
+    limiter->burst = bytes_per_sec;
+    pthread_mutex_unlock(&limiter->lock);
+}
+
+// Fonction pour consommer des jetons, en attendant si le débit autorisé est dépassé
+// Le seau peut devenir négatif : chaque thread attend le temps de rembourser sa part,
+// ce qui répartit le débit entre les threads sans réveil collectif
+void rate_limiter_consume(RateLimiter *limiter, size_t bytes) {
+    if (limiter->rate <= 0) {
+        return;
+    }
+
+    struct timespec now;
+    pthread_mutex_lock(&limiter->lock);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    limiter->tokens += elapsed_seconds(&limiter->last, &now) * limiter->rate;
+    if (limiter->tokens > limiter->burst) {
+        limiter->tokens = limiter->burst;
+    }
+    limiter->last = now;
+    limiter->tokens -= bytes;
+    double wait = limiter->tokens < 0 ? -limiter->tokens / limiter->rate : 0;
+    pthread_mutex_unlock(&limiter->lock);
+
+    if (wait > 0) {
+        struct timespec delay;
+        delay.tv_sec = (time_t)wait;
+        delay.tv_nsec = (long)((wait - delay.tv_sec) * 1e9);
+        nanosleep(&delay, NULL);
+    }
+}
+
+// Fonction pour libérer les ressources d'un limiteur de débit
+void rate_limiter_destroy(RateLimiter *limiter) {
+    pthread_mutex_destroy(&limiter->lock);
+}
+
+// Fonction pour fixer le débit global d'un type d'E/S (0 = illimité)
+void throttle_set_limit(ThrottleKind kind, double bytes_per_sec) {
+    rate_limiter_set_rate(&limiters[kind], bytes_per_sec);
+    if (kind != THROTTLE_NETWORK) {
+        adaptive.ceiling[kind] = bytes_per_sec;
+    }
+}
+
+// Fonction pour lire les compteurs cumulés d'un périphérique bloc (nombre d'E/S et temps passé en ms)
+static int read_device_counters(const char *stat_path, unsigned long long *ios, unsigned long long *ticks) {
+    FILE *file = fopen(stat_path, "r");
+    if (!file) {
+        return -1;
+    }
+    unsigned long long read_ios, read_merges, read_sectors, read_ticks;
+    unsigned long long write_ios, write_merges, write_sectors, write_ticks;
+    int fields = fscanf(file, "%llu %llu %llu %llu %llu %llu %llu %llu",
+                        &read_ios, &read_merges, &read_sectors, &read_ticks,
+                        &write_ios, &write_merges, &write_sectors, &write_ticks);
+    fclose(file);
+    if (fields != 8) {
+        return -1;
+    }
+    *ios = read_ios + write_ios;
+    *ticks = read_ticks + write_ticks;
+    return 0;
+}
+
+// Fonction pour activer le mode adaptatif sur le périphérique contenant path
+int throttle_enable_adaptive(const char *path) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        perror("Erreur lors de l'accès à la source");
+        return -1;
+    }
+    snprintf(adaptive.stat_path, sizeof(adaptive.stat_path), "/sys/dev/block/%u:%u/stat",
+             major(st.st_dev), minor(st.st_dev));
+    if (read_device_counters(adaptive.stat_path, &adaptive.ios, &adaptive.ticks) != 0) {
+        // Systèmes de fichiers sans périphérique bloc propre (tmpfs, overlay, btrfs multi-disques...)
+        fprintf(stderr, "Mode adaptatif indisponible : pas de statistiques pour le périphérique %u:%u\n",
+                major(st.st_dev), minor(st.st_dev));
+        return -1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &adaptive.last);
+    adaptive.enabled = 1;
+    return 0;
+}
+
+// Fonction pour ajuster le débit d'un type d'E/S après un échantillon de latence
+// Réduction de moitié en cas de congestion, hausse de 10 % du plafond sinon
+static void adaptive_adjust(ThrottleKind kind, int congested, double elapsed) {
+    RateLimiter *limiter = &limiters[kind];
+    double observed = adaptive.bytes[kind] / elapsed;
+    double rate = limiter->rate;
+    double ceiling = adaptive.ceiling[kind];
+
+    if (rate <= 0 && observed > adaptive.peak[kind]) {
+        adaptive.peak[kind] = observed;
+    }
+
+    if (congested) {
+        double current = rate > 0 ? rate : observed;
+        if (current <= 0) return; // Ce type d'E/S n'a rien fait : il n'est pas en cause
+        double reduced = current / 2 < ADAPTIVE_MIN_RATE ? ADAPTIVE_MIN_RATE : current / 2;
+        rate_limiter_set_rate(limiter, reduced);
+    } else if (rate > 0) {
+        double target = ceiling > 0 ? ceiling : adaptive.peak[kind];
+        double raised = rate + (target > 0 ? target : rate) * 0.1;
+        if (target <= 0 || raised >= target) {
+            raised = ceiling; // Retour à la limite fixée, ou sans limite
+        }
+        rate_limiter_set_rate(limiter, raised);
+    }
+}
+
+// Fonction pour prendre un échantillon de latence du périphérique source si l'intervalle est écoulé
+// Un seul thread échantillonne ; les autres continuent sans attendre
+static void adaptive_sample(void) {
+    if (pthread_mutex_trylock(&adaptive.lock) != 0) {
+        return;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double elapsed = elapsed_seconds(&adaptive.last, &now);
+    unsigned long long ios, ticks;
+    if (elapsed * 1000 < ADAPTIVE_INTERVAL_MS || read_device_counters(adaptive.stat_path, &ios, &ticks) != 0) {
+        pthread_mutex_unlock(&adaptive.lock);
+        return;
+    }
+
+    unsigned long long delta_ios = ios - adaptive.ios;
+    double latency = delta_ios ? (double)(ticks - adaptive.ticks) / delta_ios : 0;
+    int congested = 0;
+    // Trop peu d'E/S : périphérique inactif, l'échantillon ne dit rien de la congestion
+    if (delta_ios >= 4) {
+        double threshold = adaptive.baseline * ADAPTIVE_LATENCY_RATIO;
+        congested = adaptive.baseline > 0 && latency > threshold && latency > ADAPTIVE_MIN_LATENCY_MS;
+        if (adaptive.baseline == 0 || latency < adaptive.baseline) {
+            adaptive.baseline = latency;
+        } else {
+            // Dérive lente : un périphérique durablement plus lent devient la nouvelle référence
+            adaptive.baseline += (latency - adaptive.baseline) * 0.02;
+        }
+    }
+
+    adaptive_adjust(THROTTLE_READ, congested, elapsed);
+    adaptive_adjust(THROTTLE_WRITE, congested, elapsed);
+    if (congested) {
+        printf("Latence du périphérique source : %.1f ms par E/S (référence %.1f ms), débit de lecture réduit à %.1f Mo/s\n",
+               latency, adaptive.baseline, limiters[THROTTLE_READ].rate / (1024 * 1024));
+    }
+
+    adaptive.ios = ios;
+    adaptive.ticks = ticks;
+    adaptive.bytes[THROTTLE_READ] = adaptive.bytes[THROTTLE_WRITE] = 0;
+    adaptive.last = now;
+    pthread_mutex_unlock(&adaptive.lock);
+}
+
+// Fonction pour décompter des octets lus, écrits ou reçus, en attendant si le débit global est dépassé
+void throttle_consume(ThrottleKind kind, size_t bytes) {
+    if (adaptive.enabled && kind != THROTTLE_NETWORK) {
+        __atomic_add_fetch(&adaptive.bytes[kind], (long long)bytes, __ATOMIC_RELAXED);
+        adaptive_sample();
+    }
+    rate_limiter_consume(&limiters[kind], bytes);
+}
+
+// Fonction pour fixer la priorité processeur (nice) du processus ; retourne 0 en cas de succès
+// Appelée avant la création des threads, qui en héritent
+int set_cpu_priority(int nice_level) {
+    if (setpriority(PRIO_PROCESS, 0, nice_level) == -1) {
+        perror("Erreur lors du changement de priorité processeur");
+        return -1;
+    }
+    return 0;
+}
+
+// Fonction pour fixer la priorité d'E/S du thread appelant ; retourne 0 en cas de succès
+int set_io_priority(int io_class, int level) {
+    if (io_class == IO_CLASS_NONE) {
+        return 0;
+    }
+    if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, (io_class << IOPRIO_CLASS_SHIFT) | level) == -1) {
+        perror("Erreur lors du changement de priorité d'E/S");
+        return -1;
+    }
+    return 0;
+}
+
+// Fonction pour analyser une priorité d'E/S de la forme "idle", "be[:niveau]" ou "rt[:niveau]"
+int parse_io_priority(const char *text, int *io_class, int *level) {
+    const char *colon = strchr(text, ':');
+    size_t name_len = colon ? (size_t)(colon - text) : strlen(text);
+
+    *level = colon ? atoi(colon + 1) : 4;
+    if (*level < 0 || *level > 7) {
+        return -1;
+    }
+
+    if (strncmp(text, "idle", name_len) == 0 && name_len == 4) {
+        *io_class = IO_CLASS_IDLE;
+        *level = 0;
+    } else if (strncmp(text, "be", name_len) == 0 && name_len == 2) {
+        *io_class = IO_CLASS_BEST_EFFORT;
+    } else if (strncmp(text, "rt", name_len) == 0 && name_len == 2) {
+        *io_class = IO_CLASS_REALTIME;
+    } else {
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,62 @@
+#ifndef THROTTLE_H
+#define THROTTLE_H
+
+#include <stddef.h>
+#include <pthread.h>
+#include <time.h>
+
+// Classes de priorité d'entrées/sorties (ioprio_set)
+#define IO_CLASS_NONE 0
+#define IO_CLASS_REALTIME 1
+#define IO_CLASS_BEST_EFFORT 2
+#define IO_CLASS_IDLE 3
+
+// Seau à jetons partagé entre plusieurs threads pour limiter un débit en octets par seconde
+typedef struct {
+    pthread_mutex_t lock;
+    double rate;              // Débit autorisé en octets/s (0 = illimité)
+    double tokens;            // Jetons disponibles (négatif = dette à rembourser en attendant)
+    double burst;             // Nombre maximal de jetons accumulés
+    struct timespec last;     // Dernier remplissage du seau
+} RateLimiter;
+
+// Débits globaux d'une sauvegarde, partagés par tous les threads
+typedef enum {
+    THROTTLE_READ,            // Lectures de la source et des sauvegardes
+    THROTTLE_WRITE,           // Écritures des copies et des restaurations
+    THROTTLE_NETWORK,         // Données reçues du serveur
+    THROTTLE_COUNT
+} ThrottleKind;
+
+// Mode adaptatif : latence moyenne mesurée toutes les ADAPTIVE_INTERVAL_MS sur le périphérique source
+#define ADAPTIVE_INTERVAL_MS 500
+// Latence jugée anormale au-delà de ce multiple de la latence de référence (et de ADAPTIVE_MIN_LATENCY_MS)
+#define ADAPTIVE_LATENCY_RATIO 2.0
+#define ADAPTIVE_MIN_LATENCY_MS 1.0
+// Débit plancher en mode adaptatif (1 Mo/s) : la sauvegarde ralentit sans jamais s'arrêter
+#define ADAPTIVE_MIN_RATE (1024.0 * 1024.0)
+
+// Fonction pour initialiser un limiteur de débit (bytes_per_sec = 0 pour ne rien limiter)
+void rate_limiter_init(RateLimiter *limiter, double bytes_per_sec);
+// Fonction pour changer le débit d'un limiteur en cours d'utilisation
+void rate_limiter_set_rate(RateLimiter *limiter, double bytes_per_sec);
+// Fonction pour consommer des jetons, en attendant si le débit autorisé est dépassé
+void rate_limiter_consume(RateLimiter *limiter, size_t bytes);
+// Fonction pour libérer les ressources d'un limiteur de débit
+void rate_limiter_destroy(RateLimiter *limiter);
+// Fonction pour fixer le débit global d'un type d'E/S (0 = illimité)
+void throttle_set_limit(ThrottleKind kind, double bytes_per_sec);
+// Fonction pour décompter des octets lus, écrits ou reçus, en attendant si le débit global est dépassé
+void throttle_consume(ThrottleKind kind, size_t bytes);
+// Fonction pour activer le mode adaptatif sur le périphérique contenant path ; retourne 0 en cas de succès
+// Les débits de lecture et d'écriture sont réduits de moitié quand la latence du périphérique
+// augmente, puis remontés progressivement jusqu'aux limites fixées (ou sans limite)
+int throttle_enable_adaptive(const char *path);
+// Fonction pour fixer la priorité processeur (nice) du processus ; retourne 0 en cas de succès
+int set_cpu_priority(int nice_level);
+// Fonction pour fixer la priorité d'E/S du thread appelant ; retourne 0 en cas de succès
+int set_io_priority(int io_class, int level);
+// Fonction pour analyser une priorité d'E/S de la forme "idle", "be[:niveau]" ou "rt[:niveau]"
+int parse_io_priority(const char *text, int *io_class, int *level);
+
+#endif // THROTTLE_H
@@ -0,0 +1,318 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <openssl/md5.h>
+#include <openssl/evp.h>
+#include "verify.h"
+#include "file_handler.h"
+#include "throttle.h"
+#include "cache_io.h"
+#include "pack.h"
+#include "seal.h"
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+// Résultat de la vérification d'un fichier d'une sauvegarde
+enum { VERIFY_PENDING, VERIFY_OK, VERIFY_CORRUPTED, VERIFY_MISSING, VERIFY_UNREADABLE };
+
+// Référence d'une sauvegarde vers un contenu stocké
+typedef struct {
+    int snapshot;             // Index de la sauvegarde
+    log_element *elt;         // Élément du log (chemin et MD5 attendu)
+    dev_t dev;
+    ino_t ino;
+    off_t offset;             // Plage des données dans un conteneur (0 et -1 sinon)
+    off_t length;
+    int status;
+} VerifyRef;
+
+// État partagé entre les threads de vérification
+typedef struct {
+    char (*snapshots)[256];
+    const char *backup_dir;
+    VerifyRef *refs;
+    int *groups;              // Indice de la première référence de chaque inode
+    int group_count;
+    int next_group;           // Prochain inode à vérifier
+    long long bytes_read;
+    pthread_mutex_t lock;
+    RateLimiter limiter;
+    const VerifyOptions *options;
+} VerifyState;
+
+static int compare_refs(const void *a, const void *b) {
+    const VerifyRef *ra = a, *rb = b;
+    if (ra->dev != rb->dev) return ra->dev < rb->dev ? -1 : 1;
+    if (ra->ino != rb->ino) return ra->ino < rb->ino ? -1 : 1;
+    if (ra->offset != rb->offset) return ra->offset < rb->offset ? -1 : 1;
+    if (ra->length != rb->length) return ra->length < rb->length ? -1 : 1;
+    return 0;
+}
+
+static int compare_refs_by_snapshot(const void *a, const void *b) {
+    const VerifyRef *ra = a, *rb = b;
+    if (ra->snapshot != rb->snapshot) return ra->snapshot - rb->snapshot;
+    return strcmp(ra->elt->path, rb->elt->path);
+}
+
+static int compare_names(const void *a, const void *b) {
+    return strcmp((const char *)a, (const char *)b);
+}
+
+// Fonction pour calculer le MD5 d'un fichier stocké (ou de sa plage d'un conteneur) en respectant le débit maximal
+static int hash_stored_file(VerifyState *state, const StoredData *stored, unsigned char *md5) {
+    SealReader reader;
+    if (seal_reader_open(&reader, stored->path, stored->offset, stored->length) != 0) {
+        return -1;
+    }
+
+    EVP_MD_CTX *md5_ctx = EVP_MD_CTX_new();
+    if (!md5_ctx || EVP_DigestInit_ex(md5_ctx, EVP_md5(), NULL) != 1) {
+        EVP_MD_CTX_free(md5_ctx);
+        seal_reader_close(&reader);
+        return -1;
+    }
+
+    // Lectures selon --cache-mode : un scrub complet ne doit pas vider le cache de pages
+    // Une copie chiffrée est déchiffrée : un segment altéré est refusé par son tag d'authentification
+    const unsigned char *data;
+    ssize_t bytes = 0;
+    off_t offset = 0;
+    while (offset < reader.size && (bytes = seal_reader_pread(&reader, offset, VERIFY_BUFFER_SIZE, &data)) > 0) {
+        rate_limiter_consume(&state->limiter, bytes);
+        EVP_DigestUpdate(md5_ctx, data, bytes);
+        offset += bytes;
+        pthread_mutex_lock(&state->lock);
+        state->bytes_read += bytes;
+        pthread_mutex_unlock(&state->lock);
+    }
+    seal_reader_close(&reader);
+
+    // Un conteneur tronqué avant la fin de la plage est illisible
+    int result = bytes < 0 || (stored->length >= 0 && offset < reader.size) ? -1 : 0;
+    if (result == 0 && EVP_DigestFinal_ex(md5_ctx, md5, NULL) != 1) {
+        result = -1;
+    }
+    EVP_MD_CTX_free(md5_ctx);
+    return result;
+}
+
+// Thread de vérification : prend les inodes un par un et compare leur MD5 à celui de chaque log
+static void *verify_worker(void *arg) {
+    VerifyState *state = (VerifyState *)arg;
+    set_io_priority(state->options->io_class, state->options->io_level);
+
+    while (1) {
+        pthread_mutex_lock(&state->lock);
+        int group = state->next_group++;
+        pthread_mutex_unlock(&state->lock);
+        if (group >= state->group_count) break;
+
+        int first = state->groups[group];
+        int last = state->groups[group + 1];
+        VerifyRef *ref = &state->refs[first];
+
+        StoredData stored;
+        stored_data_locate(state->backup_dir, state->snapshots[ref->snapshot], ref->elt, &stored);
+
+        unsigned char md5[MD5_DIGEST_LENGTH];
+        int readable = hash_stored_file(state, &stored, md5) == 0;
+
+        // Toutes les sauvegardes partageant cet inode reçoivent le même verdict
+        for (int i = first; i < last; i++) {
+            if (!readable) {
+                state->refs[i].status = VERIFY_UNREADABLE;
+            } else if (memcmp(md5, state->refs[i].elt->md5, MD5_DIGEST_LENGTH) != 0) {
+                state->refs[i].status = VERIFY_CORRUPTED;
+            } else {
+                state->refs[i].status = VERIFY_OK;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+// Fonction pour lister les sauvegardes (dossiers contenant un .backup_log), triées par nom
+static int list_snapshots(const char *backup_dir, char (**names)[256]) {
+    DIR *dp = opendir(backup_dir);
+    if (!dp) {
+        perror("Erreur lors de l'ouverture du répertoire de sauvegarde");
+        return -1;
+    }
+
+    int count = 0;
+    struct dirent *entry;
+    *names = NULL;
+    while ((entry = readdir(dp)) != NULL) {
+        if (entry->d_name[0] == '.') continue;
+
+        char log_path[PATH_MAX];
+        struct stat log_stat;
+        snprintf(log_path, sizeof(log_path), "%s/%s/.backup_log", backup_dir, entry->d_name);
+        if (stat(log_path, &log_stat) != 0 || !S_ISREG(log_stat.st_mode)) continue;
+
+        char (*grown)[256] = realloc(*names, (count + 1) * sizeof(**names));
+        if (!grown) break;
+        *names = grown;
+        snprintf((*names)[count++], 256, "%s", entry->d_name);
+    }
+    closedir(dp);
+
+    qsort(*names, count, sizeof(**names), compare_names);
+    return count;
+}
+
+// Fonction pour vérifier l'intégrité de toutes les sauvegardes d'un répertoire
+int verify_backups(const char *backup_dir, const VerifyOptions *options) {
+    VerifyState state;
+    memset(&state, 0, sizeof(state));
+    state.backup_dir = backup_dir;
+    state.options = options;
+
+    // Les copies chiffrées ne peuvent être relues qu'avec la clé du répertoire
+    if (seal_check_repository(backup_dir, 0) != 0) {
+        return -1;
+    }
+
+    int snapshot_count = list_snapshots(backup_dir, &state.snapshots);
+    if (snapshot_count < 0) {
+        return -1;
+    }
+
+    // Lire tous les logs et identifier l'inode stocké de chaque fichier
+    log_t *logs = calloc(snapshot_count ? snapshot_count : 1, sizeof(log_t));
+    int ref_count = 0, ref_capacity = 0;
+    int problems = 0;
+    for (int s = 0; s < snapshot_count; s++) {
+        char log_path[PATH_MAX];
+        snprintf(log_path, sizeof(log_path), "%s/%s/.backup_log", backup_dir, state.snapshots[s]);
+        logs[s] = read_backup_log(log_path);
+
+        for (log_element *elt = logs[s].head; elt; elt = elt->next) {
+            StoredData stored;
+            struct stat st;
+            // Un fichier repris par une sauvegarde par manifeste est relu dans la sauvegarde qui le stocke,
+            // un fichier regroupé dans sa plage du conteneur
+            stored_data_locate(backup_dir, state.snapshots[s], elt, &stored);
+            const char *path = stored.path;
+            if (lstat(path, &st) != 0) {
+                printf("[%s] MANQUANT : %s\n", state.snapshots[s], elt->path);
+                problems++;
+                continue;
+            }
+
+            // Un lien symbolique est vérifié immédiatement : son MD5 est celui de sa cible
+            if (S_ISLNK(st.st_mode)) {
+                char target[PATH_MAX];
+                unsigned char md5[MD5_DIGEST_LENGTH];
+                ssize_t len = readlink(path, target, sizeof(target));
+                if (len < 0) {
+                    printf("[%s] ILLISIBLE : %s\n", state.snapshots[s], elt->path);
+                    problems++;
+                    continue;
+                }
+                EVP_Digest(target, len, md5, NULL, EVP_md5(), NULL);
+                if (memcmp(md5, elt->md5, MD5_DIGEST_LENGTH) != 0) {
+                    printf("[%s] CORROMPU : %s\n", state.snapshots[s], elt->path);
+                    problems++;
+                }
+                continue;
+            }
+
+            if (ref_count == ref_capacity) {
+                ref_capacity = ref_capacity ? ref_capacity * 2 : 1024;
+                VerifyRef *grown = realloc(state.refs, ref_capacity * sizeof(VerifyRef));
+                if (!grown) {
+                    perror("Erreur d'allocation mémoire pour la vérification");
+                    break;
+                }
+                state.refs = grown;
+            }
+            VerifyRef *ref = &state.refs[ref_count++];
+            ref->snapshot = s;
+            ref->elt = elt;
+            ref->dev = st.st_dev;
+            ref->ino = st.st_ino;
+            ref->offset = stored.offset;
+            ref->length = stored.length;
+            ref->status = VERIFY_PENDING;
+        }
+    }
+
+    // Regrouper les références par inode : chaque contenu ne sera lu qu'une fois
+    qsort(state.refs, ref_count, sizeof(VerifyRef), compare_refs);
+    state.groups = malloc((ref_count + 1) * sizeof(int));
+    for (int i = 0; i < ref_count; i++) {
+        if (i == 0 || compare_refs(&state.refs[i - 1], &state.refs[i]) != 0) {
+            state.groups[state.group_count++] = i;
+        }
+    }
+    state.groups[state.group_count] = ref_count;
+
+    // Lancer les threads de vérification
+    int thread_count = options->threads;
+    if (thread_count <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        thread_count = cpus > 0 ? (int)cpus : 1;
+    }
+    pthread_mutex_init(&state.lock, NULL);
+    rate_limiter_init(&state.limiter, options->max_read_rate);
+
+    pthread_t *threads = malloc(thread_count * sizeof(pthread_t));
+    int launched = 0;
+    for (int i = 0; i < thread_count; i++) {
+        if (pthread_create(&threads[launched], NULL, verify_worker, &state) == 0) {
+            launched++;
+        }
+    }
+    if (launched == 0) {
+        verify_worker(&state);
+    }
+    for (int i = 0; i < launched; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    // Rapport par sauvegarde : les références sont retriées par sauvegarde puis par chemin
+    qsort(state.refs, ref_count, sizeof(VerifyRef), compare_refs_by_snapshot);
+    int i = 0;
+    for (int s = 0; s < snapshot_count; s++) {
+        int files = 0, bad = 0;
+        for (; i < ref_count && state.refs[i].snapshot == s; i++) {
+            VerifyRef *ref = &state.refs[i];
+            files++;
+            if (ref->status == VERIFY_CORRUPTED) {
+                printf("[%s] CORROMPU : %s\n", state.snapshots[s], ref->elt->path);
+                bad++;
+            } else if (ref->status == VERIFY_UNREADABLE) {
+                printf("[%s] ILLISIBLE : %s\n", state.snapshots[s], ref->elt->path);
+                bad++;
+            }
+        }
+        printf("Sauvegarde %s : %d fichiers vérifiés, %d en erreur\n", state.snapshots[s], files, bad);
+        problems += bad;
+    }
+
+    printf("Vérification terminée : %d références, %d contenus uniques relus (%lld octets), %d problèmes\n",
+           ref_count, state.group_count, state.bytes_read, problems);
+
+    rate_limiter_destroy(&state.limiter);
+    pthread_mutex_destroy(&state.lock);
+    free(threads);
+    free(state.groups);
+    free(state.refs);
+    for (int s = 0; s < snapshot_count; s++) {
+        free_backup_log(&logs[s]);
+    }
+    free(logs);
+    free(state.snapshots);
+    return problems;
+}
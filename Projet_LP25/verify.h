@@ -0,0 +1,20 @@
+#ifndef VERIFY_H
+#define VERIFY_H
+
+// Taille des lectures utilisées pour recalculer les MD5 (1 Mo au plus)
+#define VERIFY_BUFFER_SIZE (1024 * 1024)
+
+// Options de la vérification des sauvegardes
+typedef struct {
+    int threads;              // Nombre de threads de vérification (0 = nombre de cœurs)
+    double max_read_rate;     // Débit de lecture maximal en octets/s (0 = illimité)
+    int io_class;             // Classe de priorité d'E/S (IO_CLASS_NONE pour ne pas la changer)
+    int io_level;             // Niveau de priorité dans la classe (0-7)
+} VerifyOptions;
+
+// Fonction pour vérifier l'intégrité de toutes les sauvegardes d'un répertoire
+// Chaque contenu stocké (inode) n'est relu qu'une fois, même s'il est partagé par plusieurs sauvegardes.
+// Retourne le nombre de fichiers corrompus ou manquants, -1 en cas d'erreur
+int verify_backups(const char *backup_dir, const VerifyOptions *options);
+
+#endif // VERIFY_H